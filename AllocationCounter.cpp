@@ -0,0 +1,61 @@
+#include "AllocationCounter.hpp"
+
+#ifdef DEBUG
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<uint64_t> allocation_count(0);
+thread_local uint64_t thread_allocation_count = 0;
+
+void CountAllocation() {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  thread_allocation_count++;
+}
+
+void *CountedAllocate(std::size_t size) {
+  CountAllocation();
+  void *ptr = std::malloc(size != 0 ? size : 1);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+}  // namespace
+
+void *operator new(std::size_t size) { return CountedAllocate(size); }
+void *operator new[](std::size_t size) { return CountedAllocate(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  CountAllocation();
+  return std::malloc(size != 0 ? size : 1);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  CountAllocation();
+  return std::malloc(size != 0 ? size : 1);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+uint64_t AllocationCounter::Count() {
+  return allocation_count.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::ThreadCount() { return thread_allocation_count; }
+
+bool AllocationCounter::Enabled() { return true; }
+
+#else
+
+uint64_t AllocationCounter::Count() { return 0; }
+
+uint64_t AllocationCounter::ThreadCount() { return 0; }
+
+bool AllocationCounter::Enabled() { return false; }
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef AllocationCounter_HPP
+#define AllocationCounter_HPP
+
+#include <cstdint>
+
+/// Counts calls to the global operator new. Only DEBUG builds replace
+/// operator new to do this; in other builds the count is always zero.
+///
+/// Count() is process wide, so allocations made by other threads between
+/// two reads (the shader compile worker, the host application) are included.
+/// ThreadCount() only sees the calling thread.
+namespace AllocationCounter {
+
+/// Total number of allocations made so far.
+uint64_t Count();
+
+/// Number of allocations the calling thread has made so far.
+uint64_t ThreadCount();
+
+/// True if this build counts allocations.
+bool Enabled();
+
+}  // namespace AllocationCounter
+
+#endif
@@ -4,44 +4,47 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
+#include <algorithm>
 #include <limits>
+#include <vector>
 
 /// A function object which calculates the maximum-weighted bipartite matching between
 /// two sets via the hungarian method.
-template <int N=20>
+///
+/// Costs are single precision to keep the matrix small; labels are kept in double
+/// precision. Scratch storage is sized on demand and reused, so repeated solves of
+/// similar size do not allocate.
 class HungarianMethod {
-public :
-static const size_t MAX_SIZE = N;
 
 private:
 size_t n, max_match;        //n workers and n jobs
-double lx[N], ly[N];        //labels of X and Y parts
-int xy[N];               //xy[x] - vertex that is matched with x,
-int yx[N];               //yx[y] - vertex that is matched with y
-bool S[N], T[N];         //sets S and T in algorithm
-double slack[N];            //as in the algorithm description
-double slackx[N];           //slackx[y] such a vertex, that
-                         // l(slackx[y]) + l(y) - w(slackx[y],y) = slack[y]
-int prev[N];             //array for memorizing alternating paths
-
-void init_labels(const double cost[N][N])
+std::vector<double> lx, ly; //labels of X and Y parts
+std::vector<int> xy;        //xy[x] - vertex that is matched with x,
+std::vector<int> yx;        //yx[y] - vertex that is matched with y
+std::vector<char> S, T;     //sets S and T in algorithm
+std::vector<double> slack;  //as in the algorithm description
+std::vector<int> slackx;    //slackx[y] such a vertex, that
+                            // l(slackx[y]) + l(y) - w(slackx[y],y) = slack[y]
+std::vector<int> prev;      //array for memorizing alternating paths
+std::vector<int> q;         //queue for bfs
+
+void init_labels(const float *cost)
 {
-    memset(lx, 0, sizeof(lx));
-    memset(ly, 0, sizeof(ly));
+    lx.assign(n, std::numeric_limits<double>::lowest());
+    ly.assign(n, 0.0);
     for (unsigned int x = 0; x < n; x++)
         for (unsigned int y = 0; y < n; y++)
-            lx[x] = std::max(lx[x], cost[x][y]);
+            lx[x] = std::max(lx[x], static_cast<double>(cost[x * n + y]));
 }
 
-void augment(const double cost[N][N]) //main function of the algorithm
+void augment(const float *cost) //main function of the algorithm
 {
     if (max_match == n) return;        //check wether matching is already perfect
     unsigned int x, y, root = 0;                //just counters and root vertex
-    int q[N], wr = 0, rd = 0;          //q - queue for bfs, wr,rd - write and read
-                                       //pos in queue
-    memset(S, false, sizeof(S));       //init set S
-    memset(T, false, sizeof(T));       //init set T
-    memset(prev, -1, sizeof(prev));    //init set prev - for the alternating tree
+    int wr = 0, rd = 0;                //wr,rd - write and read pos in queue
+    S.assign(n, false);                //init set S
+    T.assign(n, false);                //init set T
+    prev.assign(n, -1);                //init set prev - for the alternating tree
     for (x = 0; x < n; x++)            //finding root of the tree
         if (xy[x] == -1)
         {
@@ -53,7 +56,7 @@ void augment(const double cost[N][N]) //main function of the algorithm
 
     for (y = 0; y < n; y++)            //initializing slack array
     {
-        slack[y] = lx[root] + ly[y] - cost[root][y];
+        slack[y] = lx[root] + ly[y] - cost[root * n + y];
         slackx[y] = root;
     }
    while (true)                                                        //main cycle
@@ -62,7 +65,7 @@ void augment(const double cost[N][N]) //main function of the algorithm
         {
             x = q[rd++];                                                //current vertex from X part
             for (y = 0; y < n; y++)                                     //iterate through all edges in equality graph
-                if (cost[x][y] == lx[x] + ly[y] &&  !T[y])
+                if (cost[x * n + y] == lx[x] + ly[y] &&  !T[y])
                 {
                     if (yx[y] == -1) break;                             //an exposed vertex in Y found, so
                                                                         //augmenting path exists!
@@ -134,16 +137,16 @@ void update_labels()
             slack[y] -= delta;
 }
 
-void add_to_tree(int x, int prevx, const double cost[N][N])
+void add_to_tree(int x, int prevx, const float *cost)
 //x - current vertex,prevx - vertex from X before x in the alternating path,
 //so we add edges (prevx, xy[x]), (xy[x], x)
 {
     S[x] = true;                    //add x to S
     prev[x] = prevx;                //we need this when augmenting
     for (unsigned int y = 0; y < n; y++)    //update slacks, because we add new vertex to S
-        if (lx[x] + ly[y] - cost[x][y] < slack[y])
+        if (lx[x] + ly[y] - cost[x * n + y] < slack[y])
         {
-            slack[y] = lx[x] + ly[y] - cost[x][y];
+            slack[y] = lx[x] + ly[y] - cost[x * n + y];
             slackx[y] = x;
         }
 }
@@ -151,22 +154,25 @@ void add_to_tree(int x, int prevx, const double cost[N][N])
 public:
 /// Computes the best matching of two sets given its cost matrix.
 /// See the matching() method to get the computed match result.
-/// \param cost a matrix of two sets I,J where cost[i][j] is the weight of edge i->j
+/// \param cost a row major logicalSize x logicalSize matrix of two sets I,J where
+/// cost[i * logicalSize + j] is the weight of edge i->j
 /// \param logicalSize the number of elements in both I and J
 /// \returns the total cost of the best matching
-inline double operator()(const double cost[N][N], size_t logicalSize)
+inline double operator()(const float *cost, size_t logicalSize)
 {
 
     n = logicalSize;
-    assert(n <= N);
     double ret = 0;                      //weight of the optimal matching
     max_match = 0;                    //number of vertices in current matching
-    memset(xy, -1, sizeof(xy));
-    memset(yx, -1, sizeof(yx));
+    xy.assign(n, -1);
+    yx.assign(n, -1);
+    slack.resize(n);
+    slackx.resize(n);
+    q.resize(n);
     init_labels(cost);                    //step 0
     augment(cost);                        //steps 1-3
     for (unsigned int x = 0; x < n; x++)       //forming answer there
-        ret += cost[x][xy[x]];
+        ret += cost[x * n + xy[x]];
     return ret;
 }
 
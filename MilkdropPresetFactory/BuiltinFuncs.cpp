@@ -19,7 +19,8 @@
 #include <iostream>
 #include "fatal.h"
 
-std::map<std::string, Func*> BuiltinFuncs::builtin_func_tree;
+std::vector<Func*> BuiltinFuncs::builtin_funcs;
+SymbolTable BuiltinFuncs::builtin_func_symbols;
 
 int BuiltinFuncs::load_builtin_func(const std::string & name, float (*func_ptr)(float*), int num_args, int id) {
 	
@@ -40,14 +41,14 @@ int BuiltinFuncs::load_builtin_func(const std::string & name, float (*func_ptr)(
 
 Func * BuiltinFuncs::find_func(const std::string & name) {
 
-  std::map<std::string, Func*>::iterator pos = builtin_func_tree.find(name);
+  const int index = builtin_func_symbols.find(name);
 
   // Case: function not found, return null
-  if (pos == builtin_func_tree.end())
+  if (index < 0)
 	return 0;
 
   // Case: function found, return a pointer to it
-  return pos->second;
+  return builtin_funcs[index];
 
 }
 
@@ -120,6 +121,11 @@ int BuiltinFuncs::load_all_builtin_func() {
     return PROJECTM_ERROR;
   if (load_builtin_func("print", FuncWrappers::print_wrapper, 1) < 0)
       return PROJECTM_ERROR;
+
+  SymbolTable::Symbols symbols;
+  for (size_t i = 0; i < builtin_funcs.size(); i++)
+    symbols.push_back(std::make_pair(builtin_funcs[i]->getName(), static_cast<int>(i)));
+  builtin_func_symbols = SymbolTable(symbols);
   return PROJECTM_SUCCESS;
 }
 
@@ -145,9 +151,10 @@ int BuiltinFuncs::init_builtin_func_db() {
    Generally, do this on projectm exit */
 int BuiltinFuncs::destroy_builtin_func_db() {
 
-traverse<TraverseFunctors::Delete<Func> >(builtin_func_tree);
+traverseVector<TraverseFunctors::Delete<Func> >(builtin_funcs);
 
-builtin_func_tree.clear();
+builtin_funcs.clear();
+builtin_func_symbols = SymbolTable();
 initialized = false;
 return PROJECTM_SUCCESS;
 }
@@ -164,18 +171,15 @@ int BuiltinFuncs::insert_func( Func *func ) {
   
 //   //std::cout << "inserting function " << func->getName() << std::endl;
   
-  const std::pair<std::string, Func*> pair = std::make_pair(std::string(func->getName()), func);
-  
-  assert(pair.second);
-  
-  const std::pair<std::map<std::string, Func*>::iterator, bool> inserteePair =
-  	builtin_func_tree.insert(pair);
-  	
-  if (!inserteePair.second) {
+  for (const Func *other : builtin_funcs) {
+    if (other->getName() == func->getName()) {
 	std::cerr << "Failed to insert builtin function \"" << func->getName() << "\" into collection! Bailing..." << std::endl;
 	abort();
+    }
   }
 
+  builtin_funcs.push_back(func);
+
   return PROJECTM_SUCCESS;
 }
 
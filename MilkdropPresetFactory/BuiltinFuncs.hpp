@@ -230,7 +230,8 @@ return (float)result;
 }
 };
 
-#include <map>
+#include <vector>
+#include "SymbolTable.hpp"
 class BuiltinFuncs {
 
 public:
@@ -244,7 +245,9 @@ public:
     static int remove_func( Func *func );
     static Func *find_func( const std::string & name );
 private:
-     static std::map<std::string, Func*> builtin_func_tree;
+     static std::vector<Func*> builtin_funcs;
+     // Names of builtin_funcs, filled in once all are loaded
+     static SymbolTable builtin_func_symbols;
      static volatile bool initialized;
 };
 
@@ -9,9 +9,19 @@
 #include <stdio.h>
 #include "Common.hpp"
 
-BuiltinParams::BuiltinParams() {}
+namespace {
+// Shared by the parameter databases of every preset
+ParamTable::Symbols & symbols()
+{
+  static ParamTable::Symbols symbols;
+  return symbols;
+}
+}
 
-BuiltinParams::BuiltinParams(PresetInputs & presetInputs, PresetOutputs & presetOutputs)
+BuiltinParams::BuiltinParams() : builtin_params(symbols()), mesh_stride(0) {}
+
+BuiltinParams::BuiltinParams(PresetInputs & presetInputs, PresetOutputs & presetOutputs) :
+  builtin_params(symbols()), mesh_stride(0)
 {
 
   presetInputs.Initialize(presetOutputs.mesh_width(), presetOutputs.mesh_height());
@@ -52,7 +62,7 @@ int BuiltinParams::load_builtin_param_float(const std::string & name, void * eng
 std::string lowerName(name);
 std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), tolower);
 
-  if ((param = Param::create(lowerName, P_TYPE_DOUBLE, flags, engine_val, matrix, iv, ub, lb)) == NULL)
+  if ((param = Param::create(lowerName, P_TYPE_DOUBLE, flags, engine_val, matrix, iv, ub, lb, mesh_stride)) == NULL)
   {
     return PROJECTM_OUTOFMEM_ERROR;
   }
@@ -107,7 +117,7 @@ std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), tolower);
 int BuiltinParams::destroy_builtin_param_db()
 {
 
-  traverse<TraverseFunctors::Delete<Param> >(builtin_param_tree);
+  builtin_params.clear();
   return PROJECTM_SUCCESS;
 }
 
@@ -118,40 +128,14 @@ int BuiltinParams::insert_param_alt_name(Param * param, const std::string & alt_
 
   assert(param);
 
-  aliasMap.insert(std::make_pair(alt_name, param->name));
+  builtin_params.insert_alias(alt_name, param);
 
   return PROJECTM_SUCCESS;
 }
 
 Param * BuiltinParams::find_builtin_param(const std::string & name)
 {
-
-
-
-  AliasMap::iterator pos = aliasMap.find(name);
-  Param * param = 0;
-  //std::cerr << "[BuiltinParams] find_builtin_param: name is " << name << std::endl;
-  if (pos == aliasMap.end())
-  {
-    std::map<std::string, Param*>::iterator builtinPos = builtin_param_tree.find(name);
-
-    if (builtinPos != builtin_param_tree.end()) {
-    //  std::cerr << "[BuiltinParams] find_builtin_param: found it directly." << std::endl;
-      param = builtinPos->second;
-     }
-  }
-  else
-  {
-
-    std::map<std::string, Param*>::iterator builtinPos = builtin_param_tree.find(pos->second);
-
-    if (builtinPos != builtin_param_tree.end()) {
-      //std::cerr << "[BuiltinParams] find_builtin_param: found it indirectly." << std::endl;
-      param = builtinPos->second;
-
-}
-  }
-  return param;
+  return builtin_params.find(name);
 }
 
 
@@ -251,9 +235,9 @@ std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), tolower);
 /* Inserts a parameter into the builtin database */
 int BuiltinParams::insert_builtin_param( Param *param )
 {
-  std::pair<std::map<std::string, Param*>::iterator, bool> inserteePos = builtin_param_tree.insert(std::make_pair(param->name, param));
+  builtin_params.insert(param);
 
-  return inserteePos.second;
+  return PROJECTM_SUCCESS;
 }
 
 
@@ -287,6 +271,9 @@ int BuiltinParams::init_builtin_param_db(const PresetInputs & presetInputs, Pres
 /* Loads all builtin parameters, limits are also defined here */
 int BuiltinParams::load_all_builtin_param(const PresetInputs & presetInputs, PresetOutputs & presetOutputs)
 {
+  // the per pixel matrices of both are laid out for the same mesh
+  assert(presetInputs.mesh_stride() == presetOutputs.mesh_stride());
+  mesh_stride = presetOutputs.mesh_stride();
 
   load_builtin_param_float("frating", (void*)&presetOutputs.fRating, NULL, P_FLAG_NONE, 0.0 , 5.0, 0.0, "");
   load_builtin_param_float("fwavescale", (void*)&presetOutputs.wave->scale, NULL, P_FLAG_NONE, 0.0, MAX_DOUBLE_SIZE, -MAX_DOUBLE_SIZE, "");
@@ -395,9 +382,9 @@ int BuiltinParams::load_all_builtin_param(const PresetInputs & presetInputs, Pre
                            0, MAX_DOUBLE_SIZE, -MAX_DOUBLE_SIZE, "");
 
   for (unsigned int i = 0; i < NUM_Q_VARIABLES;i++) {
-	std::ostringstream os;
-	os << "q" << i+1;
-	load_builtin_param_float(os.str().c_str(), (void*)&presetOutputs.q[i],  NULL, P_FLAG_QVAR, 0, MAX_DOUBLE_SIZE, -MAX_DOUBLE_SIZE, "");
+	char name[16];
+	snprintf(name, sizeof(name), "q%u", i+1);
+	load_builtin_param_float(name, (void*)&presetOutputs.q[i],  NULL, P_FLAG_QVAR, 0, MAX_DOUBLE_SIZE, -MAX_DOUBLE_SIZE, "");
 
   }
 
@@ -405,6 +392,8 @@ int BuiltinParams::load_all_builtin_param(const PresetInputs & presetInputs, Pre
   load_builtin_param_int("meshx", (void*)&presetInputs.gx, P_FLAG_READONLY, 32, 96, 8, "");
   load_builtin_param_int("meshy", (void*)&presetInputs.gy, P_FLAG_READONLY, 24, 72, 6, "");
 
+  builtin_params.finish();
+
   return PROJECTM_SUCCESS;
 
 }
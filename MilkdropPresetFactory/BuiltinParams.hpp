@@ -30,14 +30,12 @@
 #include <string>
 #include "PresetFrameIO.hpp"
 #include "Param.hpp"
-#include <map>
+#include "ParamTable.hpp"
 #include <cstdio>
 
 class BuiltinParams {
 
 public:
-   typedef std::map<std::string, std::string> AliasMap;
-
     /** Default constructor leaves database in an uninitialized state.  */
     BuiltinParams();
 
@@ -70,17 +68,17 @@ public:
 
     template <class Fun>
     void apply(Fun & fun) {
-	traverse(builtin_param_tree, fun);
+	builtin_params.apply(fun);
     }
 
 
 private:
     static const bool BUILTIN_PARAMS_DEBUG = false;
 
-    // Used to associate multiple string names to one parameter
-    AliasMap aliasMap;
+    // Internal datastructure to store the parameters, alternate names included
+    ParamTable builtin_params;
 
-    // Internal datastructure to store the parameters
-    std::map<std::string,Param*> builtin_param_tree;
+    // Stride of the per pixel matrices being loaded, see MeshPlanes
+    int mesh_stride;
 };
 #endif
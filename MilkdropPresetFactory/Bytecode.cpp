@@ -0,0 +1,401 @@
+/**
+ * projectM -- Milkdrop-esque visualisation SDK
+ * Copyright (C)2003-2007 projectM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * See 'LICENSE.txt' included within this release
+ *
+ */
+
+#include "Bytecode.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#include "Common.hpp"
+
+/* GCC and clang can jump straight from one handler to the next through label
+   addresses; everything else dispatches through a switch. */
+#if defined(__GNUC__)
+#define BYTECODE_THREADED 1
+#endif
+
+namespace {
+
+/* An instruction with its operands resolved to memory */
+struct Op
+{
+    const void *handler;
+    float *dst;
+    const float *a, *b, *c;
+    const Op *jump;
+    void *ref;
+    short int *flag;
+    int stride;
+    float (*func)(float *);
+    BytecodeOp op;
+};
+
+/* Runs code from ip to its RETURN. Called with a null ip, stores the handler
+   of each opcode in labels instead (direct threaded builds only). */
+float execute(const Op *ip, int mesh_i, int mesh_j, const void *const **labels)
+{
+#ifdef BYTECODE_THREADED
+    static const void *const handlers[BYTECODE_OP_COUNT] = {
+#define BYTECODE_LABEL(name) &&op_##name,
+        BYTECODE_OPS(BYTECODE_LABEL)
+#undef BYTECODE_LABEL
+    };
+    if (ip == nullptr)
+    {
+        *labels = handlers;
+        return 0;
+    }
+#define OP(name) op_##name:
+#define NEXT() do { ++ip; goto *ip->handler; } while (0)
+#define GOTO(target) do { ip = (target); goto *ip->handler; } while (0)
+    goto *ip->handler;
+#else
+    (void)labels;
+#define OP(name) case BYTECODE_##name:
+#define NEXT() do { ++ip; goto dispatch; } while (0)
+#define GOTO(target) do { ip = (target); goto dispatch; } while (0)
+dispatch:
+    switch (ip->op)
+    {
+#endif
+
+    OP(RETURN)
+        return *ip->a;
+    OP(MOV)
+        *ip->dst = *ip->a;
+        NEXT();
+    OP(ADD)
+        *ip->dst = *ip->a + *ip->b;
+        NEXT();
+    OP(SUB)
+        *ip->dst = *ip->a - *ip->b;
+        NEXT();
+    OP(MUL)
+        *ip->dst = *ip->a * *ip->b;
+        NEXT();
+    OP(DIV)
+        *ip->dst = *ip->b == 0 ? MAX_DOUBLE_SIZE : *ip->a / *ip->b;
+        NEXT();
+    OP(MOD)
+        *ip->dst = (int)*ip->b == 0 ? 0 : (int)*ip->a % (int)*ip->b;
+        NEXT();
+    OP(OR)
+        *ip->dst = (int)*ip->a | (int)*ip->b;
+        NEXT();
+    OP(AND)
+        *ip->dst = (int)*ip->a & (int)*ip->b;
+        NEXT();
+    OP(MUL_ADD)
+        *ip->dst = *ip->a * *ip->b + *ip->c;
+        NEXT();
+    OP(MUL_CONST)
+        *ip->dst = *ip->a * *ip->b;
+        NEXT();
+    OP(SQR)
+        *ip->dst = *ip->a * *ip->a;
+        NEXT();
+    OP(SIN)
+        *ip->dst = sinf(*ip->a);
+        NEXT();
+    OP(COS)
+        *ip->dst = cosf(*ip->a);
+        NEXT();
+    OP(LOG)
+        *ip->dst = logf(*ip->a);
+        NEXT();
+    OP(SIN_MUL_ADD)
+        *ip->dst = sinf(*ip->a * *ip->b + *ip->c);
+        NEXT();
+    OP(COS_MUL_ADD)
+        *ip->dst = cosf(*ip->a * *ip->b + *ip->c);
+        NEXT();
+    OP(SIN_MUL_CONST)
+        *ip->dst = sinf(*ip->a * *ip->b);
+        NEXT();
+    OP(COS_MUL_CONST)
+        *ip->dst = cosf(*ip->a * *ip->b);
+        NEXT();
+    OP(CALL1)
+    {
+        float arg = *ip->a;
+        *ip->dst = ip->func(&arg);
+        NEXT();
+    }
+    OP(CALL)
+        *ip->dst = ip->func(const_cast<float *>(ip->a));
+        NEXT();
+    OP(JUMP)
+        GOTO(ip->jump);
+    OP(JUMP_IF_ZERO)
+        if (*ip->a == 0)
+            GOTO(ip->jump);
+        NEXT();
+    OP(JUMP_UNLESS_ABOVE)
+        if (!(*ip->a > *ip->b))
+            GOTO(ip->jump);
+        NEXT();
+    OP(JUMP_UNLESS_EQUAL)
+        if (!(*ip->a == *ip->b))
+            GOTO(ip->jump);
+        NEXT();
+    OP(EVAL)
+        *ip->dst = static_cast<Expr *>(ip->ref)->eval(mesh_i, mesh_j);
+        NEXT();
+    OP(LOAD_MESH)
+        if (*ip->flag && mesh_i >= 0 && mesh_j >= 0)
+            *ip->dst = static_cast<float *>(ip->ref)[mesh_i * ip->stride + mesh_j];
+        else
+            *ip->dst = *ip->a;
+        NEXT();
+    OP(LOAD_POINTS)
+        if (*ip->flag && mesh_i >= 0)
+            *ip->dst = static_cast<float *>(ip->ref)[mesh_i];
+        else
+            *ip->dst = *ip->a;
+        NEXT();
+    OP(STORE)
+        *ip->dst = *ip->a;
+        NEXT();
+    OP(STORE_CLAMP)
+    {
+        const float value = *ip->a;
+        if (value < *ip->b)
+            *ip->dst = *ip->b;
+        else if (value > *ip->c)
+            *ip->dst = *ip->c;
+        else
+            *ip->dst = value;
+        NEXT();
+    }
+    OP(STORE_MESH)
+        static_cast<float *>(ip->ref)[mesh_i * ip->stride + mesh_j] = *ip->a;
+        *ip->flag = true;
+        NEXT();
+    OP(STORE_POINTS)
+        static_cast<float *>(ip->ref)[mesh_i] = *ip->a;
+        *ip->flag = true;
+        NEXT();
+    OP(SET)
+        static_cast<LValue *>(ip->ref)->set(*ip->a);
+        NEXT();
+    OP(SET_MATRIX)
+        static_cast<LValue *>(ip->ref)->set_matrix(mesh_i, mesh_j, *ip->a);
+        NEXT();
+
+#ifndef BYTECODE_THREADED
+    default:
+        break;
+    }
+    return 0;
+#endif
+#undef OP
+#undef NEXT
+#undef GOTO
+}
+
+/* A finished program. Like any Expr it is not reentrant: its temporaries live
+   in the program, not on the stack. */
+class BytecodeExpr : public Expr
+{
+    std::vector<Op> code;
+    std::vector<float> registers;   /* constants, then temporaries */
+    size_t temps_base;
+    Expr *root;
+
+public:
+    BytecodeExpr(const std::vector<BytecodeInstruction> &instructions,
+                 const std::vector<float> &constants, int temps, Expr *root_) :
+        Expr(BYTECODE), code(instructions.size()), registers(constants),
+        temps_base(constants.size()), root(root_)
+    {
+        registers.resize(temps_base + temps, 0.0f);
+
+        const void *const *labels = nullptr;
+#ifdef BYTECODE_THREADED
+        execute(nullptr, 0, 0, &labels);
+#endif
+        for (size_t i = 0; i < instructions.size(); i++)
+        {
+            const BytecodeInstruction &from = instructions[i];
+            Op &to = code[i];
+            to.op = from.op;
+            to.handler = labels ? labels[from.op] : nullptr;
+            to.dst = location(from.dst);
+            to.a = location(from.a);
+            to.b = location(from.b);
+            to.c = location(from.c);
+            to.jump = from.jump >= 0 ? &code[from.jump] : nullptr;
+            to.ref = from.ref;
+            to.flag = from.flag;
+            to.stride = from.stride;
+            to.func = from.func;
+        }
+    }
+
+    ~BytecodeExpr() override
+    {
+        Expr::delete_expr(root);
+    }
+
+    float eval(int mesh_i, int mesh_j) override
+    {
+        return execute(code.data(), mesh_i, mesh_j, nullptr);
+    }
+
+    void eval_points(int count, const ExprVarying *varying, int varying_count) override
+    {
+        const Op *start = code.data();
+        for (int i = 0; i < count; i++)
+        {
+            for (int v = 0; v < varying_count; v++)
+                *varying[v].value = varying[v].points[i];
+            execute(start, i, -1, nullptr);
+        }
+    }
+
+#if HAVE_LLVM
+    llvm::Value *_llvm(JitContext &jitx) override
+    {
+        return nullptr;
+    }
+#endif
+
+private:
+    float *location(const BytecodeOperand &operand)
+    {
+        switch (operand.kind)
+        {
+        case BytecodeOperand::CONSTANT:
+            return &registers[operand.index];
+        case BytecodeOperand::TEMP:
+            return &registers[temps_base + operand.index];
+        case BytecodeOperand::EXTERNAL:
+            return operand.ptr;
+        default:
+            return nullptr;
+        }
+    }
+};
+
+} // namespace
+
+
+BytecodeOperand BytecodeContext::constant(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    auto pos = _constantIndex.find(bits);
+    if (pos != _constantIndex.end())
+        return BytecodeOperand(BytecodeOperand::CONSTANT, pos->second, nullptr);
+    const int index = static_cast<int>(_constants.size());
+    _constants.push_back(value);
+    _constantIndex[bits] = index;
+    return BytecodeOperand(BytecodeOperand::CONSTANT, index, nullptr);
+}
+
+BytecodeOperand BytecodeContext::temp()
+{
+    const int index = _temps++;
+    if (_temps > _maxTemps)
+        _maxTemps = _temps;
+    return BytecodeOperand(BytecodeOperand::TEMP, index, nullptr);
+}
+
+BytecodeInstruction &BytecodeContext::emit(BytecodeOp op, BytecodeOperand dst,
+                                           BytecodeOperand a, BytecodeOperand b, BytecodeOperand c)
+{
+    BytecodeInstruction instruction;
+    instruction.op = op;
+    instruction.dst = dst;
+    instruction.a = a;
+    instruction.b = b;
+    instruction.c = c;
+    instruction.jump = -1;
+    instruction.ref = nullptr;
+    instruction.flag = nullptr;
+    instruction.stride = 0;
+    instruction.func = nullptr;
+    _code.push_back(instruction);
+    return _code.back();
+}
+
+int BytecodeContext::jump(BytecodeOp op, BytecodeOperand a, BytecodeOperand b)
+{
+    emit(op, BytecodeOperand(), a, b);
+    return static_cast<int>(_code.size()) - 1;
+}
+
+void BytecodeContext::move(BytecodeOperand dst, BytecodeOperand value)
+{
+    if (dst != value)
+        emit(BYTECODE_MOV, dst, value);
+}
+
+void BytecodeContext::statement(Expr *expr)
+{
+    const size_t start = _code.size();
+    const int temps = _temps;
+
+    _fail = false;
+    _statement = true;
+    BytecodeOperand value = Expr::bytecode(*this, expr);
+    _statement = false;
+
+    if (_fail || !value.valid())
+    {
+        _code.resize(start);
+        _temps = temps;
+        _fail = false;
+        value = temp();
+        emit(BYTECODE_EVAL, value).ref = expr;
+    }
+    _temps = temps;
+    _result = value;
+}
+
+void BytecodeContext::assignment(LValue *lhs, Expr *rhs)
+{
+    const size_t start = _code.size();
+    const int temps = _temps;
+
+    _fail = false;
+    BytecodeOperand value = Expr::bytecode(*this, rhs);
+
+    if (_fail || !value.valid())
+    {
+        _code.resize(start);
+        _temps = temps;
+        _fail = false;
+        value = temp();
+        emit(BYTECODE_EVAL, value).ref = rhs;
+    }
+    lhs->_bytecode_set(*this, value);
+    _temps = temps;
+    _result = value;
+}
+
+Expr *BytecodeContext::finish(Expr *root)
+{
+    if (!_result.valid())
+        _result = constant(0.0f);
+    emit(BYTECODE_RETURN, BytecodeOperand(), _result);
+    return new BytecodeExpr(_code, _constants, _maxTemps, root);
+}
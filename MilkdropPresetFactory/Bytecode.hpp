@@ -0,0 +1,178 @@
+/**
+ * projectM -- Milkdrop-esque visualisation SDK
+ * Copyright (C)2003-2007 projectM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * See 'LICENSE.txt' included within this release
+ *
+ */
+/**
+ * $Id$
+ *
+ * Register bytecode for optimized expressions, the interpreter used where
+ * there is no LLVM JIT
+ *
+ * $Log$
+ */
+
+#ifndef _BYTECODE_HPP
+#define _BYTECODE_HPP
+
+#include "Expr.hpp"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/* Every instruction is "dst = op(a, b, c)" over float locations. */
+#define BYTECODE_OPS(X) \
+    X(RETURN)           /* return *a */ \
+    X(MOV)              \
+    X(ADD)              \
+    X(SUB)              \
+    X(MUL)              \
+    X(DIV)              /* MAX_DOUBLE_SIZE for a zero divisor, as TreeExpr */ \
+    X(MOD)              \
+    X(OR)               \
+    X(AND)              \
+    X(MUL_ADD)          /* a * b + c */ \
+    X(MUL_CONST)        /* a * b, b constant */ \
+    X(SQR)              /* a * a */ \
+    X(SIN)              \
+    X(COS)              \
+    X(LOG)              \
+    X(SIN_MUL_ADD)      /* sin(a * b + c) */ \
+    X(COS_MUL_ADD)      /* cos(a * b + c) */ \
+    X(SIN_MUL_CONST)    /* sin(a * b), b constant */ \
+    X(COS_MUL_CONST)    /* cos(a * b), b constant */ \
+    X(CALL1)            /* func(a) */ \
+    X(CALL)             /* func(a[0] .. a[n-1]), arguments in consecutive registers */ \
+    X(JUMP)             \
+    X(JUMP_IF_ZERO)     /* if a == 0 */ \
+    X(JUMP_UNLESS_ABOVE) /* unless a > b */ \
+    X(JUMP_UNLESS_EQUAL) /* unless a == b */ \
+    X(EVAL)             /* ref->eval(i, j), for nodes without a lowering */ \
+    X(LOAD_MESH)        /* per pixel parameter, see _MeshParam::eval() */ \
+    X(LOAD_POINTS)      /* per point parameter, see _PointsParam::eval() */ \
+    X(STORE)            /* *dst = a */ \
+    X(STORE_CLAMP)      /* *dst = a clamped to [b, c] */ \
+    X(STORE_MESH)       /* see _MeshParam::set_matrix() */ \
+    X(STORE_POINTS)     /* see _PointsParam::set_matrix() */ \
+    X(SET)              /* ref->set(a) */ \
+    X(SET_MATRIX)       /* ref->set_matrix(i, j, a) */
+
+enum BytecodeOp
+{
+#define BYTECODE_ENUM(name) BYTECODE_##name,
+    BYTECODE_OPS(BYTECODE_ENUM)
+#undef BYTECODE_ENUM
+    BYTECODE_OP_COUNT
+};
+
+/// A location an instruction reads or writes: a constant or temporary
+/// register of the program, or a float owned by someone else, e.g. the
+/// engine value of a parameter.
+struct BytecodeOperand
+{
+    enum Kind { NONE, CONSTANT, TEMP, EXTERNAL };
+
+    Kind kind;
+    int index;
+    float *ptr;
+
+    BytecodeOperand() : kind(NONE), index(0), ptr(nullptr) {}
+    BytecodeOperand(Kind kind_, int index_, float *ptr_) : kind(kind_), index(index_), ptr(ptr_) {}
+
+    bool valid() const { return kind != NONE; }
+    bool operator==(const BytecodeOperand &other) const
+    {
+        return kind == other.kind && index == other.index && ptr == other.ptr;
+    }
+    bool operator!=(const BytecodeOperand &other) const { return !(*this == other); }
+};
+
+/// An instruction as emitted; operands are resolved to memory by finish().
+struct BytecodeInstruction
+{
+    BytecodeOp op;
+    BytecodeOperand dst, a, b, c;
+    int jump;                   /* target of jumps */
+    void *ref;                  /* Expr of EVAL, LValue of SET, matrix of the mesh ops */
+    short int *flag;            /* matrix flag of the mesh ops */
+    int stride;                 /* matrix stride of LOAD_MESH and STORE_MESH */
+    float (*func)(float *);     /* function of CALL */
+};
+
+/// Lowers optimized expressions to bytecode, see Expr::compile().
+///
+/// Nodes lower themselves in Expr::_bytecode(), returning the operand that
+/// holds their value. Temporaries are allocated like a stack: a node takes
+/// mark(), lowers its children, release()s the mark and then takes its own
+/// result register, which may therefore be one of its inputs.
+///
+/// Parameters with plain float storage are read in place. That is only the
+/// same as evaluating the tree while nothing assigns a parameter in the
+/// middle of an expression, so assignments are only lowered as statements;
+/// a statement that cannot be lowered is evaluated through its tree instead.
+class BytecodeContext
+{
+public:
+    BytecodeContext() : _temps(0), _maxTemps(0), _fail(false), _statement(false) {}
+
+    BytecodeOperand constant(float value);
+    BytecodeOperand external(float *ptr) { return BytecodeOperand(BytecodeOperand::EXTERNAL, 0, ptr); }
+    BytecodeOperand temp();
+
+    int mark() const { return _temps; }
+    void release(int mark) { _temps = mark; }
+
+    BytecodeInstruction &emit(BytecodeOp op, BytecodeOperand dst,
+                              BytecodeOperand a = BytecodeOperand(),
+                              BytecodeOperand b = BytecodeOperand(),
+                              BytecodeOperand c = BytecodeOperand());
+    /// Emits a jump and returns it, to be pointed at its target with land().
+    int jump(BytecodeOp op, BytecodeOperand a = BytecodeOperand(), BytecodeOperand b = BytecodeOperand());
+    /// Makes the jump land on the next instruction emitted.
+    void land(int jump) { _code[jump].jump = static_cast<int>(_code.size()); }
+
+    /// Copies value to dst unless it already is there.
+    void move(BytecodeOperand dst, BytecodeOperand value);
+
+    /// Marks the statement being lowered as not lowerable.
+    BytecodeOperand fail() { _fail = true; return BytecodeOperand(); }
+
+    /// Lowers one statement of the program.
+    void statement(Expr *expr);
+    /// Lowers "lhs = rhs" with the semantics of PerFrameEqn::evaluate().
+    void assignment(LValue *lhs, Expr *rhs);
+
+    /// Returns the finished program, which evaluates to the value of the
+    /// last statement. The program owns root, if given, the way JitExpr does.
+    Expr *finish(Expr *root);
+
+private:
+    friend class Expr;
+
+    std::vector<BytecodeInstruction> _code;
+    std::vector<float> _constants;
+    std::map<uint32_t, int> _constantIndex;
+    int _temps;
+    int _maxTemps;
+    bool _fail;
+    bool _statement;
+    BytecodeOperand _result;
+};
+
+#endif /** !_BYTECODE_HPP */
@@ -19,7 +19,7 @@
  *
  */
 
-#include <sstream>
+#include <cstdio>
 #include "Common.hpp"
 #include "fatal.h"
 
@@ -35,20 +35,29 @@
 #include "InitCondUtils.hpp"
 #include "wipemalloc.h"
 
+namespace {
+// Shared by the parameters of every custom shape
+ParamTable::Symbols & symbols()
+{
+	static ParamTable::Symbols symbols;
+	return symbols;
+}
+}
 
 
-CustomShape::CustomShape() : Shape()
+CustomShape::CustomShape() : Shape(), param_tree(symbols())
 {
 	CustomShape(0);
 }
 
-CustomShape::CustomShape ( int _id ) : Shape()
+CustomShape::CustomShape ( int _id ) : Shape(), param_tree(symbols())
 {
 
 	Param * param;
 
     this->id = _id;
 	this->per_frame_count = 0;
+	this->per_frame_program = NULL;
 
 	/* Start: Load custom shape parameters */
 	param = Param::new_param_float ( "r", P_FLAG_NONE, &this->r, NULL, 1.0, 0.0, 0.5 );
@@ -209,9 +218,9 @@ CustomShape::CustomShape ( int _id ) : Shape()
 	}
 
    for (unsigned int i = 0; i < NUM_Q_VARIABLES;i++) {
-	std::ostringstream os;
-	os << "q" << i+1;
-	param = Param::new_param_float ( os.str().c_str(), P_FLAG_QVAR, &this->q[i], NULL, MAX_DOUBLE_SIZE,
+	char name[16];
+	snprintf(name, sizeof(name), "q%u", i+1);
+	param = Param::new_param_float ( name, P_FLAG_QVAR, &this->q[i], NULL, MAX_DOUBLE_SIZE,
 		 -MAX_DOUBLE_SIZE, 0.0 );
     if ( !ParamUtils::insert ( param, &this->param_tree ) )
 	{
@@ -219,6 +228,8 @@ CustomShape::CustomShape ( int _id ) : Shape()
 	}
   }
 
+	param_tree.finish();
+
 	param = Param::new_param_string ( "imageurl", P_FLAG_NONE, &this->imageUrl);
 	if ( !ParamUtils::insert( param, &this->text_properties_tree ) )
 	{
@@ -232,8 +243,8 @@ CustomShape::~CustomShape()
 {
 
 	traverseVector<TraverseFunctors::Delete<PerFrameEqn> > ( per_frame_eqn_tree );
+	Expr::delete_expr ( per_frame_program );
 	traverse<TraverseFunctors::Delete<InitCond> > ( init_cond_tree );
-	traverse<TraverseFunctors::Delete<Param> > ( param_tree );
 	traverse<TraverseFunctors::Delete<InitCond> > ( per_frame_init_eqn_tree );
 	traverse<TraverseFunctors::Delete<Param> > ( text_properties_tree );
 
@@ -243,7 +254,7 @@ void CustomShape::loadUnspecInitConds()
 {
 
 	InitCondUtils::LoadUnspecInitCond fun ( this->init_cond_tree, this->per_frame_init_eqn_tree );
-	traverse ( param_tree, fun );
+	param_tree.apply ( fun );
 }
 
 void CustomShape::evalInitConds()
@@ -32,6 +32,7 @@
 #define CUSTOM_SHAPE_DEBUG 0
 #include <map>
 #include "Param.hpp"
+#include "ParamTable.hpp"
 #include "PerFrameEqn.hpp"
 #include "InitCond.hpp"
 #include "Renderer/Renderable.hpp"
@@ -46,8 +47,8 @@ public:
     int id;
     int per_frame_count;
 
-    /* Parameter tree associated with this custom shape */
-    std::map<std::string,Param*> param_tree;
+    /* Parameters of this custom shape, the builtin ones in the same places as in any other */
+    ParamTable param_tree;
 
     /* Engine variables */
 
@@ -69,6 +70,7 @@ public:
     // Data structure to hold per frame  / per frame init equations
     std::map<std::string,InitCond*>  init_cond_tree;
     std::vector<PerFrameEqn*>  per_frame_eqn_tree;
+    Expr *per_frame_program;
     std::map<std::string,InitCond*>  per_frame_init_eqn_tree;
 
     std::map<std::string, Param*> text_properties_tree;
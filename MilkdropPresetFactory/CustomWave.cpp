@@ -23,7 +23,8 @@
 #include <string.h>
 #include <stdlib.h>
 
-#include <sstream>
+#include <algorithm>
+#include <cstdio>
 
 #include "Common.hpp"
 #include "fatal.h"
@@ -42,15 +43,26 @@
 #include "wipemalloc.h"
 #define MAX_SAMPLE_SIZE 4096
 
+namespace {
+// Shared by the parameters of every custom wave
+ParamTable::Symbols & symbols()
+{
+  static ParamTable::Symbols symbols;
+  return symbols;
+}
+}
 
 CustomWave::CustomWave(int _id) : Waveform(512),
     id(_id),
     per_frame_count(0),
+    param_tree(symbols()),
     r(0),
     g(0),
     b(0),
     a(0),
-    per_point_program(nullptr)
+    per_point_program(nullptr),
+    per_point_prologue(nullptr),
+    per_frame_program(nullptr)
 {
 
   Param * param;
@@ -397,15 +409,17 @@ CustomWave::CustomWave(int _id) : Waveform(512),
   }
 
   for (unsigned int i = 0; i < NUM_Q_VARIABLES;i++) {
-	std::ostringstream os;
-	os << "q" << i+1;
-	param = Param::new_param_float ( os.str().c_str(), P_FLAG_QVAR, &this->q[i], NULL, MAX_DOUBLE_SIZE,
+	char name[16];
+	snprintf(name, sizeof(name), "q%u", i+1);
+	param = Param::new_param_float ( name, P_FLAG_QVAR, &this->q[i], NULL, MAX_DOUBLE_SIZE,
 		 -MAX_DOUBLE_SIZE, 0.0 );
     if ( !ParamUtils::insert ( param, &this->param_tree ) )
 	{
 		abort();
 	}
   }
+
+  param_tree.finish();
 	
      /* End of parameter loading. Note that the read only parameters associated
      with custom waves (ie, sample) are variables stored in PresetFrameIO.hpp,
@@ -422,6 +436,8 @@ CustomWave::~CustomWave()
 
   for (std::vector<PerFrameEqn*>::iterator pos = per_frame_eqn_tree.begin(); pos != per_frame_eqn_tree.end(); ++pos)
     delete(*pos);
+  Expr::delete_expr(per_frame_program);
+  Expr::delete_expr(per_point_prologue);
 
   for (std::map<std::string, InitCond*>::iterator pos = init_cond_tree.begin(); pos != init_cond_tree.end(); ++pos)
     delete(pos->second);
@@ -429,9 +445,6 @@ CustomWave::~CustomWave()
   for (std::map<std::string, InitCond*>::iterator pos = per_frame_init_eqn_tree.begin(); pos != per_frame_init_eqn_tree.end(); ++pos)
     delete(pos->second);
 
-  for (std::map<std::string, Param*>::iterator pos = param_tree.begin(); pos != param_tree.end(); ++pos)
-    delete(pos->second);
-
   free(r_mesh);
   free(g_mesh);
   free(b_mesh);
@@ -497,7 +510,7 @@ void CustomWave::evalInitConds()
 
 }
 
-ColoredPoint CustomWave::PerPoint(ColoredPoint p, const WaveformContext& context)
+void CustomWave::PerPoints(ColoredPoint *points, const WaveformContext& context)
 {
     if (nullptr == per_point_program)
     {
@@ -507,6 +520,11 @@ ColoredPoint CustomWave::PerPoint(ColoredPoint p, const WaveformContext& context
         for (auto pos = per_point_eqn_tree.begin(); pos != per_point_eqn_tree.end();++pos)
             steps.push_back((*pos)->assign_expr);
         Expr *program_expr  = Expr::create_program_expr(steps, false);
+        // the points themselves are matrix params, these are set for each one by eval_points()
+        std::vector<Param *> varying;
+        for (const char *name : {"sample", "value1", "value2"})
+            varying.push_back(param_tree.find(name));
+        per_point_prologue = Expr::hoist(program_expr, varying);
         Expr *jit = nullptr;
 #if HAVE_LLVM
         char buffer[100];
@@ -514,29 +532,38 @@ ColoredPoint CustomWave::PerPoint(ColoredPoint p, const WaveformContext& context
         if (!steps.empty())
             jit = Expr::jit(program_expr, buffer);
 #endif
-        per_point_program = jit ? jit : program_expr;
+        if (nullptr == jit)
+            jit = Expr::compile(program_expr);
+        per_point_program = jit;
     }
 
-    r_mesh[context.sample_int] = r;
-    g_mesh[context.sample_int] = g;
-    b_mesh[context.sample_int] = b;
-    a_mesh[context.sample_int] = a;
-    x_mesh[context.sample_int] = x;
-    y_mesh[context.sample_int] = y;
-    sample = context.sample;
-    v1 = context.left;
-    v2 = context.right;
-
-    per_point_program->eval(context.sample_int, -1);
-
-    p.color.a = a_mesh[context.sample_int];
-    p.color.r = r_mesh[context.sample_int];
-    p.color.g = g_mesh[context.sample_int];
-    p.color.b = b_mesh[context.sample_int];
-    p.position.x = x_mesh[context.sample_int];
-    p.position.y = y_mesh[context.sample_int];
-
-    return p;
+    const int count = context.samples;
+    std::fill(r_mesh, r_mesh + count, r);
+    std::fill(g_mesh, g_mesh + count, g);
+    std::fill(b_mesh, b_mesh + count, b);
+    std::fill(a_mesh, a_mesh + count, a);
+    std::fill(x_mesh, x_mesh + count, x);
+    std::fill(y_mesh, y_mesh + count, y);
+
+    if (nullptr != per_point_prologue)
+        per_point_prologue->eval(-1, -1);
+    const ExprVarying varying[] = {
+        { &sample, context.sample },
+        { &v1, context.left },
+        { &v2, context.right },
+    };
+    per_point_program->eval_points(count, varying, 3);
+
+    for (int i = 0; i < count; i++)
+    {
+        ColoredPoint &p = points[i];
+        p.color.a = a_mesh[i];
+        p.color.r = r_mesh[i];
+        p.color.g = g_mesh[i];
+        p.color.b = b_mesh[i];
+        p.position.x = x_mesh[i];
+        p.position.y = y_mesh[i];
+    }
 }
 
 
@@ -544,6 +571,6 @@ void CustomWave::loadUnspecInitConds()
 {
 
   InitCondUtils::LoadUnspecInitCond fun(this->init_cond_tree, this->per_frame_init_eqn_tree);
-  traverse(param_tree, fun);
+  param_tree.apply(fun);
 }
 
@@ -40,6 +40,7 @@ class Preset;
 
 #include "Common.hpp"
 #include "Param.hpp"
+#include "ParamTable.hpp"
 #include "PerFrameEqn.hpp"
 #include "Renderer/Waveform.hpp"
 
@@ -58,14 +59,14 @@ public:
     /** Destructor is necessary so we can free the per point matrices **/
     virtual ~CustomWave();
 
-    ColoredPoint PerPoint(ColoredPoint p, const WaveformContext& context) override;
+    void PerPoints(ColoredPoint *points, const WaveformContext& context) override;
 
     /* Numerical id */
     int id;
     int per_frame_count;
 
-    /* Parameter tree associated with this custom wave */
-    std::map<std::string,Param*> param_tree;
+    /* Parameters of this custom wave, the builtin ones in the same places as in any other */
+    ParamTable param_tree;
 
     /* Engine variables */
     float x; /* x position for per point equations */
@@ -106,6 +107,8 @@ public:
     std::vector<PerFrameEqn*>  per_frame_eqn_tree;
     std::vector<PerPointEqn*>  per_point_eqn_tree;
     Expr *per_point_program;
+    Expr *per_point_prologue;   /* invariants of per_point_program, see Expr::hoist() */
+    Expr *per_frame_program;
     std::map<std::string,InitCond*>  per_frame_init_eqn_tree;
 
     /* Denotes the index of the last character for each string buffer */
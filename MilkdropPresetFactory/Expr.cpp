@@ -23,16 +23,93 @@
 
 #include "Expr.hpp"
 #include <cassert>
+#include <map>
+#include <set>
 
 #include "Eval.hpp"
 #include "BuiltinFuncs.hpp"
 
 #include "JitContext.hpp"
+#include "PresetCode.hpp"
+#include "Bytecode.hpp"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
+/* A subexpression moved out of a program by Expr::hoist(). The prologue computes
+   the value once per frame and every place the subexpression was found reads it.
+   Shared, so it counts its references instead of being owned by one tree. */
+class InvariantExpr : public Expr
+{
+public:
+    Expr *expr;
+    float value;
+    int refs;
+
+    explicit InvariantExpr(Expr *expr_) : Expr(OTHER), expr(expr_), value(0.0f), refs(0) {}
+    ~InvariantExpr() override
+    {
+        Expr::delete_expr(expr);
+    }
+    void _delete_from_tree() override
+    {
+        if (--refs == 0)
+            delete this;
+    }
+    float eval(int mesh_i, int mesh_j) override
+    {
+        return value;
+    }
+    bool _encode(ExprEncoder &encoder) override
+    {
+        return Expr::encode(expr, encoder);
+    }
+    BytecodeOperand _bytecode(BytecodeContext &ctx) override
+    {
+        return ctx.external(&value);
+    }
+    bool _hoist(ExprHoister &hoister) override
+    {
+        return true;
+    }
+    std::ostream &to_string(std::ostream &out) override
+    {
+        out << expr;
+        return out;
+    }
+#if HAVE_LLVM
+    llvm::Value *_llvm(JitContext &jitx) override
+    {
+        llvm::Constant *ptr = jitx.CreateFloatPtr(&value);
+        return jitx.builder.CreateLoad(ptr);
+    }
+#endif
+};
+
+/* State of Expr::hoist(). The program is visited twice: the first pass only
+   collects the params it assigns, the second moves invariant subexpressions out. */
+class ExprHoister
+{
+public:
+    std::set<Expr *> varying;
+    bool collecting = true;
+    bool inner = false;     /* inside a subexpression being hoisted */
+    std::vector<InvariantExpr *> prologue;
+    std::map<std::string, InvariantExpr *> found;
+
+    /* Visits all children. Returns true if they are all invariant and the node
+       itself is pure; otherwise, or inside a hoisted subexpression, hoists each
+       invariant child. */
+    bool children(const std::vector<Expr **> &list, bool pure);
+    void assigned(LValue *lhs)
+    {
+        if (collecting)
+            varying.insert(lhs);
+    }
+    void hoist(Expr *&expr);
+};
+
 /* A function expression in prefix form */
 class PrefunExpr : public Expr
 {
@@ -50,6 +127,10 @@ public:
 
     /* Evaluates functions in prefix form */
     Expr *_optimize() override;
+    bool _encode(ExprEncoder &encoder) override;
+    BytecodeOperand _bytecode(BytecodeContext &ctx) override;
+    bool _hoist(ExprHoister &hoister) override;
+    bool _hoist_args(ExprHoister &hoister, bool pure);
     float eval(int mesh_i, int mesh_j) override;
     std::ostream& to_string(std::ostream &out) override;
 #if HAVE_LLVM
@@ -158,6 +239,42 @@ llvm::Value *PrefunExpr::_llvm(JitContext &jitx)
 #endif
 
 
+/* Lowers a conditional: jump_op on a (and b) jumps to else_expr, otherwise then_expr is evaluated.
+ * Only the branch taken is evaluated, as in the IfExpr, IfAboveExpr and IfEqualExpr trees. */
+static BytecodeOperand bytecode_branch(BytecodeContext &ctx, BytecodeOp jump_op,
+                                       Expr *a, Expr *b, Expr *then_expr, Expr *else_expr)
+{
+    // both branches leave their value in dst
+    BytecodeOperand dst = ctx.temp();
+    const int mark = ctx.mark();
+
+    BytecodeOperand avalue = Expr::bytecode(ctx, a);
+    if (!avalue.valid())
+        return avalue;
+    BytecodeOperand bvalue;
+    if (nullptr != b && !(bvalue = Expr::bytecode(ctx, b)).valid())
+        return bvalue;
+    ctx.release(mark);
+    const int to_else = ctx.jump(jump_op, avalue, bvalue);
+
+    BytecodeOperand value = Expr::bytecode(ctx, then_expr);
+    if (!value.valid())
+        return value;
+    ctx.move(dst, value);
+    ctx.release(mark);
+    const int to_end = ctx.jump(BYTECODE_JUMP);
+
+    ctx.land(to_else);
+    value = Expr::bytecode(ctx, else_expr);
+    if (!value.valid())
+        return value;
+    ctx.move(dst, value);
+    ctx.release(mark);
+    ctx.land(to_end);
+    return dst;
+}
+
+
 class PrefunExprOne : public PrefunExpr
 {
 public:
@@ -192,6 +309,22 @@ public:
 		else
 			return expr_list[3]->eval(mesh_i,mesh_j);
 	}
+	bool _encode(ExprEncoder &encoder) override
+	{
+		encoder.u8(EXPR_OP_IF_ABOVE);
+		for (int i = 0; i < num_args; i++)
+			if (!Expr::encode(expr_list[i], encoder))
+				return false;
+		return true;
+	}
+	BytecodeOperand _bytecode(BytecodeContext &ctx) override
+	{
+		return bytecode_branch(ctx, BYTECODE_JUMP_UNLESS_ABOVE, expr_list[0], expr_list[1], expr_list[2], expr_list[3]);
+	}
+	bool _hoist(ExprHoister &hoister) override
+	{
+		return _hoist_args(hoister, true);
+	}
 #if HAVE_LLVM
     llvm::Value *_llvm(JitContext &jitx) override
     {
@@ -235,6 +368,22 @@ public:
 		else
 			return expr_list[3]->eval(mesh_i,mesh_j);
 	}
+	bool _encode(ExprEncoder &encoder) override
+	{
+		encoder.u8(EXPR_OP_IF_EQUAL);
+		for (int i = 0; i < num_args; i++)
+			if (!Expr::encode(expr_list[i], encoder))
+				return false;
+		return true;
+	}
+	BytecodeOperand _bytecode(BytecodeContext &ctx) override
+	{
+		return bytecode_branch(ctx, BYTECODE_JUMP_UNLESS_EQUAL, expr_list[0], expr_list[1], expr_list[2], expr_list[3]);
+	}
+	bool _hoist(ExprHoister &hoister) override
+	{
+		return _hoist_args(hoister, true);
+	}
 #if HAVE_LLVM
     llvm::Value *_llvm(JitContext &jitx) override
     {
@@ -276,6 +425,14 @@ public:
 		Expr *opt = PrefunExpr::_optimize();
 		if (opt != this)
 			return opt;
+		if (expr_list[0]->isConstant())
+		{
+			// the branch not taken is deleted with this
+			const int taken = expr_list[0]->eval(-1, -1) == 0 ? 2 : 1;
+			opt = expr_list[taken];
+			expr_list[taken] = nullptr;
+			return opt;
+		}
 		if (expr_list[0]->clazz!=FUNCTION)
 			return this;
 		auto *compExpr = (PrefunExpr *)expr_list[0];
@@ -297,6 +454,10 @@ public:
 		}
 		return this;
 	}
+	BytecodeOperand _bytecode(BytecodeContext &ctx) override
+	{
+		return bytecode_branch(ctx, BYTECODE_JUMP_IF_ZERO, expr_list[0], nullptr, expr_list[1], expr_list[2]);
+	}
 #if HAVE_LLVM
     llvm::Value *_llvm(JitContext &jitx) override
     {
@@ -369,6 +530,16 @@ public:
     {
         return constant;
     }
+    bool _encode(ExprEncoder &encoder) override
+    {
+        encoder.u8(EXPR_OP_CONSTANT);
+        encoder.f32(constant);
+        return true;
+    }
+    BytecodeOperand _bytecode(BytecodeContext &ctx) override
+    {
+        return ctx.constant(constant);
+    }
     std::ostream &to_string(std::ostream &out)
     {
         out << constant; return out;
@@ -403,6 +574,33 @@ public:
         float c_value = c->eval(mesh_i,mesh_j);
         return a_value * b_value + c_value;
     }
+    bool _encode(ExprEncoder &encoder) override
+    {
+        encoder.u8(EXPR_OP_MULT_ADD);
+        return Expr::encode(a, encoder) && Expr::encode(b, encoder) && Expr::encode(c, encoder);
+    }
+    // also used to fuse sin(a*b+c) and cos(a*b+c)
+    BytecodeOperand _bytecode_fused(BytecodeContext &ctx, BytecodeOp op)
+    {
+        const int mark = ctx.mark();
+        BytecodeOperand avalue = Expr::bytecode(ctx, a);
+        BytecodeOperand bvalue = avalue.valid() ? Expr::bytecode(ctx, b) : avalue;
+        BytecodeOperand cvalue = bvalue.valid() ? Expr::bytecode(ctx, c) : bvalue;
+        if (!cvalue.valid())
+            return cvalue;
+        ctx.release(mark);
+        BytecodeOperand dst = ctx.temp();
+        ctx.emit(op, dst, avalue, bvalue, cvalue);
+        return dst;
+    }
+    BytecodeOperand _bytecode(BytecodeContext &ctx) override
+    {
+        return _bytecode_fused(ctx, BYTECODE_MUL_ADD);
+    }
+    bool _hoist(ExprHoister &hoister) override
+    {
+        return hoister.children({&a, &b, &c}, true);
+    }
     std::ostream &to_string(std::ostream &out) override
     {
         out << "(" << a << " * " << b << ") + " << c;
@@ -439,6 +637,32 @@ public:
         float value = expr->eval(mesh_i,mesh_j);
         return value * c;
     }
+    bool _encode(ExprEncoder &encoder) override
+    {
+        encoder.u8(EXPR_OP_MULT_CONST);
+        encoder.f32(c);
+        return Expr::encode(expr, encoder);
+    }
+    // also used to fuse sin(a*c) and cos(a*c)
+    BytecodeOperand _bytecode_fused(BytecodeContext &ctx, BytecodeOp op)
+    {
+        const int mark = ctx.mark();
+        BytecodeOperand value = Expr::bytecode(ctx, expr);
+        if (!value.valid())
+            return value;
+        ctx.release(mark);
+        BytecodeOperand dst = ctx.temp();
+        ctx.emit(op, dst, value, ctx.constant(c));
+        return dst;
+    }
+    BytecodeOperand _bytecode(BytecodeContext &ctx) override
+    {
+        return _bytecode_fused(ctx, BYTECODE_MUL_CONST);
+    }
+    bool _hoist(ExprHoister &hoister) override
+    {
+        return hoister.children({&expr}, true);
+    }
     std::ostream &to_string(std::ostream &out) override
     {
         out << "(" << expr << " * " << c << ") + " << c;
@@ -534,6 +758,19 @@ Expr *TreeExpr::_optimize()
     if (left->isConstant() && right->isConstant())
         return Expr::const_to_expr(eval(-1, -1));
 
+    // identities that hold bit for bit, x+0 does not for x=-0
+    if ((infix_op->type == INFIX_MULT && left->isConstant() && left->eval(-1, -1) == 1.0f) ||
+        ((infix_op->type == INFIX_MULT || infix_op->type == INFIX_DIV) && right->isConstant() && right->eval(-1, -1) == 1.0f) ||
+        (infix_op->type == INFIX_MINUS && right->isConstant() && right->eval(-1, -1) == 0.0f))
+    {
+        Expr *opt = left->isConstant() ? right : left;
+        if (opt == left)
+            left = nullptr;
+        else
+            right = nullptr;
+        return opt;
+    }
+
     // this is gratuitious, but a*b+c is super common, so as proof-of-concept, let's make a special Expr
     if (infix_op->type == INFIX_ADD &&
         ((left->clazz == TREE && ((TreeExpr *)left)->infix_op->type == INFIX_MULT) ||
@@ -604,6 +841,68 @@ float TreeExpr::eval ( int mesh_i, int mesh_j )
     }
 }
 
+bool TreeExpr::_encode(ExprEncoder &encoder)
+{
+    if (NULL == infix_op)
+        return NULL != gen_expr && Expr::encode(gen_expr, encoder);
+    if (NULL == left || NULL == right)
+        return false;
+    encoder.u8(EXPR_OP_INFIX);
+    encoder.u8(infix_op->type);
+    return Expr::encode(left, encoder) && Expr::encode(right, encoder);
+}
+
+BytecodeOperand TreeExpr::_bytecode(BytecodeContext &ctx)
+{
+    if (NULL == infix_op)
+        return NULL != gen_expr ? Expr::bytecode(ctx, gen_expr) : ctx.fail();
+    if (NULL == left || NULL == right)
+        return ctx.fail();
+
+    const int mark = ctx.mark();
+    BytecodeOperand lhs = Expr::bytecode(ctx, left);
+    if (!lhs.valid())
+        return lhs;
+    BytecodeOperand rhs = Expr::bytecode(ctx, right);
+    if (!rhs.valid())
+        return rhs;
+    ctx.release(mark);
+
+    BytecodeOp op;
+    switch ( infix_op->type )
+    {
+    case INFIX_ADD:
+        op = BYTECODE_ADD; break;
+    case INFIX_MINUS:
+        op = BYTECODE_SUB; break;
+    case INFIX_MULT:
+        // x*x of the same parameter
+        op = lhs == rhs ? BYTECODE_SQR : BYTECODE_MUL; break;
+    case INFIX_MOD:
+        op = BYTECODE_MOD; break;
+    case INFIX_OR:
+        op = BYTECODE_OR; break;
+    case INFIX_AND:
+        op = BYTECODE_AND; break;
+    case INFIX_DIV:
+        op = BYTECODE_DIV; break;
+    default:
+        return ctx.fail();
+    }
+    BytecodeOperand dst = ctx.temp();
+    ctx.emit(op, dst, lhs, rhs);
+    return dst;
+}
+
+bool TreeExpr::_hoist(ExprHoister &hoister)
+{
+    if (NULL == infix_op)
+        return NULL != gen_expr && hoister.children({&gen_expr}, true);
+    if (NULL == left || NULL == right)
+        return false;
+    return hoister.children({&left, &right}, true);
+}
+
 #if HAVE_LLVM
 llvm::Value *TreeExpr::_llvm(JitContext &jitx)
 {
@@ -879,6 +1178,89 @@ Expr *PrefunExpr::_optimize()
     return this;
 }
 
+bool PrefunExpr::_encode(ExprEncoder &encoder)
+{
+    encoder.u8(EXPR_OP_FUNC);
+    if (!encoder.func(function))
+        return false;
+    encoder.u8(num_args);
+    for (int i = 0; i < num_args; i++)
+        if (!Expr::encode(expr_list[i], encoder))
+            return false;
+    return true;
+}
+
+BytecodeOperand PrefunExpr::_bytecode(BytecodeContext &ctx)
+{
+    if (num_args == 1)
+    {
+        // these match the eval() of the specialized classes made by prefun_to_expr()
+        BytecodeOp op = BYTECODE_CALL1;
+        if (dynamic_cast<SinExpr *>(this))
+            op = BYTECODE_SIN;
+        else if (dynamic_cast<CosExpr *>(this))
+            op = BYTECODE_COS;
+        else if (dynamic_cast<LogExpr *>(this))
+            op = BYTECODE_LOG;
+        else if (func_ptr == FuncWrappers::sqr_wrapper)
+            op = BYTECODE_SQR;
+
+        // sin/cos of an affine argument in one instruction
+        if (op == BYTECODE_SIN || op == BYTECODE_COS)
+        {
+            if (auto *mult_add = dynamic_cast<MultAndAddExpr *>(expr_list[0]))
+                return mult_add->_bytecode_fused(ctx, op == BYTECODE_SIN ? BYTECODE_SIN_MUL_ADD : BYTECODE_COS_MUL_ADD);
+            if (auto *mult_const = dynamic_cast<MultConstExpr *>(expr_list[0]))
+                return mult_const->_bytecode_fused(ctx, op == BYTECODE_SIN ? BYTECODE_SIN_MUL_CONST : BYTECODE_COS_MUL_CONST);
+        }
+
+        const int mark = ctx.mark();
+        BytecodeOperand value = Expr::bytecode(ctx, expr_list[0]);
+        if (!value.valid())
+            return value;
+        ctx.release(mark);
+        BytecodeOperand dst = ctx.temp();
+        ctx.emit(op, dst, value).func = func_ptr;
+        return dst;
+    }
+
+    // the arguments are passed to func_ptr as an array, so they go to consecutive registers
+    const int mark = ctx.mark();
+    BytecodeOperand first;
+    for (int i = 0; i < num_args; i++)
+    {
+        BytecodeOperand arg = ctx.temp();
+        if (i == 0)
+            first = arg;
+    }
+    for (int i = 0; i < num_args; i++)
+    {
+        const int arg_mark = ctx.mark();
+        BytecodeOperand value = Expr::bytecode(ctx, expr_list[i]);
+        if (!value.valid())
+            return value;
+        ctx.move(BytecodeOperand(BytecodeOperand::TEMP, first.index + i, nullptr), value);
+        ctx.release(arg_mark);
+    }
+    ctx.release(mark);
+    BytecodeOperand dst = ctx.temp();
+    ctx.emit(BYTECODE_CALL, dst, num_args > 0 ? first : dst).func = func_ptr;
+    return dst;
+}
+
+bool PrefunExpr::_hoist(ExprHoister &hoister)
+{
+    return _hoist_args(hoister, isConstantFn(func_ptr));
+}
+
+bool PrefunExpr::_hoist_args(ExprHoister &hoister, bool pure)
+{
+    std::vector<Expr **> args;
+    for (int i = 0; i < num_args; i++)
+        args.push_back(&expr_list[i]);
+    return hoister.children(args, pure);
+}
+
 std::ostream& PrefunExpr::to_string(std::ostream& out)
 {
     char comma = ' ';
@@ -901,6 +1283,14 @@ class AssignExpr : public Expr
 protected:
     LValue *lhs;
     Expr *rhs;
+
+    bool encodeAssignment(ExprOp op, ExprEncoder &encoder)
+    {
+        if (lhs->clazz != PARAMETER)
+            return false;
+        encoder.u8(op);
+        return encoder.param((Param *)lhs) && Expr::encode(rhs, encoder);
+    }
 public:
     AssignExpr(LValue *lhs_, Expr *rhs_): Expr(ASSIGN), lhs(lhs_), rhs(rhs_) {}
 
@@ -928,6 +1318,26 @@ public:
 
     LValue *getLValue() { return lhs; }
 
+    bool _encode(ExprEncoder &encoder) override
+    {
+        return encodeAssignment(EXPR_OP_ASSIGN, encoder);
+    }
+
+    BytecodeOperand _bytecode(BytecodeContext &ctx) override
+    {
+        BytecodeOperand value = Expr::bytecode(ctx, rhs);
+        if (value.valid())
+            lhs->_bytecode_set(ctx, value);
+        return value;
+    }
+
+    bool _hoist(ExprHoister &hoister) override
+    {
+        hoister.assigned(lhs);
+        hoister.children({&rhs}, false);
+        return false;
+    }
+
     std::ostream& to_string(std::ostream &out) override
     {
         out << lhs << " = " << rhs;
@@ -966,6 +1376,19 @@ public:
         return v;
     }
 
+    bool _encode(ExprEncoder &encoder) override
+    {
+        return encodeAssignment(EXPR_OP_ASSIGN_MATRIX, encoder);
+    }
+
+    BytecodeOperand _bytecode(BytecodeContext &ctx) override
+    {
+        BytecodeOperand value = Expr::bytecode(ctx, rhs);
+        if (value.valid())
+            lhs->_bytecode_set_matrix(ctx, value);
+        return value;
+    }
+
     std::ostream &to_string(std::ostream &out) override
     {
         out << lhs << "[i,j] = " << rhs;
@@ -1022,6 +1445,14 @@ public:
         for (auto it=steps.begin() ; it<steps.end() ; it++)
             Expr::delete_expr(*it);
     }
+    const std::vector<Expr *> &getSteps() { return steps; }
+    bool _hoist(ExprHoister &hoister) override
+    {
+        // the steps themselves stay, they may be owned by the preset
+        for (Expr *step : steps)
+            Expr::invariant(hoister, step);
+        return false;
+    }
     float eval(int mesh_i, int mesh_j) override
     {
         float f=0.0f;
@@ -1047,6 +1478,308 @@ Expr *Expr::create_program_expr(std::vector<Expr*> &steps_, bool ownSteps)
 }
 
 
+bool Expr::encode(Expr *root, ExprEncoder &encoder)
+{
+    if (root->clazz == PARAMETER)
+    {
+        encoder.u8(EXPR_OP_PARAM);
+        return encoder.param((Param *)root);
+    }
+    return root->_encode(encoder);
+}
+
+void Expr::eval_points(int count, const ExprVarying *varying, int varying_count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        for (int v = 0; v < varying_count; v++)
+            *varying[v].value = varying[v].points[i];
+        eval(i, -1);
+    }
+}
+
+/* Statements are lowered one by one, see BytecodeContext */
+Expr *Expr::compile(Expr *root)
+{
+    BytecodeContext ctx;
+    if (root->clazz == PROGRAM)
+    {
+        for (Expr *step : ((ProgramExpr *)root)->getSteps())
+            ctx.statement(step);
+    }
+    else
+    {
+        ctx.statement(root);
+    }
+    return ctx.finish(root);
+}
+
+BytecodeOperand Expr::bytecode(BytecodeContext &ctx, Expr *expr)
+{
+    const bool statement = ctx._statement;
+    ctx._statement = false;
+    // parameters are read in place, so an assignment inside an expression could change
+    // an operand that the tree would already have evaluated
+    if (expr->clazz == ASSIGN && !statement)
+        return ctx.fail();
+    return expr->_bytecode(ctx);
+}
+
+BytecodeOperand Expr::_bytecode(BytecodeContext &ctx)
+{
+    BytecodeOperand dst = ctx.temp();
+    ctx.emit(BYTECODE_EVAL, dst).ref = this;
+    return dst;
+}
+
+void LValue::_bytecode_set(BytecodeContext &ctx, BytecodeOperand value)
+{
+    ctx.emit(BYTECODE_SET, BytecodeOperand(), value).ref = this;
+}
+
+void LValue::_bytecode_set_matrix(BytecodeContext &ctx, BytecodeOperand value)
+{
+    ctx.emit(BYTECODE_SET_MATRIX, BytecodeOperand(), value).ref = this;
+}
+
+/* Evaluates the hoisted subexpressions of a program, see Expr::hoist() */
+class PrologueExpr : public Expr
+{
+    std::vector<InvariantExpr *> invariants;
+public:
+    explicit PrologueExpr(std::vector<InvariantExpr *> &invariants_) : Expr(OTHER), invariants(invariants_) {}
+    ~PrologueExpr() override
+    {
+        for (InvariantExpr *invariant : invariants)
+            Expr::delete_expr(invariant);
+    }
+    float eval(int mesh_i, int mesh_j) override
+    {
+        for (InvariantExpr *invariant : invariants)
+            invariant->value = invariant->expr->eval(-1, -1);
+        return 0.0f;
+    }
+#if HAVE_LLVM
+    llvm::Value *_llvm(JitContext &jitx) override
+    {
+        return nullptr;
+    }
+#endif
+};
+
+/* Encodes params and functions by address, so equal encodings are equal expressions */
+class ExprKeyEncoder : public ExprEncoder
+{
+public:
+    bool param(Param *param) override { return pointer(param); }
+    bool func(Func *func) override { return pointer(func); }
+    const std::string &key() const { return _code; }
+private:
+    bool pointer(const void *ptr)
+    {
+        _code.append((const char *)&ptr, sizeof(ptr));
+        return true;
+    }
+};
+
+bool ExprHoister::children(const std::vector<Expr **> &list, bool pure)
+{
+    std::vector<char> invariant(list.size());
+    bool all = pure;
+    for (size_t i = 0; i < list.size(); i++)
+    {
+        invariant[i] = Expr::invariant(*this, *list[i]);
+        all = all && invariant[i];
+    }
+    if (all && !inner)
+        return true;
+    for (size_t i = 0; i < list.size(); i++)
+        if (invariant[i])
+            hoist(*list[i]);
+    return all;
+}
+
+void ExprHoister::hoist(Expr *&expr)
+{
+    // leaves are as cheap to read as the hoisted value
+    if (collecting || expr->isConstant() || expr->clazz == PARAMETER || dynamic_cast<InvariantExpr *>(expr))
+        return;
+
+    // share what is inside too, e.g. sin(time) of sin(time)*2 and sin(time)*3
+    if (!inner)
+    {
+        inner = true;
+        expr->_hoist(*this);
+        inner = false;
+    }
+
+    ExprKeyEncoder key;
+    const bool keyed = Expr::encode(expr, key);
+    InvariantExpr *invariant = nullptr;
+    if (keyed)
+    {
+        auto pos = found.find(key.key());
+        if (pos != found.end())
+        {
+            invariant = pos->second;
+            Expr::delete_expr(expr);
+        }
+    }
+    if (nullptr == invariant)
+    {
+        invariant = new InvariantExpr(expr);
+        invariant->refs++;  // the prologue's
+        prologue.push_back(invariant);
+        if (keyed)
+            found[key.key()] = invariant;
+    }
+    invariant->refs++;
+    expr = invariant;
+}
+
+bool Expr::invariant(ExprHoister &hoister, Expr *expr)
+{
+    if (expr->isConstant())
+        return true;
+    if (expr->clazz == PARAMETER)
+        return !((Param *)expr)->has_matrix() && 0 == hoister.varying.count(expr);
+    return expr->_hoist(hoister);
+}
+
+Expr *Expr::hoist(Expr *program, const std::vector<Param *> &varying)
+{
+    ExprHoister hoister;
+    hoister.varying.insert(varying.begin(), varying.end());
+    Expr::invariant(hoister, program);
+    hoister.collecting = false;
+    Expr::invariant(hoister, program);
+    if (hoister.prologue.empty())
+        return nullptr;
+    return new PrologueExpr(hoister.prologue);
+}
+
+/* Decodes count expressions into children. On failure the ones already decoded are deleted */
+static bool decode_children(ExprDecoder &decoder, Expr **children, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if ((children[i] = Expr::decode(decoder)) == nullptr)
+        {
+            for (int j = 0; j < i; j++)
+                Expr::delete_expr(children[j]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static InfixOp *infix_op_of_type(int type)
+{
+    switch (type)
+    {
+    case INFIX_ADD:
+        return Eval::infix_add;
+    case INFIX_MINUS:
+        return Eval::infix_minus;
+    case INFIX_MOD:
+        return Eval::infix_mod;
+    case INFIX_DIV:
+        return Eval::infix_div;
+    case INFIX_MULT:
+        return Eval::infix_mult;
+    case INFIX_OR:
+        return Eval::infix_or;
+    case INFIX_AND:
+        return Eval::infix_and;
+    default:
+        return nullptr;
+    }
+}
+
+static Expr *decode_node(uint8_t op, ExprDecoder &decoder)
+{
+    Expr *children[4];
+
+    switch (op)
+    {
+    case EXPR_OP_CONSTANT:
+    {
+        float value;
+        if (!decoder.f32(value))
+            return nullptr;
+        return new ConstantExpr(value);
+    }
+    case EXPR_OP_PARAM:
+        return Expr::param_to_expr(decoder.param());
+    case EXPR_OP_INFIX:
+    {
+        uint8_t type;
+        InfixOp *infix_op;
+        if (!decoder.u8(type) || (infix_op = infix_op_of_type(type)) == nullptr)
+            return nullptr;
+        if (!decode_children(decoder, children, 2))
+            return nullptr;
+        return TreeExpr::create(infix_op, children[0], children[1]);
+    }
+    case EXPR_OP_MULT_ADD:
+        if (!decode_children(decoder, children, 3))
+            return nullptr;
+        return new MultAndAddExpr(children[0], children[1], children[2]);
+    case EXPR_OP_MULT_CONST:
+    {
+        float c;
+        if (!decoder.f32(c) || !decode_children(decoder, children, 1))
+            return nullptr;
+        return new MultConstExpr(children[0], c);
+    }
+    case EXPR_OP_FUNC:
+    {
+        Func *func = decoder.func();
+        uint8_t num_args;
+        if (func == nullptr || !decoder.u8(num_args) || num_args != func->getNumArgs())
+            return nullptr;
+        Expr **expr_list = (Expr **)wipemalloc(sizeof(Expr *) * (num_args > 0 ? num_args : 1));
+        if (!decode_children(decoder, expr_list, num_args))
+        {
+            free(expr_list);
+            return nullptr;
+        }
+        return Expr::prefun_to_expr(func, expr_list);
+    }
+    case EXPR_OP_IF_ABOVE:
+    case EXPR_OP_IF_EQUAL:
+        if (!decode_children(decoder, children, 4))
+            return nullptr;
+        if (op == EXPR_OP_IF_ABOVE)
+            return new IfAboveExpr(children[0], children[1], children[2], children[3]);
+        return new IfEqualExpr(children[0], children[1], children[2], children[3]);
+    case EXPR_OP_ASSIGN:
+    case EXPR_OP_ASSIGN_MATRIX:
+    {
+        Param *param = decoder.param();
+        if (param == nullptr || !decode_children(decoder, children, 1))
+            return nullptr;
+        if (op == EXPR_OP_ASSIGN)
+            return new AssignExpr(param, children[0]);
+        return new AssignMatrixExpr(param, children[0]);
+    }
+    default:
+        return nullptr;
+    }
+}
+
+Expr *Expr::decode(ExprDecoder &decoder)
+{
+    uint8_t op;
+    if (decoder.depth >= ExprDecoder::MAX_DEPTH || !decoder.u8(op))
+        return nullptr;
+    decoder.depth++;
+    Expr *expr = decode_node(op, decoder);
+    decoder.depth--;
+    return expr;
+}
+
+
 
 
 // TESTS
@@ -1208,6 +1941,128 @@ public:
     }
 #endif
 
+    // bytecode must agree with evaluating the tree it was compiled from
+    bool compile()
+    {
+        Func *if_fn =  BuiltinFuncs::find_func("if");
+        Func *sin_fn = BuiltinFuncs::find_func("sin");
+        Param *A = Param::createUser("a");
+        Param *B = Param::createUser("b");
+
+        const float values[][2] = { {0.0f, 0.0f}, {1.5f, -2.0f}, {3.0f, 3.0f}, {-7.25f, 0.5f} };
+        for (auto &value : values)
+        {
+            A->set_param(value[0]);
+            B->set_param(value[1]);
+
+            // sin(a*b+2)
+            Expr **expr_list = (Expr **)malloc(1 * sizeof(Expr *));
+            expr_list[0] = TreeExpr::create(Eval::infix_add,
+                    TreeExpr::create(Eval::infix_mult, A, B), Expr::const_to_expr(2.0f));
+            Expr *SIN = Expr::optimize(Expr::prefun_to_expr(sin_fn, expr_list));
+            float expected = SIN->eval(-1,-1);
+            Expr *bytecode = Expr::compile(SIN);
+            TEST(eq(expected, bytecode->eval(-1,-1)));
+            Expr::delete_expr(bytecode);
+
+            // if(a, a/b, a%b)
+            expr_list = (Expr **)malloc(3 * sizeof(Expr *));
+            expr_list[0] = A;
+            expr_list[1] = TreeExpr::create(Eval::infix_div, A, B);
+            expr_list[2] = TreeExpr::create(Eval::infix_mod, A, B);
+            Expr *IF = Expr::optimize(Expr::prefun_to_expr(if_fn, expr_list));
+            expected = IF->eval(-1,-1);
+            bytecode = Expr::compile(IF);
+            TEST(expected == bytecode->eval(-1,-1));
+            Expr::delete_expr(bytecode);
+
+            // b = a*a-b
+            Expr *ASSIGN = new AssignExpr(B, TreeExpr::create(Eval::infix_minus,
+                    TreeExpr::create(Eval::infix_mult, A, A), B));
+            expected = value[0]*value[0] - value[1];
+            bytecode = Expr::compile(ASSIGN);
+            TEST(expected == bytecode->eval(-1,-1));
+            TEST(expected == B->eval(-1,-1));
+            Expr::delete_expr(bytecode);
+        }
+
+        // p = v*b over four points with v varying, as CustomWave does
+        float p = 0.0f, v = 0.0f;
+        float points[4] = {};
+        Param *P = Param::new_param_float("p", P_FLAG_PER_POINT, &p, points, 100.0f, -100.0f, 0.0f);
+        Param *V = Param::new_param_float("v", P_FLAG_NONE, &v, NULL, 100.0f, -100.0f, 0.0f);
+        const float v_points[4] = { 0.0f, 1.5f, -2.0f, 3.0f };
+        const ExprVarying varying[] = { { &v, v_points } };
+        B->set_param(0.5f);
+        Expr *bytecode = Expr::compile(Expr::create_matrix_assignment(P,
+                TreeExpr::create(Eval::infix_mult, V, B)));
+        bytecode->eval_points(4, varying, 1);
+        for (int i = 0; i < 4; i++)
+            TEST(v_points[i] * 0.5f == points[i]);
+        Expr::delete_expr(bytecode);
+
+        delete A;
+        delete B;
+        delete P;
+        delete V;
+        return true;
+    }
+
+    bool hoist()
+    {
+        Func *if_fn =  BuiltinFuncs::find_func("if");
+        Func *sin_fn = BuiltinFuncs::find_func("sin");
+        Param *A = Param::createUser("a");
+        Param *B = Param::createUser("b");
+        Param *C = Param::createUser("c");
+        Param *D = Param::createUser("d");
+
+        // folding: if(1, a, b) is a, a*1 is a
+        Expr **expr_list = (Expr **)malloc(3 * sizeof(Expr *));
+        expr_list[0] = Expr::const_to_expr(1.0f);
+        expr_list[1] = A;
+        expr_list[2] = B;
+        TEST(A == Expr::optimize(Expr::prefun_to_expr(if_fn, expr_list)));
+        TEST(A == Expr::optimize(TreeExpr::create(Eval::infix_mult, A, Expr::const_to_expr(1.0f))));
+
+        // b = sin(c*2) + a; d = sin(c*2) * b; with a varying, b assigned
+        std::vector<Expr *> steps;
+        for (int i = 0; i < 2; i++)
+        {
+            expr_list = (Expr **)malloc(1 * sizeof(Expr *));
+            expr_list[0] = TreeExpr::create(Eval::infix_mult, C, Expr::const_to_expr(2.0f));
+            Expr *SIN = Expr::prefun_to_expr(sin_fn, expr_list);
+            if (i == 0)
+                steps.push_back(new AssignExpr(B, Expr::optimize(TreeExpr::create(Eval::infix_add, SIN, A))));
+            else
+                steps.push_back(new AssignExpr(D, Expr::optimize(TreeExpr::create(Eval::infix_mult, SIN, B))));
+        }
+        Expr *program = Expr::create_program_expr(steps, true);
+        Expr *prologue = Expr::hoist(program, std::vector<Param *>{A});
+        TEST(prologue != nullptr);
+
+        for (float c : {0.5f, 1.25f})
+        {
+            C->set_param(c);
+            prologue->eval(-1, -1);
+            for (float a : {0.0f, 3.0f})
+            {
+                A->set_param(a);
+                program->eval(-1, -1);
+                TEST(sinf(c * 2.0f) + a == B->eval(-1, -1));
+                TEST(sinf(c * 2.0f) * (sinf(c * 2.0f) + a) == D->eval(-1, -1));
+            }
+        }
+
+        Expr::delete_expr(program);
+        Expr::delete_expr(prologue);
+        delete A;
+        delete B;
+        delete C;
+        delete D;
+        return true;
+    }
+
     bool test() override
     {
         Eval::init_infix_ops();
@@ -1216,6 +2071,8 @@ public:
 #if HAVE_LLVM
         result &= jit();
 #endif
+        result &= compile();
+        result &= hoist();
         return result;
     }
 };
@@ -40,6 +40,11 @@ class Test;
 class Param;
 class LValue;
 class JitContext;
+class ExprEncoder;
+class ExprDecoder;
+class BytecodeContext;
+struct BytecodeOperand;
+class ExprHoister;
 
 #ifdef HAVE_LLVM
 namespace llvm {
@@ -73,9 +78,17 @@ public:
 };
  
 
+/// A param that changes between the points of a per point program, with its
+/// value at each point, see Expr::eval_points()
+struct ExprVarying
+{
+  float *value;           /* engine value of the param */
+  const float *points;    /* its value at each point */
+};
+
 enum ExprClass
 {
-  TREE, CONSTANT, PARAMETER, FUNCTION, ASSIGN, PROGRAM, JIT, OTHER
+  TREE, CONSTANT, PARAMETER, FUNCTION, ASSIGN, PROGRAM, JIT, BYTECODE, OTHER
 };
 
 class Expr
@@ -87,6 +100,9 @@ public:
 
   virtual bool isConstant() { return false; };
   virtual float eval(int mesh_i, int mesh_j) = 0;
+  /// Evaluates a per point program at points 0 to count-1, setting the varying params to their
+  /// value at each point first. Programs that can loop internally override this.
+  virtual void eval_points(int count, const ExprVarying *varying, int varying_count);
   virtual std::ostream& to_string(std::ostream &out)
   {
       std::cout << "nyi"; return out;
@@ -104,10 +120,30 @@ public:
   static void delete_expr(Expr *expr) { if (nullptr != expr) expr->_delete_from_tree(); }
   static Expr *optimize(Expr *root);
   static Expr *jit(Expr *root, std::string name="Expr::jit");
+  /// Compiles an optimized expression, or a program of assignments, to register bytecode
+  /// (see Bytecode.hpp). Like jit(), the result owns root.
+  static Expr *compile(Expr *root);
+  /// Moves the subexpressions of a per pixel or per point program that cannot change during a
+  /// frame into a prologue, merging identical ones. Params with a matrix, params the program
+  /// assigns and the params in varying are taken to change between evaluations of the program.
+  /// Returns the prologue, to be evaluated once per frame before the program, or nullptr if
+  /// nothing could be hoisted.
+  static Expr *hoist(Expr *program, const std::vector<Param *> &varying);
+
+  /// Appends the prefix encoding of an optimized expression (see PresetCode.hpp).
+  /// Returns false for expressions that have no encoding, e.g. JIT compiled ones.
+  static bool encode(Expr *root, ExprEncoder &encoder);
+  /// Rebuilds an encoded expression, or returns nullptr if the encoding is invalid.
+  static Expr *decode(ExprDecoder &decoder);
 
 public: // but don't call these from outside Expr.cpp
 
   virtual Expr *_optimize() { return this; };
+  virtual bool _encode(ExprEncoder &encoder) { return false; }  //ONLY called by encode()
+  static BytecodeOperand bytecode(BytecodeContext &ctx, Expr *expr);
+  virtual BytecodeOperand _bytecode(BytecodeContext &ctx);  //ONLY called by bytecode(), defaults to calling eval()
+  static bool invariant(ExprHoister &hoister, Expr *expr);
+  virtual bool _hoist(ExprHoister &hoister) { return false; }  //ONLY called by invariant(), true if the value cannot change
 #if HAVE_LLVM
   static  llvm::Value *llvm(JitContext &jit, Expr *);
   virtual llvm::Value *_llvm(JitContext &jit) = 0;  //ONLY called by llvm()
@@ -154,6 +190,9 @@ public:
   ~TreeExpr() override;
   
   Expr *_optimize() override;
+  bool _encode(ExprEncoder &encoder) override;
+  BytecodeOperand _bytecode(BytecodeContext &ctx) override;
+  bool _hoist(ExprHoister &hoister) override;
   float eval(int mesh_i, int mesh_j) override;
 #if HAVE_LLVM
   llvm::Value *_llvm(JitContext &jitx) override;
@@ -168,6 +207,9 @@ public:
     explicit LValue(ExprClass c) : Expr(c) {};
     virtual void set(float value) = 0;
     virtual void set_matrix(int mesh_i, int mesh_j, float value) = 0;
+    // emit set() / set_matrix() of a value, see BytecodeContext
+    virtual void _bytecode_set(BytecodeContext &ctx, BytecodeOperand value);
+    virtual void _bytecode_set_matrix(BytecodeContext &ctx, BytecodeOperand value);
 #if HAVE_LLVM
     virtual llvm::Value *_llvm_set_matrix(JitContext &jitx, llvm::Value *rhs)
     {
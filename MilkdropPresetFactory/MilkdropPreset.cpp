@@ -32,14 +32,18 @@
 
 #include "MilkdropPreset.hpp"
 #include "Parser.hpp"
+#include "PresetBuffer.hpp"
+#include "PresetCode.hpp"
 #include "ParamUtils.hpp"
 #include "InitCondUtils.hpp"
 #include "fatal.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <iterator>
 
 #include "PresetFrameIO.hpp"
+#include "TaskPool.hpp"
 
 #include "PresetFactoryManager.hpp"
 #include "MilkdropPresetFactory.hpp"
@@ -52,9 +56,12 @@
 MilkdropPreset::MilkdropPreset(MilkdropPresetFactory *factory, std::istream & in, const std::string & presetName,  PresetOutputs & presetOutputs):
 	Preset(presetName),
     builtinParams(_presetInputs, presetOutputs),
+    per_frame_program(nullptr),
     per_pixel_program(nullptr),
+    per_pixel_prologue(nullptr),
     _factory(factory),
-    _presetOutputs(presetOutputs)
+    _presetOutputs(presetOutputs),
+    _customEquationsIndependent(false)
 {
   initialize(in);
 }
@@ -63,11 +70,14 @@ MilkdropPreset::MilkdropPreset(MilkdropPresetFactory *factory, std::istream & in
 MilkdropPreset::MilkdropPreset(MilkdropPresetFactory *factory, const std::string & absoluteFilePath, const std::string & presetName, PresetOutputs & presetOutputs):
 	Preset(presetName),
     builtinParams(_presetInputs, presetOutputs),
+    per_frame_program(nullptr),
     per_pixel_program(nullptr),
+    per_pixel_prologue(nullptr),
     _filename(parseFilename(absoluteFilePath)),
     _absoluteFilePath(absoluteFilePath),
     _factory(factory),
-    _presetOutputs(presetOutputs)
+    _presetOutputs(presetOutputs),
+    _customEquationsIndependent(false)
 {
 
   initialize(absoluteFilePath);
@@ -83,8 +93,10 @@ MilkdropPreset::~MilkdropPreset()
 
   traverse<TraverseFunctors::Delete<PerPixelEqn> >(per_pixel_eqn_tree);
   Expr::delete_expr(per_pixel_program);
+  Expr::delete_expr(per_pixel_prologue);
 
   traverseVector<TraverseFunctors::Delete<PerFrameEqn> >(per_frame_eqn_tree);
+  Expr::delete_expr(per_frame_program);
 
   traverse<TraverseFunctors::Delete<Param> >(user_param_tree);
 
@@ -147,6 +159,76 @@ int MilkdropPreset::add_per_pixel_eqn(char * name, Expr * gen_expr)
   return PROJECTM_SUCCESS;
 }
 
+namespace {
+
+// True if every equation of the wave or shape assigns one of its own params,
+// rather than a preset param that the other waves and shapes may read
+template <class CustomObject>
+bool assigns_own_params(const CustomObject &custom)
+{
+  auto owns = [&custom](const Param *param) {
+    return custom.param_tree.owns(param);
+  };
+  for (const PerFrameEqn *eqn : custom.per_frame_eqn_tree)
+    if (!owns(eqn->param))
+      return false;
+  for (auto &init_cond : custom.init_cond_tree)
+    if (!owns(init_cond.second->param))
+      return false;
+  for (auto &init_cond : custom.per_frame_init_eqn_tree)
+    if (!owns(init_cond.second->param))
+      return false;
+  return true;
+}
+
+// What the evalCustom...() functions below do for one wave or shape
+template <class CustomObject>
+void eval_custom_object(CustomObject &custom)
+{
+  custom.evalInitConds();
+  for (auto &expression : custom.init_cond_tree)
+    expression.second->evaluate();
+  custom.per_frame_program->eval(-1, -1);
+}
+
+}  // namespace
+
+// Once q has been transferred, a wave or shape that only assigns its own params
+// reads nothing the others write, so each one is a task of its own.
+void MilkdropPreset::evalCustomWavesAndShapes()
+{
+  if (!_customEquationsIndependent)
+  {
+    evalCustomWaveInitConditions();
+    evalCustomWavePerFrameEquations();
+
+    evalCustomShapeInitConditions();
+    evalCustomShapePerFrameEquations();
+    return;
+  }
+
+  // compile on this thread, the tasks only evaluate
+  for (auto &wave : customWaves)
+    if (nullptr == wave->per_frame_program)
+      wave->per_frame_program = PerFrameEqn::compile(wave->per_frame_eqn_tree);
+  for (auto &shape : customShapes)
+    if (nullptr == shape->per_frame_program)
+      shape->per_frame_program = PerFrameEqn::compile(shape->per_frame_eqn_tree);
+
+  const int wave_count = static_cast<int>(customWaves.size());
+  const int count = wave_count + static_cast<int>(customShapes.size());
+  ParallelFor(0, count, 1, [this, wave_count](int begin, int end)
+  {
+    for (int i = begin; i < end; i++)
+    {
+      if (i < wave_count)
+        eval_custom_object(*customWaves[i]);
+      else
+        eval_custom_object(*customShapes[i - wave_count]);
+    }
+  });
+}
+
 void MilkdropPreset::evalCustomShapeInitConditions() {
   for (auto &shape : customShapes) {
     shape->evalInitConds();
@@ -166,9 +248,9 @@ void MilkdropPreset::evalCustomWavePerFrameEquations()
       assert(expression.second);
       expression.second->evaluate();
     }
-    for (auto &expression : wave->per_frame_eqn_tree) {
-      expression->evaluate();
-    }
+    if (nullptr == wave->per_frame_program)
+      wave->per_frame_program = PerFrameEqn::compile(wave->per_frame_eqn_tree);
+    wave->per_frame_program->eval(-1, -1);
   }
 }
 
@@ -179,9 +261,9 @@ void MilkdropPreset::evalCustomShapePerFrameEquations()
       assert(expression.second);
       expression.second->evaluate();
     }
-    for (auto &expression : wave->per_frame_eqn_tree) {
-      expression->evaluate();
-    }
+    if (nullptr == wave->per_frame_program)
+      wave->per_frame_program = PerFrameEqn::compile(wave->per_frame_eqn_tree);
+    wave->per_frame_program->eval(-1, -1);
   }
 }
 
@@ -197,9 +279,10 @@ void MilkdropPreset::evalPerFrameEquations() {
     assert(expression.second);
     expression.second->evaluate();
   }
-  for (auto &expression : per_frame_eqn_tree) {
-    expression->evaluate();
-  }
+  // per frame equations run as one bytecode program, see PerFrameEqn::compile()
+  if (nullptr == per_frame_program)
+    per_frame_program = PerFrameEqn::compile(per_frame_eqn_tree);
+  per_frame_program->eval(-1, -1);
 }
 
 void MilkdropPreset::preloadInitialize() {
@@ -225,6 +308,12 @@ void MilkdropPreset::postloadInitialize()
   this->loadCustomWaveUnspecInitConds();
   this->loadCustomShapeUnspecInitConds();
 
+  _customEquationsIndependent = true;
+  for (auto &wave : customWaves)
+    _customEquationsIndependent &= assigns_own_params(*wave);
+  for (auto &shape : customShapes)
+    _customEquationsIndependent &= assigns_own_params(*shape);
+
 
 /// @bug are you handling all the q variables conditions? in particular, the un-init case?
 //m_presetOutputs.q1 = 0;
@@ -321,52 +410,48 @@ void MilkdropPreset::evaluateFrame()
 
   evalPerPixelEqns();
 
-  evalCustomWaveInitConditions();
-  evalCustomWavePerFrameEquations();
+  evalCustomWavesAndShapes();
 
-  evalCustomShapeInitConditions();
-  evalCustomShapePerFrameEquations();
-
-  // Setup pointers of the custom waves and shapes to the preset outputs instance
-  /// @slow an extra O(N) per frame, could do this during eval
-  _presetOutputs.customWaves = std::vector<std::shared_ptr<CustomWave>>(customWaves);
-  _presetOutputs.customShapes = std::vector<std::shared_ptr<CustomShape>>(customShapes);
+  // Setup pointers of the custom waves and shapes to the preset outputs instance.
+  // assign() reuses the existing storage, so this does not allocate once the
+  // vectors have reached their size.
+  _presetOutputs.customWaves.assign(customWaves.begin(), customWaves.end());
+  _presetOutputs.customShapes.assign(customShapes.begin(), customShapes.end());
 
 }
 
 
+// Fills a whole plane, padding included, so PresetOutputs::PerPixelMath_simd()
+// computes sane values there too
 #ifdef __SSE2__
-inline void init_mesh(float **mesh, const float value, const int gx, const int gy)
+inline void init_mesh(float *mesh, const float value, const int size)
 {
   __m128 mvalue = _mm_set_ps1(value);
-  for (int x = 0; x < gx; x++)
-    for (int y = 0; y < gy; y += 4)
-      _mm_store_ps(&mesh[x][y], mvalue);
+  for (int i = 0; i < size; i += 4)
+    _mm_store_ps(&mesh[i], mvalue);
 }
 #else
-inline void init_mesh(float **mesh, const float value, const int gx, const int gy)
+inline void init_mesh(float *mesh, const float value, const int size)
 {
-    for (int x=0; x<gx; x++)
-        for (int y=0; y<gy; y++)
-            mesh[x][y] = value;
+    for (int i=0; i<size; i++)
+        mesh[i] = value;
 }
 #endif
 
 void MilkdropPreset::initialize_PerPixelMeshes()
 {
-  int gx = presetInputs().gx;
-  int gy = presetInputs().gy;
-
-  init_mesh(_presetOutputs.cx_mesh, presetOutputs().cx, gx, gy);
-  init_mesh(_presetOutputs.cy_mesh, presetOutputs().cy, gx, gy);
-  init_mesh(_presetOutputs.sx_mesh, presetOutputs().sx, gx, gy);
-  init_mesh(_presetOutputs.sy_mesh, presetOutputs().sy, gx, gy);
-  init_mesh(_presetOutputs.dx_mesh, presetOutputs().dx, gx, gy);
-  init_mesh(_presetOutputs.dy_mesh, presetOutputs().dy, gx, gy);
-  init_mesh(_presetOutputs.zoom_mesh, presetOutputs().zoom, gx, gy);
-  init_mesh(_presetOutputs.zoomexp_mesh, presetOutputs().zoomexp, gx, gy);
-  init_mesh(_presetOutputs.rot_mesh, presetOutputs().rot, gx, gy);
-  init_mesh(_presetOutputs.warp_mesh, presetOutputs().warp, gx, gy);
+  const int size = presetInputs().gx * _presetOutputs.mesh_stride();
+
+  init_mesh(_presetOutputs.cx_mesh, presetOutputs().cx, size);
+  init_mesh(_presetOutputs.cy_mesh, presetOutputs().cy, size);
+  init_mesh(_presetOutputs.sx_mesh, presetOutputs().sx, size);
+  init_mesh(_presetOutputs.sy_mesh, presetOutputs().sy, size);
+  init_mesh(_presetOutputs.dx_mesh, presetOutputs().dx, size);
+  init_mesh(_presetOutputs.dy_mesh, presetOutputs().dy, size);
+  init_mesh(_presetOutputs.zoom_mesh, presetOutputs().zoom, size);
+  init_mesh(_presetOutputs.zoomexp_mesh, presetOutputs().zoomexp, size);
+  init_mesh(_presetOutputs.rot_mesh, presetOutputs().rot, size);
+  init_mesh(_presetOutputs.warp_mesh, presetOutputs().warp, size);
 }
 
 
@@ -384,15 +469,22 @@ void MilkdropPreset::evalPerPixelEqns()
         for (std::map<int, PerPixelEqn*>::iterator pos = per_pixel_eqn_tree.begin(); pos != per_pixel_eqn_tree.end(); ++pos)
             steps.push_back(pos->second->assign_expr);
         Expr *program_expr = Expr::create_program_expr(steps, false);
+        // x, y, rad and ang are matrix params, so only the mesh varies between evaluations
+        per_pixel_prologue = Expr::hoist(program_expr, std::vector<Param *>());
         Expr *jit = nullptr;
 #if HAVE_LLVM
         std::string module_name = this->_filename + "_per_pixel";
         if (!steps.empty())
             jit = Expr::jit(program_expr, module_name);
 #endif
-        per_pixel_program = jit ? jit : program_expr;
+        // without the JIT, interpret the program as bytecode instead of walking the trees
+        if (nullptr == jit)
+            jit = Expr::compile(program_expr);
+        per_pixel_program = jit;
     }
 
+    if (nullptr != per_pixel_prologue)
+        per_pixel_prologue->eval(-1, -1);
     for (int mesh_x = 0; mesh_x < presetInputs().gx; mesh_x++)
         for (int mesh_y = 0; mesh_y < presetInputs().gy; mesh_y++)
             per_pixel_program->eval( mesh_x, mesh_y );
@@ -400,11 +492,22 @@ void MilkdropPreset::evalPerPixelEqns()
 
 int MilkdropPreset::readIn(std::istream & fs) {
 
+  // The parser works on a contiguous buffer; read the whole stream first.
+  std::string contents((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+  PresetBuffer buffer(contents);
+  return readIn(buffer);
+}
+
+int MilkdropPreset::readIn(PresetBuffer & fs) {
+
   presetOutputs().GetCompositeShader().second.program_source.clear();
   presetOutputs().GetWarpShader().second.program_source.clear();
 
+  // Parser state is local to this read, so presets can be loaded concurrently.
+  Parser parser;
+
   /* Parse any comments */
-  if (Parser::parse_top_comment(fs) < 0)
+  if (parser.parse_top_comment(fs) < 0)
   {
         if (MILKDROP_PRESET_DEBUG)
                     std::cerr << "[Preset::readIn] no left bracket found..." << std::endl;
@@ -414,7 +517,7 @@ int MilkdropPreset::readIn(std::istream & fs) {
   /* Parse the preset name and a left bracket */
   char tmp_name[MAX_TOKEN_SIZE];
 
-  if (Parser::parse_preset_name(fs, tmp_name) < 0)
+  if (parser.parse_preset_name(fs, tmp_name) < 0)
   {
     std::cerr <<  "[Preset::readIn] loading of preset name failed" << std::endl;
     return PROJECTM_ERROR;
@@ -425,7 +528,7 @@ int MilkdropPreset::readIn(std::istream & fs) {
   // Loop through each line in file, trying to successfully parse the file.
   // If a line does not parse correctly, keep trucking along to next line.
   int retval;
-  while ((retval = Parser::parse_line(fs, this)) != EOF)
+  while ((retval = parser.parse_line(fs, this)) != EOF)
   {
     if (retval == PROJECTM_PARSE_ERROR)
     {
@@ -448,9 +551,9 @@ int MilkdropPreset::loadPresetFile(const std::string & pathname)
 {
 
 
-  /* Open the file corresponding to pathname */
-  std::ifstream fs(pathname.c_str());
-  if (!fs || fs.eof()) {
+  /* Open (map) the file corresponding to pathname */
+  PresetFile file(pathname);
+  if (!file.isOpen()) {
 
     std::ostringstream oss;
     oss << "Problem reading file from path: \"" << pathname << "\"";
@@ -459,7 +562,20 @@ int MilkdropPreset::loadPresetFile(const std::string & pathname)
 
   }
 
- return readIn(fs);
+  /* Precompiled presets are rebuilt directly, see PresetCode */
+  if (PresetCode::isPresetCode(file.contents()))
+  {
+    if (PresetCode::read(file.contents(), *this) < 0)
+    {
+      std::ostringstream oss;
+      oss << "Corrupt or incompatible precompiled preset: \"" << pathname << "\"";
+      throw PresetFactoryException(oss.str());
+    }
+    return PROJECTM_SUCCESS;
+  }
+
+ PresetBuffer buffer(file.contents());
+ return readIn(buffer);
 
 }
 
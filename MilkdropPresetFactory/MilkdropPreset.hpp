@@ -51,6 +51,7 @@ class MilkdropPresetFactory;
 class CustomWave;
 class CustomShape;
 class InitCond;
+class PresetBuffer;
 
 
 class MilkdropPreset : public Preset
@@ -75,6 +76,11 @@ public:
 
   ~MilkdropPreset();
 
+private:
+  /// Declared ahead of builtinParams, whose constructor initializes it
+  PresetInputs _presetInputs;
+
+public:
   /// All "builtin" parameters for this MilkdropPreset. Anything *but* user defined parameters and
   /// custom waves / shapes objects go here.
   /// @bug encapsulate
@@ -129,8 +135,10 @@ public:
   /// @bug encapsulate
   /* Data structures that contain equation and initial condition information */
   std::vector<PerFrameEqn*>  per_frame_eqn_tree;   /* per frame equations */
+  Expr *per_frame_program;
   std::map<int, PerPixelEqn*>  per_pixel_eqn_tree; /* per pixel equation tree */
   Expr *per_pixel_program;
+  Expr *per_pixel_prologue;   /* invariants of per_pixel_program, see Expr::hoist() */
   std::map<std::string,InitCond*>  per_frame_init_eqn_tree; /* per frame initial equations */
   std::map<std::string,InitCond*>  init_cond_tree; /* initial conditions */
   std::map<std::string,Param*> user_param_tree; /* user parameter splay tree */
@@ -143,7 +151,6 @@ public:
   const std::string & filename() const { return _filename; } 
 private:
   std::string _filename; 
-  PresetInputs _presetInputs;
   /// Evaluates the MilkdropPreset for a frame given the current values of MilkdropPreset inputs / outputs
   /// All calculated values are stored in the associated MilkdropPreset outputs instance
   void evaluateFrame();
@@ -163,6 +170,7 @@ private:
   void loadCustomWaveUnspecInitConds();
   void loadCustomShapeUnspecInitConds();
 
+  void evalCustomWavesAndShapes();
   void evalCustomWavePerFrameEquations();
   void evalCustomShapePerFrameEquations();
   void evalPerFrameInitEquations();
@@ -172,6 +180,7 @@ private:
   void evalPerFrameEquations();
   void initialize_PerPixelMeshes();
   int readIn(std::istream & fs);
+  int readIn(PresetBuffer & buffer);
 
   void preloadInitialize();
   void postloadInitialize();
@@ -179,6 +188,10 @@ private:
   MilkdropPresetFactory *_factory;
   PresetOutputs & _presetOutputs;
 
+  /// True if the custom waves and shapes only assign their own params, so
+  /// evalCustomWavesAndShapes() may evaluate them concurrently
+  bool _customEquationsIndependent;
+
 template <class CustomObject>
 void transfer_q_variables(std::vector<std::shared_ptr<CustomObject>> & customObjects);
 
@@ -141,7 +141,7 @@ void resetPresetOutputs(PresetOutputs * presetOutputs)
 /* Reinitializes the engine variables to a default (conservative and sane) value */
 void MilkdropPresetFactory::reset()
 {
-
+    std::lock_guard<std::mutex> lock(_presetOutputsCacheMutex);
     if (_presetOutputsCache)
         resetPresetOutputs(_presetOutputsCache);
 }
@@ -211,15 +211,13 @@ std::unique_ptr<Preset> MilkdropPresetFactory::allocate(const std::string & url,
 
     PresetOutputs *presetOutputs;
     // use cached PresetOutputs if there is one, otherwise allocate
-    if (_presetOutputsCache)
     {
+        std::lock_guard<std::mutex> lock(_presetOutputsCacheMutex);
         presetOutputs = _presetOutputsCache;
         _presetOutputsCache = nullptr;
     }
-    else
-    {
+    if (presetOutputs == nullptr)
         presetOutputs = createPresetOutputs(gx,gy);
-    }
 
 	resetPresetOutputs(presetOutputs);
 
@@ -234,9 +232,19 @@ std::unique_ptr<Preset> MilkdropPresetFactory::allocate(const std::string & url,
 void MilkdropPresetFactory::releasePreset(Preset *preset_)
 {
     MilkdropPreset *preset = (MilkdropPreset *)preset_;
+    // the waves and shapes evaluate against the preset's params, so they
+    // must go now, while those still exist, from every list holding them
+    preset->_presetOutputs.customWaves.clear();
+    preset->_presetOutputs.customShapes.clear();
+    preset->_presetOutputs.drawables.clear();
     // return PresetOutputs to the cache
-    if (nullptr == _presetOutputsCache)
-        _presetOutputsCache = &preset->_presetOutputs;
-    else
-        delete &preset->_presetOutputs;
+    {
+        std::lock_guard<std::mutex> lock(_presetOutputsCacheMutex);
+        if (nullptr == _presetOutputsCache)
+        {
+            _presetOutputsCache = &preset->_presetOutputs;
+            return;
+        }
+    }
+    delete &preset->_presetOutputs;
 }
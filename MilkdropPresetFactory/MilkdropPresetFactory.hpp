@@ -14,6 +14,7 @@
 #define __MILKDROP_PRESET_FACTORY_HPP
 
 #include <memory>
+#include <mutex>
 #include "../PresetFactory.hpp"
 class DLLEXPORT PresetOutputs;
 class DLLEXPORT PresetInputs;
@@ -39,6 +40,9 @@ private:
 	void reset();
 	int gx;
 	int gy;
+	// Guards the cache; presets may be allocated and released on several
+	// threads at once.
+	std::mutex _presetOutputsCacheMutex;
 	PresetOutputs * _presetOutputsCache;
 	//PresetInputs _presetInputs;
 };
@@ -39,6 +39,7 @@
 #include <iostream>
 #include <cassert>
 #include "JitContext.hpp"
+#include "Bytecode.hpp"
 
 /** Constructor */
 Param::Param( const std::string &_name, short int _type, short int _flags, void * _engine_val, void * _matrix,
@@ -50,6 +51,7 @@ Param::Param( const std::string &_name, short int _type, short int _flags, void
         matrix_flag (0),
         engine_val(_engine_val),
         matrix (_matrix),
+        matrix_stride(0),
         default_init_val (_default_init_val),
         upper_bound (_upper_bound),
         lower_bound (_lower_bound),
@@ -65,6 +67,7 @@ Param::Param(const std::string &_name) : LValue(PARAMETER),
         flags(P_FLAG_USERDEF),
         matrix_flag(0),
         matrix(0),
+        matrix_stride(0),
         local_value(0.0)
 {
         engine_val = (float *)&local_value;
@@ -287,6 +290,20 @@ public:
     {
         return *(float *)engine_val;
     }
+    BytecodeOperand _bytecode(BytecodeContext &ctx) override
+    {
+        return ctx.external((float *)engine_val);
+    }
+    void _bytecode_set(BytecodeContext &ctx, BytecodeOperand value) override
+    {
+        // set_param() for P_TYPE_DOUBLE, matrix_flag means nothing to a float param
+        ctx.emit(BYTECODE_STORE_CLAMP, ctx.external((float *)engine_val), value,
+                 ctx.constant(lower_bound.float_val), ctx.constant(upper_bound.float_val));
+    }
+    void _bytecode_set_matrix(BytecodeContext &ctx, BytecodeOperand value) override
+    {
+        _bytecode_set(ctx, value);
+    }
 #if HAVE_LLVM
     llvm::Value *_llvm(JitContext &jitx) override
     {
@@ -317,14 +334,14 @@ public:
     float eval(int mesh_i, int mesh_j) override
     {
         assert( mesh_i >=0 && mesh_j >= 0 );
-        return ((float **)matrix)[mesh_i][mesh_j];
+        return ((float *)matrix)[mesh_i * matrix_stride + mesh_j];
     }
     void set_matrix(int mesh_i, int mesh_j, float value) override
     {
         assert( mesh_i >=0 && mesh_j >= 0);
         // Yup, presets write to read-only ALWAYS_MATRIX parameters
         // assert(!(flags & P_FLAG_READONLY));
-        ((float **)matrix)[mesh_i][mesh_j] = value;
+        ((float *)matrix)[mesh_i * matrix_stride + mesh_j] = value;
     }
 };*/
 
@@ -343,7 +360,7 @@ public:
         //    e.g. per_point1=dx=dx*1.01
         // any this means that we get called with (i>=0,j==-1)
         if ( matrix_flag && mesh_i >= 0 && mesh_j >= 0)
-            return ( ( ( float** ) matrix ) [mesh_i][mesh_j] );
+            return ( ( float* ) matrix ) [mesh_i * matrix_stride + mesh_j];
         return * ( ( float* ) ( engine_val ) );
     }
     void set_matrix(int mesh_i, int mesh_j, float value) override
@@ -354,10 +371,31 @@ public:
         }
         else
         {
-            ((float **) matrix)[mesh_i][mesh_j] = value;
+            ((float *) matrix)[mesh_i * matrix_stride + mesh_j] = value;
             matrix_flag = true;
         }
     }
+    BytecodeOperand _bytecode(BytecodeContext &ctx) override
+    {
+        BytecodeOperand dst = ctx.temp();
+        BytecodeInstruction &load = ctx.emit(BYTECODE_LOAD_MESH, dst, ctx.external((float *)engine_val));
+        load.ref = matrix;
+        load.flag = &matrix_flag;
+        load.stride = matrix_stride;
+        return dst;
+    }
+    void _bytecode_set_matrix(BytecodeContext &ctx, BytecodeOperand value) override
+    {
+        if (nullptr == matrix)
+        {
+            ctx.emit(BYTECODE_STORE, ctx.external((float *)engine_val), value);
+            return;
+        }
+        BytecodeInstruction &store = ctx.emit(BYTECODE_STORE_MESH, BytecodeOperand(), value);
+        store.ref = matrix;
+        store.flag = &matrix_flag;
+        store.stride = matrix_stride;
+    }
 };
 
 
@@ -390,13 +428,32 @@ public:
             matrix_flag = true;
         }
     }
+    BytecodeOperand _bytecode(BytecodeContext &ctx) override
+    {
+        BytecodeOperand dst = ctx.temp();
+        BytecodeInstruction &load = ctx.emit(BYTECODE_LOAD_POINTS, dst, ctx.external((float *)engine_val));
+        load.ref = matrix;
+        load.flag = &matrix_flag;
+        return dst;
+    }
+    void _bytecode_set_matrix(BytecodeContext &ctx, BytecodeOperand value) override
+    {
+        if (nullptr == matrix)
+        {
+            ctx.emit(BYTECODE_STORE, ctx.external((float *)engine_val), value);
+            return;
+        }
+        BytecodeInstruction &store = ctx.emit(BYTECODE_STORE_POINTS, BytecodeOperand(), value);
+        store.ref = matrix;
+        store.flag = &matrix_flag;
+    }
 };
 
 
 Param * Param::create( const std::string &name, short int type, short int flags,
     void * eqn_val, void *matrix,
     CValue default_init_val, CValue upper_bound,
-    CValue lower_bound)
+    CValue lower_bound, int matrix_stride)
 {
     if (type == P_TYPE_BOOL)
     {
@@ -424,7 +481,10 @@ Param * Param::create( const std::string &name, short int type, short int flags,
     assert( flags & (P_FLAG_PER_PIXEL|P_FLAG_PER_POINT) );
     if (flags & P_FLAG_PER_PIXEL)
     {
-        return new _MeshParam( name, type, flags, eqn_val, matrix, default_init_val, upper_bound, lower_bound );
+        assert(matrix_stride > 0);
+        Param *param = new _MeshParam( name, type, flags, eqn_val, matrix, default_init_val, upper_bound, lower_bound );
+        param->matrix_stride = matrix_stride;
+        return param;
     }
     else
     {
@@ -442,19 +502,75 @@ Param * Param::createUser( const std::string &name )
 
 
 #include <TestRunner.hpp>
+#include "ParamTable.hpp"
 
 #ifndef NDEBUG
 
+#define TEST(cond) if (!verify(#cond,cond)) return false
+
 struct ParamTest : public Test
 {
     ParamTest() : Test("ParamTest")
     {}
 
 public:
-    bool test() override
+    bool test_symbol_table()
+    {
+        TEST(SymbolTable().find("x") == -1);
+
+        SymbolTable::Symbols symbols;
+        for (int i = 0; i < 1000; i++)
+            symbols.push_back(std::make_pair("q" + std::to_string(i), i));
+        symbols.push_back(std::make_pair(std::string("q7"), 1000));
+        SymbolTable table(symbols);
+        TEST(table.size() == 1000);
+        for (int i = 0; i < 1000; i++)
+            TEST(table.find("q" + std::to_string(i)) == i);
+        TEST(table.find("q1000") == -1);
+        TEST(table.find("q") == -1);
+        TEST(table.find("") == -1);
+        TEST(table.find("q1", 1) == -1);
+        return true;
+    }
+
+    bool test_param_table()
     {
+        ParamTable::Symbols symbols;
+        float values[2][2];
+        ParamTable first(symbols), second(symbols);
+        ParamTable *tables[2] = { &first, &second };
+        for (int t = 0; t < 2; t++)
+        {
+            Param *zoom = Param::new_param_float("zoom", P_FLAG_NONE, &values[t][0], NULL, 1, 0, 0);
+            tables[t]->insert(zoom);
+            tables[t]->insert(Param::new_param_float("rot", P_FLAG_NONE, &values[t][1], NULL, 1, 0, 0));
+            tables[t]->insert_alias("fzoom", zoom);
+            TEST(tables[t]->find("fzoom") == zoom);
+            tables[t]->finish();
+            TEST(tables[t]->find("zoom") == zoom);
+            TEST(tables[t]->find("fzoom") == zoom);
+            TEST(tables[t]->owns(zoom));
+        }
+        TEST(first.find("rot") != second.find("rot"));
+        TEST(!first.owns(second.find("rot")));
+
+        TEST(first.find("my_var") == NULL);
+        Param *user = first.find_or_create("my_var");
+        TEST(user != NULL && (user->flags & P_FLAG_USERDEF));
+        TEST(first.find("my_var") == user);
+        TEST(first.find_or_create("rot") == first.find("rot"));
+        TEST(first.user_params().size() == 1);
+        TEST(second.find("my_var") == NULL);
         return true;
     }
+
+    bool test() override
+    {
+        bool result = true;
+        result &= test_symbol_table();
+        result &= test_param_table();
+        return result;
+    }
 };
 
 Test* Param::test()
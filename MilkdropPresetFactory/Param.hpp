@@ -84,6 +84,7 @@ protected:
     short int matrix_flag; /* for optimization purposes */
     void * engine_val; /* pointer to the engine variable */
     void * matrix; /* per pixel / per point matrix for this variable */
+    int matrix_stride; /* per pixel matrix element (i, j) is matrix[i * matrix_stride + j] */
 public:
     CValue default_init_val; /* a default initial condition value */
 protected:
@@ -95,9 +96,10 @@ protected:
 
 public:
     /// Create a new parameter
+    /// \param matrix_stride for a per pixel matrix, the distance between its columns, see MeshPlanes
     static Param * create(const std::string &name, short int type, short int flags,
            void * eqn_val, void *matrix, CValue default_init_val, CValue upper_bound,
-           CValue lower_bound);
+           CValue lower_bound, int matrix_stride = 0);
 
     static Param * createUser(const std::string &name);
 
@@ -106,6 +108,8 @@ public:
     virtual ~Param();
 
     static bool is_valid_param_string( const char *string );
+    /// True for per pixel / per point parameters, which may read a different value at each mesh point
+    bool has_matrix() const { return NULL != matrix; }
     void set_param( float val );
     void set_param( CValue val );
     void set_param( std::string &text) { *((std::string*)engine_val) = text; }
@@ -0,0 +1,129 @@
+/**
+ * projectM -- Milkdrop-esque visualisation SDK
+ * Copyright (C)2003-2007 projectM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * See 'LICENSE.txt' included within this release
+ *
+ */
+
+#include "ParamTable.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "Param.hpp"
+
+ParamTable::ParamTable(Symbols &symbols) : _symbols(symbols)
+{
+}
+
+ParamTable::~ParamTable()
+{
+    clear();
+}
+
+void ParamTable::clear()
+{
+    for (Param *param : _builtins)
+        delete param;
+    for (auto &entry : _user)
+        delete entry.second;
+    _builtins.clear();
+    _user.clear();
+}
+
+void ParamTable::insert(Param *param)
+{
+    assert(param);
+    _builtins.push_back(param);
+}
+
+void ParamTable::insert_alias(const std::string &alias, const Param *param)
+{
+    /* only the table that fills in the symbols needs them */
+    if (_symbols._table.load(std::memory_order_acquire) != nullptr)
+        return;
+
+    std::vector<Param*>::const_iterator pos = std::find(_builtins.begin(), _builtins.end(), param);
+    assert(pos != _builtins.end());
+    _aliases.push_back(std::make_pair(alias, static_cast<int>(pos - _builtins.begin())));
+}
+
+void ParamTable::finish()
+{
+    std::call_once(_symbols._once, [this]() {
+        SymbolTable::Symbols symbols(_aliases);
+        for (size_t i = 0; i < _builtins.size(); i++)
+            symbols.push_back(std::make_pair(_builtins[i]->name, static_cast<int>(i)));
+        _symbols._storage = SymbolTable(symbols);
+        _symbols._table.store(&_symbols._storage, std::memory_order_release);
+    });
+    SymbolTable::Symbols().swap(_aliases);
+
+#ifndef NDEBUG
+    /* every table of the kind has its builtins in the same places */
+    const SymbolTable *symbols = _symbols._table.load(std::memory_order_acquire);
+    for (size_t i = 0; i < _builtins.size(); i++)
+        assert(symbols->find(_builtins[i]->name) == static_cast<int>(i));
+#endif
+}
+
+Param *ParamTable::find(const std::string &name) const
+{
+    const SymbolTable *symbols = _symbols._table.load(std::memory_order_acquire);
+    if (symbols != nullptr)
+    {
+        const int index = symbols->find(name);
+        if (index >= 0 && index < static_cast<int>(_builtins.size()))
+            return _builtins[index];
+    }
+    else
+    {
+        /* the first table of the kind, still being filled in */
+        for (const auto &alias : _aliases)
+        {
+            if (alias.first == name)
+                return _builtins[alias.second];
+        }
+        for (Param *param : _builtins)
+        {
+            if (param->name == name)
+                return param;
+        }
+    }
+
+    UserParams::const_iterator pos = _user.find(name);
+    return pos == _user.end() ? NULL : pos->second;
+}
+
+Param *ParamTable::find_or_create(const std::string &name)
+{
+    Param *param = find(name);
+    if (param != NULL)
+        return param;
+
+    if (!Param::is_valid_param_string(name.c_str()))
+        return NULL;
+    if ((param = Param::createUser(name)) == NULL)
+        return NULL;
+    _user.insert(std::make_pair(param->name, param));
+    return param;
+}
+
+bool ParamTable::owns(const Param *param) const
+{
+    return param != NULL && find(param->name) == param;
+}
@@ -0,0 +1,114 @@
+/**
+ * projectM -- Milkdrop-esque visualisation SDK
+ * Copyright (C)2003-2007 projectM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * See 'LICENSE.txt' included within this release
+ *
+ */
+/**
+ * $Id$
+ *
+ * The parameters of a preset, custom wave or custom shape
+ *
+ * $Log$
+ */
+
+#ifndef _PARAM_TABLE_HPP
+#define _PARAM_TABLE_HPP
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "SymbolTable.hpp"
+
+class Param;
+
+/// The parameters of one object, e.g. a custom wave: the builtin ones that
+/// every object of its kind has, in a flat array, and the user defined ones
+/// its equations introduce, by name.
+///
+/// Every object of a kind inserts the same builtin parameters in the same
+/// order, so their names map to the same positions. The first table of the
+/// kind to finish() fills in a SymbolTable with them, which all tables of the
+/// kind then look names up in.
+class ParamTable
+{
+public:
+    /// What the tables of one kind share, e.g. a static of the class that
+    /// owns them
+    class Symbols
+    {
+    public:
+        Symbols() : _table(nullptr) {}
+
+    private:
+        friend class ParamTable;
+
+        std::once_flag _once;
+        std::atomic<const SymbolTable *> _table;
+        SymbolTable _storage;
+    };
+
+    typedef std::map<std::string, Param*> UserParams;
+
+    explicit ParamTable(Symbols &symbols);
+    /// Deletes every parameter
+    ~ParamTable();
+
+    ParamTable(const ParamTable &) = delete;
+    ParamTable &operator=(const ParamTable &) = delete;
+
+    /// Adds the next builtin parameter, taking ownership of it
+    void insert(Param *param);
+    /// Makes alias another name of param, a builtin parameter already added
+    void insert_alias(const std::string &alias, const Param *param);
+    /// Called once every builtin parameter is inserted
+    void finish();
+
+    /// The builtin or user defined parameter of that name, an alias going
+    /// before a builtin name, or NULL
+    Param *find(const std::string &name) const;
+    /// Like find(), but creates a user defined parameter if there is none
+    /// and name is a valid one
+    Param *find_or_create(const std::string &name);
+    /// True if param is one of these
+    bool owns(const Param *param) const;
+
+    UserParams &user_params() { return _user; }
+
+    /// Deletes every parameter
+    void clear();
+
+    template <class Fun>
+    void apply(Fun &fun)
+    {
+        for (Param *param : _builtins)
+            fun(param);
+        for (auto &entry : _user)
+            fun(entry.second);
+    }
+
+private:
+    Symbols &_symbols;
+    std::vector<Param*> _builtins;
+    SymbolTable::Symbols _aliases;  /* until the symbols are filled in */
+    UserParams _user;
+};
+
+#endif /** !_PARAM_TABLE_HPP */
@@ -9,6 +9,7 @@
 #include <map>
 #include <cassert>
 #include "BuiltinParams.hpp"
+#include "ParamTable.hpp"
 
 class ParamUtils
 {
@@ -24,6 +25,16 @@ public:
 
   }
 
+  /* Adds a builtin parameter of a custom wave or shape */
+  static bool insert(Param * param, ParamTable * paramTable)
+  {
+    assert(param);
+    assert(paramTable);
+
+    paramTable->insert(param);
+    return true;
+  }
+
   static const int AUTO_CREATE = 1;
   static const int NO_CREATE = 0;
 
@@ -67,6 +78,17 @@ public:
   }
 
 
+  template <int FLAGS>
+  static Param * find(const std::string & name, ParamTable * paramTable)
+  {
+    assert(paramTable);
+
+    if (FLAGS == AUTO_CREATE)
+      return paramTable->find_or_create(name);
+    return paramTable->find(name);
+  }
+
+
   static Param * find(const std::string & name, BuiltinParams * builtinParams, std::map<std::string,Param*> * insertionTree)
   {
 
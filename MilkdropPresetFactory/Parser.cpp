@@ -52,24 +52,20 @@
 /* Grabs the next token from the file. The second argument points
    to the raw string */
 
-line_mode_t Parser::line_mode;
-std::shared_ptr<CustomWave>Parser::current_wave;
-std::shared_ptr<CustomShape>Parser::current_shape;
-int Parser::string_line_buffer_index;
-char Parser::string_line_buffer[STRING_LINE_SIZE];
-unsigned int Parser::line_count;
-int Parser::per_frame_eqn_count;
-int Parser::per_frame_init_eqn_count;
-int Parser::last_custom_wave_id;
-int Parser::last_custom_shape_id;
-char Parser::last_eqn_type[MAX_TOKEN_SIZE+1];
-int Parser::last_token_size;
-
-std::string Parser::lastLinePrefix("");
-
-bool Parser::tokenWrapAroundEnabled(false);
-
-token_t Parser::parseToken(std::istream &  fs, char * string)
+Parser::Parser() :
+  line_mode(UNSET_LINE_MODE),
+  line_length(0),
+  line_count(1),
+  per_frame_eqn_count(0),
+  per_frame_init_eqn_count(0),
+  last_custom_wave_id(0),
+  last_custom_shape_id(0),
+  tokenWrapAroundEnabled(false)
+{
+  last_eqn_type[0] = '\0';
+}
+
+token_t Parser::parseToken(PresetBuffer &  fs, char * string)
 {
 
   int c;
@@ -88,13 +84,11 @@ token_t Parser::parseToken(std::istream &  fs, char * string)
     else
       c = fs.get();
 
-    last_token_size++;
-    /* If the string line buffer is full, quit */
-    if (string_line_buffer_index == (STRING_LINE_SIZE - 1))
+    /* If the line is too long, quit */
+    if (line_length == (STRING_LINE_SIZE - 1))
       return tStringBufferFilled;
+    line_length++;
 
-    /* Otherwise add this character to the string line buffer */
-    string_line_buffer[string_line_buffer_index++] = tolower(c);
     /* Now interpret the character */
     switch (c)
     {
@@ -122,11 +116,13 @@ token_t Parser::parseToken(std::istream &  fs, char * string)
           if (c == EOF)
           {
             line_mode = UNSET_LINE_MODE;
+            line_length = 0;
             return tEOF;
           }
           if (c == '\n')
           {
             line_mode = UNSET_LINE_MODE;
+            line_length = 0;
             return tEOL;
           }
         }
@@ -178,6 +174,7 @@ token_t Parser::parseToken(std::istream &  fs, char * string)
           {
             line_count = 1;
             line_mode = UNSET_LINE_MODE;
+            line_length = 0;
         if (PARSE_DEBUG)     std::cerr << "token wrap: end of file" << std::endl;
             return tEOF;
           }
@@ -207,6 +204,7 @@ token_t Parser::parseToken(std::istream &  fs, char * string)
 				return tStringTooLong;
 			}
 		}
+		line_length = 0;
 		return tEOL;
 	}
 
@@ -216,6 +214,7 @@ token_t Parser::parseToken(std::istream &  fs, char * string)
 
 
       line_mode = UNSET_LINE_MODE;
+      line_length = 0;
       return tEOL;
     case ',':
       return tComma;
@@ -229,6 +228,7 @@ token_t Parser::parseToken(std::istream &  fs, char * string)
     case EOF:
       line_count = 1;
       line_mode = UNSET_LINE_MODE;
+      line_length = 0;
       return tEOF;
 
     case '\r':
@@ -253,7 +253,7 @@ token_t Parser::parseToken(std::istream &  fs, char * string)
 /* Parse input in the form of "exp, exp, exp, ...)"
    Returns a general expression list */
 
-Expr **Parser::parse_prefix_args(std::istream &  fs, int num_args, MilkdropPreset * preset)
+Expr **Parser::parse_prefix_args(PresetBuffer &  fs, int num_args, MilkdropPreset * preset)
 {
 
   int i, j;
@@ -292,7 +292,7 @@ Expr **Parser::parse_prefix_args(std::istream &  fs, int num_args, MilkdropPrese
 }
 
 /* Parses a comment at the top of the file. Stops when left bracket is found */
-int Parser::parse_top_comment(std::istream &  fs)
+int Parser::parse_top_comment(PresetBuffer &  fs)
 {
 
   char string[MAX_TOKEN_SIZE];
@@ -311,7 +311,7 @@ int Parser::parse_top_comment(std::istream &  fs)
 
 /* Right Bracket is parsed by this function.
    puts a new string into name */
-int Parser::parse_preset_name(std::istream &  fs, char * name)
+int Parser::parse_preset_name(PresetBuffer &  fs, char * name)
 {
 
   token_t token;
@@ -327,7 +327,7 @@ int Parser::parse_preset_name(std::istream &  fs, char * name)
 
 
 /* Parses per pixel equations */
-int Parser::parse_per_pixel_eqn(std::istream &  fs, MilkdropPreset * preset, char * init_string)
+int Parser::parse_per_pixel_eqn(PresetBuffer &  fs, MilkdropPreset * preset, char * init_string)
 {
 
 
@@ -369,7 +369,7 @@ int Parser::parse_per_pixel_eqn(std::istream &  fs, MilkdropPreset * preset, cha
 }
 
 /* Parses an equation line, this function is way too big, should add some helper functions */
-int Parser::parse_line(std::istream &  fs, MilkdropPreset * preset)
+int Parser::parse_line(PresetBuffer &  fs, MilkdropPreset * preset)
 {
 
   char eqn_string[MAX_TOKEN_SIZE];
@@ -377,9 +377,7 @@ int Parser::parse_line(std::istream &  fs, MilkdropPreset * preset)
   InitCond * init_cond;
   PerFrameEqn * per_frame_eqn;
 
-  /* Clear the string line buffer */
-  memset(string_line_buffer, 0, STRING_LINE_SIZE);
-  string_line_buffer_index = 0;
+  line_length = 0;
 
   tokenWrapAroundEnabled = false;
 
@@ -717,7 +715,7 @@ int Parser::parse_line(std::istream &  fs, MilkdropPreset * preset)
 
 
 /* Parses a general expression, this function is the meat of the parser */
-Expr * Parser::_parse_gen_expr ( std::istream &  fs, TreeExpr * tree_expr, MilkdropPreset * preset)
+Expr * Parser::_parse_gen_expr ( PresetBuffer &  fs, TreeExpr * tree_expr, MilkdropPreset * preset)
 {
   int i;
   char string[MAX_TOKEN_SIZE];
@@ -979,7 +977,7 @@ Expr * Parser::_parse_gen_expr ( std::istream &  fs, TreeExpr * tree_expr, Milkd
 }
 
 
-Expr * Parser::parse_gen_expr ( std::istream &  fs, TreeExpr * tree_expr, MilkdropPreset * preset)
+Expr * Parser::parse_gen_expr ( PresetBuffer &  fs, TreeExpr * tree_expr, MilkdropPreset * preset)
 {
   Expr *gen_expr = _parse_gen_expr( fs, tree_expr, preset );
   if (nullptr == gen_expr)
@@ -1178,7 +1176,7 @@ int Parser::insert_infix_rec(InfixOp * infix_op, TreeExpr * root)
 }
 
 /* Parses an infix operator */
-Expr * Parser::parse_infix_op(std::istream &  fs, token_t token, TreeExpr * tree_expr, MilkdropPreset * preset)
+Expr * Parser::parse_infix_op(PresetBuffer &  fs, token_t token, TreeExpr * tree_expr, MilkdropPreset * preset)
 {
 
   Expr * gen_expr;
@@ -1237,7 +1235,7 @@ Expr * Parser::parse_infix_op(std::istream &  fs, token_t token, TreeExpr * tree
 }
 
 /* Parses an integer, checks for +/- prefix */
-int Parser::parse_int(std::istream &  fs, int * int_ptr)
+int Parser::parse_int(PresetBuffer &  fs, int * int_ptr)
 {
 
   char string[MAX_TOKEN_SIZE];
@@ -1300,7 +1298,7 @@ int Parser::string_to_float(char * string, float * float_ptr)
 }
 
 /* Parses a floating point number */
-int Parser::parse_float(std::istream &  fs, float * float_ptr)
+int Parser::parse_float(PresetBuffer &  fs, float * float_ptr)
 {
 
   char string[MAX_TOKEN_SIZE];
@@ -1344,7 +1342,7 @@ int Parser::parse_float(std::istream &  fs, float * float_ptr)
 }
 
 /* Parses a per frame equation. That is, interprets a stream of data as a per frame equation */
-PerFrameEqn * Parser::parse_per_frame_eqn(std::istream &  fs, int index, MilkdropPreset * preset)
+PerFrameEqn * Parser::parse_per_frame_eqn(PresetBuffer &  fs, int index, MilkdropPreset * preset)
 {
 
   char string[MAX_TOKEN_SIZE];
@@ -1395,7 +1393,7 @@ PerFrameEqn * Parser::parse_per_frame_eqn(std::istream &  fs, int index, Milkdro
 }
 
 /* Parses an 'implicit' per frame equation. That is, interprets a stream of data as a per frame equation without a prefix */
-PerFrameEqn * Parser::parse_implicit_per_frame_eqn(std::istream &  fs, char * param_string, int index, MilkdropPreset * preset)
+PerFrameEqn * Parser::parse_implicit_per_frame_eqn(PresetBuffer &  fs, char * param_string, int index, MilkdropPreset * preset)
 {
 
   Param * param;
@@ -1448,7 +1446,7 @@ PerFrameEqn * Parser::parse_implicit_per_frame_eqn(std::istream &  fs, char * pa
 }
 
 /* Parses an initial condition */
-InitCond * Parser::parse_init_cond(std::istream &  fs, char * name, MilkdropPreset * preset)
+InitCond * Parser::parse_init_cond(PresetBuffer &  fs, char * name, MilkdropPreset * preset)
 {
 
   Param * param;
@@ -1529,7 +1527,7 @@ InitCond * Parser::parse_init_cond(std::istream &  fs, char * name, MilkdropPres
 }
 
 
-void Parser::parse_string_block(std::istream &  fs, std::string * out_string) {
+void Parser::parse_string_block(PresetBuffer &  fs, std::string * out_string) {
 
 	std::set<char> skipList;
 	skipList.insert('`');
@@ -1539,7 +1537,7 @@ void Parser::parse_string_block(std::istream &  fs, std::string * out_string) {
 
 }
 
-InitCond * Parser::parse_per_frame_init_eqn(std::istream &  fs, MilkdropPreset * preset, std::map<std::string,Param*> * database)
+InitCond * Parser::parse_per_frame_init_eqn(PresetBuffer &  fs, MilkdropPreset * preset, ParamTable * database)
 {
 
   char name[MAX_TOKEN_SIZE];
@@ -1635,7 +1633,7 @@ InitCond * Parser::parse_per_frame_init_eqn(std::istream &  fs, MilkdropPreset *
   return init_cond;
 }
 
-bool Parser::scanForComment(std::istream & fs) {
+bool Parser::scanForComment(PresetBuffer & fs) {
 
   int c;
   c = fs.get();
@@ -1661,7 +1659,7 @@ bool Parser::scanForComment(std::istream & fs) {
   }
 }
 
-void Parser::readStringUntil(std::istream & fs, std::string * out_buffer, bool wrapAround, const std::set<char> & skipList) {
+void Parser::readStringUntil(PresetBuffer & fs, std::string * out_buffer, bool wrapAround, const std::set<char> & skipList) {
 
 	int c;
 
@@ -1752,7 +1750,7 @@ void Parser::readStringUntil(std::istream & fs, std::string * out_buffer, bool w
 
 
 }
-int Parser::parse_wavecode(char * token, std::istream &  fs, MilkdropPreset * preset)
+int Parser::parse_wavecode(char * token, PresetBuffer &  fs, MilkdropPreset * preset)
 {
 
   char * var_string;
@@ -1850,7 +1848,7 @@ int Parser::parse_wavecode(char * token, std::istream &  fs, MilkdropPreset * pr
   return PROJECTM_SUCCESS;
 }
 
-int Parser::parse_shapecode(char * token, std::istream &  fs, MilkdropPreset * preset)
+int Parser::parse_shapecode(char * token, PresetBuffer &  fs, MilkdropPreset * preset)
 {
 
   char * var_string;
@@ -2144,7 +2142,7 @@ int Parser::parse_shape_prefix(char * token, int * id, char ** eqn_string)
 }
 
 /* Parses custom wave equations */
-int Parser::parse_wave(char * token, std::istream &  fs, MilkdropPreset * preset)
+int Parser::parse_wave(char * token, PresetBuffer &  fs, MilkdropPreset * preset)
 {
 
   int id;
@@ -2172,7 +2170,7 @@ int Parser::parse_wave(char * token, std::istream &  fs, MilkdropPreset * preset
 
 }
 
-int Parser::parse_wave_helper(std::istream &  fs, MilkdropPreset  * preset, int id, char * eqn_type, char * init_string)
+int Parser::parse_wave_helper(PresetBuffer &  fs, MilkdropPreset  * preset, int id, char * eqn_type, char * init_string)
 {
 
   Param * param;
@@ -2325,7 +2323,7 @@ int Parser::parse_wave_helper(std::istream &  fs, MilkdropPreset  * preset, int
 }
 
 /* Parses custom shape equations */
-int Parser::parse_shape(char * token, std::istream &  fs, MilkdropPreset * preset)
+int Parser::parse_shape(char * token, PresetBuffer &  fs, MilkdropPreset * preset)
 {
 
   int id;
@@ -2418,7 +2416,7 @@ int Parser::get_string_prefix_len(char * string)
   return i;
 }
 
-int Parser::parse_shape_per_frame_init_eqn(std::istream &  fs, std::shared_ptr<CustomShape> custom_shape, MilkdropPreset * preset)
+int Parser::parse_shape_per_frame_init_eqn(PresetBuffer &  fs, std::shared_ptr<CustomShape> custom_shape, MilkdropPreset * preset)
 {
   InitCond * init_cond;
 
@@ -2440,7 +2438,7 @@ int Parser::parse_shape_per_frame_init_eqn(std::istream &  fs, std::shared_ptr<C
   return PROJECTM_SUCCESS;
 }
 
-int Parser::parse_shape_per_frame_eqn(std::istream & fs, std::shared_ptr<CustomShape> custom_shape, MilkdropPreset * preset)
+int Parser::parse_shape_per_frame_eqn(PresetBuffer & fs, std::shared_ptr<CustomShape> custom_shape, MilkdropPreset * preset)
 {
 
   Param * param;
@@ -2502,7 +2500,7 @@ int Parser::parse_shape_per_frame_eqn(std::istream & fs, std::shared_ptr<CustomS
   return PROJECTM_SUCCESS;
 }
 
-int Parser::parse_wave_per_frame_eqn(std::istream &  fs, std::shared_ptr<CustomWave> custom_wave, MilkdropPreset * preset)
+int Parser::parse_wave_per_frame_eqn(PresetBuffer &  fs, std::shared_ptr<CustomWave> custom_wave, MilkdropPreset * preset)
 {
 
   Param * param;
@@ -2599,6 +2597,12 @@ else
 #ifndef NDEBUG
 
 #include <PresetLoader.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include "PresetCode.hpp"
 
 #define TEST(cond) if (!verify(#cond,cond)) return false
 #define TEST2(str,cond) if (!verify(str,cond)) return false
@@ -2608,9 +2612,11 @@ struct ParserTest : public Test
     ParserTest() : Test("ParserTest")
     {}
 
+    PresetLoader *presetLoader;
     MilkdropPreset *preset;
-    std::istringstream is;
-    std::istringstream &ss(const char *s) { return is = std::istringstream(s); }
+    Parser parser;
+    PresetBuffer is;
+    PresetBuffer &ss(const char *s) { return is = PresetBuffer(s); }
 
     bool eq(float a, float b)
     {
@@ -2622,33 +2628,40 @@ public:
     bool test_float()
     {
         float f=-1.0f;
-        TEST(PROJECTM_SUCCESS == Parser::parse_float(ss("1.1"),&f));
+        TEST(PROJECTM_SUCCESS == parser.parse_float(ss("1.1"),&f));
         TEST(1.1f == f);
-        TEST(PROJECTM_SUCCESS == Parser::parse_float(ss("+1.2"),&f));
-        TEST(PROJECTM_SUCCESS == Parser::parse_float(ss("-1.3"),&f));
-        TEST(PROJECTM_PARSE_ERROR == Parser::parse_float(ss(""),&f));
-        TEST(PROJECTM_PARSE_ERROR == Parser::parse_float(ss("\n"),&f));
-        TEST(PROJECTM_PARSE_ERROR == Parser::parse_float(ss("+"),&f));
+        TEST(PROJECTM_SUCCESS == parser.parse_float(ss("+1.2"),&f));
+        TEST(PROJECTM_SUCCESS == parser.parse_float(ss("-1.3"),&f));
+        TEST(PROJECTM_PARSE_ERROR == parser.parse_float(ss(""),&f));
+        TEST(PROJECTM_PARSE_ERROR == parser.parse_float(ss("\n"),&f));
+        TEST(PROJECTM_PARSE_ERROR == parser.parse_float(ss("+"),&f));
+        // nothing builds up from one call to the next
+        for (int i = 0; i < 1000; i++)
+        {
+            f = 0.0f;
+            TEST(PROJECTM_SUCCESS == parser.parse_float(ss("2.5"),&f));
+            TEST(2.5f == f);
+        }
         return true;
     }
 
     bool test_int()
     {
         int i=-1;
-        TEST(PROJECTM_SUCCESS == Parser::parse_int(ss("1"),&i));
+        TEST(PROJECTM_SUCCESS == parser.parse_int(ss("1"),&i));
         TEST(1 == i);
-        TEST(PROJECTM_SUCCESS == Parser::parse_int(ss("+2"),&i));
-        TEST(PROJECTM_SUCCESS == Parser::parse_int(ss("-3"),&i));
-        TEST(PROJECTM_PARSE_ERROR == Parser::parse_int(ss(""),&i));
-        TEST(PROJECTM_PARSE_ERROR == Parser::parse_int(ss("\n"),&i));
-        TEST(PROJECTM_PARSE_ERROR == Parser::parse_int(ss("+"),&i));
+        TEST(PROJECTM_SUCCESS == parser.parse_int(ss("+2"),&i));
+        TEST(PROJECTM_SUCCESS == parser.parse_int(ss("-3"),&i));
+        TEST(PROJECTM_PARSE_ERROR == parser.parse_int(ss(""),&i));
+        TEST(PROJECTM_PARSE_ERROR == parser.parse_int(ss("\n"),&i));
+        TEST(PROJECTM_PARSE_ERROR == parser.parse_int(ss("+"),&i));
         return true;
     }
 
     bool eval_expr(float expected, const char *s)
     {
         float result;
-        Expr *expr_parse = Parser::parse_gen_expr(ss(s),nullptr,preset);
+        Expr *expr_parse = parser.parse_gen_expr(ss(s),nullptr,preset);
         TEST(expr_parse != nullptr);
         // Expr doesn't really expect to run 'non-optimized' expressions any longer
         Expr *expr = Expr::optimize(expr_parse);
@@ -2686,6 +2699,93 @@ public:
         return true;
     }
 
+    /* two presets with a bit of everything, wrapped lines included */
+    static const char *presetSource(int which)
+    {
+        if (which == 0)
+            return "[preset00]\n"
+                   "fRating=3.000000\n"
+                   "fDecay=0.950000\n"
+                   "nWaveMode=7\n"
+                   "bTexWrap=1\n"
+                   "zoom=1.010000\n"
+                   "warp=1.000000\n"
+                   "wave_r=0.650000\n"
+                   "per_frame_init_1=q8 = 2; startval = 10;\n"
+                   "per_frame_1=wave_r = wave_r + 0.35*(0.6*sin(0.933*time)\n"
+                   "per_frame_2= + 0.4*sin(1.045*time));\n"
+                   "per_frame_3=q1 = bass_att*0.5; startval = startval*0.99;\n"
+                   "per_pixel_1=zoom = zoom + 0.05*sin(rad*6 + time)*q1;\n"
+                   "per_pixel_2=rot = if(above(x,0.5), 0.01, -0.01)*q8;\n"
+                   "wavecode_0_enabled=1\n"
+                   "wavecode_0_samples=512\n"
+                   "wave_0_init1=t2 = 0.5;\n"
+                   "wave_0_per_frame1=t1 = q1*0.5 + sin(time);\n"
+                   "wave_0_per_point1=x = sample; y = 0.5 + value1*0.3*t1;\n"
+                   "shapecode_0_enabled=1\n"
+                   "shapecode_0_sides=5\n"
+                   "shape_0_per_frame1=ang = time*0.4; x = 0.5 + 0.1*cos(time);\n";
+        return "[preset00]\n"
+               "fDecay=0.980000\n"
+               "nWaveMode=2\n"
+               "bMotionVectorsOn=1\n"
+               "rot=0.020000\n"
+               "per_frame_1=wave_a = 0; q2 = time;\n"
+               "per_frame_2=zoom = 1 + 0.1*sin(time)\n"
+               "per_pixel_1=dx = 0.01*cos(y*3.14 + q2);\n"
+               "wavecode_1_enabled=1\n"
+               "wave_1_per_point1=x = 0.5 + 0.4*sin(sample*6.28 + q2);\n"
+               "wave_1_per_point2=r = x; g = y; b = 1-x*y;\n"
+               "shapecode_3_enabled=1\n"
+               "shapecode_3_sides=40\n"
+               "shape_3_per_frame1=rad = 0.1 + 0.05*bass;\n"
+               "shape_3_per_frame2=a = if(equal(frame%2,0), 1, 0.5);\n";
+    }
+
+    /* loads a preset file and encodes what was parsed */
+    bool loadCode(const std::string &path, std::string *code)
+    {
+        try
+        {
+            std::unique_ptr<Preset> loaded = presetLoader->loadPreset(path);
+            return loaded && PresetCode::write(*dynamic_cast<MilkdropPreset *>(loaded.get()), *code);
+        }
+        catch (const PresetFactoryException &)
+        {
+            return false;
+        }
+    }
+
+    // separate parsers must not share state: presets read on two threads at
+    // once parse the same as when read one after the other
+    bool test_reentrant()
+    {
+        std::string paths[2];
+        std::string serial[2];
+        for (int i = 0; i < 2; i++)
+        {
+            paths[i] = (std::filesystem::temp_directory_path() /
+                        ("projectm_parser_test_" + std::to_string(i) + ".milk")).string();
+            std::ofstream out(paths[i].c_str(), std::ios::binary | std::ios::trunc);
+            out << presetSource(i);
+        }
+        bool ok = loadCode(paths[0], &serial[0]) && loadCode(paths[1], &serial[1]);
+        for (int round = 0; ok && round < 50; round++)
+        {
+            std::string code[2];
+            bool loaded[2];
+            std::thread other([&]() { loaded[1] = loadCode(paths[1], &code[1]); });
+            loaded[0] = loadCode(paths[0], &code[0]);
+            other.join();
+            ok = loaded[0] && loaded[1] && code[0] == serial[0] && code[1] == serial[1];
+        }
+        for (int i = 0; i < 2; i++)
+            std::remove(paths[i].c_str());
+        TEST(ok);
+        TEST(serial[0] != serial[1]);
+        return true;
+    }
+
 
     bool _test()
     {
@@ -2695,18 +2795,21 @@ public:
         success &= test_eqn();
         success &= test_lines();
         success &= test_params();
+        success &= test_reentrant();
         return success;
     }
 
     bool test() override
     {
         // load IdlePreset
-        PresetLoader *presetLoader = new PresetLoader ( 400, 400, "" );
+        presetLoader = new PresetLoader ( 400, 400, "" );
         std::unique_ptr<Preset> preset_ptr = presetLoader->loadPreset("idle://Geiss & Sperl - Feedback (projectM idle HDR mix).milk");
         preset = (MilkdropPreset *)preset_ptr.get();
 
         bool success = _test();
 
+        // the preset goes back to its factory, so release it first
+        preset_ptr.reset();
         delete presetLoader;
         return success;
     }
@@ -37,6 +37,7 @@
 #include "PerFrameEqn.hpp"
 #include "InitCond.hpp"
 #include "MilkdropPreset.hpp"
+#include "PresetBuffer.hpp"
 
 /* Strings that prefix (and denote the type of) equations */
 #define PER_FRAME_STRING "per_frame_"
@@ -117,7 +118,7 @@ typedef enum {
     tNegative, /* - as a prefix operator */
     tSemiColon, /* ; */
     tStringTooLong, /* special token to indicate an invalid string length */
-    tStringBufferFilled /* the string buffer for this line is maxed out */
+    tStringBufferFilled /* the line is longer than STRING_LINE_SIZE */
   } token_t;
 
 class Test;
@@ -129,67 +130,74 @@ class PerFrameEqn;
 class MilkdropPreset;
 class TreeExpr;
 
+/// Parses Milkdrop preset files. Each instance holds the state of one parse
+/// (current line mode, custom wave/shape, line length), so separate Parser
+/// objects may read presets concurrently on different threads. A single
+/// instance is not thread safe.
 class Parser {
 public:
-    static std::string lastLinePrefix;
-    static line_mode_t line_mode;
-    static std::shared_ptr<CustomWave>current_wave;
-    static std::shared_ptr<CustomShape>current_shape;
-    static int string_line_buffer_index;
-    static char string_line_buffer[STRING_LINE_SIZE];
-    static unsigned int line_count;
-    static int per_frame_eqn_count;
-    static int per_frame_init_eqn_count;
-    static int last_custom_wave_id;
-    static int last_custom_shape_id;
-    static char last_eqn_type[MAX_TOKEN_SIZE+1];
-    static int last_token_size;
-    static bool tokenWrapAroundEnabled;
+    Parser();
+
+    std::string lastLinePrefix;
+    line_mode_t line_mode;
+    std::shared_ptr<CustomWave>current_wave;
+    std::shared_ptr<CustomShape>current_shape;
+    /// Characters read on the current line. A line ends at a newline that
+    /// does not wrap a token, or at the end of the input, so calls that
+    /// parse a line each start from zero.
+    int line_length;
+    unsigned int line_count;
+    int per_frame_eqn_count;
+    int per_frame_init_eqn_count;
+    int last_custom_wave_id;
+    int last_custom_shape_id;
+    char last_eqn_type[MAX_TOKEN_SIZE+1];
+    bool tokenWrapAroundEnabled;
 
     static Test *test();
-    static PerFrameEqn *parse_per_frame_eqn( std::istream & fs, int index,
+    PerFrameEqn *parse_per_frame_eqn( PresetBuffer & fs, int index,
                                              MilkdropPreset * preset);
-    static int parse_per_pixel_eqn( std::istream & fs, MilkdropPreset * preset,
+    int parse_per_pixel_eqn( PresetBuffer & fs, MilkdropPreset * preset,
                                     char * init_string);
-    static InitCond *parse_init_cond( std::istream & fs, char * name, MilkdropPreset * preset );
-    static int parse_preset_name( std::istream & fs, char * name );
-    static int parse_top_comment( std::istream & fs );
-    static int parse_line( std::istream & fs, MilkdropPreset * preset );
-
-    static int get_string_prefix_len(char * string);
-    static TreeExpr * insert_gen_expr(Expr * gen_expr, TreeExpr ** root);
-    static TreeExpr * insert_infix_op(InfixOp * infix_op, TreeExpr ** root);
-    static token_t parseToken(std::istream & fs, char * string);
-    static Expr ** parse_prefix_args(std::istream & fs, int num_args, MilkdropPreset * preset);
-    static Expr * parse_infix_op(std::istream & fs, token_t token, TreeExpr * tree_expr, MilkdropPreset * preset);
-    static Expr * parse_sign_arg(std::istream & fs);
-    static int parse_float(std::istream & fs, float * float_ptr);
-    static int parse_int(std::istream & fs, int * int_ptr);
-    static int insert_gen_rec(Expr * gen_expr, TreeExpr * root);
-    static int insert_infix_rec(InfixOp * infix_op, TreeExpr * root);
-    static Expr * parse_gen_expr(std::istream & fs, TreeExpr * tree_expr, MilkdropPreset * preset);
-    static PerFrameEqn * parse_implicit_per_frame_eqn(std::istream & fs, char * param_string, int index, MilkdropPreset * preset);
-    static InitCond * parse_per_frame_init_eqn(std::istream & fs, MilkdropPreset * preset, std::map<std::string,Param*> * database);
-    static int parse_wavecode_prefix(char * token, int * id, char ** var_string);
-    static int parse_wavecode(char * token, std::istream & fs, MilkdropPreset * preset);
-    static int parse_wave_prefix(char * token, int * id, char ** eqn_string);
-    static int parse_wave_helper(std::istream & fs, MilkdropPreset * preset, int id, char * eqn_type, char * init_string);
-    static int parse_shapecode(char * eqn_string, std::istream & fs, MilkdropPreset * preset);
-    static int parse_shapecode_prefix(char * token, int * id, char ** var_string);
-    static void parse_string_block(std::istream &  fs, std::string * out_string);
-    static bool scanForComment(std::istream & fs);
-    static int parse_wave(char * eqn_string, std::istream & fs, MilkdropPreset * preset);
-    static int parse_shape(char * eqn_string, std::istream & fs, MilkdropPreset * preset);
-    static int parse_shape_prefix(char * token, int * id, char ** eqn_string);
-    static void readStringUntil(std::istream & fs, std::string * out_buffer, bool wrapAround = true, const std::set<char> & skipList = std::set<char>()) ;
-
-    static int string_to_float(char * string, float * float_ptr);
-    static int parse_shape_per_frame_init_eqn(std::istream & fs, std::shared_ptr<CustomShape> custom_shape, MilkdropPreset * preset);
-    static int parse_shape_per_frame_eqn(std::istream & fs, std::shared_ptr<CustomShape> custom_shape, MilkdropPreset * preset);
-    static int parse_wave_per_frame_eqn(std::istream & fs, std::shared_ptr<CustomWave> custom_wave, MilkdropPreset * preset);
-    static bool wrapsToNextLine(const std::string & str);
+    InitCond *parse_init_cond( PresetBuffer & fs, char * name, MilkdropPreset * preset );
+    int parse_preset_name( PresetBuffer & fs, char * name );
+    int parse_top_comment( PresetBuffer & fs );
+    int parse_line( PresetBuffer & fs, MilkdropPreset * preset );
+
+    int get_string_prefix_len(char * string);
+    TreeExpr * insert_gen_expr(Expr * gen_expr, TreeExpr ** root);
+    TreeExpr * insert_infix_op(InfixOp * infix_op, TreeExpr ** root);
+    token_t parseToken(PresetBuffer & fs, char * string);
+    Expr ** parse_prefix_args(PresetBuffer & fs, int num_args, MilkdropPreset * preset);
+    Expr * parse_infix_op(PresetBuffer & fs, token_t token, TreeExpr * tree_expr, MilkdropPreset * preset);
+    Expr * parse_sign_arg(PresetBuffer & fs);
+    int parse_float(PresetBuffer & fs, float * float_ptr);
+    int parse_int(PresetBuffer & fs, int * int_ptr);
+    int insert_gen_rec(Expr * gen_expr, TreeExpr * root);
+    int insert_infix_rec(InfixOp * infix_op, TreeExpr * root);
+    Expr * parse_gen_expr(PresetBuffer & fs, TreeExpr * tree_expr, MilkdropPreset * preset);
+    PerFrameEqn * parse_implicit_per_frame_eqn(PresetBuffer & fs, char * param_string, int index, MilkdropPreset * preset);
+    InitCond * parse_per_frame_init_eqn(PresetBuffer & fs, MilkdropPreset * preset, ParamTable * database);
+    int parse_wavecode_prefix(char * token, int * id, char ** var_string);
+    int parse_wavecode(char * token, PresetBuffer & fs, MilkdropPreset * preset);
+    int parse_wave_prefix(char * token, int * id, char ** eqn_string);
+    int parse_wave_helper(PresetBuffer & fs, MilkdropPreset * preset, int id, char * eqn_type, char * init_string);
+    int parse_shapecode(char * eqn_string, PresetBuffer & fs, MilkdropPreset * preset);
+    int parse_shapecode_prefix(char * token, int * id, char ** var_string);
+    void parse_string_block(PresetBuffer &  fs, std::string * out_string);
+    bool scanForComment(PresetBuffer & fs);
+    int parse_wave(char * eqn_string, PresetBuffer & fs, MilkdropPreset * preset);
+    int parse_shape(char * eqn_string, PresetBuffer & fs, MilkdropPreset * preset);
+    int parse_shape_prefix(char * token, int * id, char ** eqn_string);
+    void readStringUntil(PresetBuffer & fs, std::string * out_buffer, bool wrapAround = true, const std::set<char> & skipList = std::set<char>()) ;
+
+    int string_to_float(char * string, float * float_ptr);
+    int parse_shape_per_frame_init_eqn(PresetBuffer & fs, std::shared_ptr<CustomShape> custom_shape, MilkdropPreset * preset);
+    int parse_shape_per_frame_eqn(PresetBuffer & fs, std::shared_ptr<CustomShape> custom_shape, MilkdropPreset * preset);
+    int parse_wave_per_frame_eqn(PresetBuffer & fs, std::shared_ptr<CustomWave> custom_wave, MilkdropPreset * preset);
+    bool wrapsToNextLine(const std::string & str);
 private:
-  static Expr * _parse_gen_expr(std::istream & fs, TreeExpr * tree_expr, MilkdropPreset * preset);
+  Expr * _parse_gen_expr(PresetBuffer & fs, TreeExpr * tree_expr, MilkdropPreset * preset);
   };
 
 #endif /** !_PARSER_H */
@@ -31,6 +31,7 @@
 
 #include "Eval.hpp"
 #include "Expr.hpp"
+#include "Bytecode.hpp"
 
 #include "wipemalloc.h"
 #include <cassert>
@@ -53,6 +54,15 @@ void PerFrameEqn::evaluate()
 }
 
 
+Expr *PerFrameEqn::compile(std::vector<PerFrameEqn*> &eqns)
+{
+	BytecodeContext ctx;
+	for (PerFrameEqn *eqn : eqns)
+		ctx.assignment(eqn->param, eqn->gen_expr);
+	return ctx.finish(nullptr);
+}
+
+
 /* Frees perframe equation structure. Warning: assumes gen_expr pointer is not freed by anyone else! */
 PerFrameEqn::~PerFrameEqn()
 {
@@ -31,6 +31,8 @@
 
 #define PER_FRAME_EQN_DEBUG 0
 
+#include <vector>
+
 class Expr;
 class Param;
 class PerFrameEqn;
@@ -47,6 +49,10 @@ public:
     /// Evaluate the per frame equation
     void evaluate();
 
+    /// Compiles equations into one program that evaluates them in order,
+    /// see Expr::compile(). The equations must outlive the program.
+    static Expr *compile(std::vector<PerFrameEqn*> &eqns);
+
   };
 
 
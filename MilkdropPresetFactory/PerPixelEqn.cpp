@@ -50,6 +50,12 @@ PerPixelEqn::PerPixelEqn(int _index, Param * param, Expr * gen_expr):index(_inde
     assign_expr = Expr::create_matrix_assignment(param, gen_expr);
 }
 
+PerPixelEqn::PerPixelEqn(int _index, Expr * _assign_expr):index(_index), assign_expr(_assign_expr)
+{
+	assert(index >= 0);
+	assert(assign_expr != 0);
+}
+
 
 PerPixelEqn::~PerPixelEqn()
 {
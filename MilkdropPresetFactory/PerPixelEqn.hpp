@@ -57,6 +57,8 @@ public:
     virtual ~PerPixelEqn();
 
     PerPixelEqn(int index, Param * param, Expr * gen_expr);
+    /// Takes ownership of an assignment built elsewhere, e.g. by PresetCode
+    PerPixelEqn(int index, Expr * assign_expr);
 
     Expr *assign_expr;
   };
@@ -49,6 +49,11 @@ PerPointEqn::PerPointEqn(int _index, Param * param, Expr * gen_expr):
     assign_expr = Expr::create_matrix_assignment(param, gen_expr);
 }
 
+PerPointEqn::PerPointEqn(int _index, Expr * _assign_expr):
+    index(_index), assign_expr(_assign_expr)
+{
+}
+
 
 PerPointEqn::~PerPointEqn()
 {
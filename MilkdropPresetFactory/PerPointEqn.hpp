@@ -41,6 +41,8 @@ public:
     ~PerPointEqn();
     void evaluate(int i);
     PerPointEqn( int index, Param *param, Expr *gen_expr );
+    /// Takes ownership of an assignment built elsewhere, e.g. by PresetCode
+    PerPointEqn( int index, Expr *assign_expr );
  };
 
 
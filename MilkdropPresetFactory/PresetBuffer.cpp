@@ -0,0 +1,110 @@
+/**
+ * projectM -- Milkdrop-esque visualisation SDK
+ * Copyright (C)2003-2007 projectM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * See 'LICENSE.txt' included within this release
+ *
+ */
+
+#include "PresetBuffer.hpp"
+
+#include <cctype>
+#include <fstream>
+#include <iterator>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif /** !WIN32 */
+
+PresetBuffer & PresetBuffer::operator>>(std::string & out)
+{
+    out.clear();
+
+    if (_fail || _eof)
+    {
+        _fail = true;
+        return *this;
+    }
+
+    int c;
+    while ((c = peek()) != EOF && std::isspace(c))
+        get();
+
+    if (c == EOF)
+    {
+        // nothing extracted
+        _fail = true;
+        return *this;
+    }
+
+    while ((c = peek()) != EOF && !std::isspace(c))
+        out.push_back(static_cast<char>(get()));
+
+    return *this;
+}
+
+PresetFile::PresetFile(const std::string & path) :
+    _open(false), _mapping(nullptr), _mappingSize(0)
+{
+#ifndef WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+    {
+        if (info.st_size == 0)
+        {
+            _open = true;
+        }
+        else
+        {
+            void * mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED)
+            {
+                _mapping = mapping;
+                _mappingSize = static_cast<size_t>(info.st_size);
+                _contents = std::string_view(static_cast<const char *>(mapping), _mappingSize);
+                _open = true;
+            }
+        }
+    }
+    close(fd);
+
+    if (_open)
+        return;
+#endif /** !WIN32 */
+
+    // Not mappable (or no mmap): read it instead.
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in)
+        return;
+    _data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    _contents = _data;
+    _open = true;
+}
+
+PresetFile::~PresetFile()
+{
+#ifndef WIN32
+    if (_mapping != nullptr)
+        munmap(_mapping, _mappingSize);
+#endif /** !WIN32 */
+}
@@ -0,0 +1,140 @@
+/**
+ * projectM -- Milkdrop-esque visualisation SDK
+ * Copyright (C)2003-2007 projectM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * See 'LICENSE.txt' included within this release
+ *
+ */
+/**
+ * $Id$
+ *
+ * Contiguous preset input for the parser
+ *
+ * $Log$
+ */
+
+#ifndef _PRESET_BUFFER_HPP
+#define _PRESET_BUFFER_HPP
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+/// Read cursor over preset text held in one contiguous block of memory.
+///
+/// Implements the subset of std::istream the parser uses with the same state
+/// rules: get() past the end returns EOF and sets both eof and fail, peek()
+/// at the end only sets eof, any read once eof is set fails, and unget()
+/// clears eof but cannot recover from fail.
+/// Every call is inline, without the sentry objects and virtual streambuf
+/// calls a stream needs per character.
+///
+/// The buffer does not own the text; it must outlive the cursor.
+class PresetBuffer {
+public:
+    PresetBuffer() : _begin(nullptr), _end(nullptr), _pos(nullptr), _eof(false), _fail(false) {}
+
+    explicit PresetBuffer(std::string_view text) :
+        _begin(text.data()), _end(text.data() + text.size()), _pos(text.data()),
+        _eof(false), _fail(false) {}
+
+    inline int get()
+    {
+        if (_fail || _eof)
+        {
+            _fail = true;
+            return EOF;
+        }
+        if (_pos == _end)
+        {
+            _eof = _fail = true;
+            return EOF;
+        }
+        return static_cast<unsigned char>(*_pos++);
+    }
+
+    inline int peek()
+    {
+        if (_fail || _eof)
+        {
+            _fail = true;
+            return EOF;
+        }
+        if (_pos == _end)
+        {
+            _eof = true;
+            return EOF;
+        }
+        return static_cast<unsigned char>(*_pos);
+    }
+
+    inline PresetBuffer & unget()
+    {
+        _eof = false;
+        if (_fail || _pos == _begin)
+            _fail = true;
+        else
+            --_pos;
+        return *this;
+    }
+
+    inline bool eof() const { return _eof; }
+    inline bool fail() const { return _fail; }
+    inline bool operator!() const { return _fail; }
+    inline explicit operator bool() const { return !_fail; }
+
+    /// Same as `std::istream >> std::string`: skips whitespace, then reads up
+    /// to the next whitespace.
+    PresetBuffer & operator>>(std::string & out);
+
+    /// The text not consumed yet.
+    inline std::string_view remaining() const
+    {
+        return std::string_view(_pos, static_cast<size_t>(_end - _pos));
+    }
+
+private:
+    const char * _begin;
+    const char * _end;
+    const char * _pos;
+    bool _eof;
+    bool _fail;
+};
+
+/// The contents of a preset file. Memory mapped on platforms that support it,
+/// read into memory otherwise.
+class PresetFile {
+public:
+    explicit PresetFile(const std::string & path);
+    ~PresetFile();
+
+    PresetFile(const PresetFile &) = delete;
+    PresetFile & operator=(const PresetFile &) = delete;
+
+    /// False if the file could not be opened or read.
+    bool isOpen() const { return _open; }
+
+    std::string_view contents() const { return _contents; }
+
+private:
+    bool _open;
+    std::string_view _contents;
+    void * _mapping;
+    size_t _mappingSize;
+    std::string _data;
+};
+
+#endif /** !_PRESET_BUFFER_HPP */
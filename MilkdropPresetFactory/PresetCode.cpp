@@ -0,0 +1,763 @@
+/**
+ * projectM -- Milkdrop-esque visualisation SDK
+ * Copyright (C)2003-2007 projectM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * See 'LICENSE.txt' included within this release
+ *
+ */
+
+/* Body layout, following the header and string table:
+ *
+ *   string warp shader source
+ *   string composite shader source
+ *   scope of the preset itself
+ *   u32 count, count x (i32 index, expr)          per pixel equations
+ *   u32 count, count x custom wave:
+ *     i32 id, i32 per frame count, scope
+ *     u32 count, count x (i32 index, expr)        per point equations
+ *   u32 count, count x custom shape:
+ *     i32 id, string image url, scope
+ *
+ * scope:
+ *   u32 count, count x u32 name                   user defined parameters
+ *   u32 count, count x init cond                  initial conditions
+ *   u32 count, count x init cond                  per frame init equations
+ *   u32 count, count x (i32 index, param, expr)   per frame equations
+ *
+ * init cond: param, u8 type, 4 byte value (u32 bool, i32 int or f32 float)
+ * param:     u8 PARAM_SCOPE_*, u32 name
+ * func:      u32 name
+ * string:    u32 length, bytes
+ * expr:      see ExprOp
+ */
+
+#include "PresetCode.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "fatal.h"
+#include "BuiltinFuncs.hpp"
+#include "MilkdropPreset.hpp"
+#include "ParamUtils.hpp"
+#include "PerPointEqn.hpp"
+
+const std::string PresetCode::EXTENSION("milkc");
+
+namespace {
+
+const char MAGIC[4] = { 'P', 'J', 'M', 'C' };
+const size_t HEADER_SIZE = 16;
+
+/* Where a parameter reference is resolved */
+enum ParamScope
+{
+    PARAM_SCOPE_BUILTIN = 0,    /* the preset's builtin parameters */
+    PARAM_SCOPE_USER,           /* the preset's user parameters */
+    PARAM_SCOPE_OBJECT          /* the parameters of the enclosing custom wave or shape */
+};
+
+inline uint32_t load_u32(const char * p)
+{
+    const unsigned char * u = reinterpret_cast<const unsigned char *>(p);
+    return uint32_t(u[0]) | (uint32_t(u[1]) << 8) | (uint32_t(u[2]) << 16) | (uint32_t(u[3]) << 24);
+}
+
+inline void store_u32(std::string & out, uint32_t value)
+{
+    out.push_back(static_cast<char>(value & 0xff));
+    out.push_back(static_cast<char>((value >> 8) & 0xff));
+    out.push_back(static_cast<char>((value >> 16) & 0xff));
+    out.push_back(static_cast<char>((value >> 24) & 0xff));
+}
+
+/* True if LoadUnspecInitCond would create exactly this initial condition
+   when it is missing, so it need not be stored */
+bool is_default_init_cond(const InitCond * init_cond, const std::map<std::string, InitCond*> * per_frame_init_eqn_tree)
+{
+    const Param * param = init_cond->param;
+
+    if (param->flags & (P_FLAG_READONLY | P_FLAG_QVAR | P_FLAG_USERDEF))
+        return false;
+    if (per_frame_init_eqn_tree->count(param->name))
+        return false;
+
+    switch (param->type)
+    {
+    case P_TYPE_BOOL:
+        return init_cond->init_val.bool_val == param->default_init_val.bool_val;
+    case P_TYPE_INT:
+        return init_cond->init_val.int_val == param->default_init_val.int_val;
+    case P_TYPE_DOUBLE:
+        return init_cond->init_val.float_val == param->default_init_val.float_val;
+    default:
+        return false;
+    }
+}
+
+
+class PresetCodeWriter : public ExprEncoder
+{
+public:
+    explicit PresetCodeWriter(MilkdropPreset & preset) : _preset(preset), _objectParams(NULL) {}
+
+    void i32(int32_t value) { u32(static_cast<uint32_t>(value)); }
+    void string(const std::string & value)
+    {
+        u32(static_cast<uint32_t>(value.size()));
+        _code.append(value);
+    }
+
+    /* Parameters are looked up in this tree first, then in the preset's */
+    void setObjectParams(ParamTable * objectParams) { _objectParams = objectParams; }
+
+    bool param(Param * param) override
+    {
+        if (param == NULL)
+            return false;
+
+        std::map<std::string, Param*>::const_iterator pos;
+
+        if (_objectParams != NULL && _objectParams->owns(param))
+            u8(PARAM_SCOPE_OBJECT);
+        else if (_preset.builtinParams.find_builtin_param(param->name) == param)
+            u8(PARAM_SCOPE_BUILTIN);
+        else if ((pos = _preset.user_param_tree.find(param->name)) != _preset.user_param_tree.end() && pos->second == param)
+            u8(PARAM_SCOPE_USER);
+        else
+            return false;
+
+        u32(name(param->name));
+        return true;
+    }
+
+    bool func(Func * func) override
+    {
+        if (func == NULL)
+            return false;
+        u32(name(func->getName()));
+        return true;
+    }
+
+    bool scope(std::map<std::string, Param*> & params,
+               std::map<std::string, InitCond*> & init_cond_tree,
+               std::map<std::string, InitCond*> & per_frame_init_eqn_tree,
+               std::vector<PerFrameEqn*> & per_frame_eqn_tree)
+    {
+        uint32_t count = 0;
+        for (const auto & entry : params)
+            if (entry.second->flags & P_FLAG_USERDEF)
+                count++;
+        u32(count);
+        for (const auto & entry : params)
+            if (entry.second->flags & P_FLAG_USERDEF)
+                u32(name(entry.first));
+
+        if (!initConds(init_cond_tree, &per_frame_init_eqn_tree) ||
+            !initConds(per_frame_init_eqn_tree, NULL))
+            return false;
+
+        u32(static_cast<uint32_t>(per_frame_eqn_tree.size()));
+        for (PerFrameEqn * eqn : per_frame_eqn_tree)
+        {
+            i32(eqn->index);
+            if (!param(eqn->param) || !Expr::encode(eqn->gen_expr, *this))
+                return false;
+        }
+        return true;
+    }
+
+    /* The header and string table, then the body written so far */
+    void finish(std::string & out)
+    {
+        out.clear();
+        out.append(MAGIC, sizeof(MAGIC));
+        store_u32(out, PresetCode::FORMAT_VERSION);
+        store_u32(out, static_cast<uint32_t>(_names.size()));
+        store_u32(out, static_cast<uint32_t>(_code.size()));
+        for (const std::string & name : _names)
+        {
+            store_u32(out, static_cast<uint32_t>(name.size()));
+            out.append(name);
+        }
+        out.append(_code);
+    }
+
+private:
+    uint32_t name(const std::string & name)
+    {
+        std::pair<std::map<std::string, uint32_t>::iterator, bool> inserted =
+            _nameIndex.insert(std::make_pair(name, static_cast<uint32_t>(_names.size())));
+        if (inserted.second)
+            _names.push_back(name);
+        return inserted.first->second;
+    }
+
+    bool initConds(std::map<std::string, InitCond*> & tree, const std::map<std::string, InitCond*> * per_frame_init_eqn_tree)
+    {
+        uint32_t count = 0;
+        for (const auto & entry : tree)
+            if (per_frame_init_eqn_tree == NULL || !is_default_init_cond(entry.second, per_frame_init_eqn_tree))
+                count++;
+        u32(count);
+
+        for (const auto & entry : tree)
+        {
+            InitCond * init_cond = entry.second;
+            if (per_frame_init_eqn_tree != NULL && is_default_init_cond(init_cond, per_frame_init_eqn_tree))
+                continue;
+
+            if (!param(init_cond->param))
+                return false;
+            u8(init_cond->param->type);
+            switch (init_cond->param->type)
+            {
+            case P_TYPE_BOOL:
+                u32(init_cond->init_val.bool_val ? 1 : 0);
+                break;
+            case P_TYPE_INT:
+                i32(init_cond->init_val.int_val);
+                break;
+            case P_TYPE_DOUBLE:
+                f32(init_cond->init_val.float_val);
+                break;
+            default:
+                return false;
+            }
+        }
+        return true;
+    }
+
+    MilkdropPreset & _preset;
+    ParamTable * _objectParams;
+    std::map<std::string, uint32_t> _nameIndex;
+    std::vector<std::string> _names;
+};
+
+
+class PresetCodeReader : public ExprDecoder
+{
+public:
+    PresetCodeReader(const char * begin, const char * end, MilkdropPreset & preset) :
+        ExprDecoder(begin, end), _preset(preset), _objectParams(NULL) {}
+
+    bool names(uint32_t count)
+    {
+        // every name takes at least its length
+        _names.reserve(std::min<size_t>(count, static_cast<size_t>(_end - _pos) / 4));
+        for (uint32_t i = 0; i < count; i++)
+        {
+            std::string name;
+            if (!string(name))
+                return false;
+            _names.push_back(name);
+        }
+        _builtinParams.assign(count, NULL);
+        _userParams.assign(count, NULL);
+        _funcs.assign(count, NULL);
+        return true;
+    }
+
+    size_t remaining() const { return static_cast<size_t>(_end - _pos); }
+
+    void setObjectParams(ParamTable * objectParams)
+    {
+        _objectParams = objectParams;
+        _objectParamCache.assign(_names.size(), NULL);
+    }
+
+    Param * param() override
+    {
+        uint8_t scope;
+        uint32_t index;
+        if (!u8(scope) || !name(index))
+            return NULL;
+
+        Param * param = NULL;
+        switch (scope)
+        {
+        case PARAM_SCOPE_BUILTIN:
+            if ((param = _builtinParams[index]) == NULL)
+                param = _builtinParams[index] = _preset.builtinParams.find_builtin_param(_names[index]);
+            break;
+        case PARAM_SCOPE_USER:
+            if ((param = _userParams[index]) == NULL)
+                param = _userParams[index] = ParamUtils::find<ParamUtils::AUTO_CREATE>(_names[index], &_preset.user_param_tree);
+            break;
+        case PARAM_SCOPE_OBJECT:
+            if (_objectParams == NULL)
+                break;
+            if ((param = _objectParamCache[index]) == NULL)
+                param = _objectParamCache[index] = ParamUtils::find<ParamUtils::AUTO_CREATE>(_names[index], _objectParams);
+            break;
+        }
+
+        if (param == NULL)
+            _fail = true;
+        return param;
+    }
+
+    Func * func() override
+    {
+        uint32_t index;
+        if (!name(index))
+            return NULL;
+        if (_funcs[index] == NULL && (_funcs[index] = BuiltinFuncs::find_func(_names[index])) == NULL)
+            _fail = true;
+        return _funcs[index];
+    }
+
+    bool scope(std::map<std::string, Param*> & params,
+               std::map<std::string, InitCond*> & init_cond_tree,
+               std::map<std::string, InitCond*> & per_frame_init_eqn_tree,
+               std::vector<PerFrameEqn*> & per_frame_eqn_tree)
+    {
+        uint32_t count, index;
+
+        if (!u32(count))
+            return false;
+        for (uint32_t i = 0; i < count; i++)
+            if (!name(index) || ParamUtils::find<ParamUtils::AUTO_CREATE>(_names[index], &params) == NULL)
+                return false;
+
+        if (!initConds(init_cond_tree, false) || !initConds(per_frame_init_eqn_tree, true))
+            return false;
+
+        if (!u32(count))
+            return false;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            int32_t eqn_index;
+            Param * param;
+            Expr * gen_expr;
+            if (!i32(eqn_index) || (param = this->param()) == NULL || (gen_expr = Expr::decode(*this)) == NULL)
+                return false;
+            per_frame_eqn_tree.push_back(new PerFrameEqn(eqn_index, param, gen_expr));
+        }
+        return true;
+    }
+
+private:
+    bool name(uint32_t & index)
+    {
+        if (!u32(index))
+            return false;
+        if (index >= _names.size())
+        {
+            _fail = true;
+            return false;
+        }
+        return true;
+    }
+
+    bool initConds(std::map<std::string, InitCond*> & tree, bool per_frame_init)
+    {
+        uint32_t count;
+        if (!u32(count))
+            return false;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            Param * param;
+            uint8_t type;
+            CValue init_val;
+
+            if ((param = this->param()) == NULL || !u8(type) || type != param->type)
+                return false;
+
+            switch (type)
+            {
+            case P_TYPE_BOOL:
+            {
+                uint32_t value;
+                if (!u32(value))
+                    return false;
+                init_val.bool_val = value != 0;
+                break;
+            }
+            case P_TYPE_INT:
+                if (!i32(init_val.int_val))
+                    return false;
+                break;
+            case P_TYPE_DOUBLE:
+                if (!f32(init_val.float_val))
+                    return false;
+                break;
+            default:
+                return false;
+            }
+
+            InitCond * init_cond = new InitCond(param, init_val);
+            if (!tree.insert(std::make_pair(param->name, init_cond)).second)
+            {
+                delete init_cond;
+                return false;
+            }
+
+            /* the parser evaluates per frame init equations as it reads them */
+            if (per_frame_init)
+                init_cond->evaluate(true);
+        }
+        return true;
+    }
+
+    MilkdropPreset & _preset;
+    std::vector<std::string> _names;
+    std::vector<Param*> _builtinParams;
+    std::vector<Param*> _userParams;
+    std::vector<Func*> _funcs;
+    ParamTable * _objectParams;
+    std::vector<Param*> _objectParamCache;
+};
+
+}  // namespace
+
+
+void ExprEncoder::u32(uint32_t value)
+{
+    store_u32(_code, value);
+}
+
+void ExprEncoder::f32(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    u32(bits);
+}
+
+bool ExprDecoder::u8(uint8_t & value)
+{
+    if (_fail || _pos == _end)
+    {
+        _fail = true;
+        return false;
+    }
+    value = static_cast<uint8_t>(*_pos++);
+    return true;
+}
+
+bool ExprDecoder::u32(uint32_t & value)
+{
+    if (_fail || _end - _pos < 4)
+    {
+        _fail = true;
+        return false;
+    }
+    value = load_u32(_pos);
+    _pos += 4;
+    return true;
+}
+
+bool ExprDecoder::i32(int32_t & value)
+{
+    uint32_t bits;
+    if (!u32(bits))
+        return false;
+    value = static_cast<int32_t>(bits);
+    return true;
+}
+
+bool ExprDecoder::f32(float & value)
+{
+    uint32_t bits;
+    if (!u32(bits))
+        return false;
+    memcpy(&value, &bits, sizeof(value));
+    return true;
+}
+
+bool ExprDecoder::string(std::string & value)
+{
+    uint32_t length;
+    if (!u32(length))
+        return false;
+    if (static_cast<size_t>(_end - _pos) < length)
+    {
+        _fail = true;
+        return false;
+    }
+    value.assign(_pos, length);
+    _pos += length;
+    return true;
+}
+
+
+bool PresetCode::isPresetCode(std::string_view data)
+{
+    return data.size() >= sizeof(MAGIC) && memcmp(data.data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool PresetCode::write(MilkdropPreset & preset, std::string & out)
+{
+    PresetCodeWriter writer(preset);
+
+    writer.string(preset.presetOutputs().GetWarpShader().second.program_source);
+    writer.string(preset.presetOutputs().GetCompositeShader().second.program_source);
+
+    if (!writer.scope(preset.user_param_tree, preset.init_cond_tree,
+                      preset.per_frame_init_eqn_tree, preset.per_frame_eqn_tree))
+        return false;
+
+    writer.u32(static_cast<uint32_t>(preset.per_pixel_eqn_tree.size()));
+    for (const auto & entry : preset.per_pixel_eqn_tree)
+    {
+        writer.i32(entry.first);
+        if (!Expr::encode(entry.second->assign_expr, writer))
+            return false;
+    }
+
+    writer.u32(static_cast<uint32_t>(preset.customWaves.size()));
+    for (auto & wave : preset.customWaves)
+    {
+        writer.i32(wave->id);
+        writer.i32(wave->per_frame_count);
+        writer.setObjectParams(&wave->param_tree);
+        if (!writer.scope(wave->param_tree.user_params(), wave->init_cond_tree,
+                          wave->per_frame_init_eqn_tree, wave->per_frame_eqn_tree))
+            return false;
+
+        writer.u32(static_cast<uint32_t>(wave->per_point_eqn_tree.size()));
+        for (PerPointEqn * eqn : wave->per_point_eqn_tree)
+        {
+            writer.i32(eqn->index);
+            if (!Expr::encode(eqn->assign_expr, writer))
+                return false;
+        }
+    }
+
+    writer.u32(static_cast<uint32_t>(preset.customShapes.size()));
+    for (auto & shape : preset.customShapes)
+    {
+        writer.i32(shape->id);
+        writer.string(shape->imageUrl);
+        writer.setObjectParams(&shape->param_tree);
+        if (!writer.scope(shape->param_tree.user_params(), shape->init_cond_tree,
+                          shape->per_frame_init_eqn_tree, shape->per_frame_eqn_tree))
+            return false;
+    }
+
+    writer.finish(out);
+    return true;
+}
+
+int PresetCode::read(std::string_view data, MilkdropPreset & preset)
+{
+    if (data.size() < HEADER_SIZE || !isPresetCode(data))
+        return PROJECTM_FAILURE;
+    if (load_u32(data.data() + 4) != FORMAT_VERSION)
+        return PROJECTM_FAILURE;
+
+    const uint32_t name_count = load_u32(data.data() + 8);
+    const uint32_t body_size = load_u32(data.data() + 12);
+
+    PresetCodeReader reader(data.data() + HEADER_SIZE, data.data() + data.size(), preset);
+    if (!reader.names(name_count) || reader.remaining() != body_size)
+        return PROJECTM_FAILURE;
+
+    // One statement each: both accessors hold the pipeline's shader lock.
+    if (!reader.string(preset.presetOutputs().GetWarpShader().second.program_source))
+        return PROJECTM_FAILURE;
+    if (!reader.string(preset.presetOutputs().GetCompositeShader().second.program_source))
+        return PROJECTM_FAILURE;
+
+    if (!reader.scope(preset.user_param_tree, preset.init_cond_tree,
+                      preset.per_frame_init_eqn_tree, preset.per_frame_eqn_tree))
+        return PROJECTM_FAILURE;
+
+    uint32_t count;
+    if (!reader.u32(count))
+        return PROJECTM_FAILURE;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        int32_t index;
+        Expr * assign_expr;
+        if (!reader.i32(index) || index < 0 || (assign_expr = Expr::decode(reader)) == NULL)
+            return PROJECTM_FAILURE;
+
+        PerPixelEqn * eqn = new PerPixelEqn(index, assign_expr);
+        if (!preset.per_pixel_eqn_tree.insert(std::make_pair(index, eqn)).second)
+        {
+            delete eqn;
+            return PROJECTM_FAILURE;
+        }
+    }
+
+    if (!reader.u32(count))
+        return PROJECTM_FAILURE;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        int32_t id, per_frame_count;
+        if (!reader.i32(id) || !reader.i32(per_frame_count))
+            return PROJECTM_FAILURE;
+
+        std::shared_ptr<CustomWave> wave = MilkdropPreset::find_custom_object(id, preset.customWaves);
+        wave->per_frame_count = per_frame_count;
+        reader.setObjectParams(&wave->param_tree);
+        if (!reader.scope(wave->param_tree.user_params(), wave->init_cond_tree,
+                          wave->per_frame_init_eqn_tree, wave->per_frame_eqn_tree))
+            return PROJECTM_FAILURE;
+
+        uint32_t eqn_count;
+        if (!reader.u32(eqn_count))
+            return PROJECTM_FAILURE;
+        for (uint32_t j = 0; j < eqn_count; j++)
+        {
+            int32_t index;
+            Expr * assign_expr;
+            if (!reader.i32(index) || (assign_expr = Expr::decode(reader)) == NULL)
+                return PROJECTM_FAILURE;
+            wave->per_point_eqn_tree.push_back(new PerPointEqn(index, assign_expr));
+        }
+    }
+
+    if (!reader.u32(count))
+        return PROJECTM_FAILURE;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        int32_t id;
+        std::string imageUrl;
+        if (!reader.i32(id) || !reader.string(imageUrl))
+            return PROJECTM_FAILURE;
+
+        std::shared_ptr<CustomShape> shape = MilkdropPreset::find_custom_object(id, preset.customShapes);
+        shape->imageUrl = imageUrl;
+        reader.setObjectParams(&shape->param_tree);
+        if (!reader.scope(shape->param_tree.user_params(), shape->init_cond_tree,
+                          shape->per_frame_init_eqn_tree, shape->per_frame_eqn_tree))
+            return PROJECTM_FAILURE;
+    }
+
+    return reader.remaining() == 0 ? PROJECTM_SUCCESS : PROJECTM_FAILURE;
+}
+
+
+// TESTS
+
+
+#include <TestRunner.hpp>
+
+#ifndef NDEBUG
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "MilkdropPresetFactory.hpp"
+
+#define TEST(cond) if (!verify(#cond,cond)) return false
+
+struct PresetCodeTest : public Test
+{
+    PresetCodeTest() : Test("PresetCodeTest"), factory(8, 8)
+    {}
+
+    MilkdropPresetFactory factory;
+
+    /* a bit of everything the format stores */
+    static const char *source()
+    {
+        return "[preset00]\n"
+               "zoom=1.01\n"
+               "per_frame_init_1=my_var = 2;\n"
+               "per_frame_1=q1 = bass*0.5; my_var = my_var*0.9;\n"
+               "per_pixel_1=zoom = zoom + 0.1*sin(time)*x + q1;\n"
+               "per_pixel_2=rot = if(above(treb,0.5), 0.01, rad*0.02);\n"
+               "wavecode_0_enabled=1\n"
+               "wave_0_per_frame1=t1 = q1;\n"
+               "wave_0_per_point1=x = sample; y = 0.5 + value1*t1;\n"
+               "shapecode_0_enabled=1\n"
+               "shape_0_per_frame1=x = 0.5 + 0.1*sin(time);\n";
+    }
+
+    /* loads data through a file, as the preset loader would */
+    std::unique_ptr<Preset> load(const std::string &data, const char *extension)
+    {
+        const std::string path = (std::filesystem::temp_directory_path() /
+                                  (std::string("projectm_preset_code_test.") + extension)).string();
+        {
+            std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        }
+        std::unique_ptr<Preset> preset;
+        try
+        {
+            preset = factory.allocate(path);
+        }
+        catch (const PresetFactoryException &)
+        {
+        }
+        std::remove(path.c_str());
+        return preset;
+    }
+
+    bool encode(Preset *preset, std::string &code)
+    {
+        return preset != NULL && PresetCode::write(*dynamic_cast<MilkdropPreset *>(preset), code);
+    }
+
+public:
+    bool test_round_trip()
+    {
+        std::string code, again;
+        TEST(encode(load(source(), "milk").get(), code));
+        TEST(PresetCode::isPresetCode(code));
+        TEST(encode(load(code, PresetCode::EXTENSION.c_str()).get(), again));
+        TEST(again == code);
+        return true;
+    }
+
+    bool test_corrupt()
+    {
+        std::string code;
+        TEST(encode(load(source(), "milk").get(), code));
+
+        /* from the magic on, truncations are rejected: inside the header,
+           then sampled through the rest, and one byte short */
+        for (size_t size = 4; size < code.size(); size += size < HEADER_SIZE ? 1 : 7)
+            TEST(load(code.substr(0, size), PresetCode::EXTENSION.c_str()) == nullptr);
+        TEST(load(code.substr(0, code.size() - 1), PresetCode::EXTENSION.c_str()) == nullptr);
+        TEST(load(code + '\0', PresetCode::EXTENSION.c_str()) == nullptr);
+
+        std::string version(code);
+        version[4]++;
+        TEST(load(version, PresetCode::EXTENSION.c_str()) == nullptr);
+        return true;
+    }
+
+    bool test() override
+    {
+        bool result = true;
+        result &= test_round_trip();
+        result &= test_corrupt();
+        return result;
+    }
+};
+
+Test* PresetCode::test()
+{
+    return new PresetCodeTest();
+}
+
+#else
+
+Test* PresetCode::test()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,142 @@
+/**
+ * projectM -- Milkdrop-esque visualisation SDK
+ * Copyright (C)2003-2007 projectM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * See 'LICENSE.txt' included within this release
+ *
+ */
+/**
+ * $Id$
+ *
+ * Precompiled (binary) form of a parsed milkdrop preset
+ *
+ * $Log$
+ */
+
+#ifndef _PRESET_CODE_HPP
+#define _PRESET_CODE_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+class Func;
+class MilkdropPreset;
+class Param;
+class Test;
+
+/// Opcodes of the flat prefix encoding of an optimized expression tree.
+/// Every node is its opcode followed by its operands, then its children in
+/// evaluation order; see Expr::encode() and Expr::decode().
+enum ExprOp
+{
+    EXPR_OP_CONSTANT = 1,   /* f32 value */
+    EXPR_OP_PARAM,          /* param reference */
+    EXPR_OP_INFIX,          /* u8 infix type, left, right */
+    EXPR_OP_MULT_ADD,       /* a, b, c: a * b + c */
+    EXPR_OP_MULT_CONST,     /* f32 c, expr */
+    EXPR_OP_FUNC,           /* func reference, u8 argument count, arguments */
+    EXPR_OP_IF_ABOVE,       /* a, b, then, else */
+    EXPR_OP_IF_EQUAL,       /* a, b, then, else */
+    EXPR_OP_ASSIGN,         /* param reference, rhs */
+    EXPR_OP_ASSIGN_MATRIX   /* param reference, rhs */
+};
+
+/// Output side of the expression encoding. References to parameters and
+/// functions are written by the owner of the encoder, which knows the scope
+/// they were resolved in.
+class ExprEncoder {
+public:
+    virtual ~ExprEncoder() {}
+
+    void u8(uint8_t value) { _code.push_back(static_cast<char>(value)); }
+    void u32(uint32_t value);
+    void f32(float value);
+
+    virtual bool param(Param * param) = 0;
+    virtual bool func(Func * func) = 0;
+
+protected:
+    std::string _code;
+};
+
+/// Input side of the expression encoding. Every read is bounds checked; a
+/// failed read leaves the decoder failed and all further reads fail too.
+class ExprDecoder {
+public:
+    /// Deeper expressions are rejected instead of overflowing the stack.
+    static const int MAX_DEPTH = 1024;
+
+    ExprDecoder(const char * begin, const char * end) : _pos(begin), _end(end), _fail(false), depth(0) {}
+    virtual ~ExprDecoder() {}
+
+    bool u8(uint8_t & value);
+    bool u32(uint32_t & value);
+    bool i32(int32_t & value);
+    bool f32(float & value);
+    bool string(std::string & value);
+
+    virtual Param * param() = 0;
+    virtual Func * func() = 0;
+
+    bool fail() const { return _fail; }
+
+protected:
+    const char * _pos;
+    const char * _end;
+    bool _fail;
+
+public:
+    int depth;
+};
+
+/// Binary form of a parsed and optimized MilkdropPreset: the user parameters,
+/// initial conditions, and per frame / per pixel / per point equations of the
+/// preset and of each custom wave and shape, plus the shader sources.
+/// Expressions are stored after Expr::optimize() as flat prefix bytecode;
+/// parameters and functions are referenced by name through a string table, so
+/// a file stays valid as long as the builtin names do.
+///
+/// Loading one rebuilds the same objects the parser would have built without
+/// tokenizing, parsing, or optimizing anything.
+///
+/// Layout (all integers little endian):
+///   "PJMC" u32 version u32 string_count u32 body_size
+///   string_count x (u32 length, bytes)
+///   body, see PresetCode.cpp
+class PresetCode {
+public:
+    static const uint32_t FORMAT_VERSION = 1;
+
+    /// File extension of precompiled presets
+    static const std::string EXTENSION;
+
+    /// True if data starts with the preset code magic, whatever its version.
+    static bool isPresetCode(std::string_view data);
+
+    /// Serializes a loaded preset.
+    /// \returns false if the preset holds something the format cannot represent
+    static bool write(MilkdropPreset & preset, std::string & out);
+
+    /// Rebuilds a preset written by write() into a freshly constructed preset.
+    /// \returns PROJECTM_SUCCESS, or PROJECTM_FAILURE for a corrupt file or a
+    /// different format version
+    static int read(std::string_view data, MilkdropPreset & preset);
+
+    static Test *test();
+};
+
+#endif /** !_PRESET_CODE_HPP */
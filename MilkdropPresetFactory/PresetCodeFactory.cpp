@@ -0,0 +1,26 @@
+//
+// C++ Implementation: PresetCodeFactory
+//
+// Description: Loads precompiled milkdrop presets, see PresetCode.hpp
+//
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+#include "PresetCodeFactory.hpp"
+#include "MilkdropPresetFactory.hpp"
+#include "PresetCode.hpp"
+
+PresetCodeFactory::PresetCodeFactory(MilkdropPresetFactory & milkdropFactory) : _milkdropFactory(milkdropFactory) {}
+
+PresetCodeFactory::~PresetCodeFactory() {}
+
+std::unique_ptr<Preset> PresetCodeFactory::allocate(const std::string & url, const std::string & name, const std::string & author) {
+
+	// MilkdropPreset recognizes the preset code header when it loads the file
+	return _milkdropFactory.allocate(url, name, author);
+}
+
+std::string PresetCodeFactory::supportedExtensions() const {
+	return PresetCode::EXTENSION;
+}
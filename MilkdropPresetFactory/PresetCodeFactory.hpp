@@ -0,0 +1,39 @@
+//
+// C++ Interface: PresetCodeFactory
+//
+// Description: Loads precompiled milkdrop presets, see PresetCode.hpp
+//
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+//
+
+#ifndef __PRESET_CODE_FACTORY_HPP
+#define __PRESET_CODE_FACTORY_HPP
+
+#include <memory>
+#include "../PresetFactory.hpp"
+
+class MilkdropPresetFactory;
+
+/// Factory for presets compiled with milkc. They load into an ordinary
+/// MilkdropPreset, so allocation (and the outputs cache) is left to the
+/// milkdrop factory, which must outlive the presets either one allocates.
+class PresetCodeFactory : public PresetFactory {
+
+public:
+
+ explicit PresetCodeFactory(MilkdropPresetFactory & milkdropFactory);
+
+ virtual ~PresetCodeFactory();
+
+ std::unique_ptr<Preset> allocate(const std::string & url, const std::string & name = std::string(),
+	const std::string & author = std::string());
+
+ std::string supportedExtensions() const;
+
+private:
+	MilkdropPresetFactory & _milkdropFactory;
+};
+
+#endif
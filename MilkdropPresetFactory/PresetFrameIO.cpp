@@ -1,14 +1,16 @@
 #include "PresetFrameIO.hpp"
-#include "wipemalloc.h"
+#include <cstring>
 #include <math.h>
 #include <cassert>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 #include "Renderer/BeatDetect.hpp"
+#include "TaskPool.hpp"
+#include "VectorMath.hpp"
 
-#ifdef __SSE2__
-#include <immintrin.h>
-#endif
+// Mesh columns per PerPixelMath task.
+static const int kPerPixelMathGrain = 8;
 
 
 PresetInputs::PresetInputs() : PipelineContext()
@@ -35,29 +37,10 @@ void PresetInputs::update(const BeatDetect & music, const PipelineContext & cont
 }
 
 
-float **alloc_mesh(size_t gx, size_t gy)
-{
-	// round gy up to multiple 4 (for possible SSE optimization)
-	gy = (gy+3) & ~(size_t)3;
-
-	float **mesh = (float **)wipe_aligned_alloc(gx * sizeof(float *));
-	float *m = (float *)wipe_aligned_alloc(gx * gy * sizeof(float));
-	for (unsigned int x = 0; x < gx; x++ )
-		mesh[x] = m + (gy * x);
-	return mesh;
-}
-
-float **free_mesh(float **mesh)
-{
-	wipe_aligned_free(mesh[0]);
-	wipe_aligned_free(mesh);
-	return NULL;
-}
-
-void copy_mesh(float **dst, float **src, int gx, int gy)
-{
-	memcpy(dst[0], src[0], gx*gy*sizeof(float));
-}
+// Per pixel matrices of PresetInputs, and those PresetOutputs keeps next to
+// the x and y mesh of its Pipeline
+static const int kPresetInputsMeshes = 8;
+static const int kPresetOutputsMeshes = 13;
 
 
 void PresetInputs::Initialize ( int _gx, int _gy )
@@ -79,23 +62,26 @@ void PresetInputs::Initialize ( int _gx, int _gy )
 	ang_per_pixel = 0;
 	// ***
 
-	this->x_mesh    = alloc_mesh(gx, gy);
-	this->y_mesh    = alloc_mesh(gx, gy);
-	this->rad_mesh  = alloc_mesh(gx, gy);
-	this->theta_mesh= alloc_mesh(gx, gy);
-	this->origtheta = alloc_mesh(gx, gy);
-	this->origrad   = alloc_mesh(gx, gy);
-	this->origx     = alloc_mesh(gx, gy);
-	this->origy     = alloc_mesh(gx, gy);
-
+	mesh_planes.Resize(kPresetInputsMeshes, gx, gy);
+	this->x_mesh    = mesh_planes.plane(0);
+	this->y_mesh    = mesh_planes.plane(1);
+	this->rad_mesh  = mesh_planes.plane(2);
+	this->theta_mesh= mesh_planes.plane(3);
+	this->origtheta = mesh_planes.plane(4);
+	this->origrad   = mesh_planes.plane(5);
+	this->origx     = mesh_planes.plane(6);
+	this->origy     = mesh_planes.plane(7);
+
+	const int stride = mesh_stride();
 	for ( x=0;x<gx;x++ )
 	{
 		for ( y=0;y<gy;y++ )
 		{
-			this->origx[x][y]=x/ ( float ) ( gx-1 );
-			this->origy[x][y]= - ( ( y/ ( float ) ( gy-1 ) )-1 );
-			this->origrad[x][y]=hypot ( ( this->origx[x][y]-.5 ) *2, ( this->origy[x][y]-.5 ) *2 ) * .7071067;
-			this->origtheta[x][y]=atan2 ( ( ( this->origy[x][y]-.5 ) *2 ), ( ( this->origx[x][y]-.5 ) *2 ) );
+			const int i = x * stride + y;
+			this->origx[i]=x/ ( float ) ( gx-1 );
+			this->origy[i]= - ( ( y/ ( float ) ( gy-1 ) )-1 );
+			this->origrad[i]=hypot ( ( this->origx[i]-.5 ) *2, ( this->origy[i]-.5 ) *2 ) * .7071067;
+			this->origtheta[i]=atan2 ( ( ( this->origy[i]-.5 ) *2 ), ( ( this->origx[i]-.5 ) *2 ) );
 		}
 	}
 }
@@ -118,20 +104,6 @@ PresetOutputs::~PresetOutputs()
 {
 	assert(this->gx_ > 0);
 
-	this->rad_mesh = free_mesh(this->rad_mesh);
-	this->sx_mesh  = free_mesh(this->sx_mesh);
-	this->sy_mesh  = free_mesh(this->sy_mesh);
-	this->dy_mesh  = free_mesh(this->dy_mesh);
-	this->dx_mesh  = free_mesh(this->dx_mesh);
-	this->cy_mesh  = free_mesh(this->cy_mesh);
-	this->cx_mesh  = free_mesh(this->cx_mesh);
-	this->warp_mesh = free_mesh(this->warp_mesh);
-	this->zoom_mesh = free_mesh(this->zoom_mesh);
-	this->zoomexp_mesh = free_mesh(this->zoomexp_mesh);
-	this->rot_mesh = free_mesh(this->rot_mesh);
-	this->orig_x   = free_mesh(this->orig_x);
-	this->orig_y   = free_mesh(this->orig_y);
-
     customWaves.clear();
     customShapes.clear();
     drawables.clear();
@@ -185,19 +157,23 @@ void PresetOutputs::Render(const BeatDetect &music,
 }
 
 // N.B. The more optimization that can be done on this method, the better! This is called a lot and can probably be improved.
-void PresetOutputs::PerPixelMath_c(const PipelineContext &context)
+void PresetOutputs::PerPixelMath_c(const PipelineContext &context, int x_begin, int x_end)
 {
-	for (int x = 0; x < gx_; x++)
+	const int stride = mesh_stride();
+	float *const x_mesh2 = x_mesh();
+	float *const y_mesh2 = y_mesh();
+
+	for (int i = x_begin * stride; i < x_end * stride; i += stride)
 	{
-		for (int y = 0; y < gy_; y++)
+		for (int y = i; y < i + gy_; y++)
 		{
-			const float fZoom2 = std::pow(this->zoom_mesh[x][y], std::pow(this->zoomexp_mesh[x][y],
-					rad_mesh[x][y] * 2.0f - 1.0f));
+			const float fZoom2 = std::pow(this->zoom_mesh[y], std::pow(this->zoomexp_mesh[y],
+					rad_mesh[y] * 2.0f - 1.0f));
 			const float fZoom2Inv = 1.0f / fZoom2;
-			x_mesh_at(x, y) = this->orig_x[x][y] * 0.5f * fZoom2Inv + 0.5f;
-			x_mesh_at(x, y) = (x_mesh_at(x, y) - this->cx_mesh[x][y]) / this->sx_mesh[x][y] + this->cx_mesh[x][y];
-			y_mesh_at(x, y) = this->orig_y[x][y] * 0.5f * fZoom2Inv + 0.5f;
-			y_mesh_at(x, y) = (y_mesh_at(x, y) - this->cy_mesh[x][y]) / this->sy_mesh[x][y] + this->cy_mesh[x][y];
+			x_mesh2[y] = this->orig_x[y] * 0.5f * fZoom2Inv + 0.5f;
+			x_mesh2[y] = (x_mesh2[y] - this->cx_mesh[y]) / this->sx_mesh[y] + this->cx_mesh[y];
+			y_mesh2[y] = this->orig_y[y] * 0.5f * fZoom2Inv + 0.5f;
+			y_mesh2[y] = (y_mesh2[y] - this->cy_mesh[y]) / this->sy_mesh[y] + this->cy_mesh[y];
 		}
 	}
 
@@ -209,151 +185,46 @@ void PresetOutputs::PerPixelMath_c(const PipelineContext &context)
 	f[2] = 10.54f + 3.0f * cosf(fWarpTime * 1.233f + 3);
 	f[3] = 11.49f + 4.0f * cosf(fWarpTime * 0.933f + 5);
 
-	for (int x = 0; x < gx_; x++)
+	for (int i = x_begin * stride; i < x_end * stride; i += stride)
 	{
-		for (int y = 0; y < gy_; y++)
+		for (int y = i; y < i + gy_; y++)
 		{
-            const float orig_x2 = this->orig_x[x][y];
-            const float orig_y2 = this->orig_y[x][y];
-            const float warp_mesh2 = this->warp_mesh[x][y] * 0.0035f;
+            const float orig_x2 = this->orig_x[y];
+            const float orig_y2 = this->orig_y[y];
+            const float warp_mesh2 = this->warp_mesh[y] * 0.0035f;
 
-			x_mesh_at(x, y) +=
+			x_mesh2[y] +=
                 (warp_mesh2 * sinf(fWarpTime * 0.333f + fWarpScaleInv * (orig_x2 * f[0] - orig_y2 * f[3]))) +
                 (warp_mesh2 * cosf(fWarpTime * 0.753f - fWarpScaleInv * (orig_x2 * f[1] - orig_y2 * f[2])));
 
-			y_mesh_at(x, y) +=
+			y_mesh2[y] +=
                 (warp_mesh2 * cosf(fWarpTime * 0.375f - fWarpScaleInv * (orig_x2 * f[2] + orig_y2 * f[1]))) +
                 (warp_mesh2 * sinf(fWarpTime * 0.825f + fWarpScaleInv * (orig_x2 * f[0] + orig_y2 * f[3])));
 		}
 	}
 
-	for (int x = 0; x < gx_; x++)
+	for (int i = x_begin * stride; i < x_end * stride; i += stride)
 	{
-		for (int y = 0; y < gy_; y++)
+		for (int y = i; y < i + gy_; y++)
 		{
-			const float u2 = x_mesh_at(x, y) - this->cx_mesh[x][y];
-			const float v2 = y_mesh_at(x, y) - this->cy_mesh[x][y];
+			const float u2 = x_mesh2[y] - this->cx_mesh[y];
+			const float v2 = y_mesh2[y] - this->cy_mesh[y];
 
-            const float rot2 = this->rot_mesh[x][y];
+            const float rot2 = this->rot_mesh[y];
             const float cos_rot = cosf(rot2);
             const float sin_rot = sinf(rot2);
 
-			x_mesh_at(x, y) = u2 * cos_rot - v2 * sin_rot + this->cx_mesh[x][y] - this->dx_mesh[x][y];
-			y_mesh_at(x, y) = u2 * sin_rot + v2 * cos_rot + this->cy_mesh[x][y] - this->dy_mesh[x][y];
+			x_mesh2[y] = u2 * cos_rot - v2 * sin_rot + this->cx_mesh[y] - this->dx_mesh[y];
+			y_mesh2[y] = u2 * sin_rot + v2 * cos_rot + this->cy_mesh[y] - this->dy_mesh[y];
 		}
 	}
 }
 
 
-#ifdef __SSE2__
-
-// is there an SSE way to do this?
-inline __m128 _mm_pow(__m128 x, __m128 y)
-{
-	float X[4];
-	float Y[4];
-	_mm_store_ps(X,x);
-	_mm_store_ps(Y,y);
-	X[0] = __builtin_powf(X[0],Y[0]);
-	X[1] = __builtin_powf(X[1],Y[1]);
-	X[2] = __builtin_powf(X[2],Y[2]);
-	X[3] = __builtin_powf(X[3],Y[3]);
-	return _mm_load_ps(X);
-}
-inline void _mm_sincosf(__m128 x, __m128 &sinx, __m128 &cosx)
-{
-	float X[4], S[4], C[4];
-	_mm_store_ps(X,x);
-	S[0] = sinf(X[0]);
-	C[0] = cosf(X[0]);
-	S[1] = sinf(X[1]);
-	C[1] = cosf(X[1]);
-	S[2] = sinf(X[2]);
-	C[2] = cosf(X[2]);
-	S[3] = sinf(X[3]);
-	C[3] = cosf(X[3]);
-	sinx = _mm_load_ps(S);
-	cosx = _mm_load_ps(C);
-}
-inline __m128 _mm_sinf(__m128 x)
-{
-	float X[4];
-	_mm_store_ps(X,x);
-	X[0] = sinf(X[0]);
-	X[1] = sinf(X[1]);
-	X[2] = sinf(X[2]);
-	X[3] = sinf(X[3]);
-	return _mm_load_ps(X);
-}
-inline __m128 _mm_cosf(__m128 x)
-{
-	float X[4];
-	_mm_store_ps(X,x);
-	X[0] = cosf(X[0]);
-	X[1] = cosf(X[1]);
-	X[2] = cosf(X[2]);
-	X[3] = cosf(X[3]);
-	return _mm_load_ps(X);
-}
-
-
-void PresetOutputs::PerPixelMath_sse(const PipelineContext &context)
+void PresetOutputs::PerPixelMath_simd(const PipelineContext &context, int x_begin, int x_end)
 {
-	for (int x = 0; x < gx_; x++)
-	{
-		for (int y = 0; y < gy_; y += 4)
-		{
-			// fZoom2 = std::pow(this->zoom_mesh[x][y], std::pow(this->zoomexp_mesh[x][y],
-			// 		rad_mesh[x][y] * 2.0f - 1.0f));
-			__m128 rad_mesh_scaled =
-				_mm_sub_ps(
-					_mm_mul_ps(
-						_mm_load_ps(&this->rad_mesh[x][y]),
-						_mm_set_ps1(2.0f)),
-					_mm_set_ps1(1.0f));
-            __m128 zoom_mesh2 = _mm_load_ps(&this->zoom_mesh[x][y]);
-            __m128 zoomexp_mesh2 = _mm_load_ps(&this->zoomexp_mesh[x][y]);
-            __m128 fZoom2 = _mm_pow(zoom_mesh2, _mm_pow(zoomexp_mesh2, rad_mesh_scaled));
-			// fZoom2Inv = 1.0f / fZoom2;
-			__m128 fZoomInv = _mm_rcp_ps(fZoom2);
-
-			// x_mesh_at(x, y) = this->orig_x[x][y] * 0.5f * fZoom2Inv + 0.5f;
-            __m128 x_mesh2 =
-				_mm_add_ps(
-					_mm_mul_ps(
-						_mm_load_ps(&this->orig_x[x][y]),
-						_mm_mul_ps(fZoomInv,_mm_set_ps1(0.5f))),		// CONSIDER: common sub-expression
-					_mm_set_ps1(0.5f));
-			// x_mesh_at(x, y) = (x_mesh_at(x, y) - this->cx_mesh[x][y]) / this->sx_mesh[x][y] + this->cx_mesh[x][y];
-            __m128 cx_mesh2 = _mm_load_ps(&this->cx_mesh[x][y]);
-            __m128 sx_mesh2 = _mm_load_ps(&this->sx_mesh[x][y]);
-			_mm_store_ps(&x_mesh_at(x, y),
-				_mm_add_ps(
-					_mm_div_ps(
-                        _mm_sub_ps(x_mesh2,cx_mesh2),
-                        sx_mesh2),
-                    cx_mesh2
-				));
-
-			// y_mesh_at(x, y) = this->orig_y[x][y] * 0.5f * fZoom2Inv + 0.5f;
-            __m128 y_mesh2 =
-				_mm_add_ps(
-					_mm_mul_ps(
-						_mm_load_ps(&this->orig_y[x][y]),
-						_mm_mul_ps(fZoomInv,_mm_set_ps1(0.5f))),
-					_mm_set_ps1(0.5f));
-			// y_mesh_at(x, y) = (y_mesh_at(x, y) - this->cy_mesh[x][y]) / this->sy_mesh[x][y] + this->cy_mesh[x][y];
-            __m128 cy_mesh2 = _mm_load_ps(&this->cy_mesh[x][y]);
-            __m128 sy_mesh2 = _mm_load_ps(&this->sy_mesh[x][y]);
-			_mm_store_ps(&y_mesh_at(x, y),
-				_mm_add_ps(
-					_mm_div_ps(
-                        _mm_sub_ps(y_mesh2,cy_mesh2),
-                        sy_mesh2),
-                    cy_mesh2
-				));
-		}
-	}
+	typedef vmath::Native V;
+	typedef V::vf vf;
 
 	const float fWarpTime = context.time * this->fWarpAnimSpeed;
 	const float fWarpScaleInv = 1.0f / this->fWarpScale;
@@ -365,128 +236,105 @@ void PresetOutputs::PerPixelMath_sse(const PipelineContext &context)
 		11.49f + 4.0f * cosf(fWarpTime * 0.933f + 5)
 	};
 
-	for (int x = 0; x < gx_; x++)
+	const vf half = V::set1(0.5f);
+	const vf scale = V::set1(fWarpScaleInv);
+	const vf f0 = V::set1(f[0]);
+	const vf f1 = V::set1(f[1]);
+	const vf f2 = V::set1(f[2]);
+	const vf f3 = V::set1(f[3]);
+
+	// The columns are padded to vmath::kMaxWidth (see MeshPlanes) and the x
+	// and y mesh have the same layout as the inputs, so the columns of the
+	// range are one stream of whole vectors. The padding holds sane values
+	// (see MilkdropPreset::initialize_PerPixelMeshes()), its results are
+	// never read.
+	const int stride = mesh_stride();
+	float *const x_mesh_out = x_mesh();
+	float *const y_mesh_out = y_mesh();
+
+	for (int i = x_begin * stride; i < x_end * stride; i += V::width)
 	{
-		for (int y = 0; y < gy_; y+=4)
-		{
-			//float orig_x = this->orig_x[x][y];
-			//float orig_y = this->orig_y[x][y];
-			//float warp_mesh = this->warp_mesh[x][y] * 0.0035f;
-            const __m128 orig_x2 = _mm_load_ps(&this->orig_x[x][y]);
-            const __m128 orig_y2 = _mm_load_ps(&this->orig_y[x][y]);
-            const __m128 warp_mesh2 = _mm_mul_ps(_mm_load_ps(&this->warp_mesh[x][y]), _mm_set_ps1(0.0035f));
-
-			// x_mesh_at(x, y) +=
-			// 	(warp_mesh * sinf(fWarpTime * 0.333f + fWarpScaleInv * (orig_x * f[0] - orig_y * f[3]))) +
-			// 	(warp_mesh * cosf(fWarpTime * 0.753f - fWarpScaleInv * (orig_x * f[1] - orig_y * f[2])));
-			_mm_store_ps(&x_mesh_at(x, y),
-				_mm_add_ps(_mm_load_ps(&x_mesh_at(x, y)),
-					_mm_add_ps(
-                        _mm_mul_ps(warp_mesh2, _mm_sinf(
-							_mm_add_ps(
-								_mm_set_ps1(fWarpTime*0.333f),
-								_mm_mul_ps(_mm_set_ps1(fWarpScaleInv),
-									_mm_sub_ps(
-                                        _mm_mul_ps(orig_x2, _mm_set_ps1(f[0])),
-                                        _mm_mul_ps(orig_y2, _mm_set_ps1(f[3]))
-									))))),
-                        _mm_mul_ps(warp_mesh2, _mm_cosf(
-							_mm_sub_ps(
-								_mm_set_ps1(fWarpTime*0.753f),
-								_mm_mul_ps(_mm_set_ps1(fWarpScaleInv),
-									_mm_sub_ps(
-                                        _mm_mul_ps(orig_x2, _mm_set_ps1(f[1])),
-                                        _mm_mul_ps(orig_y2, _mm_set_ps1(f[2]))
-									))))))));
-
-			// y_mesh_at(x, y) +=
-			// 	(warp_mesh * cosf(fWarpTime * 0.375f - fWarpScaleInv * (orig_x * f[2] + orig_y * f[1]))) +
-			// 	(warp_mesh * sinf(fWarpTime * 0.825f + fWarpScaleInv * (orig_x * f[0] + orig_y * f[3])));
-			_mm_store_ps(&y_mesh_at(x, y),
-				_mm_add_ps(_mm_load_ps(&y_mesh_at(x, y)),
-					_mm_add_ps(
-                        _mm_mul_ps(warp_mesh2, _mm_cosf(
-							_mm_sub_ps(
-								_mm_set_ps1(fWarpTime*0.375f),
-								_mm_mul_ps(_mm_set_ps1(fWarpScaleInv),
-									_mm_add_ps(
-                                        _mm_mul_ps(orig_x2, _mm_set_ps1(f[2])),
-                                        _mm_mul_ps(orig_y2, _mm_set_ps1(f[1]))
-									))))),
-                        _mm_mul_ps(warp_mesh2, _mm_sinf(
-							_mm_add_ps(
-								_mm_set_ps1(fWarpTime*0.825f),
-								_mm_mul_ps(_mm_set_ps1(fWarpScaleInv),
-									_mm_add_ps(
-                                        _mm_mul_ps(orig_x2, _mm_set_ps1(f[0])),
-                                        _mm_mul_ps(orig_y2, _mm_set_ps1(f[3]))
-									))))))));
-		}
-	}
-	for (int x = 0; x < gx_; x++)
-	{
-		for (int y = 0; y < gy_; y+=4)
-		{
-			// const float u2 = x_mesh_at(x, y) - this->cx_mesh[x][y];
-			// const float v2 = y_mesh_at(x, y) - this->cy_mesh[x][y];
-			const __m128 u2 = _mm_sub_ps(_mm_load_ps(&x_mesh_at(x, y)),_mm_load_ps(&this->cx_mesh[x][y]));
-			const __m128 v2 = _mm_sub_ps(_mm_load_ps(&y_mesh_at(x, y)),_mm_load_ps(&this->cy_mesh[x][y]));
-
-			// const float rot = this->rot_mesh[x][y];
-			// const float cos_rot = cosf(rot);
-			// const float sin_rot = sinf(rot);
-			__m128 sin_rot, cos_rot;
-			_mm_sincosf(_mm_load_ps(&this->rot_mesh[x][y]), sin_rot, cos_rot);
-
-			// x_mesh_at(x, y) = u2 * cos_rot - v2 * sin_rot + this->cx_mesh[x][y] - this->dx_mesh[x][y];
-			_mm_store_ps(&x_mesh_at(x, y),
-				_mm_add_ps(
-					_mm_sub_ps(_mm_mul_ps(u2, cos_rot), _mm_mul_ps(v2,sin_rot)),
-					_mm_sub_ps(_mm_load_ps(&this->cx_mesh[x][y]), _mm_load_ps(&this->dx_mesh[x][y]))
-					));
-			// y_mesh_at(x, y) = u2 * sin_rot + v2 * cos_rot + this->cy_mesh[x][y] - this->dy_mesh[x][y];
-			_mm_store_ps(&y_mesh_at(x, y),
-				_mm_add_ps(
-					_mm_add_ps(_mm_mul_ps(u2, sin_rot), _mm_mul_ps(v2,cos_rot)),
-					_mm_sub_ps(_mm_load_ps(&this->cy_mesh[x][y]), _mm_load_ps(&this->dy_mesh[x][y]))
-					));
-		}
+		const vf orig_x2 = V::load(&this->orig_x[i]);
+		const vf orig_y2 = V::load(&this->orig_y[i]);
+		const vf cx_mesh2 = V::load(&this->cx_mesh[i]);
+		const vf cy_mesh2 = V::load(&this->cy_mesh[i]);
+
+		// fZoom2 = pow(zoom, pow(zoomexp, rad * 2 - 1))
+		const vf rad_mesh_scaled = V::sub(V::add(V::load(&this->rad_mesh[i]), V::load(&this->rad_mesh[i])), V::set1(1.0f));
+		const vf fZoom2 = vmath::pow<V>(V::load(&this->zoom_mesh[i]),
+				vmath::pow<V>(V::load(&this->zoomexp_mesh[i]), rad_mesh_scaled));
+		const vf fZoom2InvHalf = V::div(half, fZoom2);
+
+		// x = (orig_x * 0.5 / fZoom2 + 0.5 - cx) / sx + cx
+		vf x_mesh2 = V::madd(orig_x2, fZoom2InvHalf, half);
+		x_mesh2 = V::add(V::div(V::sub(x_mesh2, cx_mesh2), V::load(&this->sx_mesh[i])), cx_mesh2);
+		vf y_mesh2 = V::madd(orig_y2, fZoom2InvHalf, half);
+		y_mesh2 = V::add(V::div(V::sub(y_mesh2, cy_mesh2), V::load(&this->sy_mesh[i])), cy_mesh2);
+
+		// warp
+		const vf warp_mesh2 = V::mul(V::load(&this->warp_mesh[i]), V::set1(0.0035f));
+		const vf ox_f0 = V::mul(orig_x2, f0);
+		const vf oy_f3 = V::mul(orig_y2, f3);
+		x_mesh2 = V::madd(warp_mesh2,
+				V::add(vmath::sin<V>(V::madd(scale, V::sub(ox_f0, oy_f3), V::set1(fWarpTime * 0.333f))),
+				       vmath::cos<V>(V::sub(V::set1(fWarpTime * 0.753f), V::mul(scale, V::sub(V::mul(orig_x2, f1), V::mul(orig_y2, f2)))))),
+				x_mesh2);
+		y_mesh2 = V::madd(warp_mesh2,
+				V::add(vmath::cos<V>(V::sub(V::set1(fWarpTime * 0.375f), V::mul(scale, V::add(V::mul(orig_x2, f2), V::mul(orig_y2, f1))))),
+				       vmath::sin<V>(V::madd(scale, V::add(ox_f0, oy_f3), V::set1(fWarpTime * 0.825f)))),
+				y_mesh2);
+
+		// rotation and translation
+		const vf u2 = V::sub(x_mesh2, cx_mesh2);
+		const vf v2 = V::sub(y_mesh2, cy_mesh2);
+		vf sin_rot, cos_rot;
+		vmath::sincos<V>(V::load(&this->rot_mesh[i]), sin_rot, cos_rot);
+
+		V::store(&x_mesh_out[i], V::add(V::sub(V::mul(u2, cos_rot), V::mul(v2, sin_rot)),
+				V::sub(cx_mesh2, V::load(&this->dx_mesh[i]))));
+		V::store(&y_mesh_out[i], V::add(V::add(V::mul(u2, sin_rot), V::mul(v2, cos_rot)),
+				V::sub(cy_mesh2, V::load(&this->dy_mesh[i]))));
 	}
 }
-#endif
 
 
 void PresetOutputs::PerPixelMath(const PipelineContext &context)
 {
-// #ifdef __SSE2__
-// 	PerPixelMath_sse(context);
-// #else
-	PerPixelMath_c(context);
-//#endif
+	// Every column is independent, so split them across the task pool. During
+	// a transition this runs concurrently with the other preset's work.
+	ParallelFor(0, gx_, kPerPixelMathGrain, [&](int x_begin, int x_end)
+	{
+		if (vmath::Native::width > 1)
+			PerPixelMath_simd(context, x_begin, x_end);
+		else
+			PerPixelMath_c(context, x_begin, x_end);
+	});
 }
 
 
 void PresetOutputs::Initialize ( int _gx, int _gy )
 {
-    SetStaticPerPixel(_gx, _gy);
+    // all the per pixel matrices share one block with the x and y mesh
+    SetStaticPerPixel(_gx, _gy, kPresetOutputsMeshes);
 
 	int x;
-	this->sx_mesh = alloc_mesh( gx_, gy_ );
-	this->sy_mesh = alloc_mesh( gx_, gy_ );
-	this->dx_mesh = alloc_mesh( gx_, gy_ );
-	this->dy_mesh = alloc_mesh( gx_, gy_ );
-	this->cx_mesh = alloc_mesh( gx_, gy_ );
-	this->cy_mesh = alloc_mesh( gx_, gy_ );
-	this->zoom_mesh = alloc_mesh( gx_, gy_ );
-	this->zoomexp_mesh = alloc_mesh( gx_, gy_ );
-	this->rot_mesh = alloc_mesh( gx_, gy_ );
-
-	this->warp_mesh = alloc_mesh( gx_, gy_ );
-	this->rad_mesh = alloc_mesh( gx_, gy_ );
-	this->orig_x  = alloc_mesh( gx_, gy_ );
-	this->orig_y  = alloc_mesh( gx_, gy_ );
+	this->sx_mesh = mesh_plane(0);
+	this->sy_mesh = mesh_plane(1);
+	this->dx_mesh = mesh_plane(2);
+	this->dy_mesh = mesh_plane(3);
+	this->cx_mesh = mesh_plane(4);
+	this->cy_mesh = mesh_plane(5);
+	this->zoom_mesh = mesh_plane(6);
+	this->zoomexp_mesh = mesh_plane(7);
+	this->rot_mesh = mesh_plane(8);
+
+	this->warp_mesh = mesh_plane(9);
+	this->rad_mesh = mesh_plane(10);
+	this->orig_x  = mesh_plane(11);
+	this->orig_y  = mesh_plane(12);
 
 	//initialize reference grid values
+	const int stride = mesh_stride();
 	for (x = 0; x < gx_; x++)
 	{
 		for (int y = 0; y < gy_; y++)
@@ -494,9 +342,9 @@ void PresetOutputs::Initialize ( int _gx, int _gy )
 			float origx = x / (float) (gx_ - 1);
 			float origy = -((y / (float) (gy_ - 1)) - 1);
 
-			rad_mesh[x][y]=hypot ( ( origx-.5 ) *2, ( origy-.5 ) *2 ) * .7071067;
-			orig_x[x][y] = (origx - .5) * 2;
-			orig_y[x][y] = (origy - .5) * 2;
+			rad_mesh[x * stride + y]=hypot ( ( origx-.5 ) *2, ( origy-.5 ) *2 ) * .7071067;
+			orig_x[x * stride + y] = (origx - .5) * 2;
+			orig_y[x * stride + y] = (origy - .5) * 2;
 		}
 	}
 }
@@ -504,14 +352,6 @@ void PresetOutputs::Initialize ( int _gx, int _gy )
 
 PresetInputs::~PresetInputs()
 {
-	this->origx = free_mesh ( this->origx );
-	this->origy = free_mesh ( this->origy );
-	this->origrad = free_mesh ( this->origrad );
-	this->origtheta = free_mesh ( this->origtheta );
-	this->x_mesh = free_mesh ( this->x_mesh );
-	this->y_mesh = free_mesh ( this->y_mesh );
-	this->rad_mesh = free_mesh ( this->rad_mesh );
-	this->theta_mesh = free_mesh ( this->theta_mesh );
 }
 
 
@@ -522,10 +362,11 @@ void PresetInputs::resetMesh()
 	assert ( rad_mesh );
 	assert ( theta_mesh );
 
-	copy_mesh(this->x_mesh, this->origx, gx, gy);
-	copy_mesh(this->y_mesh, this->origy, gx, gy);
-	copy_mesh(this->rad_mesh, this->origrad, gx, gy);
-	copy_mesh(this->theta_mesh, this->origtheta, gx, gy);
+	const size_t size = mesh_planes.plane_size() * sizeof(float);
+	memcpy(this->x_mesh, this->origx, size);
+	memcpy(this->y_mesh, this->origy, size);
+	memcpy(this->rad_mesh, this->origrad, size);
+	memcpy(this->theta_mesh, this->origtheta, size);
 }
 
 
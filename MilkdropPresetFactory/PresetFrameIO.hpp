@@ -33,15 +33,18 @@ public:
     /* variables were added in milkdrop 1.04 */
     int gx, gy;
 
-    float **x_mesh;
-    float **y_mesh;
-    float **rad_mesh;
-    float **theta_mesh;
+    /* planes of mesh_planes, element (x, y) is at [x * mesh_stride() + y] */
+    float *x_mesh;
+    float *y_mesh;
+    float *rad_mesh;
+    float *theta_mesh;
 
-    float **origtheta;  //grid containing interpolated mesh reference values
-    float **origrad;
-    float **origx;  //original mesh
-    float **origy;
+    float *origtheta;  //grid containing interpolated mesh reference values
+    float *origrad;
+    float *origx;  //original mesh
+    float *origy;
+
+    int mesh_stride() const { return mesh_planes.stride(); }
 
     void resetMesh();
 
@@ -59,6 +62,7 @@ public:
     void update (const BeatDetect & music, const PipelineContext & context);
 
     private:
+    MeshPlanes mesh_planes;
 };
 
 
@@ -118,27 +122,27 @@ public:
     float fWarpScale;
     float fShader;
 
-    float **zoom_mesh;
-    float **zoomexp_mesh;
-    float **rot_mesh;
+    /* planes of the Pipeline mesh block, element (x, y) is at [x * mesh_stride() + y] */
+    float *zoom_mesh;
+    float *zoomexp_mesh;
+    float *rot_mesh;
 
-    float **sx_mesh;
-    float **sy_mesh;
-    float **dx_mesh;
-    float **dy_mesh;
-    float **cx_mesh;
-    float **cy_mesh;
-    float **warp_mesh;
+    float *sx_mesh;
+    float *sy_mesh;
+    float *dx_mesh;
+    float *dy_mesh;
+    float *cx_mesh;
+    float *cy_mesh;
+    float *warp_mesh;
 
-    float **orig_x;  //original mesh
-    float **orig_y;
-    float **rad_mesh;
+    float *orig_x;  //original mesh
+    float *orig_y;
+    float *rad_mesh;
 
 private:
-    void PerPixelMath_c( const PipelineContext &context);
-#ifdef __SSE2__
-    void PerPixelMath_sse( const PipelineContext &context);
-#endif
+    // Compute the warped mesh for columns [x_begin, x_end).
+    void PerPixelMath_c( const PipelineContext &context, int x_begin, int x_end);
+    void PerPixelMath_simd( const PipelineContext &context, int x_begin, int x_end);
 };
 
 
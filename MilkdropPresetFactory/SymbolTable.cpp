@@ -0,0 +1,174 @@
+/**
+ * projectM -- Milkdrop-esque visualisation SDK
+ * Copyright (C)2003-2007 projectM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * See 'LICENSE.txt' included within this release
+ *
+ */
+
+#include "SymbolTable.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+
+namespace {
+
+/* Displacements tried for a bucket before the table is made larger */
+const uint32_t kMaxDisplacement = 1 << 16;
+
+/* FNV-1a. The high half picks the bucket, the low half the slot. */
+uint64_t hashName(const char *name, size_t length)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++)
+    {
+        h ^= (unsigned char)name[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+size_t bucketOf(uint64_t hash, size_t buckets)
+{
+    return (size_t)(hash >> 32) & (buckets - 1);
+}
+
+/* Slot of a name for one displacement of its bucket; slots is a power of 2 */
+size_t slotOf(uint64_t hash, uint32_t displacement, size_t slots)
+{
+    uint32_t h = (uint32_t)hash ^ (displacement * 0x9e3779b9u);
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h & (slots - 1);
+}
+
+size_t powerOfTwo(size_t n)
+{
+    size_t p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+} // namespace
+
+
+SymbolTable::SymbolTable() : _displacements(1, 0), _slots(1), _size(0)
+{
+}
+
+SymbolTable::SymbolTable(const Symbols &symbols) : _size(0)
+{
+    Symbols unique;
+    std::set<std::string> seen;
+    for (const auto &symbol : symbols)
+    {
+        if (seen.insert(symbol.first).second)
+            unique.push_back(symbol);
+    }
+    _size = unique.size();
+
+    /* At most half the slots are taken, so a bucket rarely needs more than
+       a few tries. Distinct names all but never need a larger table. */
+    size_t slots = powerOfTwo(std::max<size_t>(2 * _size, 1));
+    while (!place(unique, slots))
+    {
+        slots *= 2;
+        if (slots > 64 * powerOfTwo(_size))
+        {
+            std::cerr << "[SymbolTable] no perfect hash for " << _size << " names" << std::endl;
+            abort();
+        }
+    }
+}
+
+/* Hash and displace: the names are split into buckets of about two, and the
+   fullest buckets are placed first, each with the first displacement that
+   moves all of its names to free slots. */
+bool SymbolTable::place(const Symbols &symbols, size_t slots)
+{
+    const size_t buckets = powerOfTwo(std::max<size_t>(symbols.size() / 2, 1));
+
+    std::vector<uint64_t> hashes(symbols.size());
+    std::vector<std::vector<size_t> > members(buckets);
+    for (size_t i = 0; i < symbols.size(); i++)
+    {
+        hashes[i] = hashName(symbols[i].first.data(), symbols[i].first.size());
+        members[bucketOf(hashes[i], buckets)].push_back(i);
+    }
+
+    std::vector<size_t> order(buckets);
+    for (size_t b = 0; b < buckets; b++)
+        order[b] = b;
+    std::stable_sort(order.begin(), order.end(), [&members](size_t a, size_t b) {
+        return members[a].size() > members[b].size();
+    });
+
+    _displacements.assign(buckets, 0);
+    _slots.assign(slots, Slot());
+    std::vector<bool> taken(slots, false);
+    std::vector<size_t> placed;
+
+    for (size_t b : order)
+    {
+        if (members[b].empty())
+            break;
+
+        uint32_t displacement = 0;
+        for (; displacement < kMaxDisplacement; displacement++)
+        {
+            placed.clear();
+            for (size_t i : members[b])
+            {
+                const size_t slot = slotOf(hashes[i], displacement, slots);
+                if (taken[slot] || std::find(placed.begin(), placed.end(), slot) != placed.end())
+                    break;
+                placed.push_back(slot);
+            }
+            if (placed.size() == members[b].size())
+                break;
+        }
+        if (displacement == kMaxDisplacement)
+            return false;
+
+        _displacements[b] = displacement;
+        for (size_t k = 0; k < placed.size(); k++)
+        {
+            const auto &symbol = symbols[members[b][k]];
+            _slots[placed[k]].name = symbol.first;
+            _slots[placed[k]].id = symbol.second;
+            taken[placed[k]] = true;
+        }
+    }
+    return true;
+}
+
+int SymbolTable::find(const char *name, size_t length) const
+{
+    const uint64_t hash = hashName(name, length);
+    const uint32_t displacement = _displacements[bucketOf(hash, _displacements.size())];
+    const Slot &slot = _slots[slotOf(hash, displacement, _slots.size())];
+
+    if (slot.id < 0 || slot.name.size() != length || memcmp(slot.name.data(), name, length) != 0)
+        return -1;
+    return slot.id;
+}
@@ -0,0 +1,75 @@
+/**
+ * projectM -- Milkdrop-esque visualisation SDK
+ * Copyright (C)2003-2007 projectM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * See 'LICENSE.txt' included within this release
+ *
+ */
+/**
+ * $Id$
+ *
+ * Perfect hash of a fixed set of names, e.g. the builtin parameters
+ *
+ * $Log$
+ */
+
+#ifndef _SYMBOL_TABLE_HPP
+#define _SYMBOL_TABLE_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Maps each of a fixed set of names to an integer id. Every name gets a
+/// slot of its own, found through the displacement of its bucket, so a
+/// lookup hashes the name once and compares it with one other string.
+///
+/// The table never changes once built, so any number of threads may look
+/// names up at the same time.
+class SymbolTable
+{
+public:
+    typedef std::vector<std::pair<std::string, int> > Symbols;
+
+    /// An empty table, every lookup fails
+    SymbolTable();
+    /// Maps each name to its id. Of several entries with the same name, the
+    /// first one counts.
+    explicit SymbolTable(const Symbols &symbols);
+
+    /// The id of name, or -1 if it is not in the table
+    int find(const char *name, size_t length) const;
+    int find(const std::string &name) const { return find(name.data(), name.size()); }
+
+    /// The number of distinct names
+    size_t size() const { return _size; }
+
+private:
+    struct Slot
+    {
+        std::string name;
+        int id = -1;    /* -1 for a free slot */
+    };
+
+    bool place(const Symbols &symbols, size_t slots);
+
+    std::vector<uint32_t> _displacements;   /* per bucket */
+    std::vector<Slot> _slots;
+    size_t _size;
+};
+
+#endif /** !_SYMBOL_TABLE_HPP */
@@ -32,6 +32,7 @@
 #include "wipemalloc.h"
 #include "fftsg.h"
 #include "PCM.hpp"
+#include <algorithm>
 #include <cassert>
 
 int PCM::maxsamples = 2048;
@@ -62,6 +63,9 @@ void PCM::_initPCM(int samples) {
 
   //maxsamples=samples;
   newsamples=0;
+  beatHopNext=0;
+  beatHopCount=0;
+  beatFill=0;
     numsamples = maxsamples;
 
   //Initialize buffers to 0
@@ -108,179 +112,120 @@ PCM::~PCM() {
 
 }
 
-#include <iostream>
+namespace {
 
-void PCM::addPCMfloat(const float *PCMdata, int samples)
+/* Writes count samples of one channel, stride apart in in, to out as floats.
+   The stride is a template argument where it is 1 or 2 so the compiler can
+   vectorize the conversion and the deinterleaving. */
+template <typename T, int Stride>
+void convertSamples(const T *in, float *out, int count, float scale, float offset)
 {
-  int i,j;
-
-  for(i=0;i<samples;i++)
-    {
-      j=i+start;
-
-      if (PCMdata[i] != 0 ) {
+    for (int i = 0; i < count; i++)
+        out[i] = ((float)in[i * Stride] + offset) * scale;
+}
 
-	PCMd[0][j%maxsamples] = PCMdata[i];
-	PCMd[1][j%maxsamples] = PCMdata[i];
+template <typename T>
+void convertSamples(const T *in, int stride, float *out, int count, float scale, float offset)
+{
+    if (stride == 1)
+        convertSamples<T, 1>(in, out, count, scale, offset);
+    else if (stride == 2)
+        convertSamples<T, 2>(in, out, count, scale, offset);
+    else
+        for (int i = 0; i < count; i++)
+            out[i] = ((float)in[i * stride] + offset) * scale;
+}
 
-      }
-      else
-	{
-	  PCMd[0][j % maxsamples] = 0;
-	  PCMd[1][j % maxsamples] = 0;
-	}
+/* Converts count samples of one channel, the first of them sample in of
+   data */
+void convertChannel(const void *data, PCMSampleFormat sample, int in, int stride,
+                    float *out, int count)
+{
+    switch (sample)
+    {
+    case PCM_UINT8:
+        convertSamples((const unsigned char *)data + in, stride, out, count, 1.0f / 64, -128.0f);
+        break;
+    case PCM_INT16:
+        convertSamples((const short *)data + in, stride, out, count, 1.0f / 16384, 0.0f);
+        break;
+    case PCM_INT32:
+        convertSamples((const int *)data + in, stride, out, count, 1.0f / 16384 / 65536, 0.0f);
+        break;
+    case PCM_FLOAT32:
+        convertSamples((const float *)data + in, stride, out, count, 1.0f, 0.0f);
+        break;
     }
-
-  start+=samples;
-  start=start%maxsamples;
-
- newsamples+=samples;
- if (newsamples>maxsamples) newsamples=maxsamples;
-  numsamples = getPCMnew(pcmdataR,1,0,waveSmoothing,0,0);
-    getPCMnew(pcmdataL,0,0,waveSmoothing,0,1);
-    getPCM(vdataL,FFT_LENGTH,0,1,0,0);
-    getPCM(vdataR,FFT_LENGTH,1,1,0,0);
 }
 
+}  // namespace
 
-void PCM::addPCMfloat_2ch(const float *PCMdata, int samples)
+void PCM::addPCM(const void *data, int frames, const PCMFormat &format)
 {
-    int i,j;
-
-    for(i=0;i<samples;i+=2)
+    if (frames <= 0 || format.channels < 1)
+        return;
+
+    /* only the last maxsamples frames survive */
+    const int skip = std::max(0, frames - maxsamples);
+    const int count = frames - skip;
+    const int stride = format.planar ? 1 : format.channels;
+
+    /* at most two contiguous runs of the ring, split where it wraps */
+    int at = (start + skip) % maxsamples;
+    int done = 0;
+    while (done < count)
     {
-        j=(i/2)+start;
-        PCMd[0][j%maxsamples] = PCMdata[i];
-        PCMd[1][j%maxsamples] = PCMdata[i+1];
+        const int run = std::min(count - done, maxsamples - at);
+        for (int channel = 0; channel < 2; channel++)
+        {
+            const int source = std::min(channel, format.channels - 1);
+            const int frame = skip + done;
+            const int in = format.planar ? source * frames + frame : frame * format.channels + source;
+            convertChannel(data, format.sample, in, stride, PCMd[channel] + at, run);
+        }
+        done += run;
+        at = 0;
     }
 
-    start+=samples/2;
-    start=start%maxsamples;
+    start = (start + frames) % maxsamples;
 
-    newsamples+=samples/2;
-    if (newsamples>maxsamples)
-        newsamples=maxsamples;
+    newsamples += frames;
+    if (newsamples > maxsamples) newsamples = maxsamples;
+    analyzeBeatHops(frames);
     numsamples = getPCMnew(pcmdataR,1,0,waveSmoothing,0,0);
     getPCMnew(pcmdataL,0,0,waveSmoothing,0,1);
     getPCM(vdataL,FFT_LENGTH,0,1,0,0);
     getPCM(vdataR,FFT_LENGTH,1,1,0,0);
 }
 
+void PCM::addPCMfloat(const float *PCMdata, int samples)
+{
+    addPCM(PCMdata, samples, PCMFormat{PCM_FLOAT32, 1, false});
+}
 
-void PCM::addPCM16Data(const short* pcm_data, short samples)  {
-   int i, j;
-
-   for (i = 0; i < samples; ++i) {
-      j=i+start;
-      PCMd[0][j % maxsamples]=(pcm_data[i * 2 + 0]/16384.0);
-      PCMd[1][j % maxsamples]=(pcm_data[i * 2 + 1]/16384.0);
-   }
-
-   start = (start + samples) % maxsamples;
-
-   newsamples+=samples;
-   if (newsamples>maxsamples) newsamples=maxsamples;
-     numsamples = getPCMnew(pcmdataR,1,0,waveSmoothing,0,0);
-    getPCMnew(pcmdataL,0,0,waveSmoothing,0,1);
-    getPCM(vdataL,FFT_LENGTH,0,1,0,0);
-    getPCM(vdataR,FFT_LENGTH,1,1,0,0);
+void PCM::addPCMfloat_2ch(const float *PCMdata, int samples)
+{
+    addPCM(PCMdata, samples / 2, PCMFormat{PCM_FLOAT32, 2, false});
 }
 
+void PCM::addPCM16Data(const short* pcm_data, short samples)
+{
+    addPCM(pcm_data, samples, PCMFormat{PCM_INT16, 2, false});
+}
 
 void PCM::addPCM16(short PCMdata[2][512])
 {
-  int i,j;
-  int samples=512;
-
-	 for(i=0;i<samples;i++)
-	   {
-	     j=i+start;
-         if ( PCMdata[0][i] != 0 && PCMdata[1][i] != 0 ) {
-	         PCMd[0][j%maxsamples]=(PCMdata[0][i]/16384.0);
-	         PCMd[1][j%maxsamples]=(PCMdata[1][i]/16384.0);
-          } else {
-             PCMd[0][j % maxsamples] = (float)0;
-             PCMd[1][j % maxsamples] = (float)0;
-          }
-	   }
-
-	 // printf("Added %d samples %d %d %f\n",samples,start,(start+samples)%maxsamples,PCM[0][start+10]);
-
- start+=samples;
- start=start%maxsamples;
-
- newsamples+=samples;
- if (newsamples>maxsamples) newsamples=maxsamples;
-
-    numsamples = getPCMnew(pcmdataR,1,0,waveSmoothing,0,0);
-    getPCMnew(pcmdataL,0,0,waveSmoothing,0,1);
-    getPCM(vdataL,FFT_LENGTH,0,1,0,0);
-    getPCM(vdataR,FFT_LENGTH,1,1,0,0);
+    addPCM(PCMdata, 512, PCMFormat{PCM_INT16, 2, true});
 }
 
-
 void PCM::addPCM8( unsigned char PCMdata[2][1024])
 {
-  int i,j;
-  int samples=1024;
-
-
-	 for(i=0;i<samples;i++)
-	   {
-	     j=i+start;
-         if ( PCMdata[0][i] != 0 && PCMdata[1][i] != 0 ) {
-	         PCMd[0][j%maxsamples]=( (float)( PCMdata[0][i] - 128.0 ) / 64 );
-	         PCMd[1][j%maxsamples]=( (float)( PCMdata[1][i] - 128.0 ) / 64 );
-          } else {
-             PCMd[0][j % maxsamples] = 0;
-             PCMd[1][j % maxsamples] = 0;
-          }
-	   }
-
-
-	 // printf("Added %d samples %d %d %f\n",samples,start,(start+samples)%maxsamples,PCM[0][start+10]);
-
- start+=samples;
- start=start%maxsamples;
-
- newsamples+=samples;
- if (newsamples>maxsamples) newsamples=maxsamples;
-    numsamples = getPCMnew(pcmdataR,1,0,waveSmoothing,0,0);
-    getPCMnew(pcmdataL,0,0,waveSmoothing,0,1);
-    getPCM(vdataL,FFT_LENGTH,0,1,0,0);
-    getPCM(vdataR,FFT_LENGTH,1,1,0,0);
+    addPCM(PCMdata, 1024, PCMFormat{PCM_UINT8, 2, true});
 }
 
 void PCM::addPCM8_512( const unsigned char PCMdata[2][512])
 {
-  int i,j;
-  int samples=512;
-
-
-	 for(i=0;i<samples;i++)
-	   {
-	     j=i+start;
-         if ( PCMdata[0][i] != 0 && PCMdata[1][i] != 0 ) {
-	         PCMd[0][j%maxsamples]=( (float)( PCMdata[0][i] - 128.0 ) / 64 );
-	         PCMd[1][j%maxsamples]=( (float)( PCMdata[1][i] - 128.0 ) / 64 );
-          } else {
-             PCMd[0][j % maxsamples] = 0;
-             PCMd[1][j % maxsamples] = 0;
-          }
-	   }
-
-
-	 // printf("Added %d samples %d %d %f\n",samples,start,(start+samples)%maxsamples,PCM[0][start+10]);
-
- start+=samples;
- start=start%maxsamples;
-
- newsamples+=samples;
- if (newsamples>maxsamples) newsamples=maxsamples;
-    numsamples = getPCMnew(pcmdataR,1,0,waveSmoothing,0,0);
-    getPCMnew(pcmdataL,0,0,waveSmoothing,0,1);
-    getPCM(vdataL,FFT_LENGTH,0,1,0,0);
-    getPCM(vdataR,FFT_LENGTH,1,1,0,0);
+    addPCM(PCMdata, 512, PCMFormat{PCM_UINT8, 2, true});
 }
 
 
@@ -293,7 +238,11 @@ void PCM::addPCM8_512( const unsigned char PCMdata[2][512])
 
 //returned values are normalized from -1 to 1
 
-void PCM::getPCM(float *PCMdata, int samples, int channel, int freq, float smoothing, int derive)
+namespace {
+
+/* PCM::getPCM() from a ring buffer of PCM::maxsamples whose newest sample is at start - 1 */
+void readPCM(const float *ring, int start, float *PCMdata, int samples, int freq, float smoothing, int derive,
+             int *ip, double *w)
 {
    if (smoothing == 0)
      {
@@ -301,8 +250,8 @@ void PCM::getPCM(float *PCMdata, int samples, int channel, int freq, float smoot
        {
            int index = start - 1 - i;
            if (index < 0)
-               index = maxsamples + index;
-           PCMdata[i] = PCMd[channel][index];
+               index = PCM::maxsamples + index;
+           PCMdata[i] = ring[index];
        }
      }
    else
@@ -310,16 +259,16 @@ void PCM::getPCM(float *PCMdata, int samples, int channel, int freq, float smoot
        int index=start-1;
 
        if (index<0)
-         index=maxsamples+index;
+         index=PCM::maxsamples+index;
 
-       PCMdata[0] = PCMd[channel][index];
+       PCMdata[0] = ring[index];
 
        for (int i = 1; i < samples; i++)
        {
            index = start - 1 - i;
            if (index < 0)
-               index = maxsamples + index;
-           PCMdata[i] = (1 - smoothing) * PCMd[channel][index] + smoothing * PCMdata[i - 1];
+               index = PCM::maxsamples + index;
+           PCMdata[i] = (1 - smoothing) * ring[index] + smoothing * PCMdata[i - 1];
        }
      }
 
@@ -349,6 +298,13 @@ void PCM::getPCM(float *PCMdata, int samples, int channel, int freq, float smoot
      }
 }
 
+}  // namespace
+
+void PCM::getPCM(float *PCMdata, int samples, int channel, int freq, float smoothing, int derive)
+{
+    readPCM(PCMd[channel], start, PCMdata, samples, freq, smoothing, derive, ip, w);
+}
+
 //getPCMnew
 //
 //Like getPCM except it returns all new samples in the buffer
@@ -390,6 +346,74 @@ int PCM::getPCMnew(float *PCMdata, int channel, int freq, float smoothing, int d
    return i;
 }
 
+namespace {
+
+/* The bands BeatDetect has always used, as indices i of the newest first
+   samples [2 * i], and the weight of each band */
+const int beatBands[4] = {0, 5, 46, 400};
+const double beatWeights[3] = {100.0, 100.0, 90.0};
+
+/* Sum of the squared samples of band of both channels, for the window whose
+   newest sample is at end - 1 */
+float beatEnergy(float *const *ring, int end, int band)
+{
+    float energy = 0;
+    for (int i = beatBands[band] + 1; i <= beatBands[band + 1]; i++)
+    {
+        int index = end - 1 - i * 2;
+        if (index < 0)
+            index += PCM::maxsamples;
+        energy += ring[0][index] * ring[0][index] + ring[1][index] * ring[1][index];
+    }
+    energy *= beatWeights[band] / (beatBands[band + 1] - beatBands[band]);
+    return energy;
+}
+
+}  // namespace
+
+void PCM::analyzeBeatHops(int samples)
+{
+    /* samples the last band reaches back from the end of a hop */
+    const int window = beatBands[3] * 2 + 1;
+
+    int pending = beatFill + samples;
+    while (pending >= PCM_BEAT_HOP)
+    {
+        pending -= PCM_BEAT_HOP;
+        // a hop ends pending samples before the newest one; skip it if an
+        // unusually large add has already overwritten its window
+        if (pending + window > maxsamples)
+            continue;
+        int end = start - pending;
+        if (end < 0)
+            end += maxsamples;
+
+        PCMBeatHop hop;
+        hop.bass = beatEnergy(PCMd, end, 0);
+        hop.mid = beatEnergy(PCMd, end, 1);
+        hop.treb = beatEnergy(PCMd, end, 2);
+
+        std::lock_guard<std::mutex> lock(beatMutex);
+        beatHops[beatHopNext] = hop;
+        beatHopNext = (beatHopNext + 1) % PCM_BEAT_HOPS;
+        if (beatHopCount < PCM_BEAT_HOPS)
+            beatHopCount++;
+    }
+    std::lock_guard<std::mutex> lock(beatMutex);
+    beatFill = pending;
+}
+
+int PCM::takeBeatHops(PCMBeatHop *hops, int max, int *fill)
+{
+    std::lock_guard<std::mutex> lock(beatMutex);
+    const int count = std::min(max, beatHopCount);
+    for (int i = 0; i < count; i++)
+        hops[i] = beatHops[(beatHopNext - count + i + PCM_BEAT_HOPS) % PCM_BEAT_HOPS];
+    beatHopCount = 0;
+    *fill = beatFill;
+    return count;
+}
+
 //Free stuff
 void PCM::freePCM() {
   free(PCMd[0]);
@@ -402,3 +426,183 @@ void PCM::freePCM() {
   ip = NULL;
   w = NULL;
 }
+
+
+PCMSnapshot::PCMSnapshot() : start(0), newCount(0), resultCount(0)
+{
+    for (auto &channel : ring)
+        channel.assign(PCM::maxsamples, 0.0f);
+    newL.assign(PCM::maxsamples, 0.0f);
+    newR.assign(PCM::maxsamples, 0.0f);
+
+    w  = (double *)wipemalloc(FFT_LENGTH/2*sizeof(double));
+    ip = (int *)wipemalloc(34 * sizeof(int));
+    ip[0]=0;
+}
+
+PCMSnapshot::~PCMSnapshot()
+{
+    free(w);
+    free(ip);
+}
+
+void PCMSnapshot::update(const PCM &pcm)
+{
+    std::copy(pcm.PCMd[0], pcm.PCMd[0] + PCM::maxsamples, ring[0].begin());
+    std::copy(pcm.PCMd[1], pcm.PCMd[1] + PCM::maxsamples, ring[1].begin());
+    start = pcm.start;
+    std::copy(pcm.pcmdataL, pcm.pcmdataL + PCM::maxsamples, newL.begin());
+    std::copy(pcm.pcmdataR, pcm.pcmdataR + PCM::maxsamples, newR.begin());
+    newCount = pcm.numsamples;
+    resultCount = 0;
+}
+
+const float *PCMSnapshot::getPCM(int samples, int channel, int freq, float smoothing)
+{
+    for (size_t i = 0; i < resultCount; i++)
+    {
+        const Result &result = results[i];
+        if (result.samples == samples && result.channel == channel && result.freq == freq &&
+            result.smoothing == smoothing)
+            return result.data.data();
+    }
+
+    if (resultCount == results.size())
+        results.emplace_back();
+    Result &result = results[resultCount++];
+    result.samples = samples;
+    result.channel = channel;
+    result.freq = freq;
+    result.smoothing = smoothing;
+    result.data.resize(samples);
+    readPCM(ring[channel].data(), start, result.data.data(), samples, freq, smoothing, 0, ip, w);
+    return result.data.data();
+}
+
+
+// TESTS
+
+
+#include <TestRunner.hpp>
+
+#ifndef NDEBUG
+
+#define TEST(cond) if (!verify(#cond,cond)) return false
+
+struct PCMTest : public Test
+{
+    PCMTest() : Test("PCMTest")
+    {}
+
+public:
+    /* the sample of a channel back frames before the newest */
+    static float at(const PCM &pcm, int channel, int back)
+    {
+        return pcm.PCMd[channel][(pcm.start - 1 - back + 2 * PCM::maxsamples) % PCM::maxsamples];
+    }
+
+    bool test_formats()
+    {
+        PCM pcm;
+
+        const unsigned char u8[4] = { 192, 0, 128, 0 };
+        pcm.addPCM(u8, 2, PCMFormat{PCM_UINT8, 2, false});
+        TEST(at(pcm, 0, 1) == 1.0f);
+        TEST(at(pcm, 1, 1) == -2.0f);     /* not silenced for the zero */
+        TEST(at(pcm, 0, 0) == 0.0f);
+        TEST(at(pcm, 1, 0) == -2.0f);
+
+        const short s16[4] = { 16384, 0, -32768, 8192 };
+        pcm.addPCM(s16, 2, PCMFormat{PCM_INT16, 2, false});
+        TEST(at(pcm, 0, 1) == 1.0f);
+        TEST(at(pcm, 1, 1) == 0.0f);
+        TEST(at(pcm, 0, 0) == -2.0f);
+        TEST(at(pcm, 1, 0) == 0.5f);
+
+        const int s32[2] = { 1 << 30, -(1 << 29) };
+        pcm.addPCM(s32, 1, PCMFormat{PCM_INT32, 2, false});
+        TEST(at(pcm, 0, 0) == 1.0f);
+        TEST(at(pcm, 1, 0) == -0.5f);
+
+        const float f32[2] = { 0.25f, -0.75f };
+        pcm.addPCM(f32, 1, PCMFormat{PCM_FLOAT32, 2, false});
+        TEST(at(pcm, 0, 0) == 0.25f);
+        TEST(at(pcm, 1, 0) == -0.75f);
+        return true;
+    }
+
+    bool test_layouts()
+    {
+        PCM interleaved, planar, mono;
+
+        const float frames[8] = { 0.1f, -0.1f, 0.2f, -0.2f, 0.3f, -0.3f, 0.4f, -0.4f };
+        const float channels[8] = { 0.1f, 0.2f, 0.3f, 0.4f, -0.1f, -0.2f, -0.3f, -0.4f };
+        interleaved.addPCM(frames, 4, PCMFormat{PCM_FLOAT32, 2, false});
+        planar.addPCM(channels, 4, PCMFormat{PCM_FLOAT32, 2, true});
+        mono.addPCM(channels, 4, PCMFormat{PCM_FLOAT32, 1, false});
+        for (int back = 0; back < 4; back++)
+        {
+            for (int channel = 0; channel < 2; channel++)
+                TEST(at(planar, channel, back) == at(interleaved, channel, back));
+            TEST(at(interleaved, 0, back) == channels[3 - back]);
+            TEST(at(mono, 0, back) == channels[3 - back]);
+            TEST(at(mono, 1, back) == channels[3 - back]);
+        }
+
+        /* channels past the second are ignored */
+        const short quad[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+        interleaved.addPCM(quad, 2, PCMFormat{PCM_INT16, 4, false});
+        TEST(at(interleaved, 0, 0) == 5 / 16384.0f);
+        TEST(at(interleaved, 1, 0) == 6 / 16384.0f);
+        TEST(at(interleaved, 0, 1) == 1 / 16384.0f);
+        return true;
+    }
+
+    bool test_ring()
+    {
+        const int max = PCM::maxsamples;
+        std::vector<float> ramp(max + 100);
+        for (size_t i = 0; i < ramp.size(); i++)
+            ramp[i] = (float)i;
+
+        /* a write that crosses the end of the ring */
+        PCM pcm;
+        pcm.addPCM(ramp.data(), max - 10, PCMFormat{PCM_FLOAT32, 1, false});
+        pcm.addPCM(ramp.data(), 20, PCMFormat{PCM_FLOAT32, 1, false});
+        TEST(pcm.start == 10);
+        for (int back = 0; back < 20; back++)
+            TEST(at(pcm, 0, back) == (float)(19 - back));
+        TEST(at(pcm, 1, 20) == (float)(max - 11));
+
+        /* a write longer than the ring keeps its last frames */
+        PCM longer;
+        longer.addPCM(ramp.data(), max + 100, PCMFormat{PCM_FLOAT32, 1, false});
+        TEST(longer.start == 100);
+        for (int back = 0; back < max; back++)
+            TEST(at(longer, 0, back) == (float)(max + 99 - back));
+        return true;
+    }
+
+    bool test() override
+    {
+        bool result = true;
+        result &= test_formats();
+        result &= test_layouts();
+        result &= test_ring();
+        return result;
+    }
+};
+
+Test* PCM::test()
+{
+    return new PCMTest();
+}
+
+#else
+
+Test* PCM::test()
+{
+    return nullptr;
+}
+
+#endif
@@ -31,10 +31,50 @@
 
 #include "dlldefs.h"
 
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+class Test;
+
+
+// Sample rate the analysis assumes; see PCMMixer for other rates
+#define PCM_SAMPLE_RATE 44100
 
 // 1024 is more computationally intensive, but maybe better at detecting lower bass
 #define FFT_LENGTH 1024
 
+// Samples between two beat analyses, see PCM::takeBeatHops()
+#define PCM_BEAT_HOP 256
+// Analyses kept until BeatDetect takes them, about 0.75 s at 44.1 kHz
+#define PCM_BEAT_HOPS 128
+
+/// Sample types PCM::addPCM() converts from. The integer formats are scaled
+/// the way the add functions always have: full scale int16 is +-2.0. Every
+/// sample is converted as it is; addPCM16() and addPCM8() used to silence a
+/// frame when either channel was 0, including uint8 0, which is -2.0.
+enum PCMSampleFormat {
+    PCM_UINT8,      /* 128 is silence */
+    PCM_INT16,
+    PCM_INT32,
+    PCM_FLOAT32
+};
+
+/// Layout of audio handed to PCM::addPCM()
+struct PCMFormat {
+    PCMSampleFormat sample;
+    int channels;   /* the first two are used; one is played on both sides */
+    bool planar;    /* each channel's frames in one block, else interleaved */
+};
+
+/// Instant band energies of the audio at the end of a hop
+struct PCMBeatHop {
+    float bass;
+    float mid;
+    float treb;
+};
+
 
 class 
 #ifdef WIN32 
@@ -63,19 +103,94 @@ public:
     static int maxsamples;
     PCM();
     ~PCM();
-    void addPCMfloat(const float *PCMdata, int samples);
-    void addPCMfloat_2ch(const float *PCMdata, int samples);
+
+    /// Converts frames of audio in format straight into the buffer. Planar
+    /// data holds the frames of each channel one block after the other.
+    void addPCM(const void *data, int frames, const PCMFormat &format);
+
+    /* Shorthands for addPCM() */
+    void addPCMfloat(const float *PCMdata, int samples);        /* mono */
+    void addPCMfloat_2ch(const float *PCMdata, int samples);    /* samples counts both channels */
     void addPCM16(short [2][512]);
-    void addPCM16Data(const short* pcm_data, short samples);
+    void addPCM16Data(const short* pcm_data, short samples);    /* interleaved stereo frames */
     void addPCM8( unsigned char [2][1024]);
 	void addPCM8_512( const unsigned char [2][512]);
     void getPCM(float *data, int samples, int channel, int freq, float smoothing, int derive);
     void freePCM();
     int getPCMnew(float *PCMdata, int channel, int freq, float smoothing, int derive,int reset);
 
+    /// Copies the analyses of the hops completed since the last call, oldest
+    /// first, and returns how many there were, at most max. fill receives the
+    /// number of samples added since the last hop.
+    int takeBeatHops(PCMBeatHop *hops, int max, int *fill);
+
+    static Test *test();
+
 private:
     void _initPCM(int maxsamples);
+    /// Analyzes every hop the samples just added complete
+    void analyzeBeatHops(int samples);
+
+    /* Written by the add functions, which usually run on the audio thread */
+    std::mutex beatMutex;
+    PCMBeatHop beatHops[PCM_BEAT_HOPS];
+    int beatHopNext;    /* ring index of the next hop */
+    int beatHopCount;   /* hops not taken yet */
+    int beatFill;       /* samples added since the last hop */
 
   };
 
+/// The audio of one frame, copied from a PCM that the audio thread keeps
+/// adding to, so every render item of the frame sees the same samples.
+/// getPCM() results are cached by their arguments: waves asking for the same
+/// data share one copy, and one FFT.
+class
+#ifdef WIN32
+DLLEXPORT
+#endif
+PCMSnapshot {
+public:
+    PCMSnapshot();
+    ~PCMSnapshot();
+
+    /// Copies the current audio of pcm and drops the cached results
+    void update(const PCM &pcm);
+
+    /// PCM::getPCM() without derive, over the copied audio. The result is
+    /// shared and stays valid until the next update().
+    const float *getPCM(int samples, int channel, int freq, float smoothing);
+
+    /// Copies of PCM::pcmdataL, PCM::pcmdataR and PCM::numsamples
+    const float *pcmdataL() const { return newL.data(); }
+    const float *pcmdataR() const { return newR.data(); }
+    int numsamples() const { return newCount; }
+
+private:
+    struct Result {
+        int samples;
+        int channel;
+        int freq;
+        float smoothing;
+        std::vector<float> data;
+    };
+
+    PCMSnapshot(const PCMSnapshot &) = delete;
+    PCMSnapshot &operator=(const PCMSnapshot &) = delete;
+
+    std::vector<float> ring[2];
+    int start;
+    std::vector<float> newL;
+    std::vector<float> newR;
+    int newCount;
+
+    /* results[0 .. resultCount) belong to this frame, the rest keep their
+       storage; a deque, so adding one leaves the others where they are */
+    std::deque<Result> results;
+    size_t resultCount;
+
+    /* FFT workspace, separate from the PCM's, which the audio thread uses */
+    int *ip;
+    double *w;
+};
+
 #endif /** !_PCM_H */
@@ -0,0 +1,421 @@
+/**
+ * projectM -- Milkdrop-esque visualisation SDK
+ * Copyright (C)2003-2007 projectM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * See 'LICENSE.txt' included within this release
+ *
+ */
+
+#include "PCMMixer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "PCM.hpp"
+#include "VectorMath.hpp"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace {
+
+/* Filter taps per phase, a multiple of vmath::kMaxWidth */
+const int kTaps = 16;
+/* Phases of the polyphase filter at most; rate pairs needing more round
+   the position between two input samples to the nearest of these */
+const int kMaxPhases = 256;
+/* Frames handed to PCM::addPCMfloat_2ch() at once, well below what the
+   beat analysis can look back over */
+const int kChunk = 512;
+
+int gcd(int a, int b)
+{
+    while (b != 0)
+    {
+        const int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Windowed sinc low pass for the phase of an output frame phase / phases of
+   the way from one input frame to the next. cutoff is relative to the input
+   Nyquist frequency. */
+void designPhase(float *taps, int phase, int phases, double cutoff)
+{
+    const double half = kTaps / 2;
+    double sum = 0;
+    for (int k = 0; k < kTaps; k++)
+    {
+        /* distance of tap k from the output frame, in input frames */
+        const double d = k - (half - 1) - (double)phase / phases;
+        const double x = M_PI * cutoff * d;
+        const double sinc = d == 0 ? 1.0 : sin(x) / x;
+        const double window = 0.42 + 0.5 * cos(M_PI * d / half) + 0.08 * cos(2 * M_PI * d / half);
+        taps[k] = (float)(sinc * window);
+        sum += taps[k];
+    }
+    /* unit gain at DC for every phase */
+    for (int k = 0; k < kTaps; k++)
+        taps[k] = (float)(taps[k] / sum);
+}
+
+}  // namespace
+
+/* Frames are queued interleaved as written and deinterleaved into input
+   when mixed. input holds kTaps / 2 - 1 frames of history before the frame
+   the next output starts at, position, plus frac / up of a frame. */
+struct PCMMixer::Source {
+    Source(int sampleRate, int channels_, float gain_);
+
+    void resample();
+
+    int channels;
+    std::atomic<float> gain;
+
+    std::vector<float> queue;
+    std::atomic<size_t> written;    /* frames, wrapping */
+    std::atomic<size_t> read;
+
+    bool passThrough;
+    int up, down;                   /* output frames per input frames, reduced */
+    int phases;
+    std::vector<float> filter;      /* phases * kTaps */
+    std::vector<float> input[2];
+    size_t position;
+    int frac;
+
+    std::vector<float> output;      /* interleaved stereo, not mixed yet */
+};
+
+PCMMixer::Source::Source(int sampleRate, int channels_, float gain_) :
+    channels(channels_), gain(gain_), queue(PCM_MIXER_QUEUE * channels_), written(0), read(0),
+    passThrough(sampleRate == PCM_SAMPLE_RATE), position(kTaps / 2 - 1), frac(0)
+{
+    const int divisor = gcd(PCM_SAMPLE_RATE, sampleRate);
+    up = PCM_SAMPLE_RATE / divisor;
+    down = sampleRate / divisor;
+    phases = std::min(up, kMaxPhases);
+
+    /* below the lower Nyquist frequency, leaving room for the transition */
+    const double cutoff = 0.9 * std::min(1.0, (double)up / down);
+    filter.resize(phases * kTaps);
+    for (int phase = 0; phase < phases; phase++)
+        designPhase(&filter[phase * kTaps], phase, phases, cutoff);
+
+    /* Room for a full queue and the output it makes on top of what waits
+       for a late source, so steady mixing does not allocate */
+    for (auto &channel : input)
+    {
+        channel.reserve(kTaps + PCM_MIXER_QUEUE);
+        channel.assign(kTaps / 2 - 1, 0.0f);
+    }
+    output.reserve(2 * (PCM_MIXER_LATENCY + (size_t)(kTaps + PCM_MIXER_QUEUE) * up / down + 1));
+}
+
+/* Takes what the capture thread queued and appends it to output */
+void PCMMixer::Source::resample()
+{
+    const size_t from = read.load(std::memory_order_relaxed);
+    const size_t frames = written.load(std::memory_order_acquire) - from;
+    const float scale = gain.load(std::memory_order_relaxed);
+
+    for (auto &channel : input)
+        channel.reserve(channel.size() + frames);
+    for (size_t i = 0; i < frames; i++)
+    {
+        const float *frame = &queue[((from + i) % PCM_MIXER_QUEUE) * channels];
+        input[0].push_back(frame[0] * scale);
+        input[1].push_back(frame[channels - 1] * scale);
+    }
+    read.store(from + frames, std::memory_order_release);
+
+    if (passThrough)
+    {
+        const size_t start = kTaps / 2 - 1;
+        for (size_t i = start; i < input[0].size(); i++)
+        {
+            output.push_back(input[0][i]);
+            output.push_back(input[1][i]);
+        }
+        input[0].resize(start);
+        input[1].resize(start);
+        return;
+    }
+
+    /* rounding to the nearest phase can move the taps a frame further */
+    const size_t ahead = kTaps / 2 + (phases < up ? 1 : 0);
+    while (position + ahead < input[0].size())
+    {
+        /* nearest phase; past the last one is the first of the next frame */
+        int phase = (int)(((long long)frac * phases + up / 2) / up);
+        size_t first = position - (kTaps / 2 - 1);
+        if (phase == phases)
+        {
+            phase = 0;
+            first++;
+        }
+        assert(first + kTaps <= input[0].size());
+        const float *taps = &filter[phase * kTaps];
+        output.push_back(vmath::dot(&input[0][first], taps, kTaps));
+        output.push_back(vmath::dot(&input[1][first], taps, kTaps));
+
+        frac += down;
+        position += frac / up;
+        frac %= up;
+    }
+
+    /* keep the history of the next output frame */
+    const size_t consumed = std::min(position - (kTaps / 2 - 1), input[0].size());
+    for (auto &channel : input)
+        channel.erase(channel.begin(), channel.begin() + consumed);
+    position -= consumed;
+}
+
+
+PCMMixer::PCMMixer()
+{
+}
+
+PCMMixer::~PCMMixer()
+{
+}
+
+int PCMMixer::addSource(int sampleRate, int channels, float gain)
+{
+    if (sampleRate <= 0 || channels < 1 || channels > 2)
+        return -1;
+
+    std::lock_guard<std::mutex> lock(sourcesMutex);
+    for (int i = 0; i < PCM_MIXER_SOURCES; i++)
+    {
+        if (!sources[i])
+        {
+            sources[i].reset(new Source(sampleRate, channels, gain));
+            mixed.reserve(std::max(mixed.capacity(), sources[i]->output.capacity()));
+            return i;
+        }
+    }
+    return -1;
+}
+
+void PCMMixer::removeSource(int source)
+{
+    if (source < 0 || source >= PCM_MIXER_SOURCES)
+        return;
+
+    std::lock_guard<std::mutex> lock(sourcesMutex);
+    sources[source].reset();
+}
+
+void PCMMixer::setGain(int source, float gain)
+{
+    if (source < 0 || source >= PCM_MIXER_SOURCES || !sources[source])
+        return;
+    sources[source]->gain.store(gain, std::memory_order_relaxed);
+}
+
+int PCMMixer::write(int source, const float *data, int frames)
+{
+    if (source < 0 || source >= PCM_MIXER_SOURCES || !sources[source] || frames <= 0)
+        return 0;
+    Source &s = *sources[source];
+
+    const size_t at = s.written.load(std::memory_order_relaxed);
+    const size_t space = PCM_MIXER_QUEUE - (at - s.read.load(std::memory_order_acquire));
+    const size_t count = std::min((size_t)frames, space);
+
+    /* at most two copies, split where the queue wraps */
+    const size_t offset = at % PCM_MIXER_QUEUE;
+    const size_t first = std::min(count, PCM_MIXER_QUEUE - offset);
+    memcpy(&s.queue[offset * s.channels], data, first * s.channels * sizeof(float));
+    memcpy(&s.queue[0], data + first * s.channels, (count - first) * s.channels * sizeof(float));
+
+    s.written.store(at + count, std::memory_order_release);
+    return (int)count;
+}
+
+int PCMMixer::mix(PCM &pcm)
+{
+    std::lock_guard<std::mutex> lock(sourcesMutex);
+
+    size_t most = 0;
+    for (auto &source : sources)
+    {
+        if (!source)
+            continue;
+        source->resample();
+        most = std::max(most, source->output.size() / 2);
+    }
+
+    /* Mix what every source has produced. A source more than
+       PCM_MIXER_LATENCY frames behind is silent up to the others, so what
+       it delivers next lines up with their next frames. */
+    size_t length = most;
+    for (auto &source : sources)
+    {
+        if (!source)
+            continue;
+        if (source->output.size() / 2 + PCM_MIXER_LATENCY < most)
+            source->output.resize(most * 2, 0.0f);
+        length = std::min(length, source->output.size() / 2);
+    }
+    if (length == 0)
+        return 0;
+
+    mixed.assign(length * 2, 0.0f);
+    for (auto &source : sources)
+    {
+        if (!source)
+            continue;
+        for (size_t i = 0; i < length * 2; i++)
+            mixed[i] += source->output[i];
+        source->output.erase(source->output.begin(), source->output.begin() + length * 2);
+    }
+
+    for (size_t i = 0; i < length * 2; i += kChunk * 2)
+        pcm.addPCMfloat_2ch(&mixed[i], (int)std::min(length * 2 - i, (size_t)kChunk * 2));
+    return (int)length;
+}
+
+
+// TESTS
+
+
+#include <TestRunner.hpp>
+
+#ifndef NDEBUG
+
+#define TEST(cond) if (!verify(#cond,cond)) return false
+
+struct PCMMixerTest : public Test
+{
+    PCMMixerTest() : Test("PCMMixerTest")
+    {}
+
+public:
+    /* the frame the mixer added last */
+    static float last(const PCM &pcm)
+    {
+        return pcm.PCMd[0][(pcm.start + PCM::maxsamples - 1) % PCM::maxsamples];
+    }
+
+    /* two sources whose callbacks deliver 1024 frames on alternate calls */
+    bool test_alternating()
+    {
+        PCMMixer mixer;
+        PCM pcm;
+        const int a = mixer.addSource(PCM_SAMPLE_RATE, 1);
+        const int b = mixer.addSource(PCM_SAMPLE_RATE, 1);
+        TEST(a >= 0 && b >= 0);
+
+        std::vector<float> ones(1024, 1.0f);
+        int total = 0;
+        for (int i = 0; i < 10; i++)
+        {
+            TEST(mixer.write(i % 2 == 0 ? a : b, ones.data(), 1024) == 1024);
+            const int frames = mixer.mix(pcm);
+            total += frames;
+            if (frames > 0)
+                TEST(last(pcm) == 2.0f);
+        }
+        TEST(total == 5 * 1024);
+        return true;
+    }
+
+    /* a source that stops is waited for, then silent */
+    bool test_stalled()
+    {
+        PCMMixer mixer;
+        PCM pcm;
+        const int a = mixer.addSource(PCM_SAMPLE_RATE, 1);
+        const int b = mixer.addSource(PCM_SAMPLE_RATE, 1);
+
+        std::vector<float> ones(1024, 1.0f);
+        mixer.write(a, ones.data(), 1024);
+        mixer.write(b, ones.data(), 1024);
+        TEST(mixer.mix(pcm) == 1024);
+
+        int total = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            mixer.write(a, ones.data(), 1024);
+            total += mixer.mix(pcm);
+        }
+        /* waited for b until it was more than PCM_MIXER_LATENCY behind */
+        TEST(total == 5 * 1024);
+        TEST(last(pcm) == 1.0f);
+
+        /* b is back, behind a by less than PCM_MIXER_LATENCY */
+        mixer.write(a, ones.data(), 1024);
+        mixer.write(b, ones.data(), 1024);
+        TEST(mixer.mix(pcm) == 1024);
+        TEST(last(pcm) == 2.0f);
+        return true;
+    }
+
+    /* a rate that needs more phases than there are, so they are rounded,
+       written in blocks of many sizes, so mixes end at many phases */
+    bool test_rounded_phases()
+    {
+        PCMMixer mixer;
+        PCM pcm;
+        const int rate = 47999;
+        const int a = mixer.addSource(rate, 2);
+        TEST(a >= 0);
+
+        std::vector<float> ones(2 * 100, 1.0f);
+        long long written = 0, total = 0;
+        for (int i = 0; i < 5000; i++)
+        {
+            const int frames = 1 + i % 97;
+            TEST(mixer.write(a, ones.data(), frames) == frames);
+            written += frames;
+            total += mixer.mix(pcm);
+            if (total > kTaps)
+                TEST(std::abs(last(pcm) - 1.0f) < 0.001f);
+        }
+        TEST(std::abs(total - written * PCM_SAMPLE_RATE / rate) <= kTaps);
+        return true;
+    }
+
+    bool test() override
+    {
+        bool result = true;
+        result &= test_alternating();
+        result &= test_stalled();
+        result &= test_rounded_phases();
+        return result;
+    }
+};
+
+Test* PCMMixer::test()
+{
+    return new PCMMixerTest();
+}
+
+#else
+
+Test* PCMMixer::test()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * projectM -- Milkdrop-esque visualisation SDK
+ * Copyright (C)2003-2007 projectM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * See 'LICENSE.txt' included within this release
+ *
+ */
+/**
+ * $Id$
+ *
+ * Mixes several audio sources, each at its own sample rate, into a PCM
+ *
+ * $Log$
+ */
+
+#ifndef _PCMMIXER_H
+#define _PCMMIXER_H
+
+#include "dlldefs.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class PCM;
+class Test;
+
+// Sources a mixer takes at most
+#define PCM_MIXER_SOURCES 8
+// Frames a source queues until the next mix(), about 0.37 s at 44.1 kHz
+#define PCM_MIXER_QUEUE 16384
+// Frames the mix waits for a source that falls behind, about 0.09 s at 44.1 kHz
+#define PCM_MIXER_LATENCY 4096
+
+/// Takes the audio of up to PCM_MIXER_SOURCES sources, e.g. a line feed and
+/// a microphone, resamples each to PCM_SAMPLE_RATE and adds their sum to a
+/// PCM.
+///
+/// Each source is written by its own capture thread without locking: one
+/// thread per source may call write() while another calls mix(). Adding and
+/// removing sources takes a lock that only mix() shares.
+class
+#ifdef WIN32
+DLLEXPORT
+#endif
+PCMMixer {
+public:
+    PCMMixer();
+    ~PCMMixer();
+
+    /// Registers a source of sampleRate frames per second and 1 or 2
+    /// interleaved channels. Returns its id, or -1 if the arguments are
+    /// invalid or every source is taken.
+    int addSource(int sampleRate, int channels, float gain = 1.0f);
+    /// Drops the source and whatever it has queued. Its thread must have
+    /// stopped writing.
+    void removeSource(int source);
+    void setGain(int source, float gain);
+
+    /// Queues frames of interleaved audio for the next mix(). Returns the
+    /// number of frames queued, fewer than given if the queue is full.
+    int write(int source, const float *data, int frames);
+
+    /// Resamples everything the sources queued, adds up the frames that
+    /// every source has produced and adds the sum to pcm. The rest is kept
+    /// for the next call, so sources delivering at different times still
+    /// line up. A source more than PCM_MIXER_LATENCY frames behind the
+    /// others is silent for the difference. Returns the frames added.
+    int mix(PCM &pcm);
+
+    static Test *test();
+
+private:
+    struct Source;
+
+    std::mutex sourcesMutex;
+    std::unique_ptr<Source> sources[PCM_MIXER_SOURCES];
+    std::vector<float> mixed;   /* interleaved stereo */
+};
+
+#endif /** !_PCMMIXER_H */
@@ -2,6 +2,9 @@
 #include "RenderItemMatcher.hpp"
 #include "RenderItemMergeFunction.hpp"
 
+#include <algorithm>
+#include <cassert>
+
 const double PipelineMerger::e(2.71828182845904523536);
 const double PipelineMerger::s(0.5);
 
@@ -11,7 +14,7 @@ void PipelineMerger::DisableBlending(const Pipeline& pipeline) {
     }
 }
 
-void PipelineMerger::mergePipelines(Pipeline & a, Pipeline & b, Pipeline & out, RenderItemMatcher::MatchResults & results, RenderItemMergeFunction & mergeFunction, float ratio)
+bool PipelineMerger::mergePipelines(Pipeline & a, Pipeline & b, Pipeline & out, RenderItemMatcher::MatchResults & results, RenderItemMergeFunction & mergeFunction, float ratio)
 
 {
 
@@ -23,6 +26,9 @@ void PipelineMerger::mergePipelines(Pipeline & a, Pipeline & b, Pipeline & out,
 
 	out.drawables.clear();
 	out.compositeDrawables.clear();
+	// Halfway through, the composite drawables switch from a's to b's; make
+	// room for either on the first frame.
+	out.compositeDrawables.reserve(std::max(a.compositeDrawables.size(), b.compositeDrawables.size()));
 
     for(auto& drawable : a.drawables) {
         drawable->masterAlpha = invratio;
@@ -89,30 +95,24 @@ void PipelineMerger::mergePipelines(Pipeline & a, Pipeline & b, Pipeline & out,
 
     if (a.static_per_pixel() && b.static_per_pixel()) {
       out.SetStaticPerPixel(a.mesh_width(), a.mesh_height());
-      for (int x = 0; x < a.mesh_width(); x++) {
-        for (int y = 0; y < a.mesh_height(); y++) {
-          out.x_mesh_at(x, y) =
-              a.x_mesh_at(x, y) * invratio + b.x_mesh_at(x, y) * ratio;
-        }
+      // All three meshes have the same layout, so blend the planes as flat
+      // arrays; the padding between columns is blended along.
+      assert(b.mesh_width() == a.mesh_width() &&
+             b.mesh_height() == a.mesh_height());
+      const int size = a.mesh_width() * a.mesh_stride();
+      const float *ax = a.x_mesh();
+      const float *bx = b.x_mesh();
+      float *out_x = out.x_mesh();
+      for (int i = 0; i < size; i++) {
+        out_x[i] = ax[i] * invratio + bx[i] * ratio;
       }
-      for (int x = 0; x < a.mesh_width(); x++) {
-        for (int y = 0; y < a.mesh_height(); y++) {
-          out.y_mesh_at(x, y) =
-              a.y_mesh_at(x, y) * invratio + b.y_mesh_at(x, y) * ratio;
-        }
+      const float *ay = a.y_mesh();
+      const float *by = b.y_mesh();
+      float *out_y = out.y_mesh();
+      for (int i = 0; i < size; i++) {
+        out_y[i] = ay[i] * invratio + by[i] * ratio;
       }
     }
 
-    if(ratio < 0.5)
-    {
-        auto warp = a.GetWarpShader().second;
-        auto composite = a.GetCompositeShader().second;
-        out.UpdateShaders(warp, composite);
-    }
-    else
-    {
-        auto warp = b.GetWarpShader().second;
-        auto composite = b.GetCompositeShader().second;
-        out.UpdateShaders(warp, composite);
-    }
+    return out.CopyShadersFrom(ratio < 0.5 ? a : b);
 }
@@ -14,7 +14,10 @@ class PipelineMerger
 
 public:
     
-  static void mergePipelines(Pipeline &a,  Pipeline &b, Pipeline &out, 
+  /// Blends from a to b as ratio goes from 0 to 1. out takes the shaders of
+  /// whichever leads; returns true if it had to copy them, as it does when
+  /// the lead changes.
+  static bool mergePipelines(Pipeline &a,  Pipeline &b, Pipeline &out, 
 	RenderItemMatcher::MatchResults & matching, RenderItemMergeFunction & merger, float ratio);
 
   static void DisableBlending(const Pipeline& pipeline);
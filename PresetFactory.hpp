@@ -16,6 +16,18 @@
 #ifndef __PRESET_FACTORY_HPP
 #define __PRESET_FACTORY_HPP
 
+/// A simple exception class to strongly type all preset factory related issues
+class PresetFactoryException : public std::exception
+{
+	public:
+		inline PresetFactoryException(const std::string & message) : _message(message) {}
+		virtual ~PresetFactoryException() throw() {}
+		const std::string & message() const { return _message; } 
+
+	private:
+		std::string _message;
+};
+
 class PresetFactory {
 
 public:
@@ -13,6 +13,7 @@
 
 #ifndef DISABLE_MILKDROP_PRESETS
 #include "MilkdropPresetFactory/MilkdropPresetFactory.hpp"
+#include "MilkdropPresetFactory/PresetCodeFactory.hpp"
 #endif
 
 #ifndef DISABLE_NATIVE_PRESETS
@@ -47,8 +48,11 @@ void PresetFactoryManager::initialize(int gx, int gy) {
 	PresetFactory * factory;
 	
 	#ifndef DISABLE_MILKDROP_PRESETS
-	factory = new MilkdropPresetFactory(_gx, _gy);
-	registerFactory(factory->supportedExtensions(), factory);		
+	MilkdropPresetFactory * milkdropFactory = new MilkdropPresetFactory(_gx, _gy);
+	registerFactory(milkdropFactory->supportedExtensions(), milkdropFactory);
+
+	factory = new PresetCodeFactory(*milkdropFactory);
+	registerFactory(factory->supportedExtensions(), factory);
 	#endif
 	
 	#ifndef DISABLE_NATIVE_PRESETS
@@ -13,18 +13,6 @@
 #define __PRESET_FACTORY_MANAGER_HPP
 #include "PresetFactory.hpp"
 
-/// A simple exception class to strongly type all preset factory related issues
-class PresetFactoryException : public std::exception
-{
-	public:
-		inline PresetFactoryException(const std::string & message) : _message(message) {}
-		virtual ~PresetFactoryException() throw() {}
-		const std::string & message() const { return _message; } 
-
-	private:
-		std::string _message;
-};
-
 /// A manager of preset factories
 class PresetFactoryManager {
 
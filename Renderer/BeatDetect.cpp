@@ -73,6 +73,8 @@ BeatDetect::BeatDetect(PCM *_pcm)
     this->bass_att = 0;
     this->vol_att = 0;
     this->vol = 0;
+    this->previous_levels = Levels();
+    this->levels = Levels();
 }
 
 
@@ -93,26 +95,49 @@ void BeatDetect::reset()
     this->vol_att = 0;
     this->vol_old = 0;
     this->vol_instant=0;
+    this->previous_levels = Levels();
+    this->levels = Levels();
 }
 
 
 void BeatDetect::detectFromSamples()
 {
     vol_old = vol;
-    bass=0;
-    mid=0;
-    treb=0;
-    vol=0;
 
-    // TODO: get sample rate from PCM?  Assume 44100
-    getBeatVals(44100.0f, FFT_LENGTH, pcm->pcmdataL, pcm->pcmdataR);
+    pcmSnapshot.update(*pcm);
+
+    PCMBeatHop hops[PCM_BEAT_HOPS];
+    int fill;
+    const int count = pcm->takeBeatHops(hops, PCM_BEAT_HOPS, &fill);
+    for (int i = 0; i < count; i++)
+        addBeatHop(hops[i]);
+
+    // The newest sample is fill samples into the next hop. Interpolating
+    // between the last two hops by that much keeps the values moving
+    // smoothly, one hop behind the audio, whatever the frame rate.
+    const float t = std::min(1.0f, fill / (float)PCM_BEAT_HOP);
+    auto at = [this, t](float Levels::*value) {
+        const float level = previous_levels.*value + t * (levels.*value - previous_levels.*value);
+        // Use beat sensitivity as a multiplier
+        // 0 is "dead"
+        // 5 is pretty wild so above that doesn't make sense
+        return std::min(100.0f, level * beatSensitivity);
+    };
+    bass = at(&Levels::bass);
+    mid = at(&Levels::mid);
+    treb = at(&Levels::treb);
+    vol = at(&Levels::vol);
+    bass_att = at(&Levels::bass_att);
+    mid_att = at(&Levels::mid_att);
+    treb_att = at(&Levels::treb_att);
+    vol_att = at(&Levels::vol_att);
 }
 
 
 
 float BeatDetect::getPCMScale()
 {
-    // the constant here just depends on the particulars of getBeatVals(), the
+    // the constant here just depends on the particulars of addBeatHop(), the
     // range of vol_history, and what "looks right".
     // larger value means larger, more jagged waveform.
 
@@ -122,42 +147,19 @@ float BeatDetect::getPCMScale()
 
 
 
-void BeatDetect::getBeatVals( float samplerate, unsigned fft_length, float *vdataL, float *vdataR )
+void BeatDetect::addBeatHop(const PCMBeatHop &hop)
 {
-    assert( 512==fft_length || 1024==fft_length );    // should be power of 2, expect >= 512
-
-    // TODO: compute ranges based on samplerate
-    // roughly aiming or basee-mid cutoff of 220ish and mid-treb cutoff of 2000ish, if I did my math right
-    unsigned ranges512[4]  = {0, 3 /* 3*441000/512 = =258 */, 23 /* 23*441000/512 = =1981 */ , 200};
-    unsigned ranges1024[4] = {0, 5 /* 5*44100/1024 == 215 */, 46 /* 46*44100/1024 == 1981  */, 400};
-    unsigned *ranges = fft_length==1024 ? ranges1024 : ranges512;
-
-    bass_instant = 0;
-    for (unsigned i=ranges[0]+1 ; i<=ranges[1] ; i++)
-    {
-        bass_instant += (vdataL[i*2]*vdataL[i*2]) + (vdataR[i*2]*vdataR[i*2]);
-    }
-    bass_instant *= 100.0/(ranges[1]-ranges[0]);
+    bass_instant = hop.bass;
     bass_history -= bass_buffer[beat_buffer_pos] * (1.0/BEAT_HISTORY_LENGTH);
     bass_buffer[beat_buffer_pos] = bass_instant;
     bass_history += bass_instant * (1.0/BEAT_HISTORY_LENGTH);
 
-    mid_instant = 0;
-    for (unsigned i=ranges[1]+1 ; i<=ranges[2] ; i++)
-    {
-        mid_instant += (vdataL[i*2]*vdataL[i*2]) + (vdataR[i*2]*vdataR[i*2]);
-    }
-    mid_instant *= 100.0/(ranges[2]-ranges[1]);
+    mid_instant = hop.mid;
     mid_history -= mid_buffer[beat_buffer_pos] * (1.0/BEAT_HISTORY_LENGTH);
     mid_buffer[beat_buffer_pos] = mid_instant;
     mid_history += mid_instant * (1.0/BEAT_HISTORY_LENGTH);
 
-    treb_instant = 0;
-    for (unsigned i=ranges[2]+1 ; i<=ranges[3] ; i++)
-    {
-        treb_instant += (vdataL[i*2]*vdataL[i*2]) + (vdataR[i*2]*vdataR[i*2]);
-    }
-    treb_instant *= 90.0/(ranges[3]-ranges[2]);
+    treb_instant = hop.treb;
     treb_history -= treb_buffer[beat_buffer_pos] * (1.0/BEAT_HISTORY_LENGTH);
     treb_buffer[beat_buffer_pos] = treb_instant;
     treb_history += treb_instant * (1.0/BEAT_HISTORY_LENGTH);
@@ -167,51 +169,35 @@ void BeatDetect::getBeatVals( float samplerate, unsigned fft_length, float *vdat
     vol_buffer[beat_buffer_pos] = vol_instant;
     vol_history += vol_instant * (1.0/BEAT_HISTORY_LENGTH);
 
-//    fprintf(stderr, "%6.3f %6.2f %6.3f\n", bass_history/vol_history, mid_history/vol_history, treb_history/vol_history);
-    bass = bass_instant / fmax(0.0001, 1.3 * bass_history + 0.2*vol_history);
-    mid  =  mid_instant / fmax(0.0001, 1.3 *  mid_history + 0.2*vol_history);
-    treb = treb_instant / fmax(0.0001, 1.3 * treb_history + 0.2*vol_history);
-    vol = vol_instant / fmax(0.0001, 1.5f * vol_history);
+    Levels next;
+    next.bass = bass_instant / fmax(0.0001, 1.3 * bass_history + 0.2*vol_history);
+    next.mid  =  mid_instant / fmax(0.0001, 1.3 *  mid_history + 0.2*vol_history);
+    next.treb = treb_instant / fmax(0.0001, 1.3 * treb_history + 0.2*vol_history);
+    next.vol = vol_instant / fmax(0.0001, 1.5f * vol_history);
 
-    if ( projectM_isnan( treb ) ) {
-        treb = 0.0;
+    if ( projectM_isnan( next.treb ) ) {
+        next.treb = 0.0;
     }
-    if ( projectM_isnan( mid ) ) {
-        mid = 0.0;
+    if ( projectM_isnan( next.mid ) ) {
+        next.mid = 0.0;
     }
-    if ( projectM_isnan( bass ) ) {
-        bass = 0.0;
+    if ( projectM_isnan( next.bass ) ) {
+        next.bass = 0.0;
     }
 
-    treb_att = .6f * treb_att + .4f * treb;
-    mid_att  = .6f * mid_att + .4f * mid;
-    bass_att = .6f * bass_att + .4f * bass;
-    vol_att =  .6f * vol_att + .4f * vol;
-
-    // Use beat sensitivity as a multiplier
-    // 0 is "dead"
-    // 5 is pretty wild so above that doesn't make sense
-    bass_att = bass_att * beatSensitivity;
-    bass = bass * beatSensitivity;
-    mid_att = mid_att * beatSensitivity;
-    mid = mid * beatSensitivity;
-    treb_att = treb_att * beatSensitivity;
-    treb = treb * beatSensitivity;
-    vol_att = vol_att * beatSensitivity;
-    vol = vol * beatSensitivity;
-
-    if (bass_att>100) bass_att=100;
-    if (bass >100) bass=100;
-    if (mid_att>100) mid_att=100;
-    if (mid >100) mid=100;
-    if (treb_att>100) treb_att=100;
-    if (treb >100) treb=100;
-    if (vol_att>100) vol_att=100;
-    if (vol>100) vol=100;
+    // .6 old to .4 new per frame at BEAT_TUNING_FPS, spread over the hops of
+    // such a frame. The attack is per second: at 60 fps each frame keeps
+    // about .77 of the old value, not .6.
+    static const float decay = powf(0.6f, PCM_BEAT_HOP / ((float)PCM_SAMPLE_RATE / BEAT_TUNING_FPS));
+    next.bass_att = decay * levels.bass_att + (1 - decay) * next.bass;
+    next.mid_att  = decay * levels.mid_att + (1 - decay) * next.mid;
+    next.treb_att = decay * levels.treb_att + (1 - decay) * next.treb;
+    next.vol_att =  decay * levels.vol_att + (1 - decay) * next.vol;
+
+    previous_levels = levels;
+    levels = next;
 
     beat_buffer_pos++;
-    if (beat_buffer_pos>79)
+    if (beat_buffer_pos >= BEAT_HISTORY_LENGTH)
         beat_buffer_pos=0;
 }
-
-
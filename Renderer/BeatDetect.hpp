@@ -37,9 +37,15 @@
 #include <cmath>
 
 
-// this is the size of the buffer used to determine avg levels of the input audio
-// the actual time represented in the history depends on FPS
-#define BEAT_HISTORY_LENGTH 80
+// Frame rate the detector was tuned at. Its history and the attack of the _att
+// levels are defined in seconds, as long as they were at this rate, so every
+// frame rate gets the same smoothing per second rather than per frame.
+#define BEAT_TUNING_FPS 30
+
+// this is the size of the buffer used to determine avg levels of the input audio,
+// in hops of PCM_BEAT_HOP samples: the 80 frames at BEAT_TUNING_FPS and 44.1 kHz
+// the detector was tuned with
+#define BEAT_HISTORY_LENGTH 459
 
 class DLLEXPORT BeatDetect
 {
@@ -56,13 +62,17 @@ class DLLEXPORT BeatDetect
         float vol_att ;
 
 		PCM *pcm;
+		/// The audio of the current frame, taken by detectFromSamples()
+		PCMSnapshot pcmSnapshot;
 
 		/** Methods */
 		explicit BeatDetect(PCM *pcm);
 		~BeatDetect();
 		void reset();
+		/// Takes the frame's audio and the beat analyses of the hops
+		/// completed since the last frame (see PCM::takeBeatHops()), and
+		/// sets the values above as of the newest sample
 		void detectFromSamples();
-		void getBeatVals( float samplerate, unsigned fft_length, float *vdataL, float *vdataR );
 
         // getPCMScale() was added to address https://github.com/projectM-visualizer/projectm/issues/161
         // Returning 1.0 results in using the raw PCM data, which can make the presets look pretty unresponsive
@@ -70,6 +80,18 @@ class DLLEXPORT BeatDetect
 		float getPCMScale();
 
 	private:
+		/// Band values after a hop, before beatSensitivity
+		struct Levels {
+			float bass, mid, treb, vol;
+			float bass_att, mid_att, treb_att, vol_att;
+		};
+
+		void addBeatHop(const PCMBeatHop &hop);
+
+		/// The last two hops; frames fall in between
+		Levels previous_levels;
+		Levels levels;
+
 		int beat_buffer_pos;
         float bass_buffer[BEAT_HISTORY_LENGTH];
 		float bass_history;
@@ -13,7 +13,9 @@
 class Brighten : public RenderItem
 {
 public:
-    Brighten(){ Init(); }
+    static constexpr Kind kKind = kBrighten;
+
+    Brighten() : RenderItem(kKind) { Init(); }
     void InitVertexAttrib();
 	void Draw(RenderContext &context);
 };
@@ -21,7 +23,9 @@ public:
 class Darken : public RenderItem
 {
 public:
-    Darken(){ Init(); }
+    static constexpr Kind kKind = kDarken;
+
+    Darken() : RenderItem(kKind) { Init(); }
     void InitVertexAttrib();
 	void Draw(RenderContext &context);
 };
@@ -29,7 +33,9 @@ public:
 class Invert : public RenderItem
 {
 public:
-    Invert(){ Init(); }
+    static constexpr Kind kKind = kInvert;
+
+    Invert() : RenderItem(kKind) { Init(); }
     void InitVertexAttrib();
 	void Draw(RenderContext &context);
 };
@@ -37,7 +43,9 @@ public:
 class Solarize : public RenderItem
 {
 public:
-    Solarize(){ Init(); }
+    static constexpr Kind kKind = kSolarize;
+
+    Solarize() : RenderItem(kKind) { Init(); }
     void InitVertexAttrib();
 	void Draw(RenderContext &context);
 };
@@ -14,7 +14,7 @@
 #include "StaticShaders.hpp"
 #include <glm/gtc/type_ptr.hpp>
 
-MilkdropWaveform::MilkdropWaveform(): RenderItem(),
+MilkdropWaveform::MilkdropWaveform(): RenderItem(kKind),
     x(0.5), y(0.5), r(1), g(0), b(0), a(1), mystery(0), mode(Line), additive(false), dots(false), thick(false),
     modulateAlphaByVolume(false), maximizeColors(false), scale(10), smoothing(0),
     modOpacityStart(0), modOpacityEnd(1), rot(0), samples(0), loop(false) {
@@ -195,8 +195,8 @@ void MilkdropWaveform::MaximizeColors(RenderContext &context)
 
 void MilkdropWaveform::WaveformMath(RenderContext &context)
 {
-	float *pcmdataR = context.beatDetect->pcm->pcmdataR;
-	float *pcmdataL = context.beatDetect->pcm->pcmdataL;
+	const float *pcmdataR = context.pcmSnapshot->pcmdataR();
+	const float *pcmdataL = context.pcmSnapshot->pcmdataL();
 	// scale PCM data based on vol_history to make it more or less independent of the application output volume
     const float  vol_scale = context.beatDetect->getPCMScale();
 
@@ -222,7 +222,7 @@ void MilkdropWaveform::WaveformMath(RenderContext &context)
 			rot =   0;
 			aspectScale=1.0;
 
-			samples = context.beatDetect->pcm->numsamples;
+			samples = context.pcmSnapshot->numsamples();
 
 			float inv_nverts_minus_one = 1.0f/(float)(samples);
 
@@ -343,7 +343,7 @@ void MilkdropWaveform::WaveformMath(RenderContext &context)
 			rot = -mystery*90;
 			aspectScale =1.0f+wave_x_temp;
 			wave_x_temp=-1*(x-1.0f);
-			samples = context.beatDetect->pcm->numsamples;
+			samples = context.pcmSnapshot->numsamples();
 
 			for ( int i=0;i<  samples;i++)
 			{
@@ -365,7 +365,7 @@ void MilkdropWaveform::WaveformMath(RenderContext &context)
 			aspectScale =1.0f+wave_x_temp;
 
 
-			samples = context.beatDetect->pcm->numsamples;
+			samples = context.pcmSnapshot->numsamples();
 			two_waves = true;
 
 			const float y_adj = y*y*.5f;
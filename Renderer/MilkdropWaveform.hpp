@@ -19,7 +19,7 @@ enum MilkdropWaveformMode
 class MilkdropWaveform : public RenderItem
 {
 public:
-
+	static constexpr Kind kKind = kMilkdropWaveform;
 
 	float x;
 	float y;
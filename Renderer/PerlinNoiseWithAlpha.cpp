@@ -1,5 +1,10 @@
 #include "PerlinNoiseWithAlpha.hpp"
 
+#include <algorithm>
+#include <cstdint>
+
+#include "TaskPool.hpp"
+
 namespace {
 float Noise(int x) {
   x = (x << 13) ^ x;
@@ -22,7 +27,10 @@ float CubicInterpolate(float v0, float v1, float v2, float v3, float x) {
   float Q = (v0 - v1) - P;
   float R = v2 - v0;
 
-  return P * pow(x, 3) + Q * pow(x, 2) + R * x + v1;
+  // The same double products pow(x, 3) and pow(x, 2) returned
+  const double x2 = static_cast<double>(x) * x;
+  const double x3 = x2 * x;
+  return P * x3 + Q * x2 + R * x + v1;
 }
 
 float InterpolatedNoise(float x, float y) {
@@ -199,27 +207,88 @@ void Fill(float output[W][H][C]) {
   }
 }
 
+// InterpolatedNoise() is separable: the cubic along y interpolates cubics
+// along x over four lattice rows. Each image row x therefore interpolates the
+// lattice along x once per lattice column, then every pixel of the row
+// interpolates four of those along y. `store` receives every pixel value.
+template <typename Store>
+void FillInterpolatedNoise(int width, int height, float scale_x,
+                           float scale_y, Store store) {
+  const int lattice_end = static_cast<int>((height - 1) * scale_y) + 3;
+  ParallelFor(0, width, 16, [&](int begin, int end) {
+    // [i] interpolates lattice row i - 1. InterpolatedNoise() starts its third
+    // row at integer_x rather than integer_x - 1, kept in along_x_third.
+    std::vector<float> along_x(lattice_end + 1);
+    std::vector<float> along_x_third(lattice_end + 1);
+    for (int x = begin; x < end; ++x) {
+      const float position_x = x * scale_x;
+      const int integer_x = int(position_x);
+      const float fractional_x = position_x - integer_x;
+      for (int i = 0; i <= lattice_end; ++i) {
+        const int lattice_y = i - 1;
+        const float n0 = Noise(integer_x - 1, lattice_y);
+        const float n1 = Noise(integer_x, lattice_y);
+        const float n2 = Noise(integer_x + 1, lattice_y);
+        const float n3 = Noise(integer_x + 2, lattice_y);
+        along_x[i] = CubicInterpolate(n0, n1, n2, n3, fractional_x);
+        along_x_third[i] = CubicInterpolate(n1, n1, n2, n3, fractional_x);
+      }
+      for (int y = 0; y < height; ++y) {
+        const float position_y = y * scale_y;
+        const int integer_y = int(position_y);
+        const float fractional_y = position_y - integer_y;
+        store(x, y,
+              CubicInterpolate(along_x[integer_y], along_x[integer_y + 1],
+                               along_x_third[integer_y + 2],
+                               along_x[integer_y + 3], fractional_y));
+      }
+    }
+  });
+}
+
 }  // namespace
 
 void FillPerlin(Image<float>* image) { FillPerlinScaled(1, 1, image); }
 
 void FillPerlinScaled(float scale_x, float scale_y, Image<float>* image) {
+  if (image->dimensionality() == Dimensionality::kDimensionality2d) {
+    const int channels = image->num_channels();
+    FillInterpolatedNoise(
+        image->width(), image->height(), scale_x, scale_y,
+        [image, channels](int x, int y, float value) {
+          for (int c = 0; c < channels - 1; ++c) {
+            image->at(x, y, c) = value;
+          }
+          image->at(x, y, channels - 1) = 1.0f;
+        });
+    return;
+  }
+
   for (int x = 0; x < image->width(); ++x) {
     for (int y = 0; y < image->height(); ++y) {
-      if (image->dimensionality() == Dimensionality::kDimensionality3d) {
-        for (int z = 0; z < image->depth(); ++z) {
-          for (int c = 0; c < image->num_channels() - 1; ++c) {
-            image->at(x, y, z, c) =
-                Noise3d(x, y, z, image->width(), 3, rand(), 0.2, scale_x);
-          }
-          image->at(x, y, z, image->num_channels() - 1) = 1.0f;
-        }
-      } else {
+      for (int z = 0; z < image->depth(); ++z) {
         for (int c = 0; c < image->num_channels() - 1; ++c) {
-          image->at(x, y, c) = InterpolatedNoise(x * scale_x, y * scale_y);
+          image->at(x, y, z, c) =
+              Noise3d(x, y, z, image->width(), 3, rand(), 0.2, scale_x);
         }
-        image->at(x, y, image->num_channels() - 1) = 1.0f;
+        image->at(x, y, z, image->num_channels() - 1) = 1.0f;
       }
     }
   }
 }
+
+void FillPerlinScaled(float scale_x, float scale_y, Image<uint8_t>* image) {
+  assert(image->dimensionality() == Dimensionality::kDimensionality2d);
+  const int channels = image->num_channels();
+  FillInterpolatedNoise(
+      image->width(), image->height(), scale_x, scale_y,
+      [image, channels](int x, int y, float value) {
+        // Clamped and rounded the way GL normalizes GL_FLOAT texel data
+        const uint8_t byte = static_cast<uint8_t>(
+            std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+        for (int c = 0; c < channels - 1; ++c) {
+          image->at(x, y, c) = byte;
+        }
+        image->at(x, y, channels - 1) = 255;
+      });
+}
@@ -15,6 +15,8 @@ so the TextureManager has to use something that is pre-RGBA
 
 #include <math.h>
 
+#include <cassert>
+#include <cstdint>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -82,5 +84,8 @@ class Image {
 
 void FillPerlin(Image<float>* image);
 void FillPerlinScaled(float scale_x, float scale_y, Image<float>* image);
+// The 2D noise of the float version as normalized bytes, ready to upload as
+// GL_UNSIGNED_BYTE.
+void FillPerlinScaled(float scale_x, float scale_y, Image<uint8_t>* image);
 
 #endif /* PERLINNOISEWITHALPHA_HPP_ */
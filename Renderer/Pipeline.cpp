@@ -8,6 +8,38 @@
 
 #include <algorithm>
 
+#include "VectorMath.hpp"
+#include "wipemalloc.h"
+
+MeshPlanes::MeshPlanes()
+    : data_(nullptr), stride_(0), plane_size_(0), capacity_(0) {}
+
+MeshPlanes::~MeshPlanes() {
+  if (data_ != nullptr) {
+    wipe_aligned_free(data_);
+  }
+}
+
+int MeshPlanes::Stride(int gy) {
+  return (gy + vmath::kMaxWidth - 1) & ~(vmath::kMaxWidth - 1);
+}
+
+void MeshPlanes::Resize(int planes, int gx, int gy) {
+  stride_ = Stride(gy);
+  plane_size_ = gx * stride_;
+
+  const int size = planes * plane_size_;
+  if (size > capacity_) {
+    if (data_ != nullptr) {
+      wipe_aligned_free(data_);
+    }
+    capacity_ = size;
+    // zeroed by wipe_aligned_alloc()
+    data_ = static_cast<float *>(wipe_aligned_alloc(
+        vmath::kMaxWidth * sizeof(float), capacity_ * sizeof(float)));
+  }
+}
+
 Pipeline::Pipeline()
     : static_per_pixel_(false),
       gx_(0),
@@ -22,17 +54,48 @@ Pipeline::Pipeline()
       textureWrap(false),
       screenDecay(false) {
   std::fill(q, q + NUM_Q_VARIABLES, 0);
-  x_mesh_.reset(new float[1]);
-  y_mesh_.reset(new float[1]);
 }
 
-void Pipeline::SetStaticPerPixel(int gx, int gy) {
+void Pipeline::SetStaticPerPixel(int gx, int gy, int extra_planes) {
   static_per_pixel_ = true;
   gx_ = gx;
   gy_ = gy;
 
-  x_mesh_.reset(new float[gx * gy]);
-  y_mesh_.reset(new float[gx * gy]);
+  // Called every frame on the transition pipeline; MeshPlanes only grows.
+  mesh_.Resize(kYMeshPlane + 1 + extra_planes, gx, gy);
+}
+
+namespace {
+bool SameShader(const ShaderCache &a, const ShaderCache &b) {
+  return a.program_source == b.program_source && a.file_name == b.file_name &&
+         a.preset_path == b.preset_path &&
+         std::equal(a.textures_and_samplers.begin(),
+                    a.textures_and_samplers.end(),
+                    b.textures_and_samplers.begin(),
+                    b.textures_and_samplers.end(),
+                    [](const auto &lhs, const auto &rhs) {
+                      return lhs.first == rhs.first &&
+                             lhs.second.texture == rhs.second.texture &&
+                             lhs.second.sampler == rhs.second.sampler;
+                    });
+}
+}  // namespace
+
+bool Pipeline::CopyShadersFrom(Pipeline &other) {
+  if (&other == this) {
+    return false;
+  }
+  std::scoped_lock lock(shader_mutex_, other.shader_mutex_);
+  bool copied = false;
+  if (!SameShader(warp_shader_, other.warp_shader_)) {
+    warp_shader_ = other.warp_shader_;
+    copied = true;
+  }
+  if (!SameShader(composite_shader_, other.composite_shader_)) {
+    composite_shader_ = other.composite_shader_;
+    copied = true;
+  }
+  return copied;
 }
 
 Pipeline::~Pipeline() {}
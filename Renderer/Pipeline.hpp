@@ -20,6 +20,40 @@ class PipelineContext {
   float progress;
 };
 
+// The per pixel matrices of a gx by gy mesh, as planes of one aligned
+// allocation. Element (x, y) of plane p is plane(p)[x * stride() + y]: every
+// plane has the same layout, and stride() rounds gy up to a whole number of
+// the widest SIMD vector so columns can be processed without a scalar tail.
+// The padding is zeroed on allocation.
+class MeshPlanes {
+ public:
+  MeshPlanes();
+  ~MeshPlanes();
+  MeshPlanes(const MeshPlanes &) = delete;
+  MeshPlanes &operator=(const MeshPlanes &) = delete;
+
+  // Sizes the block for `planes` planes of gx by gy. Only reallocates when
+  // the block has to grow, which loses the contents; otherwise pointers into
+  // it stay valid.
+  void Resize(int planes, int gx, int gy);
+
+  float *plane(int p) { return data_ + p * plane_size_; }
+  const float *plane(int p) const { return data_ + p * plane_size_; }
+
+  int stride() const { return stride_; }
+  // Floats in one plane, padding included.
+  int plane_size() const { return plane_size_; }
+
+  static int Stride(int gy);
+
+ private:
+  float *data_;
+  int stride_;
+  int plane_size_;
+  // Number of floats allocated.
+  int capacity_;
+};
+
 // This class is the input to projectM's renderer
 //
 // Most implemenatations should implement PerPixel in order to get
@@ -49,7 +83,10 @@ class Pipeline {
   std::vector<std::shared_ptr<RenderItem>> compositeDrawables;
 
   Pipeline();
-  void SetStaticPerPixel(int _gx, int _gy);
+  // Sizes x_mesh and y_mesh. A subclass with more per pixel matrices can keep
+  // them in the same block: they are planes 2 .. 2 + extra_planes - 1, see
+  // mesh_plane().
+  void SetStaticPerPixel(int _gx, int _gy, int extra_planes = 0);
   virtual ~Pipeline();
   virtual PixelPoint PerPixel(PixelPoint p, const PerPixelContext context);
 
@@ -59,6 +96,11 @@ class Pipeline {
     composite_shader_ = std::move(composite_shader);
   }
 
+  // Copies the shaders of `other` into this pipeline. Cheap when they are
+  // already the same, which is the common case for a pipeline that is
+  // re-merged every frame. Returns true if anything was copied.
+  bool CopyShadersFrom(Pipeline &other);
+
   std::pair<std::unique_lock<std::mutex>, ShaderCache&> GetWarpShader() {
     return {std::unique_lock<std::mutex>(shader_mutex_), warp_shader_};
   }
@@ -68,38 +110,51 @@ class Pipeline {
   }
 
   float& x_mesh_at(int x, int y) {
-    return x_mesh_.get()[ComputeMeshOffset(x, y)];
+    return mesh_.plane(kXMeshPlane)[ComputeMeshOffset(x, y)];
   }
 
   float& y_mesh_at(int x, int y) {
-    return y_mesh_.get()[ComputeMeshOffset(x, y)];
+    return mesh_.plane(kYMeshPlane)[ComputeMeshOffset(x, y)];
   }
 
   float x_mesh_at(int x, int y) const {
-    return x_mesh_.get()[ComputeMeshOffset(x, y)];
+    return mesh_.plane(kXMeshPlane)[ComputeMeshOffset(x, y)];
   }
 
   float y_mesh_at(int x, int y) const {
-    return y_mesh_.get()[ComputeMeshOffset(x, y)];
+    return mesh_.plane(kYMeshPlane)[ComputeMeshOffset(x, y)];
   }
 
-  float mesh_width() const { return gx_; }
+  // The whole planes, laid out as described at MeshPlanes.
+  float *x_mesh() { return mesh_.plane(kXMeshPlane); }
+  float *y_mesh() { return mesh_.plane(kYMeshPlane); }
+  const float *x_mesh() const { return mesh_.plane(kXMeshPlane); }
+  const float *y_mesh() const { return mesh_.plane(kYMeshPlane); }
 
-  float mesh_height() const { return gy_; }
+  int mesh_width() const { return gx_; }
+
+  int mesh_height() const { return gy_; }
+
+  int mesh_stride() const { return mesh_.stride(); }
 
   bool static_per_pixel() const { return static_per_pixel_; }
 
  protected:
+  static const int kXMeshPlane = 0;
+  static const int kYMeshPlane = 1;
+
   int ComputeMeshOffset(int x, int y) const {
-    return (x + y * gx_) % (gx_ * gy_);
+    return x * mesh_.stride() + y;
   }
 
+  // Plane i of the extra_planes passed to SetStaticPerPixel().
+  float *mesh_plane(int i) { return mesh_.plane(kYMeshPlane + 1 + i); }
+
   std::mutex shader_mutex_;
   ShaderCache warp_shader_;
   ShaderCache composite_shader_;
 
-  std::unique_ptr<float> x_mesh_;
-  std::unique_ptr<float> y_mesh_;
+  MeshPlanes mesh_;
 
   // static per pixel stuff
   bool static_per_pixel_;
@@ -11,3 +11,56 @@
 // Underflow is obviously possible though.
 const double RenderItemDistanceMetric::NOT_COMPARABLE_VALUE
 	(1.0);
+
+namespace {
+inline bool kindMatches(RenderItem::Kind pattern, int kind) {
+	return pattern == RenderItem::kOther || pattern == kind;
+}
+}
+
+void MasterRenderItemDistance::addMetric(RenderItemDistanceMetric * fun) {
+	_metrics.push_back(fun);
+
+	for (int i = 0; i < RenderItem::kKindCount; i++)
+		for (int j = 0; j < RenderItem::kKindCount; j++) {
+			if (kindMatches(fun->lhsKind(), i) && kindMatches(fun->rhsKind(), j)) {
+				_table[i][j].metric = fun;
+				_table[i][j].swapped = false;
+			} else if (kindMatches(fun->lhsKind(), j) && kindMatches(fun->rhsKind(), i) &&
+			           (!_table[i][j].metric || _table[i][j].swapped)) {
+				_table[i][j].metric = fun;
+				_table[i][j].swapped = true;
+			}
+		}
+}
+
+void MasterRenderItemDistance::computeDistances(const RenderItem * const * lhs, std::size_t lhsCount,
+                                                const RenderItem * const * rhs, std::size_t rhsCount,
+                                                float * out, std::size_t stride) const {
+	if (lhsCount == 0 || rhsCount == 0)
+		return;
+
+	const RenderItem::Kind lhsKind = lhs[0]->kind();
+	const RenderItem::Kind rhsKind = rhs[0]->kind();
+	const Entry & entry = _table[lhsKind][rhsKind];
+
+	// Shape to shape is the common case; gather the positions once and compute whole
+	// rows in a loop the compiler can vectorize.
+	if (lhsKind == RenderItem::kShape && rhsKind == RenderItem::kShape &&
+	    (!entry.metric || typeid(*entry.metric) == typeid(ShapeXYDistance))) {
+		_x.resize(rhsCount);
+		_y.resize(rhsCount);
+		for (std::size_t j = 0; j < rhsCount; j++) {
+			_x[j] = static_cast<const Shape *>(rhs[j])->x;
+			_y[j] = static_cast<const Shape *>(rhs[j])->y;
+		}
+		for (std::size_t i = 0; i < lhsCount; i++)
+			ShapeXYDistance::computeDistances(static_cast<const Shape *>(lhs[i]), _x.data(), _y.data(),
+			                                  rhsCount, out + i * stride);
+		return;
+	}
+
+	for (std::size_t i = 0; i < lhsCount; i++)
+		for (std::size_t j = 0; j < rhsCount; j++)
+			out[i * stride + j] = computeDistance(lhs[i], rhs[j]);
+}
@@ -12,7 +12,7 @@
 #include "Renderable.hpp"
 #include <limits>
 #include <functional>
-#include <map>
+#include <vector>
 
 
 /// Compares two render items and returns zero if they are virtually equivalent and large values
@@ -22,7 +22,14 @@ public:
   virtual ~RenderItemDistanceMetric() { }
   const static double NOT_COMPARABLE_VALUE;
   virtual double operator()(const RenderItem * r1, const RenderItem * r2) const = 0;
-  virtual TypeIdPair typeIdPair() const = 0;
+
+  /// The kinds of render item this metric compares. RenderItem::kOther matches any kind.
+  virtual RenderItem::Kind lhsKind() const = 0;
+  virtual RenderItem::Kind rhsKind() const = 0;
+
+  /// Same as operator(), but trusts that r1 and r2 are of lhsKind() and rhsKind()
+  /// and skips the type checks.
+  virtual double distanceOfKinds(const RenderItem * r1, const RenderItem * r2) const = 0;
 };
 
 // A base class to construct render item distance metrics. Just specify your two concrete
@@ -51,8 +58,11 @@ inline bool supported(const RenderItem * r1, const RenderItem * r2) const {
 	//return typeid(r1) == typeid(const R1 *) && typeid(r2) == typeid(const R2 *);
 }
 
-inline TypeIdPair typeIdPair() const {
-	return TypeIdPair(typeid(const R1*).name(), typeid(const R2*).name());
+inline RenderItem::Kind lhsKind() const { return R1::kKind; }
+inline RenderItem::Kind rhsKind() const { return R2::kKind; }
+
+inline double distanceOfKinds(const RenderItem * r1, const RenderItem * r2) const {
+	return computeDistance(static_cast<const R1*>(r1), static_cast<const R2*>(r2));
 }
 
 };
@@ -89,6 +99,17 @@ public:
 	ShapeXYDistance() {}
 	virtual ~ShapeXYDistance() {}
 
+	/// Distances from one shape to many, given the x and y positions of the others.
+	static inline void computeDistances(const Shape * lhs, const float * x, const float * y, std::size_t count, float * out) {
+		const float lhsX = lhs->x;
+		const float lhsY = lhs->y;
+		for (std::size_t i = 0; i < count; i++) {
+			const float dx = lhsX - x[i];
+			const float dy = lhsY - y[i];
+			out[i] = (dx * dx + dy * dy) * 0.5f;
+		}
+	}
+
 protected:
 
 	virtual inline double computeDistance(const Shape * lhs, const Shape * rhs) const {
@@ -98,53 +119,67 @@ protected:
 };
 
 
+/// Dispatches to the metric registered for the kinds of the two items through a dense
+/// table indexed by RenderItem::Kind. Items of the same kind without a registered metric
+/// are equivalent (shapes fall back to ShapeXYDistance), items of different kinds are
+/// not comparable.
 class MasterRenderItemDistance : public RenderItemDistance<RenderItem, RenderItem> {
 
-typedef std::map<TypeIdPair, RenderItemDistanceMetric*> DistanceMetricMap;
 public:
 
 	MasterRenderItemDistance() {}
     virtual ~MasterRenderItemDistance() {
-        for (DistanceMetricMap::iterator it = _distanceMetricMap.begin(); it != _distanceMetricMap.end(); ++it)
-            delete (it->second);
-        _distanceMetricMap.clear();
+        for (RenderItemDistanceMetric * metric : _metrics)
+            delete metric;
+        _metrics.clear();
     }
 
-	inline void addMetric(RenderItemDistanceMetric * fun) {
-		_distanceMetricMap[fun->typeIdPair()] = fun;
-	}
+	/// Takes ownership of fun. A metric replaces earlier ones registered for the same
+	/// kinds; it also serves the swapped kinds unless a metric is registered for those.
+	void addMetric(RenderItemDistanceMetric * fun);
+
+	/// Fills out[i * stride + j] with the distance of lhs[i] to rhs[j]. All items of lhs
+	/// must be of one kind, as must all items of rhs.
+	void computeDistances(const RenderItem * const * lhs, std::size_t lhsCount,
+	                      const RenderItem * const * rhs, std::size_t rhsCount,
+	                      float * out, std::size_t stride) const;
 
 protected:
 	virtual inline double computeDistance(const RenderItem * lhs, const RenderItem * rhs) const {
 
-		RenderItemDistanceMetric * metric;
-
-		TypeIdPair pair(typeid(lhs), typeid(rhs));
-
+		const Entry & entry = _table[lhs->kind()][rhs->kind()];
 
 		// If specialized metric exists, use it to get higher granularity
 		// of correctness
-		if (_distanceMetricMap.count(pair)) {
-			metric = _distanceMetricMap[pair];
-		} else if (_distanceMetricMap.count(pair = TypeIdPair(typeid(rhs), typeid(lhs)))) {
-			metric = _distanceMetricMap[pair];
-		} else { // Failing that, use rtti && shape distance if its a shape type
-
-			const double rttiError = _rttiDistance(lhs,rhs);
-
-			/// @bug This is a non elegant approach to supporting shape distance
-			if (rttiError == 0 && _shapeXYDistance.supported(lhs,rhs))
-			   return _shapeXYDistance(lhs, rhs);
-			else return rttiError;
-		}
+		if (entry.metric)
+			return entry.swapped ? entry.metric->distanceOfKinds(rhs, lhs)
+			                     : entry.metric->distanceOfKinds(lhs, rhs);
 
-		return (*metric)(lhs, rhs);
+		if (lhs->kind() != rhs->kind())
+			return NOT_COMPARABLE_VALUE;
+		if (lhs->kind() == RenderItem::kShape)
+			return _shapeXYDistance.distanceOfKinds(lhs, rhs);
+		if (lhs->kind() == RenderItem::kOther)
+			return _rttiDistance.distanceOfKinds(lhs, rhs);
+		return 0.0;
 	}
 
 private:
-	mutable RTIRenderItemDistance _rttiDistance;
-	mutable ShapeXYDistance _shapeXYDistance;
-	mutable DistanceMetricMap _distanceMetricMap;
+	struct Entry {
+		Entry() : metric(0), swapped(false) {}
+		RenderItemDistanceMetric * metric;
+		/// The metric was registered for (rhs kind, lhs kind); pass the items in that order.
+		bool swapped;
+	};
+
+	RTIRenderItemDistance _rttiDistance;
+	ShapeXYDistance _shapeXYDistance;
+	std::vector<RenderItemDistanceMetric*> _metrics;
+	Entry _table[RenderItem::kKindCount][RenderItem::kKindCount];
+
+	/// Scratch positions for the batched shape distance.
+	mutable std::vector<float> _x;
+	mutable std::vector<float> _y;
 };
 
 #endif /* RenderItemDISTANCEMETRIC_H_ */
@@ -1,34 +1,143 @@
 #include "RenderItemMatcher.hpp"
+#include <algorithm>
 
-double RenderItemMatcher::computeMatching(const RenderItemList & lhs, const RenderItemList & rhs) const {
-        for (unsigned int i = 0; i < lhs.size();i++) {
-            unsigned int j;
-			for (j = 0; j < rhs.size();j++)
-				_weights[i][j] = _distanceFunction(lhs[i], rhs[j]);
-			for (; j < lhs.size();j++)
-				_weights[i][j] = RenderItemDistanceMetric::NOT_COMPARABLE_VALUE;
+void RenderItemMatcher::operator()(const RenderItemList & lhs, const RenderItemList & rhs) const {
+
+	_results.matches.clear();
+	_results.unmatchedLeft.clear();
+	_results.unmatchedRight.clear();
+	_results.error = 0;
+
+	_lhsGrouped.assign(lhs.size(), false);
+	_rhsGrouped.assign(rhs.size(), false);
+
+	// Items of different kinds are never comparable, so group both sides by kind and
+	// match each group on its own. This skips the distance function for every cross
+	// kind pair and keeps the cost matrices small.
+	for (unsigned int i = 0; i < lhs.size(); i++) {
+		if (_lhsGrouped[i])
+			continue;
+
+		const RenderItem::Kind kind = lhs[i]->kind();
+
+		_lhsGroup.clear();
+		for (unsigned int k = i; k < lhs.size(); k++) {
+			if (!_lhsGrouped[k] && lhs[k]->kind() == kind) {
+				_lhsGrouped[k] = true;
+				_lhsGroup.push_back(lhs[k]);
+			}
+		}
+
+		_rhsGroup.clear();
+		for (unsigned int j = 0; j < rhs.size(); j++) {
+			if (!_rhsGrouped[j] && rhs[j]->kind() == kind) {
+				_rhsGrouped[j] = true;
+				_rhsGroup.push_back(rhs[j]);
+			}
 		}
 
-		
-		const double error = _hungarianMethod(_weights, lhs.size());
-		//std::cout << "[computeMatching] total error is " << error << std::endl;
-		return error;
+		_results.error += computeMatching();
+		setMatches();
+	}
+
+	// Kinds that only occur on the right-hand side.
+	for (unsigned int j = 0; j < rhs.size(); j++) {
+		if (!_rhsGrouped[j]) {
+			_results.unmatchedRight.push_back(rhs[j]);
+			_results.error += RenderItemDistanceMetric::NOT_COMPARABLE_VALUE;
+		}
+	}
 }
 
+double RenderItemMatcher::computeMatching() const {
+
+	const float notComparable = RenderItemDistanceMetric::NOT_COMPARABLE_VALUE;
+
+	// Pad to a square matrix; padding rows/columns stand for "no partner".
+	_groupSize = std::max(_lhsGroup.size(), _rhsGroup.size());
+	_weights.assign(_groupSize * _groupSize, notComparable);
+
+	_distanceFunction.computeDistances(_lhsGroup.data(), _lhsGroup.size(),
+	                                   _rhsGroup.data(), _rhsGroup.size(),
+	                                   _weights.data(), _groupSize);
 
+	_matching.assign(_groupSize, -1);
 
-void RenderItemMatcher::setMatches
-	(const RenderItemList & lhs_src, const RenderItemList & rhs_src) const {
+	if (_groupSize <= MAXIMUM_HUNGARIAN_SIZE) {
+		// The hungarian method maximizes the total weight, we want the smallest total
+		// distance. Negation is exact, so the distances are restored afterwards.
+		for (float & weight : _weights)
+			weight = -weight;
+		_hungarianMethod(_weights.data(), _groupSize);
+		for (float & weight : _weights)
+			weight = -weight;
 
-      for (unsigned int i = 0; i < lhs_src.size();i++) {
-		const int j = _hungarianMethod.matching(i);
+		for (unsigned int i = 0; i < _groupSize; i++)
+			_matching[i] = _hungarianMethod.matching(i);
+	} else {
+		computeGreedyMatching();
+	}
+
+	double error = 0;
+	unsigned int matched = 0;
+	for (unsigned int i = 0; i < _lhsGroup.size(); i++) {
+		const int j = _matching[i];
+		if (j >= 0 && j < static_cast<int>(_rhsGroup.size()) && _weights[i * _groupSize + j] < notComparable) {
+			error += _weights[i * _groupSize + j];
+			matched++;
+		}
+	}
+	error += (_groupSize - matched) * RenderItemDistanceMetric::NOT_COMPARABLE_VALUE;
+
+	//std::cout << "[computeMatching] total error is " << error << std::endl;
+	return error;
+}
+
+/// Pairs the closest comparable items first. Not optimal, but O(n^2 log n).
+void RenderItemMatcher::computeGreedyMatching() const {
+
+	const float notComparable = RenderItemDistanceMetric::NOT_COMPARABLE_VALUE;
+
+	_candidates.clear();
+	for (unsigned int i = 0; i < _lhsGroup.size(); i++)
+		for (unsigned int j = 0; j < _rhsGroup.size(); j++)
+			if (_weights[i * _groupSize + j] < notComparable)
+				_candidates.push_back(std::make_pair(_weights[i * _groupSize + j], static_cast<int>(i * _groupSize + j)));
+
+	std::sort(_candidates.begin(), _candidates.end());
+
+	_rhsMatched.assign(_rhsGroup.size(), false);
+	for (const auto & candidate : _candidates) {
+		const int i = candidate.second / _groupSize;
+		const int j = candidate.second % _groupSize;
+		if (_matching[i] < 0 && !_rhsMatched[j]) {
+			_matching[i] = j;
+			_rhsMatched[j] = true;
+		}
+	}
+}
+
+
+
+void RenderItemMatcher::setMatches() const {
+
+      _rhsMatched.assign(_rhsGroup.size(), false);
+
+      for (unsigned int i = 0; i < _lhsGroup.size();i++) {
+		const int j = _matching[i];
+		const bool comparable = j >= 0 && j < static_cast<int>(_rhsGroup.size()) &&
+			_weights[i * _groupSize + j] < RenderItemDistanceMetric::NOT_COMPARABLE_VALUE;
 
 		// hack
-		if (true || _weights[i][j] == RenderItemDistanceMetric::NOT_COMPARABLE_VALUE) {
- 			_results.unmatchedLeft.push_back(lhs_src[i]);
-			_results.unmatchedRight.push_back(rhs_src[i]);
+		if (true || !comparable) {
+ 			_results.unmatchedLeft.push_back(_lhsGroup[i]);
 		} else {
-		    _results.matches.push_back(std::make_pair(lhs_src[i], rhs_src[j]));
+		    _results.matches.push_back(std::make_pair(_lhsGroup[i], _rhsGroup[j]));
+		    _rhsMatched[j] = true;
 		}
 	  }
+
+      for (unsigned int j = 0; j < _rhsGroup.size(); j++)
+		if (!_rhsMatched[j])
+			_results.unmatchedRight.push_back(_rhsGroup[j]);
 }
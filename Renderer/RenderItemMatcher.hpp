@@ -30,47 +30,52 @@ struct MatchResults {
   double error;
 };
 
-	static const std::size_t MAXIMUM_SET_SIZE = 1000;
+	/// Groups with more items than this on either side are matched greedily; the
+	/// hungarian method is O(n^3) in the group size.
+	static const std::size_t MAXIMUM_HUNGARIAN_SIZE = 64;
 
-	/// Computes an optimal matching between two renderable item sets.
+	/// Computes a matching between two renderable item sets. Only items of the same
+	/// kind (see RenderItem::Kind) are paired, so each kind is matched separately on a
+	/// cost matrix sized to that kind's item counts.
 	/// @param lhs the "left-hand side" list of render items.
 	/// @param rhs the "right-hand side" list of render items.
-	/// Sets a list of match pairs, possibly self referencing, and an error estimate of the matching.
-	inline virtual void operator()(const RenderItemList & lhs, const RenderItemList & rhs) const {
-		
-		// Ensure the first argument is greater than next to aid the helper function's logic.
-		if (lhs.size() >= rhs.size()) {
-		  _results.error = computeMatching(lhs, rhs);
-		  setMatches(lhs, rhs);
-		} else {
-		  _results.error = computeMatching(rhs, lhs);
-		  setMatches(rhs, lhs);
-		}
-		
-	
-	}
-
-	RenderItemMatcher() {}
+	/// Sets a list of match pairs and an error estimate of the matching: the sum of the
+	/// matched distances plus NOT_COMPARABLE_VALUE for every item left without a partner
+	/// on the larger side of each group.
+	void operator()(const RenderItemList & lhs, const RenderItemList & rhs) const;
+
+	RenderItemMatcher() : _groupSize(0) {}
 	virtual ~RenderItemMatcher() {}
 
 	inline MatchResults & matchResults() { return _results; }
 
-	inline double weight(int i, int j) const { return _weights[i][j]; }
-
 	MasterRenderItemDistance & distanceFunction() { return _distanceFunction; }
 
 private:
-	mutable HungarianMethod<MAXIMUM_SET_SIZE> _hungarianMethod;
-	mutable double _weights[MAXIMUM_SET_SIZE][MAXIMUM_SET_SIZE];
+	mutable HungarianMethod _hungarianMethod;
+
+	/// Row major cost matrix of the group being matched, _groupSize x _groupSize.
+	mutable std::vector<float> _weights;
+	mutable std::size_t _groupSize;
+
+	/// Items of the group being matched, and the column matched to each row.
+	mutable std::vector<RenderItem*> _lhsGroup;
+	mutable std::vector<RenderItem*> _rhsGroup;
+	mutable std::vector<int> _matching;
+	mutable std::vector<char> _rhsMatched;
+	mutable std::vector<std::pair<float, int> > _candidates;
+	mutable std::vector<char> _lhsGrouped;
+	mutable std::vector<char> _rhsGrouped;
 
 	mutable MatchResults _results;
 
 	/// @idea interface this entirely allow overriding of its type.
 	mutable MasterRenderItemDistance _distanceFunction;
-	
-	double computeMatching(const RenderItemList & lhs, const RenderItemList & rhs) const;
 
-	void setMatches(const RenderItemList & lhs_src, const RenderItemList & rhs_src) const;
+	double computeMatching() const;
+	void computeGreedyMatching() const;
+
+	void setMatches() const;
 
 };
 
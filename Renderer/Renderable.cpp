@@ -21,9 +21,12 @@ RenderContext::RenderContext()
     : time(0),
       texsize(kDefaultTextureSize),
       aspectRatio(1),
-      aspectCorrect(false){};
+      aspectCorrect(false),
+      pcmSnapshot(nullptr){};
 
-RenderItem::RenderItem() : masterAlpha(1) {}
+RenderItem::RenderItem() : masterAlpha(1), kind_(kOther) {}
+
+RenderItem::RenderItem(Kind kind) : masterAlpha(1), kind_(kind) {}
 
 void RenderItem::Init() {
   glGenVertexArrays(1, &m_vaoID);
@@ -43,11 +46,11 @@ RenderItem::~RenderItem() {
   glDeleteVertexArrays(1, &m_vaoID);
 }
 
-DarkenCenter::DarkenCenter() : RenderItem() { Init(); }
+DarkenCenter::DarkenCenter() : RenderItem(kKind) { Init(); }
 
-MotionVectors::MotionVectors() : RenderItem() { Init(); }
+MotionVectors::MotionVectors() : RenderItem(kKind) { Init(); }
 
-Border::Border() : RenderItem() { Init(); }
+Border::Border() : RenderItem(kKind) { Init(); }
 
 void DarkenCenter::InitVertexAttrib() {
   constexpr int kSubdivisions = 12;
@@ -97,7 +100,7 @@ void DarkenCenter::Draw(RenderContext &context) {
   glBindVertexArray(0);
 }
 
-Shape::Shape() : RenderItem() {
+Shape::Shape() : RenderItem(kKind) {
   sides = 4;
   thickOutline = false;
   enabled = true;
@@ -190,7 +193,8 @@ void Shape::Draw(RenderContext &context) {
   xval = x;
   yval = -(y - 1);
 
-  struct_data *buffer_data = new struct_data[sides + 2];
+  buffer_data_.resize(sides + 2);
+  struct_data *buffer_data = buffer_data_.data();
 
   if (textured) {
     if (!texture_and_sampler.has_value() && !imageUrl.empty()) {
@@ -298,7 +302,8 @@ void Shape::Draw(RenderContext &context) {
     glBindVertexArray(0);
   }
 
-  floatPair *points = new float[sides + 1][2];
+  points_.resize(2 * (sides + 1));
+  floatPair *points = reinterpret_cast<floatPair *>(points_.data());
 
   for (int i = 0; i < sides; i++) {
     t = (i - 1) / (float)sides;
@@ -341,9 +346,6 @@ void Shape::Draw(RenderContext &context) {
     glLineWidth(context.texsize < kDefaultTextureSize
                     ? 1
                     : context.texsize / kDefaultTextureSize);
-
-  delete[] buffer_data;
-  delete[] points;
 }
 
 void MotionVectors::InitVertexAttrib() {
@@ -361,7 +363,8 @@ void MotionVectors::Draw(RenderContext &context) {
   if (x_num + y_num < 600) {
     int size = x_num * y_num;
 
-    floatPair *points = new float[size][2];
+    points_.resize(2 * size);
+    floatPair *points = reinterpret_cast<floatPair *>(points_.data());
 
     for (int x = 0; x < (int)x_num; x++) {
       for (int y = 0; y < (int)y_num; y++) {
@@ -383,8 +386,6 @@ void MotionVectors::Draw(RenderContext &context) {
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    delete[] points;
-
     glUseProgram(StaticShaders::Get()->program_v2f_c4f_->GetId());
 
     glUniformMatrix4fv(
@@ -10,6 +10,7 @@
 #include "projectM-opengl.h"
 
 class BeatDetect;
+class PCMSnapshot;
 
 class ColoredPoint {
  public:
@@ -33,6 +34,8 @@ class RenderContext {
   float aspectRatio;
   bool aspectCorrect;
   BeatDetect *beatDetect;
+  // The frame's audio; render items read it instead of the live PCM.
+  PCMSnapshot *pcmSnapshot;
   std::shared_ptr<TextureManager> texture_manager_;
   glm::mat4 mat_ortho;
 
@@ -41,6 +44,26 @@ class RenderContext {
 
 class RenderItem {
  public:
+  // Small integer tag naming the class of an item, so distance metrics can be
+  // looked up by index instead of by RTTI. Derived classes inherit the kind of
+  // the nearest class that declares one; kOther matches any item.
+  enum Kind {
+    kOther = 0,
+    kDarkenCenter,
+    kShape,
+    kMotionVectors,
+    kBorder,
+    kWaveform,
+    kMilkdropWaveform,
+    kVideoEcho,
+    kBrighten,
+    kDarken,
+    kInvert,
+    kSolarize,
+    kKindCount
+  };
+  static constexpr Kind kKind = kOther;
+
   RenderItem();
   ~RenderItem();
 
@@ -48,17 +71,26 @@ class RenderItem {
   virtual void InitVertexAttrib() = 0;
   virtual void Draw(RenderContext &context) = 0;
 
+  Kind kind() const { return kind_; }
+
  protected:
+  explicit RenderItem(Kind kind);
+
   virtual void Init();
 
   GLuint m_vboID;
   GLuint m_vaoID;
+
+ private:
+  Kind kind_;
 };
 
 typedef std::vector<RenderItem *> RenderItemList;
 
 class DarkenCenter : public RenderItem {
  public:
+  static constexpr Kind kKind = kDarkenCenter;
+
   DarkenCenter();
   void InitVertexAttrib();
   void Draw(RenderContext &context);
@@ -66,6 +98,8 @@ class DarkenCenter : public RenderItem {
 
 class Shape : public RenderItem {
  public:
+  static constexpr Kind kKind = kShape;
+
   std::string imageUrl;
   int sides;
   bool thickOutline;
@@ -120,12 +154,18 @@ class Shape : public RenderItem {
   GLuint m_vaoID_not_texture;
 
   std::optional<TextureManager::TextureAndSampler> texture_and_sampler;
+
+  // Scratch vertex storage, kept between frames so drawing does not allocate.
+  std::vector<struct_data> buffer_data_;
+  std::vector<float> points_;
 };
 
 class Text : RenderItem {};
 
 class MotionVectors : public RenderItem {
  public:
+  static constexpr Kind kKind = kMotionVectors;
+
   float r;
   float g;
   float b;
@@ -139,10 +179,16 @@ class MotionVectors : public RenderItem {
   void InitVertexAttrib();
   void Draw(RenderContext &context);
   MotionVectors();
+
+ private:
+  // Scratch vertex storage, kept between frames so drawing does not allocate.
+  std::vector<float> points_;
 };
 
 class Border : public RenderItem {
  public:
+  static constexpr Kind kKind = kBorder;
+
   float outer_size;
   float outer_r;
   float outer_g;
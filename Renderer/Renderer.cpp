@@ -135,7 +135,7 @@ void Renderer::drawText(GLTtext* text, const char* string, GLfloat x, GLfloat y,
 
 Renderer::Renderer(int width, int height, int gx, int gy, BeatDetect* _beatDetect, std::string _presetURL,
                    std::string _titlefontURL, std::string _menufontURL, const std::string& datadir, std::function<void()> activateCompileContext, std::function<void()> deactivateCompileContext) :
-	mesh(gx, gy), m_presetName("None"), m_datadir(datadir), vw(width), vh(height),
+	mesh(gx, gy), m_presetName("None"), m_datadir(datadir), m_shadersUpdated(false), vw(width), vh(height),
 	title_fontURL(_titlefontURL), menu_fontURL(_menufontURL), presetURL(_presetURL)
 {
 	this->totalframes = 1;
@@ -144,6 +144,7 @@ Renderer::Renderer(int width, int height, int gx, int gy, BeatDetect* _beatDetec
 	this->lastTimeToast = nowMilliseconds();
 	this->currentTimeToast = nowMilliseconds();
 	this->noSwitch = false;
+	this->lowPrecisionBlur = false;
 	this->showfps = false;
 	this->showtoast = false;
 	this->showtitle = false;
@@ -320,6 +321,7 @@ void Renderer::RenderItems(const Pipeline& pipeline, const PipelineContext& pipe
 	renderContext.aspectRatio = aspect;
 	renderContext.texture_manager_ = texture_manager_;
 	renderContext.beatDetect = beatDetect;
+	renderContext.pcmSnapshot = &beatDetect->pcmSnapshot;
 
     for(auto& drawable : pipeline.drawables) {
         if (drawable != nullptr) {
@@ -391,6 +393,7 @@ void Renderer::RenderFrame(const Pipeline& pipeline,
 
 void Renderer::RenderFrameOnlyPass1(const Pipeline& pipeline, const PipelineContext& pipelineContext)
 {
+	m_shadersUpdated = shaderEngine->PollCompiledShaders(*currentPipe);
 	shaderEngine->RenderBlurTextures(pipeline, pipelineContext);
 
 	SetupPass1(pipeline, pipelineContext);
@@ -437,18 +440,23 @@ void Renderer::Interpolation(const Pipeline& pipeline, const PipelineContext& pi
 
 	if (pipeline.static_per_pixel())
 	{
-		for (int j = 0; j < mesh.height - 1; j++)
+		assert(pipeline.mesh_width() == mesh.width && pipeline.mesh_height() == mesh.height);
+		const int stride = pipeline.mesh_stride();
+
+		// the pipeline stores the mesh column by column, so walk it that way
+		for (int i = 0; i < mesh.width; i++)
 		{
-			int base = j * mesh.width * 2 * 4;
+			const float *x_mesh = pipeline.x_mesh() + i * stride;
+			const float *y_mesh = pipeline.y_mesh() + i * stride;
+			float *strip = pixel_mesh_.get() + i * 8;
 
-			for (int i = 0; i < mesh.width; i++)
+			for (int j = 0; j < mesh.height - 1; j++, strip += mesh.width * 2 * 4)
 			{
-				int strip = base + i * 8;
-				pixel_mesh_.get()[strip + 2] = pipeline.x_mesh_at(i, j);
-				pixel_mesh_.get()[strip + 3] = pipeline.y_mesh_at(i, j);
+				strip[2] = x_mesh[j];
+				strip[3] = y_mesh[j];
 
-				pixel_mesh_.get()[strip + 6] = pipeline.x_mesh_at(i, j + 1);
-				pixel_mesh_.get()[strip + 7] = pipeline.y_mesh_at(i, j + 1);
+				strip[6] = x_mesh[j + 1];
+				strip[7] = y_mesh[j + 1];
 			}
 		}
 	}
@@ -549,7 +557,8 @@ void Renderer::reset(int w, int h)
 
 	InitCompositeShaderVertex();
 
-	texture_manager_ = std::make_shared< TextureManager>(presetURL, texsizeX, texsizeY, m_datadir);
+	texture_manager_ = std::make_shared< TextureManager>(presetURL, texsizeX, texsizeY, m_datadir,
+	                                                     lowPrecisionBlur ? GL_RGB565 : GL_RGB);
 
 	shaderEngine->setParams(texsizeX, texsizeY, beatDetect, texture_manager_);
 	shaderEngine->LoadPresetShadersAsync(*currentPipe, m_presetName);
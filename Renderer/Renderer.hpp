@@ -59,6 +59,8 @@ public:
 
   bool studio;
   bool correction;
+  // Store blur textures as RGB565. Takes effect on the next reset().
+  bool lowPrecisionBlur;
 
   bool noSwitch;
 
@@ -121,6 +123,15 @@ public:
   std::string toastMessage() const {
     return m_toastMessage;
   }
+
+  /// True if the last RenderFrameOnlyPass1() swapped in shaders the compile
+  /// worker had finished
+  bool shadersUpdated() const { return m_shadersUpdated; }
+
+  /// True if text is drawn over the frame
+  bool drawsText() const {
+    return showtoast || showfps || showtitle || showpreset || showhelp || showstats;
+  }
   
 private:
 
@@ -146,6 +157,7 @@ private:
   std::string m_datadir;
   std::string m_fps;
   std::string m_toastMessage;
+  bool m_shadersUpdated;
 
   std::shared_ptr<float> pixel_mesh_;
 
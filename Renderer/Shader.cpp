@@ -106,6 +106,8 @@ Shader::CompileShaderProgram(std::string vertex_shader_code,
 
   glAttachShader(shader_program_id, vertex_shader_id);
   glAttachShader(shader_program_id, fragment_shader_id);
+  glProgramParameteri(shader_program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                      GL_TRUE);
 
   auto cleanup_fn = [&](void *) {
     glDetachShader(shader_program_id, vertex_shader_id);
@@ -126,3 +128,36 @@ Shader::CompileShaderProgram(std::string vertex_shader_code,
 
   return std::shared_ptr<Shader>(new Shader(shader_program_id));
 }
+
+std::shared_ptr<Shader>
+Shader::LoadShaderProgramBinary(GLenum binary_format,
+                                const std::vector<char> &binary) {
+  GLuint shader_program_id = glCreateProgram();
+  glProgramBinary(shader_program_id, binary_format, binary.data(),
+                  binary.size());
+
+  GLint program_linked;
+  glGetProgramiv(shader_program_id, GL_LINK_STATUS, &program_linked);
+  if (program_linked != GL_TRUE) {
+    glDeleteProgram(shader_program_id);
+    return nullptr;
+  }
+
+  return std::shared_ptr<Shader>(new Shader(shader_program_id));
+}
+
+bool Shader::GetProgramBinary(GLenum *binary_format,
+                              std::vector<char> *binary) const {
+  GLint length = 0;
+  glGetProgramiv(shader_program_id_, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return false;
+  }
+
+  binary->resize(length);
+  GLsizei written = 0;
+  glGetProgramBinary(shader_program_id_, length, &written, binary_format,
+                     binary->data());
+  binary->resize(written);
+  return written > 0;
+}
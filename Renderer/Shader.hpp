@@ -4,6 +4,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "Texture.hpp"
 #include "TextureManager.hpp"
@@ -18,6 +19,17 @@ public:
                        std::string fragment_shader_code,
                        std::string_view shader_type_string);
 
+  // Creates a `Shader` from a binary previously returned by
+  // `GetProgramBinary`. Returns `nullptr` if the driver rejects the binary,
+  // which it may do at any time, e.g. after a driver update.
+  static std::shared_ptr<Shader>
+  LoadShaderProgramBinary(GLenum binary_format,
+                          const std::vector<char> &binary);
+
+  // Retrieves the linked program in the driver's binary format. Returns false
+  // if the driver does not provide one.
+  bool GetProgramBinary(GLenum *binary_format, std::vector<char> *binary) const;
+
   ~Shader() { glDeleteProgram(shader_program_id_); }
 
   GLuint GetId() const { return shader_program_id_; }
@@ -18,6 +18,7 @@
 #include "GLSLGenerator.h"
 #include "HLSLParser.h"
 #include "StaticGlShaders.h"
+#include "ShaderTranspileCache.hpp"
 #include "StaticShaders.hpp"
 #include "Texture.hpp"
 
@@ -27,11 +28,14 @@ constexpr GLuint kDefaultNoiseTextureSamplingMode = GL_REPEAT;
 
 ShaderEngine::ShaderEngine(std::function<void()> activateCompileContext,
                            std::function<void()> deactivateCompileContext)
-    : activate_compile_context_(activateCompileContext),
+    : blur_levels_(0),
+      activate_compile_context_(activateCompileContext),
       deactivate_compile_context_(deactivateCompileContext),
-      compile_complete_(true) {
-  // TODO: This is a complete hack to get the static shaders set up before we
-  // call `enable*`.
+      compile_generation_(0),
+      compile_result_(nullptr),
+      stop_compile_worker_(false) {
+  // Build the static programs now, during init, rather than in the middle of
+  // the first frames that draw with them.
   StaticShaders::Get();
 
   // Initialize Blur vao/vbo
@@ -57,9 +61,18 @@ ShaderEngine::ShaderEngine(std::function<void()> activateCompileContext,
 
   glBindVertexArray(0);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  compile_worker_ = std::thread(&ShaderEngine::CompileWorker, this);
 }
 
 ShaderEngine::~ShaderEngine() {
+  {
+    std::lock_guard<std::mutex> lock(compile_queue_mutex_);
+    stop_compile_worker_ = true;
+  }
+  compile_queue_cv_.notify_one();
+  compile_worker_.join();
+
   glDeleteBuffers(1, &vboBlur);
   glDeleteVertexArrays(1, &vaoBlur);
 }
@@ -159,6 +172,114 @@ bool ApplyHlslShaderSourceTransformations(
   return true;
 }
 
+// Preprocesses and parses the transformed HLSL source and generates GLSL for
+// it, declaring the samplers in `shader`. Returns false on failure.
+bool TranspileHlslToGlsl(const std::string &shaderTypeString,
+                         const std::string &shader_filename,
+                         const std::string &transformed_hlsl_source,
+                         const ShaderCache &new_shader,
+                         std::string *glsl_source) {
+  M4::GLSLGenerator generator;
+  M4::Allocator allocator;
+
+  M4::HLSLTree tree(&allocator);
+  M4::HLSLParser parser(&allocator, &tree);
+
+  // preprocess define macros
+  std::string sourcePreprocessed;
+  if (!parser.ApplyPreprocessor(
+          shader_filename.c_str(), transformed_hlsl_source.c_str(),
+          transformed_hlsl_source.size(), sourcePreprocessed)) {
+    std::cerr << "Failed to preprocess HLSL(step1) " << shaderTypeString
+              << " shader" << std::endl;
+
+#if !DUMP_SHADERS_ON_ERROR
+    std::cerr << "Source: " << std::endl
+              << transformed_hlsl_source << std::endl;
+#else
+    std::ofstream out("/tmp/shader_" + shaderTypeString + "_step1.txt");
+    out << transformed_hlsl_source;
+    out.close();
+#endif
+    return false;
+  }
+
+  // Remove previous shader declarations
+  std::smatch matches;
+  while (std::regex_search(sourcePreprocessed, matches,
+                           std::regex("sampler(2D|3D|)(\\s+|\\().*"))) {
+    sourcePreprocessed.replace(matches.position(), matches.length(), "");
+  }
+
+  // Remove previous texsize declarations
+  while (std::regex_search(sourcePreprocessed, matches,
+                           std::regex("float4\\s+texsize_.*"))) {
+    sourcePreprocessed.replace(matches.position(), matches.length(), "");
+  }
+
+  // Declare samplers
+  std::set<std::string> texsizes;
+  for (auto &k_v : new_shader.textures_and_samplers) {
+    auto texture = k_v.second.texture;
+
+    if (texture->GetType() == GL_TEXTURE_3D) {
+      sourcePreprocessed.insert(
+          0, "uniform sampler3D sampler_" + k_v.first + ";\n");
+    } else {
+      sourcePreprocessed.insert(
+          0, "uniform sampler2D sampler_" + k_v.first + ";\n");
+    }
+
+    texsizes.insert(k_v.first);
+    texsizes.insert(std::string(texture->GetName()));
+  }
+
+  // Declare texsizes
+  std::set<std::string>::const_iterator iter_texsizes = texsizes.cbegin();
+  for (; iter_texsizes != texsizes.cend(); ++iter_texsizes) {
+    sourcePreprocessed.insert(
+        0, "uniform float4 texsize_" + *iter_texsizes + ";\n");
+  }
+
+  // transpile from HLSL (aka preset shader aka directX shader) to GLSL (aka
+  // OpenGL shader lang)
+
+  // parse
+  if (!parser.Parse(shader_filename.c_str(), sourcePreprocessed.c_str(),
+                    sourcePreprocessed.size())) {
+    std::cerr << "Failed to parse HLSL(step2) " << shaderTypeString << " shader"
+              << std::endl;
+
+#if !DUMP_SHADERS_ON_ERROR
+    std::cerr << "Source: " << std::endl << sourcePreprocessed << std::endl;
+#else
+    std::ofstream out2("/tmp/shader_" + shaderTypeString + "_step2.txt");
+    out2 << sourcePreprocessed;
+    out2.close();
+#endif
+    return false;
+  }
+
+  // generate GLSL
+  if (!generator.Generate(&tree, M4::GLSLGenerator::Target_FragmentShader,
+                          StaticGlShaders::Get()->GetGlslGeneratorVersion(),
+                          "PS")) {
+    std::cerr << "Failed to transpile HLSL(step3) " << shaderTypeString
+              << " shader to GLSL" << std::endl;
+#if !DUMP_SHADERS_ON_ERROR
+    std::cerr << "Source: " << std::endl << sourcePreprocessed << std::endl;
+#else
+    std::ofstream out2("/tmp/shader_" + shaderTypeString + "_step2.txt");
+    out2 << sourcePreprocessed;
+    out2.close();
+#endif
+    return false;
+  }
+
+  *glsl_source = generator.GetResult();
+  return true;
+}
+
 // Transpile a user-defined HLSL shader from a preset into GLSL, and then
 // compile the GLSL into a Shader object. returns a shared pointer to a valid
 // Shader if successful.
@@ -300,101 +421,32 @@ std::shared_ptr<Shader> TranspilePresetShader(
       shaderTypeString = "Other";
   }
 
-  M4::GLSLGenerator generator;
-  M4::Allocator allocator;
-
-  M4::HLSLTree tree(&allocator);
-  M4::HLSLParser parser(&allocator, &tree);
-
-  // preprocess define macros
-  std::string sourcePreprocessed;
-  if (!parser.ApplyPreprocessor(
-          shader_filename.c_str(), transformed_hlsl_source.c_str(),
-          transformed_hlsl_source.size(), sourcePreprocessed)) {
-    std::cerr << "Failed to preprocess HLSL(step1) " << shaderTypeString
-              << " shader" << std::endl;
-
-#if !DUMP_SHADERS_ON_ERROR
-    std::cerr << "Source: " << std::endl
-              << transformed_hlsl_source << std::endl;
-#else
-    std::ofstream out("/tmp/shader_" + shaderTypeString + "_step1.txt");
-    out << transformed_hlsl_source;
-    out.close();
-#endif
-    return nullptr;
-  }
-
-  // Remove previous shader declarations
-  std::smatch matches;
-  while (std::regex_search(sourcePreprocessed, matches,
-                           std::regex("sampler(2D|3D|)(\\s+|\\().*"))) {
-    sourcePreprocessed.replace(matches.position(), matches.length(), "");
-  }
-
-  // Remove previous texsize declarations
-  while (std::regex_search(sourcePreprocessed, matches,
-                           std::regex("float4\\s+texsize_.*"))) {
-    sourcePreprocessed.replace(matches.position(), matches.length(), "");
-  }
-
-  // Declare samplers
-  std::set<std::string> texsizes;
+  // The generated GLSL depends on the transformed source, the declared
+  // samplers and the GLSL target; anything else is only used for logging. The
+  // cache adds the version of the transpiler itself.
+  std::stringstream cache_key;
+  cache_key << static_cast<int>(shader_type) << '\n'
+            << static_cast<int>(
+                   StaticGlShaders::Get()->GetGlslGeneratorVersion())
+            << '\n';
   for (auto &k_v : new_shader.textures_and_samplers) {
-    auto texture = k_v.second.texture;
-
-    if (texture->GetType() == GL_TEXTURE_3D) {
-      sourcePreprocessed.insert(
-          0, "uniform sampler3D sampler_" + k_v.first + ";\n");
-    } else {
-      sourcePreprocessed.insert(
-          0, "uniform sampler2D sampler_" + k_v.first + ";\n");
-    }
-
-    texsizes.insert(k_v.first);
-    texsizes.insert(std::string(texture->GetName()));
+    cache_key << k_v.first << ' ' << k_v.second.texture->GetType() << ' '
+              << k_v.second.texture->GetName() << '\n';
   }
+  cache_key << transformed_hlsl_source;
 
-  // Declare texsizes
-  std::set<std::string>::const_iterator iter_texsizes = texsizes.cbegin();
-  for (; iter_texsizes != texsizes.cend(); ++iter_texsizes) {
-    sourcePreprocessed.insert(
-        0, "uniform float4 texsize_" + *iter_texsizes + ";\n");
-  }
-
-  // transpile from HLSL (aka preset shader aka directX shader) to GLSL (aka
-  // OpenGL shader lang)
-
-  // parse
-  if (!parser.Parse(shader_filename.c_str(), sourcePreprocessed.c_str(),
-                    sourcePreprocessed.size())) {
-    std::cerr << "Failed to parse HLSL(step2) " << shaderTypeString << " shader"
-              << std::endl;
-
-#if !DUMP_SHADERS_ON_ERROR
-    std::cerr << "Source: " << std::endl << sourcePreprocessed << std::endl;
-#else
-    std::ofstream out2("/tmp/shader_" + shaderTypeString + "_step2.txt");
-    out2 << sourcePreprocessed;
-    out2.close();
-#endif
-    return nullptr;
-  }
-
-  // generate GLSL
-  if (!generator.Generate(&tree, M4::GLSLGenerator::Target_FragmentShader,
-                          StaticGlShaders::Get()->GetGlslGeneratorVersion(),
-                          "PS")) {
-    std::cerr << "Failed to transpile HLSL(step3) " << shaderTypeString
-              << " shader to GLSL" << std::endl;
-#if !DUMP_SHADERS_ON_ERROR
-    std::cerr << "Source: " << std::endl << sourcePreprocessed << std::endl;
-#else
-    std::ofstream out2("/tmp/shader_" + shaderTypeString + "_step2.txt");
-    out2 << sourcePreprocessed;
-    out2.close();
-#endif
-    return nullptr;
+  std::string glsl_source;
+  std::optional<std::string> cached_glsl_source =
+      ShaderTranspileCache::Get()->FindGlsl(cache_key.str());
+  if (cached_glsl_source.has_value()) {
+    glsl_source = std::move(*cached_glsl_source);
+  } else {
+    if (!TranspileHlslToGlsl(shaderTypeString, shader_filename,
+                             transformed_hlsl_source, new_shader,
+                             &glsl_source)) {
+      return nullptr;
+    }
+    ShaderTranspileCache::Get()->InsertGlsl(cache_key.str(), glsl_source);
   }
 
   // now we have GLSL source for the preset shader program (hopefully it's
@@ -402,14 +454,12 @@ std::shared_ptr<Shader> TranspilePresetShader(
   // vertex shader and cross our fingers
   std::shared_ptr<Shader> return_shader;
   if (shader_type == ShaderEngine::PresentShaderType::PresentWarpShader) {
-    return_shader = Shader::CompileShaderProgram(
-        StaticGlShaders::Get()->GetPresetWarpVertexShader(),
-        generator.GetResult(),
+    return_shader = ShaderTranspileCache::Get()->CompileShaderProgram(
+        StaticGlShaders::Get()->GetPresetWarpVertexShader(), glsl_source,
         shaderTypeString);  // returns new program
   } else {
-    return_shader = Shader::CompileShaderProgram(
-        StaticGlShaders::Get()->GetPresetCompVertexShader(),
-        generator.GetResult(),
+    return_shader = ShaderTranspileCache::Get()->CompileShaderProgram(
+        StaticGlShaders::Get()->GetPresetCompVertexShader(), glsl_source,
         shaderTypeString);  // returns new program
   }
 
@@ -418,10 +468,10 @@ std::shared_ptr<Shader> TranspilePresetShader(
               << std::endl;
 
 #if !DUMP_SHADERS_ON_ERROR
-    std::cerr << "Source:" << std::endl << generator.GetResult() << std::endl;
+    std::cerr << "Source:" << std::endl << glsl_source << std::endl;
 #else
     std::ofstream out3("/tmp/shader_" + shaderTypeString + "_step3.txt");
-    out3 << generator.GetResult();
+    out3 << glsl_source;
     out3.close();
 #endif
     return nullptr;
@@ -602,56 +652,71 @@ void ShaderEngine::SetupShaderVariables(GLuint program,
   }
 }
 
+namespace {
+// Looks up `prefix` + `name` in `program` without allocating for the names
+// presets actually use.
+GLint GetPrefixedUniformLocation(GLuint program, const char *prefix,
+                                 std::string_view name) {
+  char buffer[128];
+  int length = snprintf(buffer, sizeof(buffer), "%s%.*s", prefix,
+                        static_cast<int>(name.size()), name.data());
+  if (length >= 0 && length < static_cast<int>(sizeof(buffer))) {
+    return glGetUniformLocation(program, buffer);
+  }
+  return glGetUniformLocation(program,
+                              (prefix + std::string(name)).c_str());
+}
+
+void SetTexsizeUniform(GLuint program, std::string_view name,
+                       const Texture &texture) {
+  GLint param = GetPrefixedUniformLocation(program, "texsize_", name);
+  if (param < 0) {
+    // unused uniform have been optimized out by glsl compiler
+    return;
+  }
+  glUniform4f(param, texture.GetWidth(), texture.GetHeight(),
+              1 / (float)texture.GetWidth(), 1 / (float)texture.GetHeight());
+}
+}  // namespace
+
+// Runs every frame, so it avoids building temporary strings and maps.
 void ShaderEngine::SetupTextures(GLuint program, const ShaderCache &shader) {
   unsigned int texNum = 0;
-  std::map<std::string, std::shared_ptr<Texture>> texsizes;
 
   // Set samplers
   for (auto &k_v : shader.textures_and_samplers) {
-    auto texture = k_v.second.texture;
-    auto sampler = k_v.second.sampler;
-
-    std::string samplerName = "sampler_" + k_v.first;
+    const auto &texture = k_v.second.texture;
+    const auto &sampler = k_v.second.sampler;
 
     // https://www.khronos.org/opengl/wiki/Sampler_(GLSL)#Binding_textures_to_samplers
-    GLint param = glGetUniformLocation(program, samplerName.c_str());
+    GLint param = GetPrefixedUniformLocation(program, "sampler_", k_v.first);
     if (param < 0) {
       // unused uniform have been optimized out by glsl compiler
       continue;
     }
 
-    texsizes[k_v.first] = texture;
-    texsizes[std::string(texture->GetName())] = texture;
-
     glActiveTexture(GL_TEXTURE0 + texNum);
     glBindTexture(texture->GetType(), texture->GetId());
     glBindSampler(texNum, sampler->GetId());
 
     glUniform1i(param, texNum);
     texNum++;
-  }
-
-  // Set texsizes
-  for (auto &k_v : texsizes) {
-    auto texture = k_v.second;
 
-    std::string texsizeName =
-        (std::stringstream() << "texsize_" << k_v.first).str();
-    GLint textSizeParam = glGetUniformLocation(program, texsizeName.c_str());
-    if (textSizeParam >= 0) {
-      glUniform4f(textSizeParam, texture->GetWidth(), texture->GetHeight(),
-                  1 / (float)texture->GetWidth(),
-                  1 / (float)texture->GetHeight());
-    } else {
-      // unused uniform have been optimized out by glsl compiler
-      continue;
-    }
+    // Set texsizes, both under the sampler name and the texture name.
+    SetTexsizeUniform(program, k_v.first, *texture);
+    SetTexsizeUniform(program, texture->GetName(), *texture);
   }
 }
 
 void ShaderEngine::RenderBlurTextures(const Pipeline &pipeline,
                                       const PipelineContext &pipelineContext) {
-  unsigned int passes = 6;
+  // Each level is a horizontal and a vertical pass, and each level reads the
+  // one before it, so only the chain up to the deepest sampled level is
+  // needed.
+  const unsigned int passes = 2 * blur_levels_;
+  if (passes == 0) {
+    return;
+  }
 
   const float w[8] = {4.0f, 3.8f, 3.5f, 2.9f,
                       1.9f, 1.2f, 0.7f, 0.3f};  //<- user can specify these
@@ -811,110 +876,132 @@ void ShaderEngine::RenderBlurTextures(const Pipeline &pipeline,
 }
 
 namespace {
+// Returns how many levels of the blur chain `shader` samples.
+int BlurLevels(const ShaderCache &shader) {
+  for (int level = 3; level > 0; level--) {
+    if (shader.textures_and_samplers.count("blur" + std::to_string(level))) {
+      return level;
+    }
+  }
+  return 0;
+}
+}  // namespace
 
-void CompilePresetShaders(
-    Pipeline *pipeline, std::shared_ptr<TextureManager> texture_manager,
-    std::function<void()> activate_compile_context,
-    std::function<void()> deactivate_compile_context,
-    std::function<void(std::shared_ptr<Shader>, std::shared_ptr<Shader>,
-                       ShaderCache, ShaderCache)>
-        compile_completed_callback) {
-  activate_compile_context();
-
+std::unique_ptr<ShaderEngine::CompileResult>
+ShaderEngine::CompilePresetShaders(const CompileJob &job) {
   std::cout << "Starting shader compilation" << std::endl;
 
-  std::shared_ptr<Shader> new_composite_shader = nullptr,
-                          new_warp_shader = nullptr;
-  ShaderCache new_composite_shader_cache, new_warp_shader_cache;
-  // compile and link warp and composite shaders from pipeline
-  std::string file_name, program_source;
-
-  {
-    auto shader = pipeline->GetWarpShader();
-    file_name = shader.second.file_name;
-    program_source = shader.second.program_source;
-  }
+  auto result = std::make_unique<CompileResult>();
+  result->generation = job.generation;
 
-  if (!program_source.empty()) {
-    new_warp_shader = TranspilePresetShader(
-        texture_manager, ShaderEngine::PresentShaderType::PresentWarpShader,
-        file_name, program_source, &new_warp_shader_cache);
-    if (new_warp_shader == nullptr) {
+  // compile and link warp and composite shaders from pipeline
+  if (!job.warp_shader.program_source.empty()) {
+    result->warp_shader = TranspilePresetShader(
+        job.texture_manager, PresentShaderType::PresentWarpShader,
+        job.warp_shader.file_name, job.warp_shader.program_source,
+        &result->warp_shader_cache);
+    if (result->warp_shader == nullptr) {
       std::cerr << "Failed to transpile warp shader, exiting compilation!"
                 << std::endl;
-      return;
+      // Fall back to the static shaders rather than a half-compiled set.
+      result = std::make_unique<CompileResult>();
+      result->generation = job.generation;
+      return result;
     }
   }
 
-  {
-    auto shader = pipeline->GetCompositeShader();
-    file_name = shader.second.file_name;
-    program_source = shader.second.program_source;
+  if (compile_generation_.load() != job.generation) {
+    std::cout << "Shader compilation superseded" << std::endl;
+    return nullptr;
   }
 
-  if (!program_source.empty()) {
-    new_composite_shader = TranspilePresetShader(
-        texture_manager,
-        ShaderEngine::PresentShaderType::PresentCompositeShader, file_name,
-        program_source, &new_composite_shader_cache);
-    if (new_composite_shader == nullptr) {
+  if (!job.composite_shader.program_source.empty()) {
+    result->composite_shader = TranspilePresetShader(
+        job.texture_manager, PresentShaderType::PresentCompositeShader,
+        job.composite_shader.file_name, job.composite_shader.program_source,
+        &result->composite_shader_cache);
+    if (result->composite_shader == nullptr) {
       std::cerr << "Failed to transpile composite shader, exiting compilation!"
                 << std::endl;
-      return;
+      // Fall back to the static shaders rather than a half-compiled set.
+      result = std::make_unique<CompileResult>();
+      result->generation = job.generation;
+      return result;
     }
   }
 
   glFinish();
 
   std::cerr << "Finished shader compilation" << std::endl;
-  compile_completed_callback(new_composite_shader, new_warp_shader,
-                             new_composite_shader_cache, new_warp_shader_cache);
-  deactivate_compile_context();
+  return result;
 }
-}  // namespace
 
-void ShaderEngine::UpdateShaders(Pipeline *pipeline,
-                                 std::shared_ptr<Shader> composite_shader,
-                                 std::shared_ptr<Shader> warp_shader,
-                                 ShaderCache composite_shader_cache,
-                                 ShaderCache warp_shader_cache) {
-  std::lock_guard<std::mutex> program_reference_lock(program_reference_mutex_);
+void ShaderEngine::CompileWorker() {
+  activate_compile_context_();
+
+  while (true) {
+    std::unique_ptr<CompileJob> job;
+    {
+      std::unique_lock<std::mutex> lock(compile_queue_mutex_);
+      compile_queue_cv_.wait(
+          lock, [this] { return stop_compile_worker_ || pending_job_; });
+      if (stop_compile_worker_) {
+        break;
+      }
+      job = std::move(pending_job_);
+    }
+
+    if (job->generation != compile_generation_.load()) {
+      continue;
+    }
+
+    std::unique_ptr<CompileResult> result = CompilePresetShaders(*job);
+    if (result == nullptr) {
+      continue;
+    }
+    delete compile_result_.exchange(result.release());
+  }
+
+  // Programs are shared with the render context, so it is fine to release a
+  // result nobody picked up from here.
+  delete compile_result_.exchange(nullptr);
+  deactivate_compile_context_();
+}
+
+bool ShaderEngine::PollCompiledShaders(Pipeline &pipeline) {
+  std::unique_ptr<CompileResult> result(compile_result_.exchange(nullptr));
+  if (result == nullptr ||
+      result->generation != compile_generation_.load()) {
+    return false;
+  }
+
   std::cout << "Updating shaders" << std::endl;
   ResetPerPresetState();
 
-  pipeline->UpdateShaders(warp_shader_cache, composite_shader_cache);
-  composite_shader_ = composite_shader;
-  warp_shader_ = warp_shader;
-  compile_complete_ = true;
-  compile_complete_cv_.notify_one();
+  blur_levels_ = std::max(BlurLevels(result->warp_shader_cache),
+                          BlurLevels(result->composite_shader_cache));
+  pipeline.UpdateShaders(std::move(result->warp_shader_cache),
+                         std::move(result->composite_shader_cache));
+  composite_shader_ = std::move(result->composite_shader);
+  warp_shader_ = std::move(result->warp_shader);
+  return true;
 }
 
 void ShaderEngine::LoadPresetShadersAsync(Pipeline &pipeline,
                                           std::string_view preset_name) {
+  // Snapshot the sources here so the worker never touches a pipeline that
+  // may be destroyed before it gets to the job.
+  auto job = std::make_unique<CompileJob>();
+  job->generation = ++compile_generation_;
+  job->texture_manager = texture_manager_;
+  job->warp_shader = pipeline.GetWarpShader().second;
+  job->composite_shader = pipeline.GetCompositeShader().second;
+
   {
-    std::unique_lock<std::mutex> program_reference_lock(
-        program_reference_mutex_);
-    if (compile_complete_) {
-      if (compile_thread_.joinable()) {
-        compile_thread_.join();
-      }
-    } else {
-      std::cerr << "Compile thread from previous preset has not completed!"
-                << std::endl;
-      compile_complete_cv_.wait(program_reference_lock);
-      compile_complete_ = false;
-      if (compile_thread_.joinable()) {
-        compile_thread_.join();
-      }
-    }
+    std::lock_guard<std::mutex> lock(compile_queue_mutex_);
+    pending_job_ = std::move(job);
   }
-
-  compile_thread_ =
-      std::thread(&CompilePresetShaders, &pipeline, texture_manager_,
-                  activate_compile_context_, deactivate_compile_context_,
-                  std::bind(&ShaderEngine::UpdateShaders, this, &pipeline,
-                            std::placeholders::_1, std::placeholders::_2,
-                            std::placeholders::_3, std::placeholders::_4));
+  compile_queue_cv_.notify_one();
 }
 
 void ShaderEngine::ResetPerPresetState() {
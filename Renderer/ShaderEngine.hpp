@@ -8,11 +8,14 @@
 #ifndef SHADERENGINE_HPP_
 #define SHADERENGINE_HPP_
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdlib>
 #include <functional>
 #include <glm/vec3.hpp>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <sstream>
 #include <thread>
 
@@ -35,7 +38,14 @@ class ShaderEngine {
   ShaderEngine(std::function<void()> activateCompileContext,
                std::function<void()> deactivateCompileContext);
   virtual ~ShaderEngine();
+  // Queues compilation of the preset shaders of `pipeline` on the compile
+  // worker and returns immediately. A job still queued or in progress for a
+  // previous pipeline is superseded; its result is discarded.
   void LoadPresetShadersAsync(Pipeline &pipeline, std::string_view preset_name);
+  // Installs the most recent finished compile, if any, into `pipeline` and the
+  // active programs. Must be called from the render thread before the preset
+  // shaders are enabled for a frame. Returns true if the shaders changed.
+  bool PollCompiledShaders(Pipeline &pipeline);
   bool enableWarpShader(ShaderCache &shader, const Pipeline &pipeline,
                         const PipelineContext &pipelineContext,
                         const glm::mat4 &mat_ortho);
@@ -67,24 +77,49 @@ class ShaderEngine {
   void SetupShaderVariables(GLuint program, const Pipeline &pipeline,
                             const PipelineContext &pipelineContext);
   void SetupTextures(GLuint program, const ShaderCache &shader);
-  void UpdateShaders(Pipeline *pipeline,
-                     std::shared_ptr<Shader> composite_shader,
-                     std::shared_ptr<Shader> warp_shader,
-                     ShaderCache composite_shader_cache,
-                     ShaderCache warp_shader_cache);
+
+  struct CompileJob {
+    uint64_t generation;
+    std::shared_ptr<TextureManager> texture_manager;
+    ShaderCache warp_shader;
+    ShaderCache composite_shader;
+  };
+
+  struct CompileResult {
+    uint64_t generation;
+    std::shared_ptr<Shader> composite_shader, warp_shader;
+    ShaderCache composite_shader_cache, warp_shader_cache;
+  };
+
+  void CompileWorker();
+  std::unique_ptr<CompileResult> CompilePresetShaders(const CompileJob &job);
 
   void ResetShaders();
   void ResetShadersAsync();
 
-  std::mutex program_reference_mutex_;
-  // programs generated from preset shader code
+  // programs generated from preset shader code, only touched by the render
+  // thread
   std::shared_ptr<Shader> composite_shader_, warp_shader_;
-
-  std::thread compile_thread_;
-  bool compile_complete_;
-  std::condition_variable compile_complete_cv_;
+  // Deepest blur level (0-3) sampled by either program. Levels past it are
+  // not rendered.
+  int blur_levels_;
 
   std::function<void()> activate_compile_context_, deactivate_compile_context_;
+
+  // Generation of the most recently requested compile. The worker checks it
+  // between stages and abandons jobs that have been superseded.
+  std::atomic<uint64_t> compile_generation_;
+  // Finished compile waiting to be picked up by `PollCompiledShaders`. Owned by
+  // whichever thread exchanges it out.
+  std::atomic<CompileResult *> compile_result_;
+
+  // Guards `pending_job_` and `stop_compile_worker_`. At most one job is
+  // pending; queueing a new one replaces it.
+  std::mutex compile_queue_mutex_;
+  std::condition_variable compile_queue_cv_;
+  std::unique_ptr<CompileJob> pending_job_;
+  bool stop_compile_worker_;
+  std::thread compile_worker_;
 };
 
 #endif /* SHADERENGINE_HPP_ */
@@ -0,0 +1,284 @@
+#include "ShaderTranspileCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+namespace {
+// Upper bound on the number of entries of each level kept in memory. Program
+// binaries are tens of kilobytes each on most drivers.
+constexpr size_t kMaxMemoryEntries = 256;
+
+constexpr char kGlslMagic[4] = {'P', 'M', 'S', 'G'};
+constexpr char kBinaryMagic[4] = {'P', 'M', 'S', 'B'};
+constexpr size_t kEntryHeaderSize = 4 + 2 * sizeof(uint32_t);
+
+// 64 bit FNV-1a.
+uint64_t Hash(std::string_view data, uint64_t hash = 14695981039346656037ULL) {
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Names the entry of `key`, in memory and on disk. Lookups still compare the
+// key itself; the version only keeps old entries from being read at all.
+uint64_t KeyHash(std::string_view key) {
+  const uint32_t version = ShaderTranspileCache::kVersion;
+  return Hash(key, Hash(std::string_view(
+                       reinterpret_cast<const char *>(&version), sizeof(version))));
+}
+
+// A disk entry is the magic of its level, the version, the key size, the key
+// and then the value.
+std::string EncodeEntry(const char (&magic)[4], std::string_view key,
+                        std::string_view value) {
+  const uint32_t header[2] = {ShaderTranspileCache::kVersion,
+                              static_cast<uint32_t>(key.size())};
+  std::string contents(magic, sizeof(magic));
+  contents.append(reinterpret_cast<const char *>(header), sizeof(header));
+  contents.append(key);
+  contents.append(value);
+  return contents;
+}
+
+// The value of a disk entry of this level, version and key.
+std::optional<std::string> DecodeEntry(
+    const std::optional<std::string> &contents, const char (&magic)[4],
+    std::string_view key) {
+  if (!contents.has_value() || contents->size() < kEntryHeaderSize ||
+      contents->compare(0, sizeof(magic), magic, sizeof(magic)) != 0) {
+    return std::nullopt;
+  }
+  uint32_t header[2];
+  memcpy(header, contents->data() + sizeof(magic), sizeof(header));
+  if (header[0] != ShaderTranspileCache::kVersion ||
+      header[1] != key.size() ||
+      contents->size() - kEntryHeaderSize < key.size() ||
+      contents->compare(kEntryHeaderSize, key.size(), key) != 0) {
+    return std::nullopt;
+  }
+  return contents->substr(kEntryHeaderSize + key.size());
+}
+
+template <typename Map, typename Value>
+void InsertBounded(Map *map, std::deque<uint64_t> *order, uint64_t key,
+                   Value value) {
+  if (map->find(key) == map->end()) {
+    order->push_back(key);
+  }
+  (*map)[key] = std::move(value);
+  while (order->size() > kMaxMemoryEntries) {
+    map->erase(order->front());
+    order->pop_front();
+  }
+}
+
+// Writes through a temporary file so a crash never leaves a truncated entry
+// behind.
+void WriteFile(const std::string &path, const std::string &contents) {
+  const std::string temp_path = path + ".tmp";
+  {
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      return;
+    }
+    out.write(contents.data(), contents.size());
+    if (!out) {
+      std::remove(temp_path.c_str());
+      return;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temp_path, path, error);
+  if (error) {
+    std::cerr << "Failed to write shader cache entry " << path << ": "
+              << error.message() << std::endl;
+    std::remove(temp_path.c_str());
+  }
+}
+
+std::optional<std::string> ReadFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return std::nullopt;
+  }
+  return std::string(std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>());
+}
+}  // namespace
+
+void ShaderTranspileCache::SetCacheDirectory(const std::string &directory) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  directory_.clear();
+  if (directory.empty()) {
+    return;
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  if (error) {
+    std::cerr << "Failed to create shader cache directory " << directory
+              << ": " << error.message() << std::endl;
+    return;
+  }
+  directory_ = directory;
+}
+
+std::string ShaderTranspileCache::EntryPath(uint64_t hash,
+                                            std::string_view extension) const {
+  char name[17];
+  snprintf(name, sizeof(name), "%016llx",
+           static_cast<unsigned long long>(hash));
+  return (std::filesystem::path(directory_) / name).string() +
+         std::string(extension);
+}
+
+std::optional<std::string> ShaderTranspileCache::FindGlsl(
+    std::string_view key) {
+  const uint64_t hash = KeyHash(key);
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = glsl_.find(hash);
+  if (it != glsl_.end()) {
+    if (it->second.key != key) {
+      return std::nullopt;
+    }
+    return it->second.value;
+  }
+
+  if (directory_.empty()) {
+    return std::nullopt;
+  }
+  std::optional<std::string> glsl =
+      DecodeEntry(ReadFile(EntryPath(hash, ".glsl")), kGlslMagic, key);
+  if (glsl.has_value()) {
+    InsertBounded(&glsl_, &glsl_order_, hash,
+                  Entry<std::string>{std::string(key), *glsl});
+  }
+  return glsl;
+}
+
+void ShaderTranspileCache::InsertGlsl(std::string_view key,
+                                      const std::string &glsl) {
+  const uint64_t hash = KeyHash(key);
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  InsertBounded(&glsl_, &glsl_order_, hash,
+                Entry<std::string>{std::string(key), glsl});
+  if (!directory_.empty()) {
+    WriteFile(EntryPath(hash, ".glsl"), EncodeEntry(kGlslMagic, key, glsl));
+  }
+}
+
+const std::string &ShaderTranspileCache::DriverString() {
+  if (driver_string_.empty()) {
+    std::stringstream driver;
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+      const GLubyte *value = glGetString(name);
+      driver << (value != nullptr ? reinterpret_cast<const char *>(value) : "")
+             << '\n';
+    }
+    driver_string_ = driver.str();
+  }
+  return driver_string_;
+}
+
+std::optional<ShaderTranspileCache::ProgramBinary>
+ShaderTranspileCache::FindBinary(uint64_t hash, const std::string &key) {
+  auto it = binaries_.find(hash);
+  if (it != binaries_.end()) {
+    if (it->second.key != key) {
+      return std::nullopt;
+    }
+    return it->second.value;
+  }
+
+  if (directory_.empty()) {
+    return std::nullopt;
+  }
+  std::optional<std::string> value =
+      DecodeEntry(ReadFile(EntryPath(hash, ".bin")), kBinaryMagic, key);
+  if (!value.has_value() || value->size() <= sizeof(uint32_t)) {
+    return std::nullopt;
+  }
+
+  uint32_t format;
+  memcpy(&format, value->data(), sizeof(format));
+  ProgramBinary binary{
+      static_cast<GLenum>(format),
+      std::vector<char>(value->begin() + sizeof(format), value->end())};
+  InsertBounded(&binaries_, &binaries_order_, hash,
+                Entry<ProgramBinary>{key, binary});
+  return binary;
+}
+
+void ShaderTranspileCache::InsertBinary(uint64_t hash, const std::string &key,
+                                        ProgramBinary binary) {
+  if (!directory_.empty()) {
+    const uint32_t format = binary.format;
+    std::string value(reinterpret_cast<const char *>(&format), sizeof(format));
+    value.append(binary.data.begin(), binary.data.end());
+    WriteFile(EntryPath(hash, ".bin"), EncodeEntry(kBinaryMagic, key, value));
+  }
+  InsertBounded(&binaries_, &binaries_order_, hash,
+                Entry<ProgramBinary>{key, std::move(binary)});
+}
+
+std::shared_ptr<Shader> ShaderTranspileCache::CompileShaderProgram(
+    const std::string &vertex_shader_code,
+    const std::string &fragment_shader_code,
+    std::string_view shader_type_string) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  if (binaries_supported_ < 0) {
+    GLint num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    binaries_supported_ = num_formats > 0 ? 1 : 0;
+  }
+
+  if (binaries_supported_ == 0) {
+    lock.unlock();
+    return Shader::CompileShaderProgram(vertex_shader_code,
+                                        fragment_shader_code,
+                                        shader_type_string);
+  }
+
+  // The separator keeps "ab" + "c" and "a" + "bc" from colliding.
+  std::string key = DriverString();
+  key.append(vertex_shader_code);
+  key.push_back('\0');
+  key.append(fragment_shader_code);
+  const uint64_t hash = KeyHash(key);
+
+  std::optional<ProgramBinary> binary = FindBinary(hash, key);
+  lock.unlock();
+
+  if (binary.has_value()) {
+    std::shared_ptr<Shader> shader =
+        Shader::LoadShaderProgramBinary(binary->format, binary->data);
+    if (shader != nullptr) {
+      return shader;
+    }
+    // Rejected, most likely by an updated driver with an unchanged version
+    // string. Fall through and overwrite the entry.
+  }
+
+  std::shared_ptr<Shader> shader = Shader::CompileShaderProgram(
+      vertex_shader_code, fragment_shader_code, shader_type_string);
+  if (shader == nullptr) {
+    return nullptr;
+  }
+
+  ProgramBinary new_binary;
+  if (shader->GetProgramBinary(&new_binary.format, &new_binary.data)) {
+    lock.lock();
+    InsertBinary(hash, key, std::move(new_binary));
+  }
+  return shader;
+}
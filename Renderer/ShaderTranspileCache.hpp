@@ -0,0 +1,93 @@
+#ifndef SHADER_TRANSPILE_CACHE_HPP_
+#define SHADER_TRANSPILE_CACHE_HPP_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Shader.hpp"
+#include "projectM-opengl.h"
+
+// Two level cache for preset shaders, shared by every `ShaderEngine`. The
+// second level also holds the built-in programs of `StaticShaders`.
+//
+// The first level maps a hash of the HLSL transpiler input to the GLSL that
+// `GLSLGenerator` produced for it. The second level maps a hash of the GLSL
+// vertex and fragment sources, plus the GL vendor/renderer/version strings, to
+// a linked program binary retrieved with `glGetProgramBinary`.
+//
+// Both levels are kept in memory (bounded, oldest entries evicted first) and,
+// if a cache directory is set, persisted as one file per entry so they survive
+// restarts. Every entry holds its full key, which lookups compare, so two keys
+// with the same hash never share an entry. Both keys include `kVersion`.
+// Disk entries are never evicted; delete the directory to reset it.
+class ShaderTranspileCache {
+ public:
+  // Bump whenever the GLSL produced for a key may change (hlslparser, the
+  // HLSL rewrites of `ShaderEngine`) or the entry layout does. Entries of
+  // other versions are never used.
+  static constexpr uint32_t kVersion = 2;
+
+  static std::shared_ptr<ShaderTranspileCache> Get() {
+    static auto instance_ =
+        std::shared_ptr<ShaderTranspileCache>(new ShaderTranspileCache());
+    return instance_;
+  }
+
+  // Enables persisting entries below `directory`, creating it if necessary.
+  // An empty path keeps the cache in memory only.
+  void SetCacheDirectory(const std::string &directory);
+
+  // Returns the GLSL previously stored for `key`. `key` must describe
+  // everything the transpiler output depends on.
+  std::optional<std::string> FindGlsl(std::string_view key);
+  void InsertGlsl(std::string_view key, const std::string &glsl);
+
+  // Same contract as `Shader::CompileShaderProgram`, but loads the program
+  // from a cached binary when the driver accepts one, and stores the binary of
+  // newly linked programs. Requires a current GL context.
+  std::shared_ptr<Shader> CompileShaderProgram(
+      const std::string &vertex_shader_code,
+      const std::string &fragment_shader_code,
+      std::string_view shader_type_string);
+
+ private:
+  struct ProgramBinary {
+    GLenum format;
+    std::vector<char> data;
+  };
+
+  template <typename Value>
+  struct Entry {
+    std::string key;
+    Value value;
+  };
+
+  ShaderTranspileCache() = default;
+
+  std::string EntryPath(uint64_t hash, std::string_view extension) const;
+  const std::string &DriverString();
+  std::optional<ProgramBinary> FindBinary(uint64_t hash,
+                                          const std::string &key);
+  void InsertBinary(uint64_t hash, const std::string &key,
+                    ProgramBinary binary);
+
+  std::mutex mutex_;
+  std::string directory_;
+  std::string driver_string_;
+  // -1 unknown, 0 unsupported, 1 supported
+  int binaries_supported_ = -1;
+
+  std::unordered_map<uint64_t, Entry<std::string>> glsl_;
+  std::deque<uint64_t> glsl_order_;
+  std::unordered_map<uint64_t, Entry<ProgramBinary>> binaries_;
+  std::deque<uint64_t> binaries_order_;
+};
+
+#endif /* SHADER_TRANSPILE_CACHE_HPP_ */
@@ -1,21 +1,23 @@
 #include "StaticShaders.hpp"
 
+#include "ShaderTranspileCache.hpp"
 #include "StaticGlShaders.h"
 
 StaticShaders::StaticShaders() {
   std::shared_ptr<StaticGlShaders> static_gl_shaders = StaticGlShaders::Get();
+  std::shared_ptr<ShaderTranspileCache> cache = ShaderTranspileCache::Get();
 
-  program_v2f_c4f_ = Shader::CompileShaderProgram(
+  program_v2f_c4f_ = cache->CompileShaderProgram(
       static_gl_shaders->GetV2fC4fVertexShader(),
       static_gl_shaders->GetV2fC4fFragmentShader(), "v2f_c4f");
-  program_v2f_c4f_t2f_ = Shader::CompileShaderProgram(
+  program_v2f_c4f_t2f_ = cache->CompileShaderProgram(
       static_gl_shaders->GetV2fC4fT2fVertexShader(),
       static_gl_shaders->GetV2fC4fT2fFragmentShader(), "v2f_c4f_t2f");
 
-  program_blur1_ = Shader::CompileShaderProgram(
+  program_blur1_ = cache->CompileShaderProgram(
       static_gl_shaders->GetBlurVertexShader(),
       static_gl_shaders->GetBlur1FragmentShader(), "blur1");
-  program_blur2_ = Shader::CompileShaderProgram(
+  program_blur2_ = cache->CompileShaderProgram(
       static_gl_shaders->GetBlurVertexShader(),
       static_gl_shaders->GetBlur2FragmentShader(), "blur2");
 
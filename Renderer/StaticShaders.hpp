@@ -2,6 +2,10 @@
 
 #include "Shader.hpp"
 
+// The programs every frame draws with, whatever the preset. They are built
+// the first time `Get` is called, which `ShaderEngine` does while the renderer
+// is set up, and go through `ShaderTranspileCache` so that a restart with the
+// same driver links them from cached binaries instead of compiling them.
 class StaticShaders {
 public:
   static std::shared_ptr<StaticShaders> Get() {
@@ -25,18 +25,18 @@ Texture::Texture(std::string name, ImageType image_type, int width, int height,
 
 Texture::Texture(std::string name, ImageType image_type, int width, int height,
                  int depth, bool is_user_texture, GLenum data_format,
-                 GLenum data_type, void *data)
+                 GLenum data_type, void *data, GLint internal_format)
     : Texture(std::move(name), image_type, 0, width, height, depth,
               is_user_texture) {
   glGenTextures(1, &texture_id_);
   glBindTexture(texture_type_, texture_id_);
   switch (image_type) {
   case ImageType::k2d:
-    glTexImage2D(texture_type_, 0, GL_RGB, width_, height_, 0, data_format,
-                 data_type, data);
+    glTexImage2D(texture_type_, 0, internal_format, width_, height_, 0,
+                 data_format, data_type, data);
     break;
   case ImageType::k3d:
-    glTexImage3D(texture_type_, 0, GL_RGB, width_, height_, depth_, 0,
+    glTexImage3D(texture_type_, 0, internal_format, width_, height_, depth_, 0,
                  data_format, data_type, data);
     break;
   }
@@ -31,7 +31,7 @@ public:
           int depth, bool is_user_texture);
   Texture(std::string name, ImageType image_type, int width, int height,
           int depth, bool is_user_texture, GLenum data_format, GLenum data_type,
-          void *data);
+          void *data, GLint internal_format = GL_RGB);
   Texture(std::string name, ImageType image_type, GLuint texture_id, int width,
           int height, int depth, bool is_user_texture);
   ~Texture();
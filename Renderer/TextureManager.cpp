@@ -89,7 +89,8 @@ void TextureManager::InsertNamedTexture(std::string name,
 }
 
 TextureManager::TextureManager(std::string presets_url, int width, int height,
-                               std::string data_url)
+                               std::string data_url,
+                               GLint blur_internal_format)
     : presets_url_(std::move(presets_url)) {
   LoadIdleTextures();
 
@@ -130,7 +131,8 @@ TextureManager::TextureManager(std::string presets_url, int width, int height,
     auto blur_texture_name = blur_texture_name_stream.str();
     auto blur_texture = std::make_shared<Texture>(
         blur_texture_name, Texture::ImageType::k2d, RoundUp(width, 16),
-        RoundUp(height, 16), 0, false);
+        RoundUp(height, 16), 0, false, GL_RGB, GL_UNSIGNED_BYTE, nullptr,
+        blur_internal_format);
     blur_texture->GetSamplerForModes(GL_CLAMP_TO_EDGE, GL_LINEAR);
     named_textures_[blur_texture_name] = blur_texture;
     blur_textures_.push_back(blur_texture);
@@ -139,41 +141,39 @@ TextureManager::TextureManager(std::string presets_url, int width, int height,
   constexpr int kNoiseTexSize = 256;
   constexpr int kNoiseTexSizeSmall = 32;
 
+  // The noise is generated as bytes: the textures are GL_RGB internally, so
+  // uploading floats only made the driver convert them.
   auto noise_lq_lite =
-      Image<float>::Create(kNoiseTexSizeSmall, kNoiseTexSizeSmall, 4);
+      Image<uint8_t>::Create(kNoiseTexSizeSmall, kNoiseTexSizeSmall, 4);
   FillPerlinScaled(1, 1, noise_lq_lite.get());
-  auto noise_lq = Image<float>::Create(kNoiseTexSize, kNoiseTexSize, 4);
-  FillPerlin(noise_lq.get());
-  auto noise_mq = Image<float>::Create(kNoiseTexSize, kNoiseTexSize, 4);
+  auto noise_lq = Image<uint8_t>::Create(kNoiseTexSize, kNoiseTexSize, 4);
+  FillPerlinScaled(1, 1, noise_lq.get());
+  auto noise_mq = Image<uint8_t>::Create(kNoiseTexSize, kNoiseTexSize, 4);
   FillPerlinScaled(0.25f, 0.25f, noise_mq.get());
-  auto noise_hq = Image<float>::Create(kNoiseTexSize, kNoiseTexSize, 4);
+  auto noise_hq = Image<uint8_t>::Create(kNoiseTexSize, kNoiseTexSize, 4);
   FillPerlinScaled(0.125f, 0.125f, noise_hq.get());
-  auto noisevol_lq = Image<float>::Create(
-      kNoiseTexSizeSmall, kNoiseTexSizeSmall, kNoiseTexSizeSmall, 4);
-  FillPerlin(noisevol_lq.get());
-  auto noisevol_hq = Image<float>::Create(
-      kNoiseTexSizeSmall, kNoiseTexSizeSmall, kNoiseTexSizeSmall, 4);
-  FillPerlinScaled(0.25f, 0.25f, noisevol_hq.get());
   // TODO: populate these with a loop and a helper function
   InsertNamedTexture("noise_lq_lite", Texture::ImageType::k2d,
                      kNoiseTexSizeSmall, kNoiseTexSizeSmall, 0, false,
-                     GL_REPEAT, GL_LINEAR, GL_RGBA, GL_FLOAT,
+                     GL_REPEAT, GL_LINEAR, GL_RGBA, GL_UNSIGNED_BYTE,
                      noise_lq_lite->data());
   InsertNamedTexture("noise_lq", Texture::ImageType::k2d, kNoiseTexSize,
                      kNoiseTexSize, 0, false, GL_REPEAT, GL_LINEAR, GL_RGBA,
-                     GL_FLOAT, noise_lq->data());
+                     GL_UNSIGNED_BYTE, noise_lq->data());
   InsertNamedTexture("noise_mq", Texture::ImageType::k2d, kNoiseTexSize,
                      kNoiseTexSize, 0, false, GL_REPEAT, GL_LINEAR, GL_RGBA,
-                     GL_FLOAT, noise_mq->data());
+                     GL_UNSIGNED_BYTE, noise_mq->data());
   InsertNamedTexture("noise_hq", Texture::ImageType::k2d, kNoiseTexSize,
                      kNoiseTexSize, 0, false, GL_REPEAT, GL_LINEAR, GL_RGBA,
-                     GL_FLOAT, noise_hq->data());
+                     GL_UNSIGNED_BYTE, noise_hq->data());
+  // The volumes have always been filled from the first texels of noise_lq;
+  // the 3D noise generated for them was never uploaded.
   InsertNamedTexture("noisevol_lq", Texture::ImageType::k3d, kNoiseTexSizeSmall,
                      kNoiseTexSizeSmall, kNoiseTexSizeSmall, false, GL_REPEAT,
-                     GL_LINEAR, GL_RGBA, GL_FLOAT, noise_lq->data());
+                     GL_LINEAR, GL_RGBA, GL_UNSIGNED_BYTE, noise_lq->data());
   InsertNamedTexture("noisevol_hq", Texture::ImageType::k3d, kNoiseTexSizeSmall,
                      kNoiseTexSizeSmall, kNoiseTexSizeSmall, false, GL_REPEAT,
-                     GL_LINEAR, GL_RGBA, GL_FLOAT, noise_lq->data());
+                     GL_LINEAR, GL_RGBA, GL_UNSIGNED_BYTE, noise_lq->data());
 }
 
 void TextureManager::LoadIdleTextures() {
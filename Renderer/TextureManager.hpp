@@ -25,9 +25,10 @@ public:
   // Constructs a TextureManager, populating the store with any images under
   // `presets_url`, `data_url`/presets and `data_url`/textures. Also initializes
   // the main texture to `width` * `height` texels, and a series of blur
-  // textures with sizes progressively halved from the main texture size.
+  // textures with sizes progressively halved from the main texture size,
+  // stored with `blur_internal_format`.
   TextureManager(std::string presets_url, int width, int height,
-                 std::string data_url);
+                 std::string data_url, GLint blur_internal_format = GL_RGB);
 
   void Clear();
 
@@ -10,7 +10,7 @@
 #include "StaticShaders.hpp"
 #include <glm/gtc/type_ptr.hpp>
 
-VideoEcho::VideoEcho(): a(0), zoom(1), orientation(Normal)
+VideoEcho::VideoEcho(): RenderItem(kKind), a(0), zoom(1), orientation(Normal)
 {
     Init();
 }
@@ -20,6 +20,8 @@ enum Orientation
 class VideoEcho: public RenderItem
 {
 public:
+	static constexpr Kind kKind = kVideoEcho;
+
 	VideoEcho();
 	virtual ~VideoEcho();
 
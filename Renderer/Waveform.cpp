@@ -32,10 +32,9 @@ constexpr float kVolumeMultplier = 5;
 }  // namespace
 
 Waveform::Waveform(int _samples)
-    : RenderItem(),
+    : RenderItem(kKind),
       samples(_samples),
       points(_samples),
-      pointContext(_samples),
       left_channel_buffer_(_samples),
       right_channel_buffer_(_samples) {
   spectrum = false; /* spectrum data or pcm data */
@@ -62,48 +61,58 @@ void Waveform::InitVertexAttrib() {
       reinterpret_cast<void *>(ColoredPoint::kColorOffset));  // colors
 }
 
+void Waveform::Resize(int samples) {
+  if (sample_positions_.size() == static_cast<size_t>(samples)) {
+    return;
+  }
+  sample_positions_.resize(samples);
+  for (int x = 0; x < samples; ++x) {
+    sample_positions_[x] = x / static_cast<float>(samples - 1);
+  }
+  if (points.size() < sample_positions_.size()) {
+    points.resize(samples);
+    left_channel_buffer_.resize(samples);
+    right_channel_buffer_.resize(samples);
+  }
+}
+
 void Waveform::Draw(RenderContext &context) {
+  Resize(samples);
+
   // scale PCM data based on vol_history to make it more or less independent of
   // the application output volume
   const float vol_scale =
       context.beatDetect->getPCMScale() * scaling *
       (spectrum ? kFreqDomainCoefficient : kTimeDomainCoefficient);
 
-  context.beatDetect->pcm->getPCM(left_channel_buffer_.data(), samples, 0,
-                                  spectrum, smoothing, 0);
-  context.beatDetect->pcm->getPCM(right_channel_buffer_.data(), samples, 1,
-                                  spectrum, smoothing, 0);
+  // Shared with every other wave asking for the same data this frame.
+  const float *left =
+      context.pcmSnapshot->getPCM(samples, 0, spectrum, smoothing);
+  const float *right =
+      context.pcmSnapshot->getPCM(samples, 1, spectrum, smoothing);
 
-  for (auto &sample : left_channel_buffer_) {
-    sample *= vol_scale;
-  }
-  for (auto &sample : right_channel_buffer_) {
-    sample *= vol_scale;
+  // the per point equations see the PCM scaled twice
+  for (int x = 0; x < samples; ++x) {
+    left_channel_buffer_[x] = vol_scale * (left[x] * vol_scale);
+    right_channel_buffer_[x] = vol_scale * (right[x] * vol_scale);
   }
 
   WaveformContext wave_context(samples, context.beatDetect);
+  wave_context.sample = sample_positions_.data();
+  wave_context.left = left_channel_buffer_.data();
+  wave_context.right = right_channel_buffer_.data();
 
-  for (int x = 0; x < samples; ++x) {
-    wave_context.sample = x / static_cast<float>(samples - 1);
-    wave_context.sample_int = x;
-    wave_context.left = vol_scale * left_channel_buffer_[x];
-    wave_context.right = vol_scale * right_channel_buffer_[x];
+  PerPoints(points.data(), wave_context);
 
-    points[x] = PerPoint(points[x], wave_context);
-  }
-
-  std::vector<ColoredPoint> points_transformed = points;
-
-  for (auto &point : points_transformed) {
-    point.position.y = 1 - point.position.y;
-    point.color.a *= masterAlpha;
+  for (int x = 0; x < samples; ++x) {
+    points[x].position.y = 1 - points[x].position.y;
+    points[x].color.a *= masterAlpha;
   }
 
   glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
 
-  glBufferData(GL_ARRAY_BUFFER,
-               sizeof(ColoredPoint) * points_transformed.size(),
-               points_transformed.data(), GL_DYNAMIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(ColoredPoint) * samples, points.data(),
+               GL_DYNAMIC_DRAW);
 
   glBindBuffer(GL_ARRAY_BUFFER, 0);
 
@@ -16,19 +16,25 @@
 
 class WaveformContext {
  public:
-  float sample;
   int samples;
-  int sample_int;
-  float left;
-  float right;
+  // Per sample inputs, `samples` values each.
+  const float* sample;  // position of the sample in the wave, 0 to 1
+  const float* left;
+  const float* right;
   BeatDetect* music;
 
   WaveformContext(int samples, BeatDetect* music)
-      : samples(samples), music(music) {}
+      : samples(samples),
+        sample(nullptr),
+        left(nullptr),
+        right(nullptr),
+        music(music) {}
 };
 
 class Waveform : public RenderItem {
  public:
+  static constexpr Kind kKind = kWaveform;
+
   int samples;   /* number of samples associated with this wave form. Usually
                     powers of 2 */
   bool spectrum; /* spectrum data or pcm data */
@@ -45,10 +51,14 @@ class Waveform : public RenderItem {
   void Draw(RenderContext& context);
 
  private:
-  virtual ColoredPoint PerPoint(ColoredPoint p,
-                                const WaveformContext& context) = 0;
+  // Evaluates all `context.samples` points of the wave in one call, writing
+  // them to `points`.
+  virtual void PerPoints(ColoredPoint* points,
+                         const WaveformContext& context) = 0;
+  void Resize(int samples);
+  // Vertices uploaded each frame.
   std::vector<ColoredPoint> points;
-  std::vector<float> pointContext;
+  std::vector<float> sample_positions_;
   std::vector<float> left_channel_buffer_;
   std::vector<float> right_channel_buffer_;
 };
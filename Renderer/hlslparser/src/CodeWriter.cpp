@@ -20,6 +20,10 @@ namespace M4
 
 static const int _maxLineLength = 2048;
 
+// Typical generated preset shaders are a few to tens of kilobytes; reserving up
+// front avoids growing the buffer through every power of two.
+static const size_t _initialBufferSize = 32 * 1024;
+
 CodeWriter::CodeWriter(bool writeFileNames)
 {
     m_currentLine       = 1;
@@ -27,6 +31,7 @@ CodeWriter::CodeWriter(bool writeFileNames)
     m_spacesPerIndent   = 4;
     m_writeLines        = false;
     m_writeFileNames    = writeFileNames;
+    m_buffer.reserve(_initialBufferSize);
 }
 
 void CodeWriter::BeginLine(int indent, const char* fileName, int lineNumber)
@@ -67,10 +72,7 @@ void CodeWriter::BeginLine(int indent, const char* fileName, int lineNumber)
     }
 
     // Handle the indentation.
-    for (int i = 0; i < indent * m_spacesPerIndent; ++i)
-    {
-        m_buffer += " ";
-    }
+    m_buffer.append(indent * m_spacesPerIndent, ' ');
 }
 
 void CodeWriter::EndLine(const char* text)
@@ -107,10 +109,7 @@ void CodeWriter::WriteLine(int indent, const char* format, ...)
     ASSERT(result != -1);
     (void) result;
 
-    for (int i = 0; i < indent * m_spacesPerIndent; ++i)
-    {
-        m_buffer += " ";
-    }
+    m_buffer.append(indent * m_spacesPerIndent, ' ');
     m_buffer += buffer;
 
     EndLine();
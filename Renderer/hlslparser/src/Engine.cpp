@@ -2,7 +2,7 @@
 #include "Engine.h"
 
 #include <stdio.h>  // vsnprintf
-#include <string.h> // strcmp, strcasecmp
+#include <string.h> // strcmp, strcasecmp, memcpy
 #include <stdlib.h>	// strtod, strtol
 
 
@@ -94,76 +94,149 @@ void Log_ErrorArgList(const char * format, va_list args) {
 }
 
 
-// Engine/StringPool.cpp
+// Engine/MemoryArena.cpp
 
-StringPool::StringPool(Allocator * allocator) : stringArray(allocator) {
+MemoryArena::MemoryArena(size_t _blockSize) : blockSize(_blockSize), firstBlock(NULL), currentBlock(NULL), currentOffset(0) {
 }
-StringPool::~StringPool() {
-    for (int i = 0; i < stringArray.GetSize(); i++) {
-        free((void *)stringArray[i]);
-        stringArray[i] = NULL;
+
+MemoryArena::~MemoryArena() {
+    Block * block = firstBlock;
+    while (block != NULL) {
+        Block * next = block->next;
+        free(block);
+        block = next;
     }
 }
 
-const char * StringPool::AddString(const char * string) {
-    for (int i = 0; i < stringArray.GetSize(); i++) {
-        if (String_Equal(stringArray[i], string)) return stringArray[i];
+void * MemoryArena::Allocate(size_t size, size_t alignment) {
+    // Round the header up so block data keeps malloc's alignment.
+    const size_t header = (sizeof(Block) + 15) & ~size_t(15);
+    ASSERT(alignment <= 16 && (alignment & (alignment - 1)) == 0);
+
+    while (true) {
+        if (currentBlock != NULL) {
+            size_t offset = (currentOffset + alignment - 1) & ~(alignment - 1);
+            if (offset + size <= currentBlock->capacity) {
+                currentOffset = offset + size;
+                return (char *)currentBlock + header + offset;
+            }
+        }
+
+        // Move on to the next retained block, or chain a new one. Blocks too
+        // small for this request are skipped until the next Reset.
+        Block * next = currentBlock != NULL ? currentBlock->next : firstBlock;
+        if (next == NULL) {
+            size_t capacity = size > blockSize ? size : blockSize;
+            next = (Block *)malloc(header + capacity);
+            if (next == NULL) return NULL;
+            next->next = NULL;
+            next->capacity = capacity;
+            if (currentBlock != NULL) currentBlock->next = next;
+            else firstBlock = next;
+        }
+        currentBlock = next;
+        currentOffset = 0;
     }
-#if _MSC_VER
-    const char * dup = _strdup(string);
-#else
-    const char * dup = strdup(string);
-#endif
-    stringArray.PushBack(dup);
-    return dup;
 }
 
-// @@ From mprintf.cpp
-static char *mprintf_valist(int size, const char *fmt, va_list args) {
-    ASSERT(size > 0);
-    char *res = NULL;
-    va_list tmp;
+const char * MemoryArena::CopyString(const char * string, size_t length) {
+    char * copy = (char *)Allocate(length + 1, 1);
+    if (copy == NULL) return NULL;
+    memcpy(copy, string, length);
+    copy[length] = 0;
+    return copy;
+}
 
-    while (1) {
-        res = new char[size];
-        if (!res) return NULL;
+void MemoryArena::Reset() {
+    currentBlock = NULL;
+    currentOffset = 0;
+}
 
-        va_copy(tmp, args);
-        int len = vsnprintf(res, size, fmt, tmp);
-        va_end(tmp);
 
-        if ((len >= 0) && (size >= len + 1)) {
-            break;
-        }
+// Engine/StringPool.cpp
 
-        delete [] res;
+// FNV-1a
+static unsigned int String_Hash(const char * string, size_t length) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)string[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+StringPool::StringPool(MemoryArena * _arena) : arena(_arena), table(NULL), tableSize(0), count(0) {
+}
 
-        if (len > -1 ) {
-            size = len + 1;
+StringPool::~StringPool() {
+    // The strings themselves belong to the arena.
+    free(table);
+}
+
+// Returns the slot holding `string`, or the empty slot where it would go.
+int StringPool::FindSlot(const char * string, size_t length) const {
+    ASSERT(tableSize > 0);
+    int mask = tableSize - 1;
+    int slot = String_Hash(string, length) & mask;
+    while (table[slot] != NULL) {
+        if (strncmp(table[slot], string, length) == 0 && table[slot][length] == 0) {
+            return slot;
         }
-        else {
-            size *= 2;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void StringPool::Grow() {
+    const char ** oldTable = table;
+    int oldSize = tableSize;
+
+    tableSize = oldSize == 0 ? 256 : oldSize * 2;
+    table = (const char **)calloc(tableSize, sizeof(const char *));
+    for (int i = 0; i < oldSize; i++) {
+        if (oldTable[i] != NULL) {
+            table[FindSlot(oldTable[i], strlen(oldTable[i]))] = oldTable[i];
         }
     }
+    free(oldTable);
+}
+
+const char * StringPool::Intern(const char * string, size_t length) {
+    // Keep the load factor under 3/4.
+    if ((count + 1) * 4 > tableSize * 3) {
+        Grow();
+    }
+    int slot = FindSlot(string, length);
+    if (table[slot] == NULL) {
+        table[slot] = arena->CopyString(string, length);
+        count++;
+    }
+    return table[slot];
+}
 
-    return res;
+const char * StringPool::AddString(const char * string) {
+    return Intern(string, strlen(string));
 }
 
 const char * StringPool::AddStringFormatList(const char * format, va_list args) {
+    char buffer[256];
     va_list tmp;
     va_copy(tmp, args);
-    const char * string = mprintf_valist(256, format, tmp);
+    int length = vsnprintf(buffer, sizeof(buffer), format, tmp);
     va_end(tmp);
 
-    for (int i = 0; i < stringArray.GetSize(); i++) {
-        if (String_Equal(stringArray[i], string)) {
-            delete [] string;
-            return stringArray[i];
-        }
+    if (length < 0) return NULL;
+    if (length < (int)sizeof(buffer)) {
+        return Intern(buffer, length);
     }
 
-    stringArray.PushBack(string);
-    return string;
+    // Rare: format into arena memory. The scratch copy is wasted, but it goes
+    // away with the rest of the translation.
+    char * large = (char *)arena->Allocate(length + 1, 1);
+    va_copy(tmp, args);
+    vsnprintf(large, length + 1, format, tmp);
+    va_end(tmp);
+    return Intern(large, length);
 }
 
 const char * StringPool::AddStringFormat(const char * format, ...) {
@@ -176,10 +249,8 @@ const char * StringPool::AddStringFormat(const char * format, ...) {
 }
 
 bool StringPool::GetContainsString(const char * string) const {
-    for (int i = 0; i < stringArray.GetSize(); i++) {
-        if (String_Equal(stringArray[i], string)) return true;
-    }
-    return false;
+    if (tableSize == 0) return false;
+    return table[FindSlot(string, strlen(string))] != NULL;
 }
 
 } // M4 namespace
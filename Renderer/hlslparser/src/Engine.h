@@ -44,6 +44,44 @@ public:
 };
 
 
+// Engine/MemoryArena.h
+
+// Bump allocator for data that lives exactly as long as one translation. Memory
+// is taken from large blocks and only returned when the arena is reset or
+// destroyed, so a whole AST is released at once instead of node by node.
+// Destructors of objects placed in the arena are never run.
+class MemoryArena {
+public:
+    explicit MemoryArena(size_t blockSize = 64 * 1024);
+    ~MemoryArena();
+
+    void * Allocate(size_t size, size_t alignment);
+    template <typename T> T * New() {
+        return new(Allocate(sizeof(T), alignof(T))) T();
+    }
+
+    // Returns a NUL terminated copy of the first `length` bytes of `string`.
+    const char * CopyString(const char * string, size_t length);
+
+    // Makes all blocks available again without returning them to the heap.
+    void Reset();
+
+private:
+    struct Block {
+        Block * next;
+        size_t  capacity;
+    };
+
+    MemoryArena(const MemoryArena &);
+    MemoryArena & operator=(const MemoryArena &);
+
+    size_t  blockSize;
+    Block * firstBlock;
+    Block * currentBlock;
+    size_t  currentOffset;
+};
+
+
 // Engine/String.h
 
 int String_Printf(char * buffer, int size, const char * format, ...);
@@ -89,6 +127,11 @@ template <typename T>
 class Array {
 public:
     Array(Allocator * _allocator) : allocator(_allocator), buffer(NULL), size(0), capacity(0) {}
+    ~Array() {
+        DestroyRange(buffer, 0, size);
+        size = 0;
+        SetCapacity(0);
+    }
 
     void PushBack(const T & val) {
         ASSERT(&val < buffer || &val >= buffer+size);
@@ -165,6 +208,9 @@ private:
     }
 
 
+    Array(const Array &);
+    Array & operator=(const Array &);
+
 private:
     Allocator * allocator; // @@ Do we really have to keep a pointer to this?
     T * buffer;
@@ -175,9 +221,10 @@ private:
 
 // Engine/StringPool.h
 
-// @@ Implement this with a hash table!
+// Interns strings in a MemoryArena. Lookups go through an open addressing hash
+// table, so each distinct string costs one arena copy and nothing else.
 struct StringPool {
-    StringPool(Allocator * allocator);
+    StringPool(MemoryArena * arena);
     ~StringPool();
 
     const char * AddString(const char * string);
@@ -185,7 +232,15 @@ struct StringPool {
     const char * AddStringFormatList(const char * fmt, va_list args);
     bool GetContainsString(const char * string) const;
 
-    Array<const char *> stringArray;
+private:
+    int FindSlot(const char * string, size_t length) const;
+    const char * Intern(const char * string, size_t length);
+    void Grow();
+
+    MemoryArena * arena;
+    const char ** table;
+    int tableSize; // power of two
+    int count;
 };
 
 
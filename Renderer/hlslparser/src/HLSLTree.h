@@ -973,7 +973,7 @@ public:
     template <class T>
     T* AddNode(const char* fileName, int line)
     {
-        HLSLNode* node = new (AllocateMemory(sizeof(T))) T();
+        HLSLNode* node = m_arena.New<T>();
         node->nodeType  = T::s_type;
         node->fileName  = fileName;
         node->line      = line;
@@ -998,27 +998,12 @@ public:
 
 private:
 
-    void* AllocateMemory(size_t size);
-    void  AllocatePage();
-
-private:
-
-    static const size_t s_nodePageSize = 1024 * 4;
-
-    struct NodePage
-    {
-        NodePage*   next;
-        char        buffer[s_nodePageSize];
-    };
-
     Allocator*      m_allocator;
+    // Owns every node and pooled string; all of it is released with the tree.
+    MemoryArena     m_arena;
     StringPool      m_stringPool;
     HLSLRoot*       m_root;
 
-    NodePage*       m_firstPage;
-    NodePage*       m_currentPage;
-    size_t          m_currentPageOffset;
-
 };
 
 
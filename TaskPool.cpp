@@ -0,0 +1,185 @@
+#include "TaskPool.hpp"
+
+namespace {
+// Index of the queue owned by the current thread; 0 for threads that are not
+// pool workers.
+thread_local int current_queue = 0;
+
+int DefaultWorkerCount() {
+#ifdef USE_THREADS
+  const int cores = static_cast<int>(std::thread::hardware_concurrency());
+  // The thread waiting on a group runs tasks too.
+  return cores > 1 ? cores - 1 : 0;
+#else
+  return 0;
+#endif
+}
+}  // namespace
+
+bool TaskPool::Queue::Push(const Task &task) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (size == kCapacity) {
+    return false;
+  }
+  tasks[(head + size) % kCapacity] = task;
+  size++;
+  return true;
+}
+
+bool TaskPool::Queue::PopNewest(Task *task) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (size == 0) {
+    return false;
+  }
+  size--;
+  *task = tasks[(head + size) % kCapacity];
+  return true;
+}
+
+bool TaskPool::Queue::StealOldest(Task *task) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (size == 0) {
+    return false;
+  }
+  *task = tasks[head];
+  head = (head + 1) % kCapacity;
+  size--;
+  return true;
+}
+
+bool TaskPool::Queue::TakeFromGroup(const TaskGroup *group, Task *task) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (int i = size - 1; i >= 0; i--) {
+    if (tasks[(head + i) % kCapacity].group != group) {
+      continue;
+    }
+    *task = tasks[(head + i) % kCapacity];
+    for (int j = i + 1; j < size; j++) {
+      tasks[(head + j - 1) % kCapacity] = tasks[(head + j) % kCapacity];
+    }
+    size--;
+    return true;
+  }
+  return false;
+}
+
+TaskPool &TaskPool::Instance() {
+  static TaskPool instance(DefaultWorkerCount());
+  return instance;
+}
+
+TaskPool::TaskPool(int worker_count)
+    : queues_(worker_count + 1), queued_(0), stop_(false) {
+  workers_.reserve(worker_count);
+  for (int i = 0; i < worker_count; i++) {
+    workers_.emplace_back(&TaskPool::WorkerMain, this, i + 1);
+  }
+}
+
+TaskPool::~TaskPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  sleep_cv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void TaskPool::Submit(const Task &task) {
+  if (!queues_[current_queue].Push(task)) {
+    Execute(task);
+    return;
+  }
+  queued_.fetch_add(1, std::memory_order_release);
+  if (!workers_.empty()) {
+    // Taking the lock orders the increment against a worker that is about to
+    // sleep, so the notification cannot be lost.
+    { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+    sleep_cv_.notify_one();
+  }
+}
+
+bool TaskPool::RunOne() {
+  if (queued_.load(std::memory_order_acquire) == 0) {
+    return false;
+  }
+
+  Task task;
+  bool found = queues_[current_queue].PopNewest(&task);
+  const int queue_count = static_cast<int>(queues_.size());
+  for (int i = 1; !found && i < queue_count; i++) {
+    found = queues_[(current_queue + i) % queue_count].StealOldest(&task);
+  }
+  if (!found) {
+    return false;
+  }
+
+  queued_.fetch_sub(1, std::memory_order_relaxed);
+  Execute(task);
+  return true;
+}
+
+bool TaskPool::RunOneFromGroup(const TaskGroup *group) {
+  if (queued_.load(std::memory_order_acquire) == 0) {
+    return false;
+  }
+
+  Task task;
+  bool found = false;
+  const int queue_count = static_cast<int>(queues_.size());
+  for (int i = 0; !found && i < queue_count; i++) {
+    found = queues_[(current_queue + i) % queue_count].TakeFromGroup(group,
+                                                                     &task);
+  }
+  if (!found) {
+    return false;
+  }
+
+  queued_.fetch_sub(1, std::memory_order_relaxed);
+  Execute(task);
+  return true;
+}
+
+void TaskPool::Execute(const Task &task) {
+  task.run(task.context, task.begin, task.end);
+  TaskGroup *group = task.group;
+  std::lock_guard<std::mutex> lock(group->done_mutex_);
+  if (group->outstanding_.fetch_sub(1, std::memory_order_release) == 1) {
+    group->done_cv_.notify_all();
+  }
+}
+
+void TaskPool::WorkerMain(int index) {
+  current_queue = index;
+  while (true) {
+    if (RunOne()) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleep_cv_.wait(lock, [this] {
+      return stop_ || queued_.load(std::memory_order_acquire) > 0;
+    });
+    if (stop_) {
+      return;
+    }
+  }
+}
+
+void TaskGroup::Submit(void (*run)(void *, int, int), void *context,
+                       int begin, int end) {
+  outstanding_.fetch_add(1, std::memory_order_relaxed);
+  pool_.Submit(TaskPool::Task{run, context, begin, end, this});
+}
+
+void TaskGroup::Wait() {
+  while (pool_.RunOneFromGroup(this)) {
+  }
+  // What is left was taken by workers. Returning only with the lock, after
+  // the last task released it, keeps the group alive until it is unused.
+  std::unique_lock<std::mutex> lock(done_mutex_);
+  done_cv_.wait(lock, [this] {
+    return outstanding_.load(std::memory_order_acquire) == 0;
+  });
+}
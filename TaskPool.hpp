@@ -0,0 +1,161 @@
+#ifndef TaskPool_HPP
+#define TaskPool_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGroup;
+
+/// Process wide pool of worker threads shared by every projectM instance.
+///
+/// Each worker owns a bounded queue; it takes its own work newest first and,
+/// when that runs dry, steals the oldest task of another queue. Threads that
+/// are not workers (the render thread) push to a shared queue. A thread that
+/// waits for a TaskGroup runs the group's queued tasks itself, then sleeps
+/// until the ones other threads took have finished. It never picks up the
+/// tasks of other groups, which may be far longer than its own. Tasks may
+/// start and wait for nested groups without deadlocking: every task of a
+/// group is either queued, where its waiter can run it, or running.
+///
+/// Tasks are plain function pointers plus a context, so scheduling does not
+/// allocate. Without USE_THREADS the pool has no workers and every task runs
+/// on the thread that waits for it.
+class TaskPool {
+ public:
+  static TaskPool &Instance();
+
+  ~TaskPool();
+
+  /// Number of worker threads, not counting threads that wait on a group.
+  int WorkerCount() const { return static_cast<int>(workers_.size()); }
+
+ private:
+  friend class TaskGroup;
+
+  struct Task {
+    void (*run)(void *context, int begin, int end);
+    void *context;
+    int begin;
+    int end;
+    TaskGroup *group;
+  };
+
+  // Fixed capacity ring buffer; Push fails when it is full and the caller
+  // runs the task itself.
+  struct Queue {
+    static constexpr int kCapacity = 256;
+
+    std::mutex mutex;
+    Task tasks[kCapacity];
+    int head = 0;
+    int size = 0;
+
+    bool Push(const Task &task);
+    bool PopNewest(Task *task);
+    bool StealOldest(Task *task);
+    // Removes the newest task of `group`.
+    bool TakeFromGroup(const TaskGroup *group, Task *task);
+  };
+
+  explicit TaskPool(int worker_count);
+  TaskPool(const TaskPool &) = delete;
+  TaskPool &operator=(const TaskPool &) = delete;
+
+  void Submit(const Task &task);
+  // Runs one queued task, preferring the calling worker's own queue. Returns
+  // false if every queue was empty.
+  bool RunOne();
+  // Runs one queued task of `group`. Returns false if none is queued.
+  bool RunOneFromGroup(const TaskGroup *group);
+  void Execute(const Task &task);
+  void WorkerMain(int index);
+
+  // queues_[0] is shared by non-worker threads, queues_[i + 1] belongs to
+  // worker i.
+  std::vector<Queue> queues_;
+  std::vector<std::thread> workers_;
+
+  std::atomic<int> queued_;
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+  bool stop_;
+};
+
+/// A set of tasks that are waited for together. Callables passed to Run and
+/// ParallelFor are referenced, not copied, and must outlive Wait(). Tasks are
+/// added by the thread that waits for the group, not by the group's own tasks.
+class TaskGroup {
+ public:
+  explicit TaskGroup(TaskPool &pool = TaskPool::Instance())
+      : pool_(pool), outstanding_(0) {}
+  ~TaskGroup() { Wait(); }
+
+  TaskGroup(const TaskGroup &) = delete;
+  TaskGroup &operator=(const TaskGroup &) = delete;
+
+  /// Queues `function()`.
+  template <typename Function>
+  void Run(Function &function) {
+    Submit(&CallFunction<Function>, &function, 0, 0);
+  }
+
+  /// Queues `body(chunk_begin, chunk_end)` for consecutive chunks of at most
+  /// `grain` indices covering [begin, end).
+  template <typename Body>
+  void ParallelFor(int begin, int end, int grain, Body &body) {
+    if (grain < 1) {
+      grain = 1;
+    }
+    for (int chunk = begin; chunk < end; chunk += grain) {
+      const int chunk_end = end - chunk > grain ? chunk + grain : end;
+      Submit(&CallBody<Body>, &body, chunk, chunk_end);
+    }
+  }
+
+  /// Runs the queued tasks of this group, then sleeps until the ones running
+  /// on other threads have finished.
+  void Wait();
+
+ private:
+  friend class TaskPool;
+
+  template <typename Function>
+  static void CallFunction(void *context, int, int) {
+    (*static_cast<Function *>(context))();
+  }
+
+  template <typename Body>
+  static void CallBody(void *context, int begin, int end) {
+    (*static_cast<Body *>(context))(begin, end);
+  }
+
+  void Submit(void (*run)(void *, int, int), void *context, int begin,
+              int end);
+
+  TaskPool &pool_;
+  std::atomic<int> outstanding_;
+  // Held while a task is counted off, so Wait() cannot return, and the group
+  // go away, before the task's thread is done with it.
+  std::mutex done_mutex_;
+  std::condition_variable done_cv_;
+};
+
+/// Runs `body(chunk_begin, chunk_end)` over [begin, end) on the shared pool
+/// and returns once every chunk has finished.
+template <typename Body>
+void ParallelFor(int begin, int end, int grain, Body &&body) {
+  if (end - begin <= grain || TaskPool::Instance().WorkerCount() == 0) {
+    if (begin < end) {
+      body(begin, end);
+    }
+    return;
+  }
+  TaskGroup group;
+  group.ParallelFor(begin, end, grain, body);
+  group.Wait();
+}
+
+#endif
@@ -6,6 +6,9 @@
 #include <MilkdropPresetFactory/Parser.hpp>
 #include <TestRunner.hpp>
 #include <MilkdropPresetFactory/Param.hpp>
+#include <MilkdropPresetFactory/PresetCode.hpp>
+#include <PCM.hpp>
+#include <PCMMixer.hpp>
 
 std::vector<Test *> TestRunner::tests;
 
@@ -19,6 +22,9 @@ bool TestRunner::run()
         tests.push_back(Param::test());
         tests.push_back(Parser::test());
         tests.push_back(Expr::test());
+        tests.push_back(PresetCode::test());
+        tests.push_back(PCM::test());
+        tests.push_back(PCMMixer::test());
     }
 
     int count = 0;
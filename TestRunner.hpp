@@ -9,6 +9,7 @@
 #define PROJECTM_LUA_TESTRUNNER_H
 
 
+#include <iostream>
 #include <string>
 #include <vector>
 
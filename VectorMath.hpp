@@ -0,0 +1,531 @@
+#ifndef VectorMath_HPP
+#define VectorMath_HPP
+
+// Vectorized single precision sin/cos/exp/log/pow.
+//
+// The kernels are the Cephes single precision algorithms (the same ones used
+// by sse_mathfun / neon_mathfun) written once against a small set of backend
+// primitives. The SSE2, NEON and scalar backends round identically; AVX2 uses
+// fused multiply-add when available and may differ from them in the last bit.
+//
+// Error measured against double precision libm:
+//
+//   sin, cos, sincos   absolute error < 8e-8 for |x| <= 8192, which is
+//                      < 2 ulp wherever |result| > 0.05. The three-constant
+//                      Cody-Waite reduction degrades slowly above that
+//                      (about 1e-6 absolute at |x| = 1e5).
+//   exp                < 1 ulp on [-87.3, 88.3]; flushed to 0 below and
+//                      clamped to 2.4e38 above.
+//   log                < 1 ulp on normal positive inputs, NaN for x <= 0.
+//   pow                exp(y * log|x|), so the relative error scales with
+//                      |y * ln x|: < 2 ulp while it is < 1, < 17 ulp while it
+//                      is < 10. Negative bases with integral exponents
+//                      follow C pow(); pow(0, y) is 0, 1 or inf.
+//
+// Denormal and NaN inputs are not handled specially. None of the kernels set
+// errno.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace vmath {
+
+// Portable fallback, one lane. Masks are represented as all-ones bit patterns
+// stored in a float, exactly like the SIMD backends.
+struct Scalar {
+  typedef float vf;
+  typedef int32_t vi;
+  static const int width = 1;
+
+  static vf castf(vi a) { vf r; std::memcpy(&r, &a, sizeof(r)); return r; }
+  static vi casti(vf a) { vi r; std::memcpy(&r, &a, sizeof(r)); return r; }
+
+  static vf set1(float a) { return a; }
+  static vi set1i(int32_t a) { return a; }
+  static vf load(const float* p) { return *p; }
+  static void store(float* p, vf a) { *p = a; }
+
+  static vf add(vf a, vf b) { return a + b; }
+  static vf sub(vf a, vf b) { return a - b; }
+  static vf mul(vf a, vf b) { return a * b; }
+  static vf div(vf a, vf b) { return a / b; }
+  static vf madd(vf a, vf b, vf c) { return a * b + c; }
+  static vf min(vf a, vf b) { return a < b ? a : b; }
+  static vf max(vf a, vf b) { return a > b ? a : b; }
+
+  static vf and_(vf a, vf b) { return castf(casti(a) & casti(b)); }
+  static vf or_(vf a, vf b) { return castf(casti(a) | casti(b)); }
+  static vf xor_(vf a, vf b) { return castf(casti(a) ^ casti(b)); }
+  static vf andnot(vf a, vf b) { return castf(~casti(a) & casti(b)); }
+
+  static vf mask(bool m) { return castf(m ? -1 : 0); }
+  static vf cmplt(vf a, vf b) { return mask(a < b); }
+  static vf cmple(vf a, vf b) { return mask(a <= b); }
+  static vf cmpeq(vf a, vf b) { return mask(a == b); }
+
+  static vi cvtt(vf a) { return static_cast<vi>(a); }
+  static vf tof(vi a) { return static_cast<vf>(a); }
+
+  static vi iadd(vi a, vi b) { return a + b; }
+  static vi isub(vi a, vi b) { return a - b; }
+  static vi iand(vi a, vi b) { return a & b; }
+  static vi iandnot(vi a, vi b) { return ~a & b; }
+  static vi icmpeq(vi a, vi b) { return a == b ? -1 : 0; }
+  template <int N>
+  static vi slli(vi a) { return static_cast<vi>(static_cast<uint32_t>(a) << N); }
+  template <int N>
+  static vi srli(vi a) { return static_cast<vi>(static_cast<uint32_t>(a) >> N); }
+};
+
+#if defined(__SSE2__)
+struct Sse2 {
+  typedef __m128 vf;
+  typedef __m128i vi;
+  static const int width = 4;
+
+  static vf castf(vi a) { return _mm_castsi128_ps(a); }
+  static vi casti(vf a) { return _mm_castps_si128(a); }
+
+  static vf set1(float a) { return _mm_set1_ps(a); }
+  static vi set1i(int32_t a) { return _mm_set1_epi32(a); }
+  static vf load(const float* p) { return _mm_loadu_ps(p); }
+  static void store(float* p, vf a) { _mm_storeu_ps(p, a); }
+
+  static vf add(vf a, vf b) { return _mm_add_ps(a, b); }
+  static vf sub(vf a, vf b) { return _mm_sub_ps(a, b); }
+  static vf mul(vf a, vf b) { return _mm_mul_ps(a, b); }
+  static vf div(vf a, vf b) { return _mm_div_ps(a, b); }
+  static vf madd(vf a, vf b, vf c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+  static vf min(vf a, vf b) { return _mm_min_ps(a, b); }
+  static vf max(vf a, vf b) { return _mm_max_ps(a, b); }
+
+  static vf and_(vf a, vf b) { return _mm_and_ps(a, b); }
+  static vf or_(vf a, vf b) { return _mm_or_ps(a, b); }
+  static vf xor_(vf a, vf b) { return _mm_xor_ps(a, b); }
+  static vf andnot(vf a, vf b) { return _mm_andnot_ps(a, b); }
+
+  static vf cmplt(vf a, vf b) { return _mm_cmplt_ps(a, b); }
+  static vf cmple(vf a, vf b) { return _mm_cmple_ps(a, b); }
+  static vf cmpeq(vf a, vf b) { return _mm_cmpeq_ps(a, b); }
+
+  static vi cvtt(vf a) { return _mm_cvttps_epi32(a); }
+  static vf tof(vi a) { return _mm_cvtepi32_ps(a); }
+
+  static vi iadd(vi a, vi b) { return _mm_add_epi32(a, b); }
+  static vi isub(vi a, vi b) { return _mm_sub_epi32(a, b); }
+  static vi iand(vi a, vi b) { return _mm_and_si128(a, b); }
+  static vi iandnot(vi a, vi b) { return _mm_andnot_si128(a, b); }
+  static vi icmpeq(vi a, vi b) { return _mm_cmpeq_epi32(a, b); }
+  template <int N>
+  static vi slli(vi a) { return _mm_slli_epi32(a, N); }
+  template <int N>
+  static vi srli(vi a) { return _mm_srli_epi32(a, N); }
+};
+#endif
+
+#if defined(__AVX2__)
+struct Avx2 {
+  typedef __m256 vf;
+  typedef __m256i vi;
+  static const int width = 8;
+
+  static vf castf(vi a) { return _mm256_castsi256_ps(a); }
+  static vi casti(vf a) { return _mm256_castps_si256(a); }
+
+  static vf set1(float a) { return _mm256_set1_ps(a); }
+  static vi set1i(int32_t a) { return _mm256_set1_epi32(a); }
+  static vf load(const float* p) { return _mm256_loadu_ps(p); }
+  static void store(float* p, vf a) { _mm256_storeu_ps(p, a); }
+
+  static vf add(vf a, vf b) { return _mm256_add_ps(a, b); }
+  static vf sub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+  static vf mul(vf a, vf b) { return _mm256_mul_ps(a, b); }
+  static vf div(vf a, vf b) { return _mm256_div_ps(a, b); }
+#if defined(__FMA__)
+  static vf madd(vf a, vf b, vf c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+  static vf madd(vf a, vf b, vf c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+  static vf min(vf a, vf b) { return _mm256_min_ps(a, b); }
+  static vf max(vf a, vf b) { return _mm256_max_ps(a, b); }
+
+  static vf and_(vf a, vf b) { return _mm256_and_ps(a, b); }
+  static vf or_(vf a, vf b) { return _mm256_or_ps(a, b); }
+  static vf xor_(vf a, vf b) { return _mm256_xor_ps(a, b); }
+  static vf andnot(vf a, vf b) { return _mm256_andnot_ps(a, b); }
+
+  static vf cmplt(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+  static vf cmple(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+  static vf cmpeq(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+
+  static vi cvtt(vf a) { return _mm256_cvttps_epi32(a); }
+  static vf tof(vi a) { return _mm256_cvtepi32_ps(a); }
+
+  static vi iadd(vi a, vi b) { return _mm256_add_epi32(a, b); }
+  static vi isub(vi a, vi b) { return _mm256_sub_epi32(a, b); }
+  static vi iand(vi a, vi b) { return _mm256_and_si256(a, b); }
+  static vi iandnot(vi a, vi b) { return _mm256_andnot_si256(a, b); }
+  static vi icmpeq(vi a, vi b) { return _mm256_cmpeq_epi32(a, b); }
+  template <int N>
+  static vi slli(vi a) { return _mm256_slli_epi32(a, N); }
+  template <int N>
+  static vi srli(vi a) { return _mm256_srli_epi32(a, N); }
+};
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+struct Neon {
+  typedef float32x4_t vf;
+  typedef int32x4_t vi;
+  static const int width = 4;
+
+  static vf castf(vi a) { return vreinterpretq_f32_s32(a); }
+  static vi casti(vf a) { return vreinterpretq_s32_f32(a); }
+  static vf castm(uint32x4_t a) { return vreinterpretq_f32_u32(a); }
+
+  static vf set1(float a) { return vdupq_n_f32(a); }
+  static vi set1i(int32_t a) { return vdupq_n_s32(a); }
+  static vf load(const float* p) { return vld1q_f32(p); }
+  static void store(float* p, vf a) { vst1q_f32(p, a); }
+
+  static vf add(vf a, vf b) { return vaddq_f32(a, b); }
+  static vf sub(vf a, vf b) { return vsubq_f32(a, b); }
+  static vf mul(vf a, vf b) { return vmulq_f32(a, b); }
+#if defined(__aarch64__)
+  static vf div(vf a, vf b) { return vdivq_f32(a, b); }
+#else
+  // ARMv7 has no vector divide; two Newton-Raphson steps give full precision
+  // for the operands used here.
+  static vf div(vf a, vf b) {
+    float32x4_t r = vrecpeq_f32(b);
+    r = vmulq_f32(vrecpsq_f32(b, r), r);
+    r = vmulq_f32(vrecpsq_f32(b, r), r);
+    return vmulq_f32(a, r);
+  }
+#endif
+  // vmlaq is a separate multiply and add on ARMv7, keeping results identical
+  // to the other backends.
+  static vf madd(vf a, vf b, vf c) { return vmlaq_f32(c, a, b); }
+  static vf min(vf a, vf b) { return vminq_f32(a, b); }
+  static vf max(vf a, vf b) { return vmaxq_f32(a, b); }
+
+  static vf and_(vf a, vf b) { return castf(vandq_s32(casti(a), casti(b))); }
+  static vf or_(vf a, vf b) { return castf(vorrq_s32(casti(a), casti(b))); }
+  static vf xor_(vf a, vf b) { return castf(veorq_s32(casti(a), casti(b))); }
+  static vf andnot(vf a, vf b) { return castf(vbicq_s32(casti(b), casti(a))); }
+
+  static vf cmplt(vf a, vf b) { return castm(vcltq_f32(a, b)); }
+  static vf cmple(vf a, vf b) { return castm(vcleq_f32(a, b)); }
+  static vf cmpeq(vf a, vf b) { return castm(vceqq_f32(a, b)); }
+
+  static vi cvtt(vf a) { return vcvtq_s32_f32(a); }
+  static vf tof(vi a) { return vcvtq_f32_s32(a); }
+
+  static vi iadd(vi a, vi b) { return vaddq_s32(a, b); }
+  static vi isub(vi a, vi b) { return vsubq_s32(a, b); }
+  static vi iand(vi a, vi b) { return vandq_s32(a, b); }
+  static vi iandnot(vi a, vi b) { return vbicq_s32(b, a); }
+  static vi icmpeq(vi a, vi b) { return vreinterpretq_s32_u32(vceqq_s32(a, b)); }
+  template <int N>
+  static vi slli(vi a) { return vshlq_n_s32(a, N); }
+  template <int N>
+  static vi srli(vi a) {
+    return vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(a), N));
+  }
+};
+#endif
+
+#if defined(__AVX2__)
+typedef Avx2 Native;
+#elif defined(__SSE2__)
+typedef Sse2 Native;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+typedef Neon Native;
+#else
+typedef Scalar Native;
+#endif
+
+// Largest lane count of any backend. Buffers padded to a multiple of this can
+// be processed without a scalar tail.
+static const int kMaxWidth = 8;
+
+template <class B>
+inline typename B::vf select(typename B::vf mask, typename B::vf a,
+                             typename B::vf b) {
+  return B::or_(B::and_(mask, a), B::andnot(mask, b));
+}
+
+template <class B>
+inline typename B::vf abs(typename B::vf x) {
+  return B::andnot(B::castf(B::set1i(0x80000000)), x);
+}
+
+// floor() for |x| < 2^31.
+template <class B>
+inline typename B::vf floor(typename B::vf x) {
+  typedef typename B::vf vf;
+  const vf t = B::tof(B::cvtt(x));
+  return B::sub(t, B::and_(B::cmplt(x, t), B::set1(1.0f)));
+}
+
+template <class B>
+inline void sincos(typename B::vf x, typename B::vf& s, typename B::vf& c) {
+  typedef typename B::vf vf;
+  typedef typename B::vi vi;
+
+  vf sign_sin = B::and_(x, B::castf(B::set1i(0x80000000)));
+  x = abs<B>(x);
+
+  // j = (int)(x * 4/pi), rounded up to an even octant.
+  vi j = B::cvtt(B::mul(x, B::set1(1.27323954473516f)));
+  j = B::iand(B::iadd(j, B::set1i(1)), B::set1i(~1));
+  const vf y = B::tof(j);
+
+  const vf swap_sign_sin = B::castf(B::template slli<29>(B::iand(j, B::set1i(4))));
+  const vf sign_cos = B::castf(B::template slli<29>(
+      B::iandnot(B::isub(j, B::set1i(2)), B::set1i(4))));
+  const vf poly_mask = B::castf(B::icmpeq(B::iand(j, B::set1i(2)), B::set1i(0)));
+  sign_sin = B::xor_(sign_sin, swap_sign_sin);
+
+  // Extended precision modular arithmetic: x - y * pi/4.
+  x = B::madd(y, B::set1(-0.78515625f), x);
+  x = B::madd(y, B::set1(-2.4187564849853515625e-4f), x);
+  x = B::madd(y, B::set1(-3.77489497744594108e-8f), x);
+
+  const vf z = B::mul(x, x);
+
+  vf pc = B::set1(2.443315711809948e-5f);
+  pc = B::madd(pc, z, B::set1(-1.388731625493765e-3f));
+  pc = B::madd(pc, z, B::set1(4.166664568298827e-2f));
+  pc = B::mul(B::mul(pc, z), z);
+  pc = B::madd(z, B::set1(-0.5f), pc);
+  pc = B::add(pc, B::set1(1.0f));
+
+  vf ps = B::set1(-1.9515295891e-4f);
+  ps = B::madd(ps, z, B::set1(8.3321608736e-3f));
+  ps = B::madd(ps, z, B::set1(-1.6666654611e-1f));
+  ps = B::mul(B::mul(ps, z), x);
+  ps = B::add(ps, x);
+
+  s = B::xor_(select<B>(poly_mask, ps, pc), sign_sin);
+  c = B::xor_(select<B>(poly_mask, pc, ps), sign_cos);
+}
+
+template <class B>
+inline typename B::vf sin(typename B::vf x) {
+  typename B::vf s, c;
+  sincos<B>(x, s, c);
+  return s;
+}
+
+template <class B>
+inline typename B::vf cos(typename B::vf x) {
+  typename B::vf s, c;
+  sincos<B>(x, s, c);
+  return c;
+}
+
+template <class B>
+inline typename B::vf exp(typename B::vf x) {
+  typedef typename B::vf vf;
+
+  const vf underflow = B::cmplt(x, B::set1(-87.3365447505f));
+  x = B::min(x, B::set1(88.3762626647949f));
+  x = B::max(x, B::set1(-88.3762626647949f));
+
+  // exp(x) = 2^n * exp(g), |g| <= ln2 / 2
+  const vf fx = floor<B>(B::madd(x, B::set1(1.44269504088896341f), B::set1(0.5f)));
+  x = B::madd(fx, B::set1(-0.693359375f), x);
+  x = B::madd(fx, B::set1(2.12194440e-4f), x);
+
+  const vf z = B::mul(x, x);
+  vf y = B::set1(1.9875691500e-4f);
+  y = B::madd(y, x, B::set1(1.3981999507e-3f));
+  y = B::madd(y, x, B::set1(8.3334519073e-3f));
+  y = B::madd(y, x, B::set1(4.1665795894e-2f));
+  y = B::madd(y, x, B::set1(1.6666665459e-1f));
+  y = B::madd(y, x, B::set1(5.0000001201e-1f));
+  y = B::madd(y, z, x);
+  y = B::add(y, B::set1(1.0f));
+
+  // 2^n with n in [-126, 128] does not fit a single exponent field at the top
+  // end, so scale by 2^floor(n/2) and 2^(n - floor(n/2)).
+  const typename B::vi n = B::cvtt(fx);
+  const typename B::vi n1 = B::isub(
+      B::template srli<1>(B::iadd(n, B::set1i(0x80000000))), B::set1i(0x40000000));
+  const typename B::vi n2 = B::isub(n, n1);
+  y = B::mul(y, B::castf(B::template slli<23>(B::iadd(n1, B::set1i(0x7f)))));
+  y = B::mul(y, B::castf(B::template slli<23>(B::iadd(n2, B::set1i(0x7f)))));
+
+  return B::andnot(underflow, y);
+}
+
+template <class B>
+inline typename B::vf log(typename B::vf x) {
+  typedef typename B::vf vf;
+  typedef typename B::vi vi;
+
+  const vf invalid = B::cmple(x, B::set1(0.0f));
+  x = B::max(x, B::castf(B::set1i(0x00800000)));  // smallest normal
+
+  const vi bits = B::casti(x);
+  vf e = B::tof(B::isub(B::template srli<23>(bits), B::set1i(0x7f)));
+  e = B::add(e, B::set1(1.0f));
+
+  // mantissa in [0.5, 1)
+  x = B::castf(B::iand(bits, B::set1i(~0x7f800000)));
+  x = B::or_(x, B::set1(0.5f));
+
+  const vf mask = B::cmplt(x, B::set1(0.707106781186547524f));
+  const vf tmp = B::and_(x, mask);
+  x = B::sub(x, B::set1(1.0f));
+  e = B::sub(e, B::and_(B::set1(1.0f), mask));
+  x = B::add(x, tmp);
+
+  const vf z = B::mul(x, x);
+  vf y = B::set1(7.0376836292e-2f);
+  y = B::madd(y, x, B::set1(-1.1514610310e-1f));
+  y = B::madd(y, x, B::set1(1.1676998740e-1f));
+  y = B::madd(y, x, B::set1(-1.2420140846e-1f));
+  y = B::madd(y, x, B::set1(1.4249322787e-1f));
+  y = B::madd(y, x, B::set1(-1.6668057665e-1f));
+  y = B::madd(y, x, B::set1(2.0000714765e-1f));
+  y = B::madd(y, x, B::set1(-2.4999993993e-1f));
+  y = B::madd(y, x, B::set1(3.3333331174e-1f));
+  y = B::mul(B::mul(y, x), z);
+
+  y = B::madd(e, B::set1(-2.12194440e-4f), y);
+  y = B::madd(z, B::set1(-0.5f), y);
+  x = B::add(x, y);
+  x = B::madd(e, B::set1(0.693359375f), x);
+
+  return B::or_(x, invalid);  // NaN
+}
+
+template <class B>
+inline typename B::vf pow(typename B::vf x, typename B::vf y) {
+  typedef typename B::vf vf;
+  typedef typename B::vi vi;
+
+  const vf zero = B::set1(0.0f);
+  const vf ax = abs<B>(x);
+  vf r = exp<B>(B::mul(y, log<B>(ax)));
+
+  // Negative base: only defined for integral exponents. Every float with
+  // |y| >= 2^23 is an even integer.
+  const vf ay = abs<B>(y);
+  const vf big = B::cmple(B::set1(8388608.0f), ay);
+  const vf fy = B::min(ay, B::set1(8388608.0f));
+  const vf integral = B::or_(big, B::cmpeq(floor<B>(fy), fy));
+  const vi odd_bit = B::iand(B::cvtt(fy), B::set1i(1));
+  const vf odd = B::andnot(big, B::castf(B::template slli<31>(odd_bit)));
+  const vf negative = B::cmplt(x, zero);
+  r = select<B>(negative,
+                B::or_(B::xor_(r, odd), B::castf(B::iandnot(B::casti(integral),
+                                                            B::set1i(-1)))),
+                r);
+
+  // pow(0, y): 0 for y > 0, 1 for y == 0, inf for y < 0.
+  const vf base_zero = B::cmpeq(ax, zero);
+  const vf zero_result =
+      select<B>(B::cmplt(zero, y), zero,
+                select<B>(B::cmpeq(y, zero), B::set1(1.0f),
+                          B::castf(B::set1i(0x7f800000))));
+  r = select<B>(base_zero, zero_result, r);
+
+  // pow(x, 0) is 1 for every x.
+  return select<B>(B::cmpeq(y, zero), B::set1(1.0f), r);
+}
+
+// Array kernels. Inputs and outputs may alias; no alignment is required. The
+// tail is evaluated through a padded vector so that every element gets the
+// same rounding regardless of its position in the array.
+namespace detail {
+template <class B, class F>
+inline void map1(const float* in, float* out, std::size_t n, F f) {
+  std::size_t i = 0;
+  for (; i + B::width <= n; i += B::width) {
+    B::store(out + i, f(B::load(in + i)));
+  }
+  if (i < n) {
+    float a[B::width] = {0};
+    float r[B::width];
+    std::memcpy(a, in + i, (n - i) * sizeof(float));
+    B::store(r, f(B::load(a)));
+    std::memcpy(out + i, r, (n - i) * sizeof(float));
+  }
+}
+
+template <class B, class F>
+inline void map2(const float* in0, const float* in1, float* out, std::size_t n,
+                 F f) {
+  std::size_t i = 0;
+  for (; i + B::width <= n; i += B::width) {
+    B::store(out + i, f(B::load(in0 + i), B::load(in1 + i)));
+  }
+  if (i < n) {
+    float a[B::width] = {0};
+    float b[B::width] = {0};
+    float r[B::width];
+    std::memcpy(a, in0 + i, (n - i) * sizeof(float));
+    std::memcpy(b, in1 + i, (n - i) * sizeof(float));
+    B::store(r, f(B::load(a), B::load(b)));
+    std::memcpy(out + i, r, (n - i) * sizeof(float));
+  }
+}
+}  // namespace detail
+
+inline void sin(const float* in, float* out, std::size_t n) {
+  detail::map1<Native>(in, out, n, [](Native::vf x) { return sin<Native>(x); });
+}
+
+inline void cos(const float* in, float* out, std::size_t n) {
+  detail::map1<Native>(in, out, n, [](Native::vf x) { return cos<Native>(x); });
+}
+
+inline void exp(const float* in, float* out, std::size_t n) {
+  detail::map1<Native>(in, out, n, [](Native::vf x) { return exp<Native>(x); });
+}
+
+inline void log(const float* in, float* out, std::size_t n) {
+  detail::map1<Native>(in, out, n, [](Native::vf x) { return log<Native>(x); });
+}
+
+inline void pow(const float* x, const float* y, float* out, std::size_t n) {
+  detail::map2<Native>(x, y, out, n, [](Native::vf a, Native::vf b) {
+    return pow<Native>(a, b);
+  });
+}
+
+// Sum of a[i] * b[i]. The lanes are accumulated separately and added at the
+// end, so the result can differ from a sequential sum in the last bits.
+inline float dot(const float* a, const float* b, std::size_t n) {
+  typedef Native B;
+  B::vf acc = B::set1(0.0f);
+  const std::size_t body = n - n % B::width;
+  for (std::size_t i = 0; i < body; i += B::width) {
+    acc = B::madd(B::load(a + i), B::load(b + i), acc);
+  }
+  float lanes[B::width];
+  B::store(lanes, acc);
+  float sum = 0.0f;
+  for (int lane = 0; lane < B::width; lane++) {
+    sum += lanes[lane];
+  }
+  for (std::size_t i = body; i < n; i++) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+}  // namespace vmath
+
+#endif
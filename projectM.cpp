@@ -40,28 +40,30 @@
 #include "Pipeline.hpp"
 #include <iostream>
 #include "projectM.hpp"
+#include "AllocationCounter.hpp"
 #include "BeatDetect.hpp"
 #include "Preset.hpp"
 #include "PipelineMerger.hpp"
 #include "PCM.hpp"                    //Sound data handler (buffering, FFT, etc.)
+#include "PCMMixer.hpp"
 
 #include <map>
 
 #include "Renderer.hpp"
+#include "ShaderTranspileCache.hpp"
 #include "PresetChooser.hpp"
 #include "ConfigFile.h"
 #include "TextureManager.hpp"
 #include "TimeKeeper.hpp"
 #include "RenderItemMergeFunction.hpp"
+#include "TaskPool.hpp"
+
+#include <chrono>
+#include <sstream>
 
 #ifdef USE_THREADS
 #include "pthread.h"
 
-#include "BackgroundWorker.h"
-
-pthread_t thread;
-BackgroundWorkerSync worker_sync;
-
 #ifdef SYNC_PRESET_SWITCHES
 pthread_mutex_t preset_mutex;
 #endif
@@ -70,9 +72,6 @@ pthread_mutex_t preset_mutex;
 projectM::~projectM()
 {
 #ifdef USE_THREADS
-    void *status;
-    worker_sync.finish_up();
-    pthread_join(thread, &status);
     #ifdef SYNC_PRESET_SWITCHES
     pthread_mutex_destroy( &preset_mutex );
     #endif
@@ -88,6 +87,7 @@ projectM::~projectM()
         delete ( _pcm );
         _pcm = 0;
     }
+    delete _pcmMixer;
 
     if(timeKeeper) {
         delete timeKeeper;
@@ -96,6 +96,7 @@ projectM::~projectM()
 
     delete(_pipelineContext);
     delete(_pipelineContext2);
+    delete(_transitionPipeline);
 }
 
 unsigned projectM::initRenderToTexture()
@@ -110,7 +111,7 @@ void projectM::projectM_resetTextures()
 
 
 projectM::projectM ( std::string config_file, int flags) :
-        _pcm(0), beatDetect ( 0 ), renderer ( 0 ), _pipelineContext(new PipelineContext()), _pipelineContext2(new PipelineContext()), m_presetPos(0),
+        _pcm(0), _pcmMixer(0), beatDetect ( 0 ), renderer ( 0 ), _pipelineContext(new PipelineContext()), _pipelineContext2(new PipelineContext()), _transitionPipeline(new Pipeline()), m_presetPos(0),
         timeKeeper(NULL), m_flags(flags), _matcher(NULL), _merger(NULL)
 {
     readConfig(config_file);
@@ -120,7 +121,7 @@ projectM::projectM ( std::string config_file, int flags) :
 }
 
 projectM::projectM(Settings settings, int flags):
-        _pcm(0), beatDetect ( 0 ), renderer ( 0 ), _pipelineContext(new PipelineContext()), _pipelineContext2(new PipelineContext()), m_presetPos(0),
+        _pcm(0), _pcmMixer(0), beatDetect ( 0 ), renderer ( 0 ), _pipelineContext(new PipelineContext()), _pipelineContext2(new PipelineContext()), _transitionPipeline(new Pipeline()), m_presetPos(0),
         timeKeeper(NULL), m_flags(flags), _matcher(NULL), _merger(NULL), _settings(settings)
 {
     projectM_init ( _settings.meshX, _settings.meshY, _settings.fps,
@@ -147,9 +148,11 @@ bool projectM::writeConfig(const std::string & configFile, const Settings & sett
     config.add("Menu Font", settings.menuFontURL);
     config.add("Hard Cut Sensitivity", settings.beatSensitivity);
     config.add("Aspect Correction", settings.aspectCorrection);
+    config.add("Low Precision Blur", settings.lowPrecisionBlur);
     config.add("Easter Egg Parameter", settings.easterEgg);
     config.add("Shuffle Enabled", settings.shuffleEnabled);
     config.add("Soft Cut Ratings Enabled", settings.softCutRatingsEnabled);
+    config.add("Shader Cache Path", settings.shaderCacheDir);
     std::fstream file(configFile.c_str());
     if (file) {
         file << config;
@@ -215,6 +218,8 @@ void projectM::readConfig (const std::string & configFile )
     _settings.easterEgg = config.read<float> ( "Easter Egg Parameter", 0.0);
     _settings.softCutRatingsEnabled =
             config.read<bool> ( "Soft Cut Ratings Enabled", false);
+    _settings.shaderCacheDir = config.read<string> ( "Shader Cache Path", "" );
+    _settings.lowPrecisionBlur = config.read<bool> ( "Low Precision Blur", false );
 
     // Hard Cuts are preset transitions that occur when your music becomes louder. They only occur after a hard cut duration threshold has passed.
     _settings.hardcutEnabled = config.read<bool> ( "Hard Cuts Enabled", false );
@@ -245,28 +250,6 @@ void projectM::readConfig (const std::string & configFile )
 
 }
 
-#ifdef USE_THREADS
-static void *thread_callback(void *prjm)
-{
-    projectM *p = (projectM *)prjm;
-    p->thread_func(prjm);
-    return NULL;
-}
-
-
-void *projectM::thread_func(void *vptr_args)
-{
-    //  printf("in thread: %f\n", timeKeeper->PresetProgressB());
-    while (true)
-    {
-        if (!worker_sync.wait_for_work())
-            return NULL;
-        evaluateSecondPreset();
-        worker_sync.finished_work();
-    }
-}
-#endif
-
 void projectM::evaluateSecondPreset()
 {
     pipelineContext2().time = timeKeeper->GetRunningTime();
@@ -279,10 +262,9 @@ void projectM::evaluateSecondPreset()
 
 void projectM::renderFrame()
 {
-    Pipeline pipeline;
     Pipeline *comboPipeline;
     
-    comboPipeline = renderFrameOnlyPass1(&pipeline);
+    comboPipeline = renderFrameOnlyPass1(_transitionPipeline);
     
     renderFrameOnlyPass2(comboPipeline,0,0,0);
     
@@ -309,6 +291,8 @@ Pipeline * projectM::renderFrameOnlyPass1(Pipeline *pPipeline) /*pPipeline is a
     int x, y;
 #endif
 
+    frameAllocationsStart = AllocationCounter::ThreadCount();
+
     timeKeeper->UpdateTimers();
 /*
     if (timeKeeper->IsSmoothing())
@@ -328,6 +312,7 @@ Pipeline * projectM::renderFrameOnlyPass1(Pipeline *pPipeline) /*pPipeline is a
     pipelineContext().frame = timeKeeper->PresetFrameA();
     pipelineContext().progress = timeKeeper->PresetProgressA();
 
+    _pcmMixer->mix(*_pcm);
     beatDetect->detectFromSamples();
 
     //m_activePreset->evaluateFrame();
@@ -362,26 +347,27 @@ Pipeline * projectM::renderFrameOnlyPass1(Pipeline *pPipeline) /*pPipeline is a
         //	 printf("start thread\n");
         assert ( m_activePreset2.get() );
 
-#ifdef USE_THREADS
-        worker_sync.wake_up_bg();
-#endif
+        // Preset B is queued on the shared task pool while this thread renders
+        // preset A. Both split their per-pixel math into further tasks, which
+        // idle workers pick up, so the lighter preset's threads help with the
+        // heavier one. Wait() sleeps until preset B is done.
+        auto evaluate_second_preset = [this]() { evaluateSecondPreset(); };
+        TaskGroup presets;
+        presets.Run(evaluate_second_preset);
 
         m_activePreset->Render(*beatDetect, pipelineContext());
 
-#ifdef USE_THREADS
-        worker_sync.wait_for_bg_to_finish();
-#else
-        evaluateSecondPreset();
-#endif
+        presets.Wait();
 
 
         pPipeline->SetStaticPerPixel(settings().meshX, settings().meshY);
 
         assert(_matcher);
-        PipelineMerger::mergePipelines( m_activePreset->pipeline(),
-                                        m_activePreset2->pipeline(), *pPipeline,
-                                        _matcher->matchResults(),
-                                        *_merger, timeKeeper->SmoothRatio());
+        if (PipelineMerger::mergePipelines( m_activePreset->pipeline(),
+                                            m_activePreset2->pipeline(), *pPipeline,
+                                            _matcher->matchResults(),
+                                            *_merger, timeKeeper->SmoothRatio()))
+            steadyFrames = 0;
 
         renderer->RenderFrameOnlyPass1(*pPipeline, pipelineContext());
 
@@ -398,6 +384,7 @@ Pipeline * projectM::renderFrameOnlyPass1(Pipeline *pPipeline) /*pPipeline is a
             //printf("End Smooth\n");
             m_activePreset = std::move(m_activePreset2);
             timeKeeper->EndSmoothing();
+            steadyFrames = 0;
         }
         //printf("Normal\n");
 
@@ -469,6 +456,13 @@ void projectM::renderFrameEndOnSeparatePasses(Pipeline *pPipeline) {
     }
   
     count++;
+    lastFrameAllocations = AllocationCounter::ThreadCount() - frameAllocationsStart;
+    if (renderer->shadersUpdated() || renderer->drawsText())
+        steadyFrames = 0;
+    // Once a preset, or both presets of a soft transition, have run for a
+    // frame, everything they fill has grown to size.
+    assert(steadyFrames < 2 || lastFrameAllocations == 0);
+    steadyFrames++;
 #ifndef WIN32
     /** Frame-rate limiter */
     /** Compute once per preset */
@@ -508,12 +502,46 @@ void projectM::projectM_reset()
     this->count = 0;
 
     this->fpsstart = 0;
+    this->frameAllocationsStart = 0;
+    this->lastFrameAllocations = 0;
+    this->steadyFrames = 0;
 
     projectM_resetengine();
 }
 
+namespace {
+
+typedef std::chrono::steady_clock StartupClock;
+
+double millisecondsSince(StartupClock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(StartupClock::now() - start).count();
+}
+
+}  // namespace
+
 void projectM::projectM_init ( int gx, int gy, int fps, int texsize, int width, int height )
 {
+    const StartupClock::time_point initStart = StartupClock::now();
+    std::ostringstream report;
+
+    /* Set the seed to the current time in seconds */
+    srand ( time ( NULL ) );
+
+    // The preset factories, their builtin tables and the preset directory
+    // scan do not need GL; they are set up on the task pool while this thread
+    // initializes the renderer. Creating the pool here also starts its
+    // workers before the first transition needs them.
+    PresetLoader * presetLoader = nullptr;
+    double presetLoaderTime = 0;
+    auto loadPresets = [&]() {
+        const StartupClock::time_point start = StartupClock::now();
+        presetLoader = createPresetLoader(gx, gy);
+        presetLoaderTime = millisecondsSince(start);
+    };
+    TaskGroup presetTasks;
+    presetTasks.Run(loadPresets);
+
     /** Initialise start time */
     timeKeeper = new TimeKeeper(_settings.presetDuration,_settings.smoothPresetDuration, _settings.hardcutDuration, _settings.easterEgg);
 
@@ -525,6 +553,8 @@ void projectM::projectM_init ( int gx, int gy, int fps, int texsize, int width,
 
     if (!_pcm)
         _pcm = new PCM();
+    if (!_pcmMixer)
+        _pcmMixer = new PCMMixer();
     assert(pcm());
     beatDetect = new BeatDetect ( _pcm );
 
@@ -532,9 +562,20 @@ void projectM::projectM_init ( int gx, int gy, int fps, int texsize, int width,
         mspf= ( int ) ( 1000.0/ ( float ) _settings.fps );
     else mspf = 0;
 
+    StartupClock::time_point start = StartupClock::now();
+    ShaderTranspileCache::Get()->SetCacheDirectory(_settings.shaderCacheDir);
     this->renderer = new Renderer ( width, height, gx, gy, beatDetect, settings().presetURL, settings().titleFontURL, settings().menuFontURL, settings().datadir , settings().activateCompileContext, settings().deactivateCompileContext);
+    renderer->lowPrecisionBlur = _settings.lowPrecisionBlur;
+    report << "renderer: " << millisecondsSince(start) << " ms" << std::endl;
+
+    start = StartupClock::now();
+    presetTasks.Wait();
+    report << "preset loader: " << presetLoaderTime << " ms, waited "
+           << millisecondsSince(start) << " ms" << std::endl;
 
-    initPresetTools(gx, gy);
+    start = StartupClock::now();
+    initPresetTools(presetLoader);
+    report << "preset tools and idle preset: " << millisecondsSince(start) << " ms" << std::endl;
 
 
 #ifdef USE_THREADS
@@ -542,14 +583,6 @@ void projectM::projectM_init ( int gx, int gy, int fps, int texsize, int width,
     #ifdef SYNC_PRESET_SWITCHES
     pthread_mutex_init(&preset_mutex, NULL);
 #endif
-
-    worker_sync.reset();
-    if (pthread_create(&thread, NULL, thread_callback, this) != 0)
-    {
-
-        std::cerr << "[projectM] failed to allocate a thread! try building with option USE_THREADS turned off" << std::endl;;
-        exit(EXIT_FAILURE);
-    }
 #endif
 
     /// @bug order of operatoins here is busted
@@ -560,6 +593,11 @@ void projectM::projectM_init ( int gx, int gy, int fps, int texsize, int width,
     pipelineContext().fps = fps;
     pipelineContext2().fps = fps;
 
+    report << "total: " << millisecondsSince(initStart) << " ms" << std::endl;
+    startupReport = report.str();
+#ifdef DEBUG
+    std::cerr << "[projectM] startup" << std::endl << startupReport;
+#endif
 }
 
 /* Reinitializes the engine variables to a default (conservative and sane) value */
@@ -585,6 +623,7 @@ void projectM::projectM_resetGL ( int w, int h )
     _settings.windowWidth = w;
     _settings.windowHeight = h;
     renderer->reset ( w,h );
+    steadyFrames = 0;
 }
 
 /** Sets the title to display */
@@ -598,17 +637,16 @@ void projectM::projectM_setTitle ( std::string title ) {
 }
 
 
-int projectM::initPresetTools(int gx, int gy)
+PresetLoader * projectM::createPresetLoader(int gx, int gy) const
 {
+    std::string url = (m_flags & FLAG_DISABLE_PLAYLIST_LOAD) ? std::string() : _settings.presetURL;
+    return new PresetLoader ( gx, gy, url);
+}
 
-    /* Set the seed to the current time in seconds */
-    srand ( time ( NULL ) );
-
-    std::string url = (m_flags & FLAG_DISABLE_PLAYLIST_LOAD) ? std::string() : settings().presetURL;
-
-    if ( ( m_presetLoader = new PresetLoader ( gx, gy, url) ) == 0 )
+int projectM::initPresetTools(PresetLoader * presetLoader)
+{
+    if ( ( m_presetLoader = presetLoader ) == 0 )
     {
-        m_presetLoader = 0;
         std::cerr << "[projectM] error allocating preset loader" << std::endl;
         return PROJECTM_FAILURE;
     }
@@ -768,6 +806,7 @@ std::string projectM::switchPreset(const bool hardCut) {
         timeKeeper->StartSmoothing();
     }
 
+    steadyFrames = 0;
     if (result.empty()) {
         presetSwitchedEvent(hardCut, **m_presetPos);
         errorLoadingCurrentPreset = false;
@@ -967,6 +1006,7 @@ void projectM::changeTextureSize(int size) {
                             beatDetect, _settings.presetURL,
                             _settings.titleFontURL, _settings.menuFontURL,
                             _settings.datadir, _settings.activateCompileContext, _settings.deactivateCompileContext);
+    steadyFrames = 0;
 }
 void projectM::changeHardcutDuration(int seconds) {
     timeKeeper->ChangeHardcutDuration(seconds);
@@ -35,6 +35,7 @@
 #include <dirent.h>
 #endif /** WIN32 */
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <string>
 #include <cstdlib>
@@ -68,6 +69,7 @@ class PipelineContext;
 #include "PCM.hpp"
 class BeatDetect;
 class PCM;
+class PCMMixer;
 class Func;
 class Renderer;
 class Preset;
@@ -134,6 +136,9 @@ public:
         std::string titleFontURL;
         std::string menuFontURL;
         std::string datadir;
+        /// Directory for transpiled preset shaders and program binaries.
+        /// Empty keeps the shader cache in memory only.
+        std::string shaderCacheDir;
         int smoothPresetDuration;
         int presetDuration;
         bool hardcutEnabled;
@@ -141,6 +146,9 @@ public:
         float hardcutSensitivity;
         float beatSensitivity;
         bool aspectCorrection;
+        /// Store blur textures as RGB565, roughly halving the bandwidth of
+        /// the blur passes at the cost of some banding.
+        bool lowPrecisionBlur;
         float easterEgg;
         bool shuffleEnabled;
         bool softCutRatingsEnabled;
@@ -161,6 +169,7 @@ public:
             hardcutSensitivity(2.0),
             beatSensitivity(1.0),
             aspectCorrection(true),
+            lowPrecisionBlur(false),
             easterEgg(0.0),
             shuffleEnabled(true),
             softCutRatingsEnabled(false) {}
@@ -285,7 +294,10 @@ public:
   inline PCM * pcm() {
 	  return _pcm;
   }
-  void *thread_func(void *vptr_args);
+  /// Sources registered here are mixed into pcm() at the start of each frame
+  inline PCMMixer * pcmMixer() {
+	  return _pcmMixer;
+  }
   PipelineContext & pipelineContext() { return *_pipelineContext; }
   PipelineContext & pipelineContext2() { return *_pipelineContext2; }
 
@@ -298,15 +310,31 @@ public:
   int getWindowHeight() { return _settings.windowHeight; }
   bool getErrorLoadingCurrentPreset() const { return errorLoadingCurrentPreset; }
 
+  /// Heap allocations the rendering thread made during the last complete
+  /// frame, from the start of renderFrameOnlyPass1 to the end of
+  /// renderFrameEndOnSeparatePasses. Tasks that pool workers took are not
+  /// counted. Frames that do not switch presets should not allocate, and
+  /// DEBUG builds assert that they don't; see steadyFrames. Only counted in
+  /// DEBUG builds (see AllocationCounter.hpp); always zero otherwise.
+  uint64_t getLastFrameAllocations() const { return lastFrameAllocations; }
+
+  /// How long each step of initialization took, one "step: N ms" line per
+  /// step. The preset loader is set up while the renderer initializes, so
+  /// the steps add up to more than the total.
+  const std::string & getStartupReport() const { return startupReport; }
+
   void default_key_handler(projectMEvent event, projectMKeycode keycode);
   Renderer *renderer;
 
 private:
   PCM * _pcm;
+  PCMMixer * _pcmMixer;
   double sampledPresetDuration();
   BeatDetect * beatDetect;
   PipelineContext * _pipelineContext;
   PipelineContext * _pipelineContext2;
+  /// Merged pipeline rendered during soft transitions; reused across frames
+  Pipeline * _transitionPipeline;
   Settings _settings;
 
 
@@ -319,6 +347,14 @@ private:
   int timestart;
   int count;
   float fpsstart;
+  uint64_t frameAllocationsStart;
+  uint64_t lastFrameAllocations;
+  /// Frames rendered since the last preset switch, change of the preset
+  /// leading a transition, end of a transition, shader update, resize or
+  /// frame with text over it. Such frames may allocate, and so may the one
+  /// after, while buffers grow to size.
+  int steadyFrames;
+  std::string startupReport;
 
   void readConfig(const std::string &configFile);
   void projectM_init(int gx, int gy, int fps, int texsize, int width, int height);
@@ -327,8 +363,12 @@ private:
   void projectM_initengine();
   void projectM_resetengine();
 
-  /// Initializes preset loading / management libraries
-  int initPresetTools(int gx, int gy);
+  /// Sets up the preset factories and scans the preset directory. Does not
+  /// touch GL, so it may run on any thread.
+  PresetLoader * createPresetLoader(int gx, int gy) const;
+
+  /// Initializes preset loading / management libraries around presetLoader
+  int initPresetTools(PresetLoader * presetLoader);
 
   /// Deinitialize all preset related tools. Usually done before projectM cleanup
   void destroyPresetTools();
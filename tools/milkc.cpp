@@ -0,0 +1,92 @@
+//
+// milkc: compiles milkdrop presets into the binary form loaded by
+// PresetCodeFactory, see MilkdropPresetFactory/PresetCode.hpp
+//
+// usage: milkc [-o output] preset.milk...
+//
+// Each preset is written next to its source with the extension replaced,
+// unless a single preset is given with -o.
+//
+// Copyright: See COPYING file that comes with this distribution
+//
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MilkdropPresetFactory/MilkdropPreset.hpp"
+#include "MilkdropPresetFactory/MilkdropPresetFactory.hpp"
+#include "MilkdropPresetFactory/PresetCode.hpp"
+
+namespace {
+
+// Mesh size of the outputs the presets are loaded into; it does not affect
+// the compiled form.
+const int kMeshSize = 8;
+
+std::string OutputPath(const std::string &input) {
+  const std::string::size_type dot = input.find_last_of('.');
+  const std::string::size_type slash = input.find_last_of("/\\");
+  const std::string stem =
+      (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+          ? input
+          : input.substr(0, dot);
+  return stem + "." + PresetCode::EXTENSION;
+}
+
+bool Compile(MilkdropPresetFactory &factory, const std::string &input,
+             const std::string &output) {
+  std::unique_ptr<Preset> preset;
+  try {
+    preset = factory.allocate(input);
+  } catch (const PresetFactoryException &e) {
+    std::cerr << "milkc: " << e.message() << std::endl;
+    return false;
+  }
+
+  auto *milkdrop_preset = dynamic_cast<MilkdropPreset *>(preset.get());
+  std::string code;
+  if (milkdrop_preset == nullptr ||
+      !PresetCode::write(*milkdrop_preset, code)) {
+    std::cerr << "milkc: cannot compile \"" << input << "\"" << std::endl;
+    return false;
+  }
+
+  std::ofstream out(output.c_str(), std::ios::binary | std::ios::trunc);
+  out.write(code.data(), static_cast<std::streamsize>(code.size()));
+  if (!out) {
+    std::cerr << "milkc: cannot write \"" << output << "\"" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string output;
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "-o" && i + 1 < argc) {
+      output = argv[++i];
+    } else {
+      inputs.push_back(arg);
+    }
+  }
+
+  if (inputs.empty() || (!output.empty() && inputs.size() != 1)) {
+    std::cerr << "usage: milkc [-o output] preset.milk..." << std::endl;
+    return 2;
+  }
+
+  MilkdropPresetFactory factory(kMeshSize, kMeshSize);
+
+  bool ok = true;
+  for (const std::string &input : inputs) {
+    ok &= Compile(factory, input, output.empty() ? OutputPath(input) : output);
+  }
+  return ok ? 0 : 1;
+}